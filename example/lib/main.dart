@@ -35,7 +35,6 @@ class _MyAppState extends State<MyApp> {
   VolumeData? _currentVolumeData;
 
   // Audio recording and playback
-  final List<Uint8List> _audioChunks = [];
   String? _savedFilePath;
   final AudioPlayer _audioPlayer = AudioPlayer();
   bool _isPlaying = false;
@@ -99,21 +98,6 @@ class _MyAppState extends State<MyApp> {
       (audioData) {
         if (!mounted) return;
 
-        // Collect audio data during recording
-        if (_recordingState == RecordingState.recording) {
-          _audioChunks.add(Uint8List.fromList(audioData));
-
-          // Debug: Check if audio data contains actual audio (not silence)
-          if (_audioChunks.length % 100 == 0) { // Every 100 chunks
-            bool hasSoundData = audioData.any((byte) => byte != 0);
-            if (hasSoundData) {
-              print('音频数据正常 - 块 ${_audioChunks.length}: ${audioData.length} bytes, 包含音频数据');
-            } else {
-              print('警告: 音频数据块 ${_audioChunks.length} 全为静音');
-            }
-          }
-        }
-
         setState(() {
           _audioChunkCount++;
         });
@@ -230,10 +214,12 @@ class _MyAppState extends State<MyApp> {
         _setStatusMessage('开始录制成功');
         setState(() {
           _audioChunkCount = 0; // 重置计数器
-          _audioChunks.clear(); // 清空之前的录音数据
           _savedFilePath = null; // 清空保存的文件路径
         });
 
+        // 由原生写入线程直接保存WAV文件
+        await _startFileRecording();
+
         // 自动启动音量监听
         if (!_volumeMonitoringEnabled) {
           await _startVolumeMonitoring();
@@ -294,13 +280,19 @@ class _MyAppState extends State<MyApp> {
 
   Future<void> _stopRecording() async {
     try {
+      // 先结束文件写入以获取录音摘要
+      final fileResult = await _recorder.stopFileRecording();
+
       bool success = await _recorder.stopRecording();
       if (success) {
         _setStatusMessage('停止录制成功，共录制 $_audioChunkCount 个音频块');
 
-        // 自动保存录音文件
-        if (_audioChunks.isNotEmpty) {
-          await _saveRecording();
+        if (fileResult != null && fileResult.frames > 0) {
+          print('录音文件: $fileResult');
+          setState(() {
+            _savedFilePath = fileResult.path;
+          });
+          _setStatusMessage('录音已保存到: ${path.basename(fileResult.path)}');
         } else {
           _setStatusMessage('停止录制成功，但没有录制到音频数据');
         }
@@ -313,110 +305,22 @@ class _MyAppState extends State<MyApp> {
     }
   }
 
-  // 保存录音为WAV文件
-  Future<void> _saveRecording() async {
+  // 开始将录音写入WAV文件
+  Future<void> _startFileRecording() async {
     try {
-      if (_audioChunks.isEmpty) {
-        _setStatusMessage('没有录音数据可保存');
-        return;
-      }
-
       // 获取Documents目录
       final directory = await getApplicationDocumentsDirectory();
       final timestamp = DateTime.now().millisecondsSinceEpoch;
       final fileName = 'recording_$timestamp.wav';
       final filePath = path.join(directory.path, fileName);
 
-      // 创建WAV文件
-      await _createWavFile(filePath);
-
-      setState(() {
-        _savedFilePath = filePath;
-      });
-
-      _setStatusMessage('录音已保存到: $fileName');
-    } catch (e) {
-      _setStatusMessage('保存录音失败: $e');
-    }
-  }
-
-  // 创建WAV文件
-  Future<void> _createWavFile(String filePath) async {
-    // 计算总音频数据大小
-    int totalDataSize = _audioChunks.fold(0, (sum, chunk) => sum + chunk.length);
-
-    // 使用实际的音频格式参数
-    final format = _actualAudioFormat ?? AudioConfig();
-    final int sampleRate = format.sampleRate;
-    final int channels = format.channels;
-    final int bitsPerSample = format.bitsPerSample;
-    final int byteRate = sampleRate * channels * (bitsPerSample ~/ 8);
-    final int blockAlign = channels * (bitsPerSample ~/ 8);
-
-    print('创建WAV文件 - 采样率: ${sampleRate}Hz, 声道: $channels, 位深度: ${bitsPerSample}bit');
-    print('音频数据大小: $totalDataSize bytes, 音频块数: ${_audioChunks.length}');
-
-    // 检查音频数据完整性
-    int nonZeroChunks = 0;
-    for (final chunk in _audioChunks) {
-      if (chunk.any((byte) => byte != 0)) {
-        nonZeroChunks++;
+      bool success = await _recorder.startFileRecording(filePath);
+      if (!success) {
+        _setStatusMessage('无法创建录音文件: $fileName');
       }
+    } catch (e) {
+      _setStatusMessage('创建录音文件失败: $e');
     }
-    print('包含音频数据的块数: $nonZeroChunks / ${_audioChunks.length}');
-
-    if (nonZeroChunks == 0) {
-      print('警告: 所有音频数据都是静音！');
-    }
-
-    final file = File(filePath);
-    final sink = file.openWrite();
-
-    // 写入WAV头部
-    final header = ByteData(44);
-
-    // RIFF Header
-    header.setUint8(0, 0x52); // 'R'
-    header.setUint8(1, 0x49); // 'I'
-    header.setUint8(2, 0x46); // 'F'
-    header.setUint8(3, 0x46); // 'F'
-    header.setUint32(4, totalDataSize + 36, Endian.little); // File size - 8
-
-    // WAVE Header
-    header.setUint8(8, 0x57);   // 'W'
-    header.setUint8(9, 0x41);   // 'A'
-    header.setUint8(10, 0x56);  // 'V'
-    header.setUint8(11, 0x45);  // 'E'
-
-    // Format Chunk
-    header.setUint8(12, 0x66);  // 'f'
-    header.setUint8(13, 0x6D);  // 'm'
-    header.setUint8(14, 0x74);  // 't'
-    header.setUint8(15, 0x20);  // ' '
-    header.setUint32(16, 16, Endian.little);      // Format chunk size
-    header.setUint16(20, 1, Endian.little);       // PCM format
-    header.setUint16(22, channels, Endian.little);
-    header.setUint32(24, sampleRate, Endian.little);
-    header.setUint32(28, byteRate, Endian.little);
-    header.setUint16(32, blockAlign, Endian.little);
-    header.setUint16(34, bitsPerSample, Endian.little);
-
-    // Data Chunk
-    header.setUint8(36, 0x64);  // 'd'
-    header.setUint8(37, 0x61);  // 'a'
-    header.setUint8(38, 0x74);  // 't'
-    header.setUint8(39, 0x61);  // 'a'
-    header.setUint32(40, totalDataSize, Endian.little);
-
-    // 写入头部
-    sink.add(header.buffer.asUint8List());
-
-    // 写入音频数据
-    for (final chunk in _audioChunks) {
-      sink.add(chunk);
-    }
-
-    await sink.close();
   }
 
   // 播放录音
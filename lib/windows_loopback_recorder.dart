@@ -1,8 +1,9 @@
+import 'dart:isolate';
 import 'dart:typed_data';
 import 'windows_loopback_recorder_platform_interface.dart';
 
 /// Export the API classes for external use
-export 'windows_loopback_recorder_platform_interface.dart' show RecordingState, AudioConfig, VolumeData;
+export 'windows_loopback_recorder_platform_interface.dart' show RecordingState, AudioConfig, VolumeData, BackpressurePolicy, AudioEncoding, Dither, RecordingFileFormat, DeliveryStats, AudioPacket, PipelineStageStats, FileRecordingResult, FileSegment, PreRollSnapshot, MeterLevels, SpectrumData, VadStats, NoiseSuppressionStats, WaveformPeaks, FeatureFrames;
 
 /// Windows Loopback Recorder Plugin
 ///
@@ -81,9 +82,11 @@ class WindowsLoopbackRecorder {
   /// Start volume monitoring
   ///
   /// Begins monitoring the mixed audio volume (system + microphone)
+  /// [intervalMs] - Audio per update; levels in between are aggregated
+  /// (0 = one update per capture packet)
   /// Returns true if volume monitoring started successfully
-  Future<bool> startVolumeMonitoring() {
-    return _platform.startVolumeMonitoring();
+  Future<bool> startVolumeMonitoring({int intervalMs = 33}) {
+    return _platform.startVolumeMonitoring(intervalMs: intervalMs);
   }
 
   /// Stop volume monitoring
@@ -94,9 +97,264 @@ class WindowsLoopbackRecorder {
     return _platform.stopVolumeMonitoring();
   }
 
+  /// Start a new integrated loudness measurement
+  ///
+  /// [VolumeData.integratedLufs] otherwise covers everything metered since
+  /// [startRecording], e.g. reset it at the start of each program.
+  Future<bool> resetLoudness() {
+    return _platform.resetLoudness();
+  }
+
   /// Get the volume data stream
   ///
   /// Returns a Stream of VolumeData containing real-time volume information
   /// including RMS, decibels, and percentage values
   Stream<VolumeData> get volumeStream => _platform.volumeStream;
+
+  /// Start the spectrum stream
+  ///
+  /// The mixed audio is analyzed natively: a Hann-windowed FFT of the last
+  /// [fftSize] samples, reduced to [bands] log-spaced bands between [minHz]
+  /// and [maxHz] (limited to half the sample rate).
+  /// [intervalMs] - Audio per update
+  /// Returns false if the settings are invalid
+  Future<bool> startSpectrum({
+    int intervalMs = 50,
+    int fftSize = 2048,
+    int bands = 32,
+    double minHz = 20.0,
+    double maxHz = 20000.0,
+  }) {
+    return _platform.startSpectrum(
+      intervalMs: intervalMs,
+      fftSize: fftSize,
+      bands: bands,
+      minHz: minHz,
+      maxHz: maxHz,
+    );
+  }
+
+  /// Stop the spectrum stream
+  Future<bool> stopSpectrum() {
+    return _platform.stopSpectrum();
+  }
+
+  /// Get the spectrum data stream
+  ///
+  /// Returns a Stream of SpectrumData with the level of each band in dBFS
+  Stream<SpectrumData> get spectrumStream => _platform.spectrumStream;
+
+  /// Start the feature stream for speech models
+  ///
+  /// The mixed audio is turned natively into one row every 10 ms: the
+  /// pre-emphasized audio of the last 25 ms, Hann-windowed and transformed,
+  /// through [melBins] triangular mel filters between [minHz] and [maxHz]
+  /// (limited to half the sample rate), as natural log energies. With
+  /// [mfcc] above zero, rows hold that many cepstral coefficients instead.
+  /// [preEmphasis] - Coefficient a of x[n] - a x[n-1]; 0 turns it off
+  /// [rowsPerUpdate] - Rows sent together on [featureStream]
+  /// Returns false if the settings are invalid
+  Future<bool> startFeatures({
+    int melBins = 80,
+    int mfcc = 0,
+    double minHz = 20.0,
+    double maxHz = 8000.0,
+    double preEmphasis = 0.97,
+    int rowsPerUpdate = 10,
+  }) {
+    return _platform.startFeatures(
+      melBins: melBins,
+      mfcc: mfcc,
+      minHz: minHz,
+      maxHz: maxHz,
+      preEmphasis: preEmphasis,
+      rowsPerUpdate: rowsPerUpdate,
+    );
+  }
+
+  /// Stop the feature stream
+  Future<bool> stopFeatures() {
+    return _platform.stopFeatures();
+  }
+
+  /// Get the feature stream
+  ///
+  /// Returns a Stream of FeatureFrames, each with [rowsPerUpdate] rows
+  Stream<FeatureFrames> get featureStream => _platform.featureStream;
+
+  /// Start voice activity detection
+  ///
+  /// The microphone and the delivered mix are each scored natively on energy
+  /// above the noise floor and on spectral shape; speech from either counts.
+  /// With [AudioConfig.packetHeader], packets carry [AudioPacket.isSpeech]
+  /// and [AudioPacket.speechProbability]. Only audio delivery needs this;
+  /// file recording and the pre-roll keep every frame.
+  /// [threshold] - Smoothed probability (0 to 1) that counts as speech
+  /// [hangoverMs] - How long speech lasts after the last speech frame
+  /// [gate] - Deliver only speech, plus [paddingMs] before and after each
+  /// segment; the first packet after a gap is flagged as a discontinuity
+  /// Returns false if the settings are invalid
+  Future<bool> startVad({
+    double threshold = 0.5,
+    int hangoverMs = 200,
+    bool gate = false,
+    int paddingMs = 300,
+  }) {
+    return _platform.startVad(
+      threshold: threshold,
+      hangoverMs: hangoverMs,
+      gate: gate,
+      paddingMs: paddingMs,
+    );
+  }
+
+  /// Stop voice activity detection; delivery is no longer gated
+  Future<bool> stopVad() {
+    return _platform.stopVad();
+  }
+
+  /// Get voice activity detection state and how much audio the gate held back
+  Future<VadStats> getVadStats() {
+    return _platform.getVadStats();
+  }
+
+  /// Get the fixed latency noise suppression adds and the noise floors it
+  /// has estimated
+  Future<NoiseSuppressionStats> getNoiseSuppressionStats() {
+    return _platform.getNoiseSuppressionStats();
+  }
+
+  /// Deliver audio directly to a native port
+  ///
+  /// While attached, each audio chunk is posted from the capture thread to
+  /// [port] as a Uint8List whose memory is owned by the receiving isolate,
+  /// bypassing the platform thread and [audioStream]. Pass the SendPort of a
+  /// ReceivePort created in a background isolate to process audio there.
+  /// Silence markers arrive as ints; expand them with the encoding's silence
+  /// byte (0 for PCM, 0xFF for µ-law, 0xD5 for A-law).
+  /// Returns true if the port was attached
+  Future<bool> attachAudioPort(SendPort port) {
+    return _platform.attachAudioPort(port);
+  }
+
+  /// Stop delivering audio to the native port
+  ///
+  /// Audio returns to [audioStream].
+  /// Returns true if the port was detached
+  Future<bool> detachAudioPort() {
+    return _platform.detachAudioPort();
+  }
+
+  /// Acknowledge consumed audio chunks
+  ///
+  /// Only needed with a [BackpressurePolicy] other than none while audio is
+  /// delivered to a native port; [audioStream] acknowledges automatically.
+  /// Silence markers (int messages) count as chunks.
+  Future<void> acknowledgeAudio(int count) {
+    return _platform.acknowledgeAudio(count);
+  }
+
+  /// Get audio delivery counters
+  ///
+  /// Returns dropped-frame and high-watermark counters of the delivery queue
+  Future<DeliveryStats> getDeliveryStats() {
+    return _platform.getDeliveryStats();
+  }
+
+  /// Get per-stage pipeline counters
+  ///
+  /// Keys are stage names (mix, convert, deliver, meter, record). A stage is skipped
+  /// for every capture packet while nothing consumes its output.
+  Future<Map<String, PipelineStageStats>> getPipelineStats() {
+    return _platform.getPipelineStats();
+  }
+
+  /// Start writing the recording to a WAV file
+  ///
+  /// [path] - Destination file; an existing file is overwritten
+  /// [segmentSeconds] - Roll over to a new file after this many seconds
+  /// [segmentBytes] - Roll over before a file would exceed this size
+  /// [format] - WAV, or lossless FLAC at about half the size
+  /// [peaks] - Also build waveform peaks for [queryPeaks]
+  /// The file receives the processed audio (see [getAudioFormat]) from a
+  /// native writer thread, independent of [audioStream]. Its header is
+  /// refreshed every second so an interrupted recording remains playable,
+  /// and files past 4 GiB switch to RF64. Requires an active recording;
+  /// FLAC also fails for 32-bit and float samples.
+  ///
+  /// With a segment limit, files are named `<name>_000000.wav`,
+  /// `<name>_000001.wav`, ... and cut at exact sample positions; see
+  /// [fileSegmentStream].
+  ///
+  /// With [peaks], a min/max/RMS pyramid of the audio is built as it is
+  /// written and saved next to the file as `<path>.peaks` (see
+  /// [FileRecordingResult.peaksPath]), covering every segment.
+  Future<bool> startFileRecording(String path,
+      {int segmentSeconds = 0,
+      int segmentBytes = 0,
+      RecordingFileFormat format = RecordingFileFormat.wav,
+      bool peaks = false}) {
+    return _platform.startFileRecording(path,
+        segmentSeconds: segmentSeconds, segmentBytes: segmentBytes, format: format, peaks: peaks);
+  }
+
+  /// Reduce frames [startFrame, endFrame) of the waveform to [columns] columns
+  ///
+  /// Without [path], reads the peaks of the file recording in progress,
+  /// started with `peaks: true`; with it, reads a `.peaks` file saved by an
+  /// earlier recording. Each column comes from the coarsest level whose
+  /// buckets fit in it, so the cost follows [columns], not the range.
+  /// Returns null when there are no peaks for the range.
+  Future<WaveformPeaks?> queryPeaks(
+      {String? path, required int startFrame, required int endFrame, required int columns}) {
+    return _platform.queryPeaks(path: path, startFrame: startFrame, endFrame: endFrame, columns: columns);
+  }
+
+  /// Finish the file recording and return its summary
+  ///
+  /// Returns null if no file recording was active. [stopRecording] also
+  /// finishes the file, but discards the summary.
+  Future<FileRecordingResult?> stopFileRecording() {
+    return _platform.stopFileRecording();
+  }
+
+  /// Stream of finished recording files
+  ///
+  /// Emits once per file after it is closed, with its path and sample range.
+  /// Listen before [startFileRecording] to see every segment.
+  Stream<FileSegment> get fileSegmentStream => _platform.fileSegmentStream;
+
+  /// Keep the most recent processed audio in memory so it can be saved
+  /// after the fact
+  ///
+  /// [budgetBytes] - Memory the ring may hold; older audio is evicted
+  /// [compressed] - Hold FLAC frames, fitting roughly twice the audio; PCM
+  /// for 32-bit and float samples, which FLAC cannot hold
+  /// Can be armed before [startRecording] and stays armed across recordings
+  /// until [stopPreRoll]. Fails for budgets below two blocks (200 ms of PCM,
+  /// or two FLAC frames).
+  Future<bool> startPreRoll({int budgetBytes = 16 << 20, bool compressed = false}) {
+    return _platform.startPreRoll(budgetBytes: budgetBytes, compressed: compressed);
+  }
+
+  /// Disarm the pre-roll ring and release its memory
+  Future<bool> stopPreRoll() {
+    return _platform.stopPreRoll();
+  }
+
+  /// Write the last [seconds] of the pre-roll ring to [path] (0 = everything)
+  ///
+  /// Capture keeps running while the file is written. Compressed rings save
+  /// FLAC, starting on a frame boundary. Returns null if the ring is empty
+  /// or the file cannot be written.
+  Future<PreRollSnapshot?> savePreRoll(String path, {int seconds = 0}) {
+    return _platform.savePreRoll(path, seconds: seconds);
+  }
+
+  /// The last [seconds] of the pre-roll ring as a complete WAV or FLAC file
+  ///
+  /// Returns null if the ring is not armed or holds no audio.
+  Future<Uint8List?> getPreRoll({int seconds = 0}) {
+    return _platform.getPreRoll(seconds: seconds);
+  }
 }
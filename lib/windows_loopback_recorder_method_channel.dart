@@ -1,4 +1,6 @@
 import 'dart:async';
+import 'dart:ffi' show NativeApi;
+import 'dart:isolate';
 import 'package:flutter/foundation.dart';
 import 'package:flutter/services.dart';
 
@@ -18,12 +20,38 @@ class MethodChannelWindowsLoopbackRecorder extends WindowsLoopbackRecorderPlatfo
   @visibleForTesting
   final volumeEventChannel = const EventChannel('windows_loopback_recorder/volume_stream');
 
+  /// The event channel used for spectrum data.
+  @visibleForTesting
+  final spectrumEventChannel = const EventChannel('windows_loopback_recorder/spectrum_stream');
+
+  /// The event channel used for log-mel and MFCC features.
+  @visibleForTesting
+  final featureEventChannel = const EventChannel('windows_loopback_recorder/feature_stream');
+
+  /// The event channel used for file recording events.
+  @visibleForTesting
+  final fileEventChannel = const EventChannel('windows_loopback_recorder/file_events');
+
   StreamSubscription<dynamic>? _audioStreamSubscription;
-  final StreamController<Uint8List> _audioStreamController = StreamController<Uint8List>.broadcast();
+  // Synchronous so a chunk counts as consumed only after listeners ran.
+  final StreamController<Uint8List> _audioStreamController = StreamController<Uint8List>.broadcast(sync: true);
+
+  // Flow control: acknowledge every _ackBatch chunks (0 = disabled)
+  int _ackBatch = 0;
+  int _unacknowledgedChunks = 0;
+
+  // Byte that decodes to silence in the delivered encoding
+  int _silenceByte = 0;
 
   StreamSubscription<dynamic>? _volumeStreamSubscription;
   final StreamController<VolumeData> _volumeStreamController = StreamController<VolumeData>.broadcast();
 
+  StreamSubscription<dynamic>? _spectrumStreamSubscription;
+  final StreamController<SpectrumData> _spectrumStreamController = StreamController<SpectrumData>.broadcast();
+
+  StreamSubscription<dynamic>? _featureStreamSubscription;
+  final StreamController<FeatureFrames> _featureStreamController = StreamController<FeatureFrames>.broadcast();
+
   @override
   Future<String?> getPlatformVersion() async {
     final version = await methodChannel.invokeMethod<String>('getPlatformVersion');
@@ -34,6 +62,13 @@ class MethodChannelWindowsLoopbackRecorder extends WindowsLoopbackRecorderPlatfo
   Future<bool> startRecording({AudioConfig? config}) async {
     final result = await methodChannel.invokeMethod<bool>('startRecording', config?.toMap());
     if (result == true) {
+      final flowControlled = config != null && config.backpressurePolicy != BackpressurePolicy.none;
+      _ackBatch = flowControlled ? (config.maxQueuedChunks ~/ 4).clamp(1, 1 << 30) : 0;
+      _silenceByte = switch (config?.encoding) {
+        AudioEncoding.muLaw => 0xFF,
+        AudioEncoding.aLaw => 0xD5,
+        _ => 0,
+      };
       _setupAudioStream();
     }
     return result ?? false;
@@ -114,8 +149,10 @@ class MethodChannelWindowsLoopbackRecorder extends WindowsLoopbackRecorderPlatfo
   }
 
   @override
-  Future<bool> startVolumeMonitoring() async {
-    final result = await methodChannel.invokeMethod<bool>('startVolumeMonitoring');
+  Future<bool> startVolumeMonitoring({int intervalMs = 33}) async {
+    final result = await methodChannel.invokeMethod<bool>('startVolumeMonitoring', {
+      'intervalMs': intervalMs,
+    });
     if (result == true) {
       _setupVolumeStream();
     }
@@ -130,14 +167,264 @@ class MethodChannelWindowsLoopbackRecorder extends WindowsLoopbackRecorderPlatfo
     return result ?? false;
   }
 
+  @override
+  Future<bool> resetLoudness() async {
+    final result = await methodChannel.invokeMethod<bool>('resetLoudness');
+    return result ?? false;
+  }
+
   @override
   Stream<VolumeData> get volumeStream => _volumeStreamController.stream;
 
+  @override
+  Future<bool> startSpectrum({
+    int intervalMs = 50,
+    int fftSize = 2048,
+    int bands = 32,
+    double minHz = 20.0,
+    double maxHz = 20000.0,
+  }) async {
+    final result = await methodChannel.invokeMethod<bool>('startSpectrum', {
+      'intervalMs': intervalMs,
+      'fftSize': fftSize,
+      'bands': bands,
+      'minHz': minHz,
+      'maxHz': maxHz,
+    });
+    if (result == true && _spectrumStreamSubscription == null) {
+      _setupSpectrumStream();
+    }
+    return result ?? false;
+  }
+
+  @override
+  Future<bool> stopSpectrum() async {
+    final result = await methodChannel.invokeMethod<bool>('stopSpectrum');
+    await _spectrumStreamSubscription?.cancel();
+    _spectrumStreamSubscription = null;
+    return result ?? false;
+  }
+
+  @override
+  Stream<SpectrumData> get spectrumStream => _spectrumStreamController.stream;
+
+  @override
+  Future<bool> startFeatures({
+    int melBins = 80,
+    int mfcc = 0,
+    double minHz = 20.0,
+    double maxHz = 8000.0,
+    double preEmphasis = 0.97,
+    int rowsPerUpdate = 10,
+  }) async {
+    final result = await methodChannel.invokeMethod<bool>('startFeatures', {
+      'melBins': melBins,
+      'mfcc': mfcc,
+      'minHz': minHz,
+      'maxHz': maxHz,
+      'preEmphasis': preEmphasis,
+      'rowsPerUpdate': rowsPerUpdate,
+    });
+    if (result == true && _featureStreamSubscription == null) {
+      _setupFeatureStream();
+    }
+    return result ?? false;
+  }
+
+  @override
+  Future<bool> stopFeatures() async {
+    final result = await methodChannel.invokeMethod<bool>('stopFeatures');
+    await _featureStreamSubscription?.cancel();
+    _featureStreamSubscription = null;
+    return result ?? false;
+  }
+
+  @override
+  Stream<FeatureFrames> get featureStream => _featureStreamController.stream;
+
+  @override
+  Future<bool> startVad({
+    double threshold = 0.5,
+    int hangoverMs = 200,
+    bool gate = false,
+    int paddingMs = 300,
+  }) async {
+    final result = await methodChannel.invokeMethod<bool>('startVad', {
+      'threshold': threshold,
+      'hangoverMs': hangoverMs,
+      'gate': gate,
+      'paddingMs': paddingMs,
+    });
+    return result ?? false;
+  }
+
+  @override
+  Future<bool> stopVad() async {
+    final result = await methodChannel.invokeMethod<bool>('stopVad');
+    return result ?? false;
+  }
+
+  @override
+  Future<VadStats> getVadStats() async {
+    final result = await methodChannel.invokeMethod('getVadStats');
+    if (result is Map) {
+      return VadStats.fromMap(Map<String, dynamic>.from(result));
+    }
+    return const VadStats();
+  }
+
+  @override
+  Future<NoiseSuppressionStats> getNoiseSuppressionStats() async {
+    final result = await methodChannel.invokeMethod('getNoiseSuppressionStats');
+    if (result is Map) {
+      return NoiseSuppressionStats.fromMap(Map<String, dynamic>.from(result));
+    }
+    return const NoiseSuppressionStats();
+  }
+
+  @override
+  Future<bool> attachAudioPort(SendPort port) async {
+    final result = await methodChannel.invokeMethod<bool>('attachAudioPort', {
+      'port': port.nativePort,
+      'postCObject': NativeApi.postCObject.address,
+    });
+    return result ?? false;
+  }
+
+  @override
+  Future<bool> detachAudioPort() async {
+    final result = await methodChannel.invokeMethod<bool>('detachAudioPort');
+    return result ?? false;
+  }
+
+  @override
+  Future<void> acknowledgeAudio(int count) async {
+    await methodChannel.invokeMethod<bool>('acknowledgeAudio', {'count': count});
+  }
+
+  @override
+  Future<DeliveryStats> getDeliveryStats() async {
+    final result = await methodChannel.invokeMethod('getDeliveryStats');
+    if (result is Map) {
+      return DeliveryStats.fromMap(Map<String, dynamic>.from(result));
+    }
+    return const DeliveryStats();
+  }
+
+  @override
+  Future<Map<String, PipelineStageStats>> getPipelineStats() async {
+    final result = await methodChannel.invokeMethod('getPipelineStats');
+    final Map<String, PipelineStageStats> stages = {};
+    if (result is Map) {
+      result.forEach((key, value) {
+        if (key is String && value is Map) {
+          stages[key] = PipelineStageStats.fromMap(Map<String, dynamic>.from(value));
+        }
+      });
+    }
+    return stages;
+  }
+
+  @override
+  Future<bool> startFileRecording(String path,
+      {int segmentSeconds = 0,
+      int segmentBytes = 0,
+      RecordingFileFormat format = RecordingFileFormat.wav,
+      bool peaks = false}) async {
+    final result = await methodChannel.invokeMethod<bool>('startFileRecording', {
+      'path': path,
+      'segmentSeconds': segmentSeconds,
+      'segmentBytes': segmentBytes,
+      'format': format.index,
+      'peaks': peaks,
+    });
+    return result ?? false;
+  }
+
+  @override
+  Future<WaveformPeaks?> queryPeaks(
+      {String? path, required int startFrame, required int endFrame, required int columns}) async {
+    final result = await methodChannel.invokeMethod('queryPeaks', {
+      if (path != null) 'path': path,
+      'startFrame': startFrame,
+      'endFrame': endFrame,
+      'columns': columns,
+    });
+    if (result is Map) {
+      return WaveformPeaks.fromMap(Map<String, dynamic>.from(result));
+    }
+    return null;
+  }
+
+  @override
+  Future<FileRecordingResult?> stopFileRecording() async {
+    final result = await methodChannel.invokeMethod('stopFileRecording');
+    if (result is Map) {
+      return FileRecordingResult.fromMap(Map<String, dynamic>.from(result));
+    }
+    return null;
+  }
+
+  @override
+  Stream<FileSegment> get fileSegmentStream => fileEventChannel
+      .receiveBroadcastStream()
+      .where((event) => event is Map && event['event'] == 'segmentComplete')
+      .map((event) => FileSegment.fromMap(Map<String, dynamic>.from(event as Map)));
+
+  @override
+  Future<bool> startPreRoll({int budgetBytes = 16 << 20, bool compressed = false}) async {
+    final result = await methodChannel.invokeMethod<bool>('startPreRoll', {
+      'budgetBytes': budgetBytes,
+      'compressed': compressed,
+    });
+    return result ?? false;
+  }
+
+  @override
+  Future<bool> stopPreRoll() async {
+    final result = await methodChannel.invokeMethod<bool>('stopPreRoll');
+    return result ?? false;
+  }
+
+  @override
+  Future<PreRollSnapshot?> savePreRoll(String path, {int seconds = 0}) async {
+    final result = await methodChannel.invokeMethod('savePreRoll', {
+      'path': path,
+      'seconds': seconds,
+    });
+    if (result is Map) {
+      return PreRollSnapshot.fromMap(Map<String, dynamic>.from(result));
+    }
+    return null;
+  }
+
+  @override
+  Future<Uint8List?> getPreRoll({int seconds = 0}) {
+    return methodChannel.invokeMethod<Uint8List>('getPreRoll', {'seconds': seconds});
+  }
+
   void _setupAudioStream() {
+    _unacknowledgedChunks = 0;
     _audioStreamSubscription = eventChannel.receiveBroadcastStream().listen(
       (dynamic data) {
         if (data is Uint8List) {
           _audioStreamController.add(data);
+        } else if (data is int) {
+          // Silence marker: audio dropped by BackpressurePolicy.dropNewest.
+          // Headered streams receive a stamped silent packet instead.
+          final silence = Uint8List(data);
+          if (_silenceByte != 0) {
+            silence.fillRange(0, data, _silenceByte);
+          }
+          _audioStreamController.add(silence);
+        } else {
+          return;
+        }
+
+        if (_ackBatch > 0 && ++_unacknowledgedChunks >= _ackBatch) {
+          final count = _unacknowledgedChunks;
+          _unacknowledgedChunks = 0;
+          acknowledgeAudio(count);
         }
       },
       onError: (error) {
@@ -150,7 +437,9 @@ class MethodChannelWindowsLoopbackRecorder extends WindowsLoopbackRecorderPlatfo
     _volumeStreamSubscription = volumeEventChannel.receiveBroadcastStream().listen(
       (dynamic data) {
         try {
-          if (data is Map) {
+          if (data is Float32List) {
+            _volumeStreamController.add(VolumeData.fromFloats(data));
+          } else if (data is Map) {
             // Convert to Map<String, dynamic> safely
             final Map<String, dynamic> volumeMap = {};
             data.forEach((key, value) {
@@ -171,10 +460,40 @@ class MethodChannelWindowsLoopbackRecorder extends WindowsLoopbackRecorderPlatfo
     );
   }
 
+  void _setupSpectrumStream() {
+    _spectrumStreamSubscription = spectrumEventChannel.receiveBroadcastStream().listen(
+      (dynamic data) {
+        if (data is Float32List) {
+          _spectrumStreamController.add(SpectrumData.fromFloats(data));
+        }
+      },
+      onError: (error) {
+        debugPrint('Spectrum stream error: $error');
+      },
+    );
+  }
+
+  void _setupFeatureStream() {
+    _featureStreamSubscription = featureEventChannel.receiveBroadcastStream().listen(
+      (dynamic data) {
+        if (data is Float32List) {
+          _featureStreamController.add(FeatureFrames.fromFloats(data));
+        }
+      },
+      onError: (error) {
+        debugPrint('Feature stream error: $error');
+      },
+    );
+  }
+
   void dispose() {
     _audioStreamSubscription?.cancel();
     _volumeStreamSubscription?.cancel();
+    _spectrumStreamSubscription?.cancel();
+    _featureStreamSubscription?.cancel();
     _audioStreamController.close();
     _volumeStreamController.close();
+    _spectrumStreamController.close();
+    _featureStreamController.close();
   }
 }
@@ -1,3 +1,5 @@
+import 'dart:isolate';
+import 'dart:math' as math;
 import 'dart:typed_data';
 import 'package:plugin_platform_interface/plugin_platform_interface.dart';
 
@@ -10,16 +12,129 @@ enum RecordingState {
   paused,
 }
 
+/// What the native side does when the audio consumer falls behind
+enum BackpressurePolicy {
+  /// Deliver everything immediately; memory is unbounded
+  none,
+
+  /// Stall capture until the consumer catches up
+  block,
+
+  /// Discard the oldest queued chunks
+  dropOldest,
+
+  /// Discard new chunks and deliver a block of silence in their place
+  dropNewest,
+}
+
+/// Encoding of the chunks on [WindowsLoopbackRecorder.audioStream]
+enum AudioEncoding {
+  /// Raw interleaved PCM
+  pcm,
+
+  /// FLAC frames; the first chunk starts with the `fLaC` stream header
+  flac,
+
+  /// G.711 µ-law, one byte per sample
+  muLaw,
+
+  /// G.711 A-law, one byte per sample
+  aLaw,
+
+  /// IMA ADPCM, 4 bits per sample; each chunk is one self-contained block
+  /// in the WAVE_FORMAT_IMA_ADPCM layout
+  imaAdpcm,
+}
+
+/// Noise added before samples are rounded to 16 or 24 bits
+enum Dither {
+  /// Round as is; quiet passages distort below the last bit
+  none,
+
+  /// Triangular noise of ±1 LSB, which turns that distortion into a
+  /// constant, signal-independent hiss
+  triangular,
+
+  /// Triangular noise pushed towards high frequencies, where it is less
+  /// audible, at twice the total power
+  noiseShaped,
+}
+
+/// Container written by [WindowsLoopbackRecorderPlatform.startFileRecording]
+enum RecordingFileFormat {
+  wav,
+  flac,
+}
+
 /// Audio configuration parameters
 class AudioConfig {
   final int sampleRate;
   final int channels;
+  /// Delivered sample size: 16, 24 (packed) or 32. Encoded output, the file
+  /// and analysis use 16; [getAudioFormat] reports what is delivered
   final int bitsPerSample;
 
+  /// With 32 [bitsPerSample], IEEE float samples rather than integers
+  final bool floatSamples;
+
+  /// Noise added before rounding to 16 or 24 bits
+  final Dither dither;
+
+  /// Emit exact frames of this many milliseconds (0 = off)
+  final int frameDurationMs;
+
+  /// Coalesce audio until at least this many bytes are pending (0 = off)
+  final int minChunkBytes;
+
+  /// Coalesce audio until this many milliseconds are pending (0 = off)
+  final int maxLatencyMs;
+
+  /// Flow control between native capture and the Dart consumer
+  final BackpressurePolicy backpressurePolicy;
+
+  /// Chunks allowed to wait for the consumer before [backpressurePolicy] applies
+  final int maxQueuedChunks;
+
+  /// Prefix every audio chunk with a header; parse with [AudioPacket.tryParse]
+  final bool packetHeader;
+
+  /// Encoding of delivered chunks; with FLAC and IMA ADPCM each chunk holds
+  /// one frame/block of about [frameDurationMs]
+  final AudioEncoding encoding;
+
+  /// Remove the system audio the microphone picks up from the speakers
+  /// before mixing; needs both devices at one sample rate
+  final bool echoCancellation;
+
+  /// Longest echo path the canceller models, in milliseconds (up to 1000)
+  final int echoTailMs;
+
+  /// Remove stationary noise (fans, hum, hiss) from the microphone and/or
+  /// the system audio before mixing; see [NoiseSuppressionStats.micLatencyMs]
+  final bool micNoiseSuppression;
+  final bool systemNoiseSuppression;
+
+  /// Most the suppressor lowers a noise-only band, in dB (1-40)
+  final int noiseSuppressionDb;
+
   const AudioConfig({
     this.sampleRate = 44100,
     this.channels = 2,
     this.bitsPerSample = 16,
+    this.floatSamples = false,
+    this.dither = Dither.none,
+    this.frameDurationMs = 0,
+    this.minChunkBytes = 0,
+    this.maxLatencyMs = 0,
+    this.backpressurePolicy = BackpressurePolicy.none,
+    this.maxQueuedChunks = 32,
+    this.packetHeader = false,
+    this.encoding = AudioEncoding.pcm,
+    this.echoCancellation = false,
+    this.echoTailMs = 250,
+    this.micNoiseSuppression = false,
+    this.systemNoiseSuppression = false,
+    this.noiseSuppressionDb = 20,
   });
 
   factory AudioConfig.fromMap(Map<String, dynamic> map) {
@@ -27,6 +142,32 @@ class AudioConfig {
       sampleRate: (map['sampleRate'] is int) ? map['sampleRate'] : 44100,
       channels: (map['channels'] is int) ? map['channels'] : 2,
       bitsPerSample: (map['bitsPerSample'] is int) ? map['bitsPerSample'] : 16,
+      floatSamples: (map['floatSamples'] is bool) ? map['floatSamples'] : false,
+      dither: (map['dither'] is int &&
+              map['dither'] >= 0 &&
+              map['dither'] < Dither.values.length)
+          ? Dither.values[map['dither']]
+          : Dither.none,
+      frameDurationMs: (map['frameDurationMs'] is int) ? map['frameDurationMs'] : 0,
+      minChunkBytes: (map['minChunkBytes'] is int) ? map['minChunkBytes'] : 0,
+      maxLatencyMs: (map['maxLatencyMs'] is int) ? map['maxLatencyMs'] : 0,
+      backpressurePolicy: (map['backpressurePolicy'] is int &&
+              map['backpressurePolicy'] >= 0 &&
+              map['backpressurePolicy'] < BackpressurePolicy.values.length)
+          ? BackpressurePolicy.values[map['backpressurePolicy']]
+          : BackpressurePolicy.none,
+      maxQueuedChunks: (map['maxQueuedChunks'] is int) ? map['maxQueuedChunks'] : 32,
+      packetHeader: (map['packetHeader'] is bool) ? map['packetHeader'] : false,
+      encoding: (map['encoding'] is int &&
+              map['encoding'] >= 0 &&
+              map['encoding'] < AudioEncoding.values.length)
+          ? AudioEncoding.values[map['encoding']]
+          : AudioEncoding.pcm,
+      echoCancellation: (map['echoCancellation'] is bool) ? map['echoCancellation'] : false,
+      echoTailMs: (map['echoTailMs'] is int) ? map['echoTailMs'] : 250,
+      micNoiseSuppression: (map['micNoiseSuppression'] is bool) ? map['micNoiseSuppression'] : false,
+      systemNoiseSuppression: (map['systemNoiseSuppression'] is bool) ? map['systemNoiseSuppression'] : false,
+      noiseSuppressionDb: (map['noiseSuppressionDb'] is int) ? map['noiseSuppressionDb'] : 20,
     );
   }
 
@@ -35,22 +176,440 @@ class AudioConfig {
       'sampleRate': sampleRate,
       'channels': channels,
       'bitsPerSample': bitsPerSample,
+      'floatSamples': floatSamples,
+      'dither': dither.index,
+      'frameDurationMs': frameDurationMs,
+      'minChunkBytes': minChunkBytes,
+      'maxLatencyMs': maxLatencyMs,
+      'backpressurePolicy': backpressurePolicy.index,
+      'maxQueuedChunks': maxQueuedChunks,
+      'packetHeader': packetHeader,
+      'encoding': encoding.index,
+      'echoCancellation': echoCancellation,
+      'echoTailMs': echoTailMs,
+      'micNoiseSuppression': micNoiseSuppression,
+      'systemNoiseSuppression': systemNoiseSuppression,
+      'noiseSuppressionDb': noiseSuppressionDb,
     };
   }
 }
 
+/// How often a native pipeline stage ran or was skipped
+///
+/// Stages only run while something consumes their output, e.g. `convert`
+/// and `deliver` need an audio listener, `meter` a volume listener,
+/// `spectrum` a spectrum listener, `features` a feature stream listener,
+/// `vad` voice activity detection with an
+/// audio listener, `record` an active file recording and `preroll` an armed
+/// pre-roll ring. `aec` and `denoise` run with the mix when echo
+/// cancellation or noise suppression is on.
+class PipelineStageStats {
+  final int runs;   // Capture packets the stage processed
+  final int skips;  // Capture packets skipped because nobody was listening
+
+  const PipelineStageStats({this.runs = 0, this.skips = 0});
+
+  factory PipelineStageStats.fromMap(Map<String, dynamic> map) {
+    return PipelineStageStats(
+      runs: (map['runs'] as num?)?.toInt() ?? 0,
+      skips: (map['skips'] as num?)?.toInt() ?? 0,
+    );
+  }
+
+  @override
+  String toString() => 'PipelineStageStats(runs: $runs, skips: $skips)';
+}
+
+/// An audio chunk with its header (see [AudioConfig.packetHeader])
+///
+/// The header is a fixed 48-byte little-endian layout (40 bytes before
+/// version 2):
+///
+/// | Offset | Size | Field            |
+/// |--------|------|------------------|
+/// | 0      | 4    | magic "WLRP"     |
+/// | 4      | 1    | header size      |
+/// | 5      | 1    | version          |
+/// | 6      | 2    | flags            |
+/// | 8      | 4    | sequence         |
+/// | 12     | 4    | frame count      |
+/// | 16     | 8    | first sample     |
+/// | 24     | 8    | capture time     |
+/// | 32     | 4    | sample rate      |
+/// | 36     | 2    | channels         |
+/// | 38     | 2    | format id        |
+/// | 40     | 4    | speech (float32) |
+/// | 44     | 4    | reserved         |
+class AudioPacket {
+  static const int magic = 0x50524C57;
+  static const int minHeaderSize = 40;
+
+  static const int flagSilent = 0x0001;
+  static const int flagDiscontinuity = 0x0002;
+  static const int flagTimestampError = 0x0004;
+  static const int flagPadded = 0x0008;
+  static const int flagSpeech = 0x0010;
+  static const int flagDropped = 0x0020;  // Silence for audio dropped by dropNewest
+
+  static const int formatPcm16 = 1;
+  static const int formatFlac = 2;
+  static const int formatMuLaw = 3;
+  static const int formatALaw = 4;
+  static const int formatImaAdpcm = 5;
+  static const int formatPcm24 = 6;    // Packed little-endian, 3 bytes per sample
+  static const int formatPcm32 = 7;
+  static const int formatFloat32 = 8;  // IEEE float in [-1, 1]
+
+  final int flags;
+  final int sequence;          // Increments by one per packet; gaps mean drops
+  final int frameCount;        // Sample frames in [audio]
+  final int firstSampleIndex;  // Frames emitted before this packet
+  final int captureTime;       // QPC time of the first frame, 100 ns units
+  final int sampleRate;
+  final int channels;
+  final int formatId;
+  final double? speechProbability;  // Highest VAD probability, null without VAD
+  final Uint8List audio;       // Payload, a view into the received chunk
+
+  const AudioPacket({
+    required this.flags,
+    required this.sequence,
+    required this.frameCount,
+    required this.firstSampleIndex,
+    required this.captureTime,
+    required this.sampleRate,
+    required this.channels,
+    required this.formatId,
+    this.speechProbability,
+    required this.audio,
+  });
+
+  bool get isSilent => flags & flagSilent != 0;
+  bool get isDiscontinuity => flags & flagDiscontinuity != 0;
+  bool get isSpeech => flags & flagSpeech != 0;
+  bool get isDropped => flags & flagDropped != 0;
+
+  /// Parses a chunk received with [AudioConfig.packetHeader] set
+  ///
+  /// Returns null if [bytes] does not start with a valid header.
+  static AudioPacket? tryParse(Uint8List bytes) {
+    if (bytes.length < minHeaderSize) {
+      return null;
+    }
+    final header = ByteData.sublistView(bytes);
+    final headerSize = header.getUint8(4);
+    if (header.getUint32(0, Endian.little) != magic ||
+        headerSize < minHeaderSize ||
+        headerSize > bytes.length) {
+      return null;
+    }
+    final speech = headerSize >= 48 ? header.getFloat32(40, Endian.little) : -1.0;
+    return AudioPacket(
+      flags: header.getUint16(6, Endian.little),
+      sequence: header.getUint32(8, Endian.little),
+      frameCount: header.getUint32(12, Endian.little),
+      firstSampleIndex: header.getUint64(16, Endian.little),
+      captureTime: header.getInt64(24, Endian.little),
+      sampleRate: header.getUint32(32, Endian.little),
+      channels: header.getUint16(36, Endian.little),
+      formatId: header.getUint16(38, Endian.little),
+      speechProbability: speech >= 0 ? speech : null,
+      audio: Uint8List.sublistView(bytes, headerSize),
+    );
+  }
+}
+
+/// Audio delivery counters
+class DeliveryStats {
+  final int deliveredChunks;     // Chunks handed to the consumer
+  final int droppedChunks;       // Chunks discarded by the backpressure policy
+  final int droppedFrames;       // Sample frames discarded by the backpressure policy
+  final int queuedChunks;        // Chunks currently waiting in native memory
+  final int inFlightChunks;      // Chunks sent but not yet acknowledged
+  final int highWatermarkChunks; // Most chunks ever waiting in native memory
+  final int highWatermarkBytes;  // Most bytes ever waiting in native memory
+
+  const DeliveryStats({
+    this.deliveredChunks = 0,
+    this.droppedChunks = 0,
+    this.droppedFrames = 0,
+    this.queuedChunks = 0,
+    this.inFlightChunks = 0,
+    this.highWatermarkChunks = 0,
+    this.highWatermarkBytes = 0,
+  });
+
+  factory DeliveryStats.fromMap(Map<String, dynamic> map) {
+    return DeliveryStats(
+      deliveredChunks: (map['deliveredChunks'] as num?)?.toInt() ?? 0,
+      droppedChunks: (map['droppedChunks'] as num?)?.toInt() ?? 0,
+      droppedFrames: (map['droppedFrames'] as num?)?.toInt() ?? 0,
+      queuedChunks: (map['queuedChunks'] as num?)?.toInt() ?? 0,
+      inFlightChunks: (map['inFlightChunks'] as num?)?.toInt() ?? 0,
+      highWatermarkChunks: (map['highWatermarkChunks'] as num?)?.toInt() ?? 0,
+      highWatermarkBytes: (map['highWatermarkBytes'] as num?)?.toInt() ?? 0,
+    );
+  }
+
+  @override
+  String toString() {
+    return 'DeliveryStats(delivered: $deliveredChunks, dropped: $droppedChunks '
+           '($droppedFrames frames), queued: $queuedChunks, inFlight: $inFlightChunks, '
+           'highWatermark: $highWatermarkChunks chunks/$highWatermarkBytes bytes)';
+  }
+}
+
+/// Voice activity detection state and gate counters
+///
+/// The counters cover delivery since [startVad] or the start of the
+/// recording, whichever came later.
+class VadStats {
+  final bool enabled;
+  final bool speaking;                 // Either detector currently hears speech
+  final double speechProbability;      // Higher of the mix and microphone, -1 when off
+  final double micSpeechProbability;   // Microphone alone, -1 without one
+  final int passedBytes;               // Audio delivered by the gate
+  final int suppressedBytes;           // Audio the gate held back for good
+  final double suppressedRatio;        // suppressed / (passed + suppressed)
+
+  const VadStats({
+    this.enabled = false,
+    this.speaking = false,
+    this.speechProbability = -1,
+    this.micSpeechProbability = -1,
+    this.passedBytes = 0,
+    this.suppressedBytes = 0,
+    this.suppressedRatio = 0,
+  });
+
+  factory VadStats.fromMap(Map<String, dynamic> map) {
+    return VadStats(
+      enabled: map['enabled'] as bool? ?? false,
+      speaking: map['speaking'] as bool? ?? false,
+      speechProbability: (map['speechProbability'] as num?)?.toDouble() ?? -1,
+      micSpeechProbability: (map['micSpeechProbability'] as num?)?.toDouble() ?? -1,
+      passedBytes: (map['passedBytes'] as num?)?.toInt() ?? 0,
+      suppressedBytes: (map['suppressedBytes'] as num?)?.toInt() ?? 0,
+      suppressedRatio: (map['suppressedRatio'] as num?)?.toDouble() ?? 0,
+    );
+  }
+
+  @override
+  String toString() {
+    return 'VadStats(speaking: $speaking, probability: ${speechProbability.toStringAsFixed(2)}, '
+           'passed: $passedBytes, suppressed: $suppressedBytes '
+           '(${(suppressedRatio * 100).toStringAsFixed(1)}%))';
+  }
+}
+
+/// Noise suppression state of the current recording
+class NoiseSuppressionStats {
+  final bool micEnabled;
+  final bool systemEnabled;
+  final double micLatencyMs;     // Fixed delay the suppressor adds, 0 when off
+  final double systemLatencyMs;
+  final double micNoiseDb;       // Estimated noise floor in dBFS, -120 when unknown
+  final double systemNoiseDb;
+
+  const NoiseSuppressionStats({
+    this.micEnabled = false,
+    this.systemEnabled = false,
+    this.micLatencyMs = 0,
+    this.systemLatencyMs = 0,
+    this.micNoiseDb = -120,
+    this.systemNoiseDb = -120,
+  });
+
+  factory NoiseSuppressionStats.fromMap(Map<String, dynamic> map) {
+    return NoiseSuppressionStats(
+      micEnabled: map['micEnabled'] as bool? ?? false,
+      systemEnabled: map['systemEnabled'] as bool? ?? false,
+      micLatencyMs: (map['micLatencyMs'] as num?)?.toDouble() ?? 0,
+      systemLatencyMs: (map['systemLatencyMs'] as num?)?.toDouble() ?? 0,
+      micNoiseDb: (map['micNoiseDb'] as num?)?.toDouble() ?? -120,
+      systemNoiseDb: (map['systemNoiseDb'] as num?)?.toDouble() ?? -120,
+    );
+  }
+
+  @override
+  String toString() {
+    return 'NoiseSuppressionStats(mic: $micEnabled, ${micNoiseDb.toStringAsFixed(1)} dBFS, '
+           'system: $systemEnabled, ${systemNoiseDb.toStringAsFixed(1)} dBFS, '
+           'latency: ${micLatencyMs.toStringAsFixed(1)}/${systemLatencyMs.toStringAsFixed(1)} ms)';
+  }
+}
+
+/// Summary of a finished native file recording
+class FileRecordingResult {
+  final String path;
+  final int dataBytes;    // Audio bytes in the file, measured as PCM
+  final int fileBytes;    // Size on disk, headers and compression included
+  final int frames;       // Sample frames in the file
+  final int droppedBytes; // Audio lost because the disk fell behind
+  final bool rf64;        // The file exceeded 4 GiB and uses the RF64 layout
+  final bool complete;    // Every write and the final header update succeeded
+  final int segments;     // Files written; more than one when rotating
+  final String? peaksPath; // Waveform peaks file, when peaks were requested
+
+  const FileRecordingResult({
+    required this.path,
+    this.dataBytes = 0,
+    this.fileBytes = 0,
+    this.frames = 0,
+    this.droppedBytes = 0,
+    this.rf64 = false,
+    this.complete = false,
+    this.segments = 1,
+    this.peaksPath,
+  });
+
+  factory FileRecordingResult.fromMap(Map<String, dynamic> map) {
+    return FileRecordingResult(
+      path: map['path'] as String? ?? '',
+      dataBytes: (map['dataBytes'] as num?)?.toInt() ?? 0,
+      fileBytes: (map['fileBytes'] as num?)?.toInt() ?? 0,
+      frames: (map['frames'] as num?)?.toInt() ?? 0,
+      droppedBytes: (map['droppedBytes'] as num?)?.toInt() ?? 0,
+      rf64: map['rf64'] as bool? ?? false,
+      complete: map['complete'] as bool? ?? false,
+      segments: (map['segments'] as num?)?.toInt() ?? 1,
+      peaksPath: map['peaksPath'] as String?,
+    );
+  }
+
+  @override
+  String toString() {
+    return 'FileRecordingResult(path: $path, frames: $frames, bytes: $dataBytes, '
+           'fileBytes: $fileBytes, dropped: $droppedBytes, rf64: $rf64, complete: $complete, segments: $segments'
+           '${peaksPath != null ? ', peaksPath: $peaksPath' : ''})';
+  }
+}
+
+/// A finished file of a rotating recording
+///
+/// Segments are contiguous: each one starts at the frame after the previous
+/// one ends, so `firstFrame` values add up to a gapless timeline.
+class FileSegment {
+  final String path;
+  final int index;        // 0 for the first file
+  final int firstFrame;   // Sample frames recorded before this segment
+  final int frameCount;   // Sample frames in this segment
+  final int droppedBytes; // Audio lost because the disk fell behind
+  final bool complete;    // Every write and the final header update succeeded
+
+  const FileSegment({
+    required this.path,
+    this.index = 0,
+    this.firstFrame = 0,
+    this.frameCount = 0,
+    this.droppedBytes = 0,
+    this.complete = false,
+  });
+
+  factory FileSegment.fromMap(Map<String, dynamic> map) {
+    return FileSegment(
+      path: map['path'] as String? ?? '',
+      index: (map['index'] as num?)?.toInt() ?? 0,
+      firstFrame: (map['firstFrame'] as num?)?.toInt() ?? 0,
+      frameCount: (map['frameCount'] as num?)?.toInt() ?? 0,
+      droppedBytes: (map['droppedBytes'] as num?)?.toInt() ?? 0,
+      complete: map['complete'] as bool? ?? false,
+    );
+  }
+
+  @override
+  String toString() {
+    return 'FileSegment(#$index $path, frames: $firstFrame+$frameCount, '
+           'dropped: $droppedBytes, complete: $complete)';
+  }
+}
+
+/// Audio saved from the pre-roll ring
+class PreRollSnapshot {
+  final String path;
+  final int firstFrame;              // Stream position of the first sample frame
+  final int frames;                  // Sample frames in the file
+  final RecordingFileFormat format;  // FLAC when the ring is compressed
+
+  const PreRollSnapshot({
+    required this.path,
+    this.firstFrame = 0,
+    this.frames = 0,
+    this.format = RecordingFileFormat.wav,
+  });
+
+  factory PreRollSnapshot.fromMap(Map<String, dynamic> map) {
+    final format = (map['format'] as num?)?.toInt() ?? 0;
+    return PreRollSnapshot(
+      path: map['path'] as String? ?? '',
+      firstFrame: (map['firstFrame'] as num?)?.toInt() ?? 0,
+      frames: (map['frames'] as num?)?.toInt() ?? 0,
+      format: format == 1 ? RecordingFileFormat.flac : RecordingFileFormat.wav,
+    );
+  }
+
+  @override
+  String toString() {
+    return 'PreRollSnapshot($path, frames: $firstFrame+$frames, format: ${format.name})';
+  }
+}
+
+/// Levels of one channel or capture source, linear with 1.0 = full scale
+class MeterLevels {
+  final double rms;
+  final double peak;      // Largest sample
+  final double truePeak;  // Largest 4x oversampled value; may exceed 1.0
+                          // Equals peak for capture sources
+
+  const MeterLevels({this.rms = 0.0, this.peak = 0.0, this.truePeak = 0.0});
+
+  @override
+  String toString() => 'MeterLevels(rms: ${rms.toStringAsFixed(3)}, '
+      'peak: ${peak.toStringAsFixed(3)}, truePeak: ${truePeak.toStringAsFixed(3)})';
+}
+
 /// Volume data from audio monitoring
+///
+/// Native code sends each update as a [Float32List] (see [VolumeData.fromFloats])
+/// aggregating all audio since the previous one.
 class VolumeData {
   final double rms;        // Root Mean Square value (0.0 - 1.0)
   final double decibels;   // Decibel value (-96.0 dB - 0.0 dB)
   final int percentage;    // Percentage value (0% - 100%)
-  final int timestamp;     // Timestamp in milliseconds
+  final int timestamp;     // Milliseconds since the recording started
+  final double peak;       // Largest sample, linear (1.0 = full scale)
+  final double truePeak;   // Largest 4x oversampled value; may exceed 1.0
+
+  // EBU R128 loudness in LUFS; negative infinity until enough audio was seen
+  final double momentaryLufs;   // Last 400 ms
+  final double shortTermLufs;   // Last 3 s
+  final double integratedLufs;  // Gated, since the recording or resetLoudness()
+
+  final List<MeterLevels> channels;  // Per output channel
+  final List<MeterLevels> sources;   // System, microphone; before the mix
+  final List<MeterLevels> systemChannels;  // Per system audio channel
+  final List<MeterLevels> micChannels;     // Per microphone channel that is mixed
+
+  /// Levels of the system audio before the microphone was mixed in
+  MeterLevels get system => sources.isNotEmpty ? sources[0] : const MeterLevels();
+
+  /// Levels of the microphone before it was mixed in
+  MeterLevels get mic => sources.length > 1 ? sources[1] : const MeterLevels();
 
   const VolumeData({
     required this.rms,
     required this.decibels,
     required this.percentage,
     required this.timestamp,
+    this.peak = 0.0,
+    this.truePeak = 0.0,
+    this.momentaryLufs = double.negativeInfinity,
+    this.shortTermLufs = double.negativeInfinity,
+    this.integratedLufs = double.negativeInfinity,
+    this.channels = const [],
+    this.sources = const [],
+    this.systemChannels = const [],
+    this.micChannels = const [],
   });
 
   factory VolumeData.fromMap(Map<String, dynamic> map) {
@@ -59,18 +618,276 @@ class VolumeData {
       decibels: (map['db'] as num).toDouble(),
       percentage: map['percentage'] as int,
       timestamp: map['timestamp'] as int,
+      peak: (map['peak'] as num?)?.toDouble() ?? 0.0,
+      truePeak: (map['truePeak'] as num?)?.toDouble() ?? 0.0,
+      momentaryLufs: (map['momentaryLufs'] as num?)?.toDouble() ?? double.negativeInfinity,
+      shortTermLufs: (map['shortTermLufs'] as num?)?.toDouble() ?? double.negativeInfinity,
+      integratedLufs: (map['integratedLufs'] as num?)?.toDouble() ?? double.negativeInfinity,
     );
   }
 
+  /// Parses a native meter frame
+  ///
+  /// | Index | Field                                  |
+  /// |-------|----------------------------------------|
+  /// | 0     | header size H (values before triples)  |
+  /// | 1     | layout version                         |
+  /// | 2     | milliseconds since recording start     |
+  /// | 3-5   | rms, peak, true peak of all channels   |
+  /// | 6-8   | momentary, short-term, integrated LUFS |
+  /// | 9     | channel count C                        |
+  /// | 10    | source count S (system, microphone)    |
+  /// | 11    | system channel count SC                |
+  /// | 12    | microphone channel count MC            |
+  /// | H...  | C, S, SC then MC triples of rms, peak, true peak |
+  ///
+  /// Frames from before version 2 end the header at index 11 and carry no
+  /// per-source channels.
+  factory VolumeData.fromFloats(Float32List frame) {
+    final headerSize = frame[0].toInt();
+    final channelCount = frame[9].toInt();
+    final sourceCount = frame[10].toInt();
+    final systemChannelCount = headerSize > 11 ? frame[11].toInt() : 0;
+    final micChannelCount = headerSize > 12 ? frame[12].toInt() : 0;
+    List<MeterLevels> triples(int first, int count) => List.generate(count, (i) {
+          final at = headerSize + (first + i) * 3;
+          return MeterLevels(rms: frame[at], peak: frame[at + 1], truePeak: frame[at + 2]);
+        });
+
+    final rms = frame[3].toDouble();
+    final decibels = rmsToDecibels(rms);
+    return VolumeData(
+      rms: rms,
+      decibels: decibels,
+      percentage: decibelsToPercentage(decibels),
+      timestamp: frame[2].round(),
+      peak: frame[4],
+      truePeak: frame[5],
+      momentaryLufs: frame[6],
+      shortTermLufs: frame[7],
+      integratedLufs: frame[8],
+      channels: triples(0, channelCount),
+      sources: triples(channelCount, sourceCount),
+      systemChannels: triples(channelCount + sourceCount, systemChannelCount),
+      micChannels: triples(channelCount + sourceCount + systemChannelCount, micChannelCount),
+    );
+  }
+
+  /// 20 log10(rms), clamped to -96..0 dB
+  static double rmsToDecibels(double rms) {
+    if (rms <= 0.0) return -96.0;
+    return (20.0 * math.log(rms) / math.ln10).clamp(-96.0, 0.0).toDouble();
+  }
+
+  /// -96 dB maps to 0%, 0 dB to 100%
+  static int decibelsToPercentage(double db) {
+    return ((db + 96.0) / 96.0 * 100.0).floor().clamp(0, 100).toInt();
+  }
+
+  /// The signal reached full scale, at a sample or between samples
+  bool get clipping => peak >= 32767 / 32768 || truePeak > 1.0;
+
   @override
   String toString() {
     return 'VolumeData(rms: ${rms.toStringAsFixed(3)}, '
            'db: ${decibels.toStringAsFixed(1)}dB, '
            'percentage: $percentage%, '
+           'peak: ${peak.toStringAsFixed(3)}, '
+           'truePeak: ${truePeak.toStringAsFixed(3)}, '
+           'loudness: ${momentaryLufs.toStringAsFixed(1)}/${shortTermLufs.toStringAsFixed(1)}/'
+           '${integratedLufs.toStringAsFixed(1)} LUFS, '
            'timestamp: $timestamp)';
   }
 }
 
+/// Spectrum of the recent audio, from the native analyzer
+///
+/// Native code sends each update as a [Float32List] (see
+/// [SpectrumData.fromFloats]) of a few hundred bytes.
+class SpectrumData {
+  final int timestamp;        // Milliseconds since the recording started
+  final int sampleRate;       // Rate of the analyzed audio
+  final int fftSize;          // Samples per transform
+  final double minHz;         // Lower edge of the first band
+  final double maxHz;         // Upper edge of the last band
+  final List<double> bands;   // Level of each band in dBFS, lowest band first
+
+  const SpectrumData({
+    required this.timestamp,
+    required this.sampleRate,
+    required this.fftSize,
+    required this.minHz,
+    required this.maxHz,
+    required this.bands,
+  });
+
+  /// Parses a native spectrum frame
+  ///
+  /// | Index | Field                                 |
+  /// |-------|---------------------------------------|
+  /// | 0     | header size H (values before bands)   |
+  /// | 1     | layout version                        |
+  /// | 2     | milliseconds since recording start    |
+  /// | 3     | sample rate                           |
+  /// | 4     | FFT size                              |
+  /// | 5-6   | lowest and highest band edge in Hz    |
+  /// | 7     | band count B                          |
+  /// | H...  | B band levels in dBFS                 |
+  factory SpectrumData.fromFloats(Float32List frame) {
+    final headerSize = frame[0].toInt();
+    final bandCount = frame[7].toInt();
+    return SpectrumData(
+      timestamp: frame[2].round(),
+      sampleRate: frame[3].toInt(),
+      fftSize: frame[4].toInt(),
+      minHz: frame[5],
+      maxHz: frame[6],
+      bands: List<double>.generate(bandCount, (i) => frame[headerSize + i]),
+    );
+  }
+
+  /// Lower edge of band [index] in Hz; [bands.length] gives the upper edge
+  /// of the last band. Edges are spaced evenly in log frequency.
+  double bandEdgeHz(int index) =>
+      minHz * math.pow(maxHz / minHz, index / bands.length).toDouble();
+
+  /// Geometric center of band [index] in Hz
+  double bandCenterHz(int index) => math.sqrt(bandEdgeHz(index) * bandEdgeHz(index + 1));
+
+  @override
+  String toString() => 'SpectrumData(bands: ${bands.length}, '
+      '${minHz.toStringAsFixed(0)}-${maxHz.toStringAsFixed(0)} Hz, '
+      'fftSize: $fftSize, timestamp: $timestamp)';
+}
+
+/// Log-mel or MFCC rows from the native feature extractor
+///
+/// Each row describes a 25 ms window; row `firstRow + i` starts
+/// `(firstRow + i) * hopMs` milliseconds into the analyzed audio. Row
+/// numbers start over with each recording and when the analyzed sample rate
+/// changes. Native code sends each update as a [Float32List] (see
+/// [FeatureFrames.fromFloats]).
+class FeatureFrames {
+  final int sampleRate;       // Rate of the analyzed audio
+  final double hopMs;         // Time between two rows
+  final double windowMs;      // Audio each row describes
+  final int firstRow;         // Number of the first row since the stream started
+  final int melBins;          // Mel filters behind each row
+  final int valuesPerRow;     // melBins for log-mel rows, else MFCCs per row
+  final double minHz;         // Lower edge of the first filter
+  final double maxHz;         // Upper edge of the last filter
+  final Float32List values;   // Rows one after the other, oldest first
+
+  const FeatureFrames({
+    required this.sampleRate,
+    required this.hopMs,
+    required this.windowMs,
+    required this.firstRow,
+    required this.melBins,
+    required this.valuesPerRow,
+    required this.minHz,
+    required this.maxHz,
+    required this.values,
+  });
+
+  /// Parses a native feature update
+  ///
+  /// | Index | Field                                       |
+  /// |-------|---------------------------------------------|
+  /// | 0     | header size H (values before the rows)      |
+  /// | 1     | layout version                              |
+  /// | 2     | sample rate                                 |
+  /// | 3     | hop in milliseconds                         |
+  /// | 4     | window in milliseconds                      |
+  /// | 5     | first row number                            |
+  /// | 6     | row count R                                 |
+  /// | 7     | values per row V                            |
+  /// | 8     | mel filters                                 |
+  /// | 9-10  | lowest and highest filter edge in Hz        |
+  /// | H...  | R rows of V values: natural log filter energies, or MFCCs |
+  factory FeatureFrames.fromFloats(Float32List frame) {
+    final headerSize = frame[0].toInt();
+    final rows = frame[6].toInt();
+    final valuesPerRow = frame[7].toInt();
+    return FeatureFrames(
+      sampleRate: frame[2].toInt(),
+      hopMs: frame[3],
+      windowMs: frame[4],
+      firstRow: frame[5].toInt(),
+      melBins: frame[8].toInt(),
+      valuesPerRow: valuesPerRow,
+      minHz: frame[9],
+      maxHz: frame[10],
+      values: Float32List.sublistView(frame, headerSize, headerSize + rows * valuesPerRow),
+    );
+  }
+
+  int get rows => valuesPerRow > 0 ? values.length ~/ valuesPerRow : 0;
+
+  /// True when rows hold MFCCs rather than log-mel energies
+  bool get isMfcc => valuesPerRow != melBins;
+
+  /// Values of row [index], without copying
+  Float32List row(int index) =>
+      Float32List.sublistView(values, index * valuesPerRow, (index + 1) * valuesPerRow);
+
+  /// Start of row [index] in milliseconds since the stream started
+  double rowStartMs(int index) => (firstRow + index) * hopMs;
+
+  @override
+  String toString() => 'FeatureFrames(rows: $rows, firstRow: $firstRow, '
+      '${isMfcc ? '$valuesPerRow MFCCs' : '$melBins mel bins'}, sampleRate: $sampleRate)';
+}
+
+/// Waveform columns for a frame range, from the native peak pyramid
+///
+/// [values] holds, for each column and then each channel, the minimum,
+/// maximum and RMS of the samples in [-1, 1]: `(column * channels + channel) * 3`
+/// indexes the minimum.
+class WaveformPeaks {
+  final int sampleRate;
+  final int channels;
+  final int frames;        // Frames the pyramid covers
+  final int bucketFrames;  // Resolution the columns were built from
+  final int startFrame;    // Range the columns span
+  final int endFrame;
+  final Float32List values;
+
+  const WaveformPeaks({
+    required this.sampleRate,
+    required this.channels,
+    required this.frames,
+    required this.bucketFrames,
+    required this.startFrame,
+    required this.endFrame,
+    required this.values,
+  });
+
+  factory WaveformPeaks.fromMap(Map<String, dynamic> map) {
+    final values = map['values'];
+    return WaveformPeaks(
+      sampleRate: (map['sampleRate'] as num?)?.toInt() ?? 0,
+      channels: (map['channels'] as num?)?.toInt() ?? 0,
+      frames: (map['frames'] as num?)?.toInt() ?? 0,
+      bucketFrames: (map['bucketFrames'] as num?)?.toInt() ?? 0,
+      startFrame: (map['startFrame'] as num?)?.toInt() ?? 0,
+      endFrame: (map['endFrame'] as num?)?.toInt() ?? 0,
+      values: values is Float32List ? values : Float32List.fromList(
+          values is List ? values.map((v) => (v as num).toDouble()).toList() : const <double>[]),
+    );
+  }
+
+  int get columns => channels > 0 ? values.length ~/ (channels * 3) : 0;
+
+  double min(int column, int channel) => values[(column * channels + channel) * 3];
+  double max(int column, int channel) => values[(column * channels + channel) * 3 + 1];
+  double rms(int column, int channel) => values[(column * channels + channel) * 3 + 2];
+
+  @override
+  String toString() => 'WaveformPeaks(columns: $columns, channels: $channels, '
+      'frames: $startFrame-$endFrame of $frames, bucketFrames: $bucketFrames)';
+}
+
 abstract class WindowsLoopbackRecorderPlatform extends PlatformInterface {
   /// Constructs a WindowsLoopbackRecorderPlatform.
   WindowsLoopbackRecorderPlatform() : super(token: _token);
@@ -146,8 +963,8 @@ abstract class WindowsLoopbackRecorderPlatform extends PlatformInterface {
     throw UnimplementedError('getAudioFormat() has not been implemented.');
   }
 
-  /// Start volume monitoring
-  Future<bool> startVolumeMonitoring() {
+  /// Start volume monitoring, with one update per [intervalMs] of audio
+  Future<bool> startVolumeMonitoring({int intervalMs = 33}) {
     throw UnimplementedError('startVolumeMonitoring() has not been implemented.');
   }
 
@@ -156,8 +973,151 @@ abstract class WindowsLoopbackRecorderPlatform extends PlatformInterface {
     throw UnimplementedError('stopVolumeMonitoring() has not been implemented.');
   }
 
+  /// Restart the integrated loudness measurement
+  Future<bool> resetLoudness() {
+    throw UnimplementedError('resetLoudness() has not been implemented.');
+  }
+
   /// Volume stream
   Stream<VolumeData> get volumeStream {
     throw UnimplementedError('volumeStream has not been implemented.');
   }
+
+  /// Start the spectrum stream, with one update per [intervalMs] of audio
+  Future<bool> startSpectrum({
+    int intervalMs = 50,
+    int fftSize = 2048,
+    int bands = 32,
+    double minHz = 20.0,
+    double maxHz = 20000.0,
+  }) {
+    throw UnimplementedError('startSpectrum() has not been implemented.');
+  }
+
+  /// Stop the spectrum stream
+  Future<bool> stopSpectrum() {
+    throw UnimplementedError('stopSpectrum() has not been implemented.');
+  }
+
+  /// Spectrum stream
+  Stream<SpectrumData> get spectrumStream {
+    throw UnimplementedError('spectrumStream has not been implemented.');
+  }
+
+  /// Start the feature stream, with log-mel or MFCC rows every 10 ms
+  Future<bool> startFeatures({
+    int melBins = 80,
+    int mfcc = 0,
+    double minHz = 20.0,
+    double maxHz = 8000.0,
+    double preEmphasis = 0.97,
+    int rowsPerUpdate = 10,
+  }) {
+    throw UnimplementedError('startFeatures() has not been implemented.');
+  }
+
+  /// Stop the feature stream
+  Future<bool> stopFeatures() {
+    throw UnimplementedError('stopFeatures() has not been implemented.');
+  }
+
+  /// Feature stream
+  Stream<FeatureFrames> get featureStream {
+    throw UnimplementedError('featureStream has not been implemented.');
+  }
+
+  /// Start voice activity detection on the microphone and the delivered mix
+  Future<bool> startVad({
+    double threshold = 0.5,
+    int hangoverMs = 200,
+    bool gate = false,
+    int paddingMs = 300,
+  }) {
+    throw UnimplementedError('startVad() has not been implemented.');
+  }
+
+  /// Stop voice activity detection
+  Future<bool> stopVad() {
+    throw UnimplementedError('stopVad() has not been implemented.');
+  }
+
+  /// Get voice activity detection state and gate counters
+  Future<VadStats> getVadStats() {
+    throw UnimplementedError('getVadStats() has not been implemented.');
+  }
+
+  /// Get noise suppression latency and noise floors
+  Future<NoiseSuppressionStats> getNoiseSuppressionStats() {
+    throw UnimplementedError('getNoiseSuppressionStats() has not been implemented.');
+  }
+
+  /// Deliver audio chunks to a native port instead of the audio stream
+  Future<bool> attachAudioPort(SendPort port) {
+    throw UnimplementedError('attachAudioPort() has not been implemented.');
+  }
+
+  /// Return audio delivery to the audio stream
+  Future<bool> detachAudioPort() {
+    throw UnimplementedError('detachAudioPort() has not been implemented.');
+  }
+
+  /// Report consumed audio chunks for flow control
+  Future<void> acknowledgeAudio(int count) {
+    throw UnimplementedError('acknowledgeAudio() has not been implemented.');
+  }
+
+  /// Get audio delivery counters
+  Future<DeliveryStats> getDeliveryStats() {
+    throw UnimplementedError('getDeliveryStats() has not been implemented.');
+  }
+
+  /// Get per-stage run/skip counters of the native pipeline
+  Future<Map<String, PipelineStageStats>> getPipelineStats() {
+    throw UnimplementedError('getPipelineStats() has not been implemented.');
+  }
+
+  /// Start writing processed audio to a WAV or FLAC file natively
+  Future<bool> startFileRecording(String path,
+      {int segmentSeconds = 0,
+      int segmentBytes = 0,
+      RecordingFileFormat format = RecordingFileFormat.wav,
+      bool peaks = false}) {
+    throw UnimplementedError('startFileRecording() has not been implemented.');
+  }
+
+  /// Reduce a frame range of the recording's waveform peaks to columns
+  Future<WaveformPeaks?> queryPeaks(
+      {String? path, required int startFrame, required int endFrame, required int columns}) {
+    throw UnimplementedError('queryPeaks() has not been implemented.');
+  }
+
+  /// Finish the native file recording
+  Future<FileRecordingResult?> stopFileRecording() {
+    throw UnimplementedError('stopFileRecording() has not been implemented.');
+  }
+
+  /// Stream of files finished by the native file recording
+  Stream<FileSegment> get fileSegmentStream {
+    throw UnimplementedError('fileSegmentStream has not been implemented.');
+  }
+
+  /// Keep the most recent processed audio in a memory-bounded ring
+  Future<bool> startPreRoll({int budgetBytes = 16 << 20, bool compressed = false}) {
+    throw UnimplementedError('startPreRoll() has not been implemented.');
+  }
+
+  /// Disarm the pre-roll ring and release its memory
+  Future<bool> stopPreRoll() {
+    throw UnimplementedError('stopPreRoll() has not been implemented.');
+  }
+
+  /// Write the last [seconds] of the pre-roll ring to a file (0 = all of it)
+  Future<PreRollSnapshot?> savePreRoll(String path, {int seconds = 0}) {
+    throw UnimplementedError('savePreRoll() has not been implemented.');
+  }
+
+  /// The last [seconds] of the pre-roll ring as WAV or FLAC file bytes
+  Future<Uint8List?> getPreRoll({int seconds = 0}) {
+    throw UnimplementedError('getPreRoll() has not been implemented.');
+  }
 }
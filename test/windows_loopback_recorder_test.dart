@@ -1,3 +1,4 @@
+import 'dart:isolate';
 import 'dart:typed_data';
 import 'package:flutter_test/flutter_test.dart';
 import 'package:windows_loopback_recorder/windows_loopback_recorder.dart';
@@ -41,6 +42,112 @@ class MockWindowsLoopbackRecorderPlatform
 
   @override
   Future<AudioConfig> getAudioFormat() => Future.value(AudioConfig());
+
+  @override
+  Future<bool> startVolumeMonitoring({int intervalMs = 33}) => Future.value(true);
+
+  @override
+  Future<bool> stopVolumeMonitoring() => Future.value(true);
+
+  @override
+  Future<bool> resetLoudness() => Future.value(true);
+
+  @override
+  Stream<VolumeData> get volumeStream => const Stream.empty();
+
+  @override
+  Future<bool> startSpectrum({
+    int intervalMs = 50,
+    int fftSize = 2048,
+    int bands = 32,
+    double minHz = 20.0,
+    double maxHz = 20000.0,
+  }) => Future.value(true);
+
+  @override
+  Future<bool> stopSpectrum() => Future.value(true);
+
+  @override
+  Stream<SpectrumData> get spectrumStream => const Stream.empty();
+
+  @override
+  Future<bool> startFeatures({
+    int melBins = 80,
+    int mfcc = 0,
+    double minHz = 20.0,
+    double maxHz = 8000.0,
+    double preEmphasis = 0.97,
+    int rowsPerUpdate = 10,
+  }) => Future.value(true);
+
+  @override
+  Future<bool> stopFeatures() => Future.value(true);
+
+  @override
+  Stream<FeatureFrames> get featureStream => const Stream.empty();
+
+  @override
+  Future<bool> startVad({
+    double threshold = 0.5,
+    int hangoverMs = 200,
+    bool gate = false,
+    int paddingMs = 300,
+  }) => Future.value(true);
+
+  @override
+  Future<bool> stopVad() => Future.value(true);
+
+  @override
+  Future<VadStats> getVadStats() => Future.value(const VadStats());
+
+  @override
+  Future<NoiseSuppressionStats> getNoiseSuppressionStats() => Future.value(const NoiseSuppressionStats());
+
+  @override
+  Future<bool> attachAudioPort(SendPort port) => Future.value(true);
+
+  @override
+  Future<bool> detachAudioPort() => Future.value(true);
+
+  @override
+  Future<void> acknowledgeAudio(int count) => Future.value();
+
+  @override
+  Future<DeliveryStats> getDeliveryStats() => Future.value(const DeliveryStats());
+
+  @override
+  Future<Map<String, PipelineStageStats>> getPipelineStats() => Future.value({});
+
+  @override
+  Future<bool> startFileRecording(String path,
+          {int segmentSeconds = 0,
+          int segmentBytes = 0,
+          RecordingFileFormat format = RecordingFileFormat.wav,
+          bool peaks = false}) =>
+      Future.value(true);
+
+  @override
+  Future<WaveformPeaks?> queryPeaks(
+          {String? path, required int startFrame, required int endFrame, required int columns}) =>
+      Future.value(null);
+
+  @override
+  Future<FileRecordingResult?> stopFileRecording() => Future.value(null);
+
+  @override
+  Stream<FileSegment> get fileSegmentStream => const Stream.empty();
+
+  @override
+  Future<bool> startPreRoll({int budgetBytes = 16 << 20, bool compressed = false}) => Future.value(true);
+
+  @override
+  Future<bool> stopPreRoll() => Future.value(true);
+
+  @override
+  Future<PreRollSnapshot?> savePreRoll(String path, {int seconds = 0}) => Future.value(null);
+
+  @override
+  Future<Uint8List?> getPreRoll({int seconds = 0}) => Future.value(null);
 }
 
 void main() {
@@ -57,4 +164,153 @@ void main() {
 
     expect(await windowsLoopbackRecorderPlugin.getPlatformVersion(), '42');
   });
+
+  test('AudioPacket.tryParse reads the native header layout', () {
+    final bytes = Uint8List(44);
+    final header = ByteData.sublistView(bytes);
+    header.setUint32(0, AudioPacket.magic, Endian.little);
+    header.setUint8(4, 40);
+    header.setUint8(5, 1);
+    header.setUint16(6, AudioPacket.flagSilent, Endian.little);
+    header.setUint32(8, 7, Endian.little);
+    header.setUint32(12, 1, Endian.little);
+    header.setUint64(16, 4800, Endian.little);
+    header.setInt64(24, 123456789, Endian.little);
+    header.setUint32(32, 48000, Endian.little);
+    header.setUint16(36, 2, Endian.little);
+    header.setUint16(38, AudioPacket.formatPcm16, Endian.little);
+
+    final packet = AudioPacket.tryParse(bytes)!;
+    expect(packet.sequence, 7);
+    expect(packet.isSilent, isTrue);
+    expect(packet.firstSampleIndex, 4800);
+    expect(packet.captureTime, 123456789);
+    expect(packet.sampleRate, 48000);
+    expect(packet.channels, 2);
+    expect(packet.audio.length, 4);
+    expect(packet.speechProbability, isNull);
+
+    expect(AudioPacket.tryParse(Uint8List(44)), isNull);
+  });
+
+  test('AudioConfig carries the output sample format', () {
+    const config = AudioConfig(bitsPerSample: 32, floatSamples: true, dither: Dither.noiseShaped);
+    final map = config.toMap();
+    expect(map['floatSamples'], isTrue);
+    expect(map['dither'], 2);
+
+    final parsed = AudioConfig.fromMap(map);
+    expect(parsed.bitsPerSample, 32);
+    expect(parsed.floatSamples, isTrue);
+    expect(parsed.dither, Dither.noiseShaped);
+    expect(AudioConfig.fromMap({'dither': 7}).dither, Dither.none);
+  });
+
+  test('AudioPacket.tryParse reads the speech fields of version 2', () {
+    final bytes = Uint8List(48);
+    final header = ByteData.sublistView(bytes);
+    header.setUint32(0, AudioPacket.magic, Endian.little);
+    header.setUint8(4, 48);
+    header.setUint8(5, 2);
+    header.setUint16(6, AudioPacket.flagSpeech, Endian.little);
+    header.setFloat32(40, 0.75, Endian.little);
+
+    final packet = AudioPacket.tryParse(bytes)!;
+    expect(packet.isSpeech, isTrue);
+    expect(packet.speechProbability, 0.75);
+    expect(packet.audio, isEmpty);
+
+    header.setFloat32(40, -1, Endian.little);
+    expect(AudioPacket.tryParse(bytes)!.speechProbability, isNull);
+  });
+
+  test('VolumeData.fromFloats reads the native meter frame layout', () {
+    final frame = Float32List.fromList([
+      11, 1, 1500, 0.5, 0.9, 1.2, -20, -21, -23, 2, 0,
+      0.4, 0.8, 0.9, 0.6, 0.9, 1.2,
+    ]);
+
+    final volume = VolumeData.fromFloats(frame);
+    expect(volume.rms, 0.5);
+    expect(volume.decibels, closeTo(-6.02, 0.01));
+    expect(volume.percentage, 93);
+    expect(volume.timestamp, 1500);
+    expect(volume.truePeak, closeTo(1.2, 1e-6));
+    expect(volume.clipping, isTrue);
+    expect(volume.integratedLufs, -23);
+    expect(volume.channels.length, 2);
+    expect(volume.channels[1].rms, closeTo(0.6, 1e-6));
+    expect(volume.sources, isEmpty);
+  });
+
+  test('VolumeData.fromFloats reads the per-source meters', () {
+    final frame = Float32List.fromList([
+      13, 2, 100, 0.5, 0.9, 0.9, -20, -21, -23, 1, 2, 2, 1,
+      0.5, 0.9, 0.9,
+      0.3, 0.6, 0.6, 0.2, 0.4, 0.4,
+      0.3, 0.5, 0.5, 0.3, 0.6, 0.6,
+      0.2, 0.4, 0.4,
+    ]);
+
+    final volume = VolumeData.fromFloats(frame);
+    expect(volume.channels.length, 1);
+    expect(volume.sources.length, 2);
+    expect(volume.system.peak, closeTo(0.6, 1e-6));
+    expect(volume.mic.rms, closeTo(0.2, 1e-6));
+    expect(volume.systemChannels.length, 2);
+    expect(volume.systemChannels[1].peak, closeTo(0.6, 1e-6));
+    expect(volume.micChannels.single.truePeak, closeTo(0.4, 1e-6));
+  });
+
+  test('SpectrumData.fromFloats reads the native spectrum frame layout', () {
+    final frame = Float32List.fromList([8, 1, 250, 48000, 2048, 20, 20000, 3, -10, -40, -80]);
+
+    final spectrum = SpectrumData.fromFloats(frame);
+    expect(spectrum.timestamp, 250);
+    expect(spectrum.sampleRate, 48000);
+    expect(spectrum.fftSize, 2048);
+    expect(spectrum.bands, [-10, -40, -80]);
+    expect(spectrum.bandEdgeHz(0), closeTo(20, 1e-3));
+    expect(spectrum.bandEdgeHz(1), closeTo(200, 1e-2));
+    expect(spectrum.bandEdgeHz(3), closeTo(20000, 1));
+    expect(spectrum.bandCenterHz(1), closeTo(632.46, 0.01));
+  });
+
+  test('FeatureFrames.fromFloats reads the native feature frame layout', () {
+    final frame = Float32List.fromList([
+      11, 1, 16000, 10, 25, 40, 2, 3, 40, 20, 8000,
+      -1, -2, -3,
+      -4, -5, -6,
+    ]);
+
+    final features = FeatureFrames.fromFloats(frame);
+    expect(features.sampleRate, 16000);
+    expect(features.rows, 2);
+    expect(features.isMfcc, isTrue);
+    expect(features.row(1), [-4, -5, -6]);
+    expect(features.rowStartMs(1), closeTo(410, 1e-6));
+    expect(features.maxHz, 8000);
+  });
+
+  test('WaveformPeaks.fromMap reads the native column layout', () {
+    final peaks = WaveformPeaks.fromMap({
+      'sampleRate': 48000,
+      'channels': 2,
+      'frames': 96000,
+      'bucketFrames': 4096,
+      'startFrame': 0,
+      'endFrame': 96000,
+      'values': Float32List.fromList([
+        -0.5, 0.5, 0.25, -0.1, 0.1, 0.05,
+        -0.8, 0.9, 0.4, -0.2, 0.3, 0.1,
+      ]),
+    });
+
+    expect(peaks.columns, 2);
+    expect(peaks.bucketFrames, 4096);
+    expect(peaks.min(0, 0), closeTo(-0.5, 1e-6));
+    expect(peaks.max(0, 1), closeTo(0.1, 1e-6));
+    expect(peaks.rms(1, 0), closeTo(0.4, 1e-6));
+    expect(peaks.max(1, 1), closeTo(0.3, 1e-6));
+  });
 }
@@ -0,0 +1,194 @@
+#include "windows_loopback_recorder/asr_fast_path.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define WLR_ASR_SSE2 1
+#endif
+
+namespace windows_loopback_recorder {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Middle of the 7 to 9 kHz transition band, and the Kaiser beta for 80 dB.
+// What lies between 8 and 9 kHz folds back above 7 kHz only.
+constexpr double kCutoffHz = 8000.0;
+constexpr double kKaiserBeta = 7.857;
+
+// Zeroth-order modified Bessel function of the first kind
+double BesselI0(double x) {
+  double sum = 1.0;
+  double term = 1.0;
+  for (int k = 1; k < 50; k++) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+    if (term < sum * 1e-12) {
+      break;
+    }
+  }
+  return sum;
+}
+
+// One output of a symmetric filter of 2 * |half| + 1 taps over |x|, with
+// |half| a multiple of 4: the two mirrored samples of each tap pair are
+// added first, halving the multiplies. |taps| holds the first half and the
+// center tap.
+float SymmetricDot(const float* taps, const float* x, size_t half) {
+  const float* mirror = x + 2 * half;
+#ifdef WLR_ASR_SSE2
+  __m128 acc0 = _mm_setzero_ps();
+  __m128 acc1 = _mm_setzero_ps();
+  size_t k = 0;
+  for (; k + 8 <= half; k += 8) {
+    __m128 high0 = _mm_shuffle_ps(_mm_loadu_ps(mirror - k - 3), _mm_loadu_ps(mirror - k - 3), _MM_SHUFFLE(0, 1, 2, 3));
+    __m128 high1 = _mm_shuffle_ps(_mm_loadu_ps(mirror - k - 7), _mm_loadu_ps(mirror - k - 7), _MM_SHUFFLE(0, 1, 2, 3));
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(taps + k), _mm_add_ps(_mm_loadu_ps(x + k), high0)));
+    acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(taps + k + 4), _mm_add_ps(_mm_loadu_ps(x + k + 4), high1)));
+  }
+  for (; k < half; k += 4) {
+    __m128 high = _mm_shuffle_ps(_mm_loadu_ps(mirror - k - 3), _mm_loadu_ps(mirror - k - 3), _MM_SHUFFLE(0, 1, 2, 3));
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(taps + k), _mm_add_ps(_mm_loadu_ps(x + k), high)));
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+  return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + taps[half] * x[half];
+#else
+  float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  for (size_t k = 0; k < half; k += 4) {
+    for (size_t j = 0; j < 4; j++) {
+      sum[j] += taps[k + j] * (x[k + j] + mirror[-static_cast<ptrdiff_t>(k + j)]);
+    }
+  }
+  return (sum[0] + sum[1]) + (sum[2] + sum[3]) + taps[half] * x[half];
+#endif
+}
+
+inline float ToFloat(float sample) { return sample; }
+inline float ToFloat(int16_t sample) { return sample * (1.0f / 32768.0f); }
+
+inline float Clamp(float sample) { return std::min(1.0f, std::max(-1.0f, sample)); }
+
+}  // namespace
+
+AsrFastPath::AsrFastPath() : taps_(kHalfTaps + 1), buffer_(kHistory + kBlockFrames, 0.0f) {
+  // Windowed sinc, normalized to unit gain at DC
+  double center = (kTaps - 1) / 2.0;
+  double cutoff = kCutoffHz / kInputRate;
+  double sum = 0.0;
+  std::vector<double> taps(kTaps);
+  for (size_t n = 0; n < kTaps; n++) {
+    double t = n - center;
+    double sinc = t == 0.0 ? 2.0 * cutoff : std::sin(2.0 * kPi * cutoff * t) / (kPi * t);
+    double ratio = t / center;
+    taps[n] = sinc * BesselI0(kKaiserBeta * std::sqrt(1.0 - ratio * ratio)) / BesselI0(kKaiserBeta);
+    sum += taps[n];
+  }
+  for (size_t n = 0; n <= kHalfTaps; n++) {
+    taps_[n] = static_cast<float>(taps[n] / sum);
+  }
+}
+
+bool AsrFastPath::Supports(uint32_t systemRate, uint16_t systemChannels, uint16_t systemBits,
+                           uint32_t outputRate, uint16_t outputChannels, uint16_t outputBits) {
+  return systemRate == kInputRate && systemChannels == 2 && systemBits == 32 &&
+         outputRate == kOutputRate && outputChannels == 1 && outputBits == 16;
+}
+
+void AsrFastPath::Reset() {
+  std::fill(buffer_.begin(), buffer_.end(), 0.0f);
+  next_ = 0;
+}
+
+size_t AsrFastPath::Process(const float* system, size_t systemFrames, const float* mic,
+                            uint16_t micChannels, size_t micFrames, int16_t* out,
+                            SourceLevels* systemMeter, SourceLevels* micMeter) {
+  return ProcessFrames(system, systemFrames, mic, micChannels, micFrames, out, systemMeter, micMeter);
+}
+
+size_t AsrFastPath::Process(const float* system, size_t systemFrames, const int16_t* mic,
+                            uint16_t micChannels, size_t micFrames, int16_t* out,
+                            SourceLevels* systemMeter, SourceLevels* micMeter) {
+  return ProcessFrames(system, systemFrames, mic, micChannels, micFrames, out, systemMeter, micMeter);
+}
+
+template <typename MicSample>
+size_t AsrFastPath::ProcessFrames(const float* system, size_t systemFrames, const MicSample* mic,
+                                  uint16_t micChannels, size_t micFrames, int16_t* out,
+                                  SourceLevels* systemMeter, SourceLevels* micMeter) {
+  if (!system) {
+    systemFrames = 0;
+  }
+  if (!mic || micChannels == 0) {
+    micFrames = 0;
+  }
+  uint16_t mixedMicChannels = std::min<uint16_t>(micChannels, 2);
+  size_t frames = std::max(systemFrames, micFrames);
+  size_t written = 0;
+  float* block = &buffer_[kHistory];
+
+  for (size_t done = 0; done < frames; done += kBlockFrames) {
+    size_t count = std::min(kBlockFrames, frames - done);
+
+    // One source at a time so each loop is straight-line
+    size_t systemCount = done < systemFrames ? std::min(count, systemFrames - done) : 0;
+    size_t micCount = done < micFrames ? std::min(count, micFrames - done) : 0;
+    const float* systemFrame = systemCount ? system + done * 2 : nullptr;
+    if (systemMeter) {
+      for (size_t i = 0; i < systemCount; i++) {
+        systemMeter->Add(0, systemFrame[i * 2]);
+        systemMeter->Add(1, systemFrame[i * 2 + 1]);
+      }
+    }
+    if (micCount == 0) {
+      for (size_t i = 0; i < systemCount; i++) {
+        block[i] = 0.5f * (Clamp(systemFrame[i * 2]) + Clamp(systemFrame[i * 2 + 1]));
+      }
+      std::fill(block + systemCount, block + count, 0.0f);
+    } else {
+      // Mix into per-channel scratch, then downmix into the block
+      for (size_t i = 0; i < systemCount; i++) {
+        left_[i] = systemFrame[i * 2];
+        right_[i] = systemFrame[i * 2 + 1];
+      }
+      std::fill(left_ + systemCount, left_ + count, 0.0f);
+      std::fill(right_ + systemCount, right_ + count, 0.0f);
+      const MicSample* micFrame = mic + done * micChannels;
+      for (size_t i = 0; i < micCount; i++) {
+        left_[i] += ToFloat(micFrame[i * micChannels]);
+      }
+      if (mixedMicChannels > 1) {
+        for (size_t i = 0; i < micCount; i++) {
+          right_[i] += ToFloat(micFrame[i * micChannels + 1]);
+        }
+      }
+      if (micMeter) {
+        for (size_t i = 0; i < micCount; i++) {
+          for (uint16_t channel = 0; channel < mixedMicChannels; channel++) {
+            micMeter->Add(channel, ToFloat(micFrame[i * micChannels + channel]));
+          }
+        }
+      }
+      for (size_t i = 0; i < count; i++) {
+        block[i] = 0.5f * (Clamp(left_[i]) + Clamp(right_[i]));
+      }
+    }
+
+    // Every third output of the low-pass, quantized as the resampler's is
+    size_t available = kHistory + count;
+    for (; next_ + kTaps <= available; next_ += kFactor) {
+      float sample = Clamp(SymmetricDot(taps_.data(), &buffer_[next_], kHalfTaps));
+      out[written++] = static_cast<int16_t>(sample * 32767.0f);
+    }
+
+    // The newest kHistory samples are the history of the next block
+    std::copy(buffer_.begin() + count, buffer_.begin() + available, buffer_.begin());
+    next_ -= count;
+  }
+  return written;
+}
+
+}  // namespace windows_loopback_recorder
@@ -0,0 +1,88 @@
+#include "windows_loopback_recorder/audio_chunker.h"
+
+#include <algorithm>
+
+namespace windows_loopback_recorder {
+
+void AudioChunker::Configure(const ChunkingConfig& config, uint32_t sampleRate,
+                             uint32_t bytesPerFrame) {
+  bytesPerFrame_ = bytesPerFrame;
+  exactBytes_ = 0;
+  minBytes_ = 0;
+  latencyBytes_ = 0;
+
+  if (bytesPerFrame == 0 || sampleRate == 0) {
+    Reset();
+    return;
+  }
+
+  if (config.frameDurationMs > 0) {
+    size_t frames = static_cast<size_t>(sampleRate) * config.frameDurationMs / 1000;
+    exactBytes_ = std::max<size_t>(frames, 1) * bytesPerFrame;
+  } else {
+    if (config.minChunkBytes > 0) {
+      // Round up to whole frames so chunks never split a frame.
+      minBytes_ = (config.minChunkBytes + bytesPerFrame - 1) / bytesPerFrame * bytesPerFrame;
+    }
+    if (config.maxLatencyMs > 0) {
+      size_t frames = static_cast<size_t>(sampleRate) * config.maxLatencyMs / 1000;
+      latencyBytes_ = std::max<size_t>(frames, 1) * bytesPerFrame;
+    }
+  }
+
+  Reset();
+}
+
+void AudioChunker::Reset() {
+  pending_.clear();
+  pending_.reserve(std::max(exactBytes_, std::max(minBytes_, latencyBytes_)));
+}
+
+void AudioChunker::Push(const uint8_t* data, size_t size, const EmitFunction& emit) {
+  if (exactBytes_ > 0) {
+    while (size > 0) {
+      size_t take = std::min(size, exactBytes_ - pending_.size());
+      pending_.insert(pending_.end(), data, data + take);
+      data += take;
+      size -= take;
+
+      if (pending_.size() == exactBytes_) {
+        EmitPending(emit);
+      }
+    }
+    return;
+  }
+
+  pending_.insert(pending_.end(), data, data + size);
+
+  size_t threshold = 0;
+  if (minBytes_ > 0 && latencyBytes_ > 0) {
+    threshold = std::min(minBytes_, latencyBytes_);
+  } else {
+    threshold = minBytes_ > 0 ? minBytes_ : latencyBytes_;
+  }
+
+  if (threshold > 0 && pending_.size() >= threshold) {
+    EmitPending(emit);
+  }
+}
+
+void AudioChunker::Flush(const EmitFunction& emit) {
+  if (pending_.empty()) {
+    return;
+  }
+
+  if (exactBytes_ > 0) {
+    pending_.resize(exactBytes_, 0);
+  }
+  EmitPending(emit);
+}
+
+void AudioChunker::EmitPending(const EmitFunction& emit) {
+  std::vector<uint8_t> chunk;
+  chunk.swap(pending_);
+  emit(chunk);
+  pending_.reserve(std::max(exactBytes_, std::max(minBytes_, latencyBytes_)));
+}
+
+}  // namespace windows_loopback_recorder
@@ -0,0 +1,399 @@
+#include "windows_loopback_recorder/audio_engine.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace windows_loopback_recorder {
+
+namespace {
+
+// Runs a cleanup stage (echo cancellation, noise suppression) over a
+// capture packet of 16-bit PCM or 32-bit float samples; |out| may be |in|
+template <typename Stage>
+void ProcessSourcePacket(Stage& stage, uint16_t bitsPerSample, const uint8_t* in, uint8_t* out, size_t frames) {
+  if (bitsPerSample == 16) {
+    stage.Process(reinterpret_cast<const int16_t*>(in), reinterpret_cast<int16_t*>(out), frames);
+  } else {
+    stage.Process(reinterpret_cast<const float*>(in), reinterpret_cast<float*>(out), frames);
+  }
+}
+
+}  // namespace
+
+AudioEngine::~AudioEngine() {
+  Clear();
+}
+
+bool AudioEngine::Configure(const EngineConfig& config) {
+  Clear();
+  if (config.systemChannels == 0 || config.systemRate == 0 || config.outputRate == 0 ||
+      config.outputChannels == 0) {
+    return false;
+  }
+  config_ = config;
+
+  // Mix and channel kernels for these formats, so the capture loop does not
+  // look at them again
+  kernels_ = SelectFormatKernels(config.systemFormat, config.systemChannels, config.micFormat,
+                                 config.micChannels, config.outputChannels);
+  converting_ = config.systemRate != config.outputRate || config.systemChannels != config.outputChannels;
+
+  // libsamplerate, for the output channel count
+  if (config.systemRate != config.outputRate) {
+    int error = 0;
+    srcState_ = src_new(SRC_SINC_MEDIUM_QUALITY, config.outputChannels, &error);
+    if (!srcState_ || error != 0) {
+      srcState_ = nullptr;
+      return false;
+    }
+
+    // Warm up the resampler with a small amount of silence to stabilize
+    std::vector<float> warmupData(config.outputChannels * 64, 0.0f);
+    SRC_DATA warmupSrcData;
+    warmupSrcData.data_in = warmupData.data();
+    warmupSrcData.input_frames = 64;
+    warmupSrcData.data_out = warmupData.data();
+    warmupSrcData.output_frames = 64;
+    warmupSrcData.src_ratio = 1.0;
+    warmupSrcData.end_of_input = 0;
+    src_process(srcState_, &warmupSrcData);
+  }
+
+  // Output samples. Deeper or dithered output stays float from the mix to
+  // one rounding in quantizer_. The encoders take 16-bit input, and so do
+  // capture formats the float mix cannot read.
+  SampleFormat outputFormat = config.outputFormat;
+  if (config.encoded || !kernels_.mixFloat) {
+    outputFormat = SampleFormat::PCM16;
+  }
+  DitherMode dither = kernels_.mixFloat ? config.dither : DitherMode::NONE;
+  quantize_ = (outputFormat != SampleFormat::PCM16 || dither != DitherMode::NONE) &&
+              quantizer_.Configure(outputFormat, config.outputChannels, dither);
+
+  // The common speech recognition format skips the generic conversion chain
+  if (!quantize_ && AsrFastPath::Supports(config.systemRate, config.systemChannels, kernels_.systemBits,
+                                          config.outputRate, config.outputChannels, 16)) {
+    asrFastPath_ = std::make_unique<AsrFastPath>();
+  }
+
+  // The canceller pairs loopback and microphone frames one to one, so both
+  // devices must run at one rate; otherwise the microphone is mixed as is
+  if (config.echoCancellation && config.micChannels != 0 && config.micRate == config.systemRate &&
+      kernels_.micBits == kernels_.systemBits && kernels_.mix) {
+    echoCanceller_ = std::make_unique<EchoCanceller>();
+    if (!echoCanceller_->Configure(config.systemRate, config.systemChannels, config.micChannels,
+                                   config.echoTailMs)) {
+      echoCanceller_.reset();
+    }
+  }
+
+  // One suppressor per source; at one rate they share their FFT
+  std::shared_ptr<RealFft> suppressorFft;
+  auto makeSuppressor = [&](uint32_t rate, uint16_t channels, uint16_t bits) {
+    std::unique_ptr<NoiseSuppressor> suppressor;
+    if (channels != 0 && bits != 0) {
+      suppressor = std::make_unique<NoiseSuppressor>();
+      if (suppressor->Configure(rate, channels, config.noiseSuppressionDb, suppressorFft)) {
+        suppressorFft = suppressor->fft();
+        return suppressor;
+      }
+    }
+    return std::unique_ptr<NoiseSuppressor>();
+  };
+  if (config.micNoiseSuppression) {
+    micSuppressor_ = makeSuppressor(config.micRate, config.micChannels, kernels_.micBits);
+  }
+  if (config.systemNoiseSuppression) {
+    systemSuppressor_ = makeSuppressor(config.systemRate, config.systemChannels, kernels_.systemBits);
+  }
+
+  configured_ = true;
+  return true;
+}
+
+void AudioEngine::Clear() {
+  if (srcState_) {
+    // Force reset the resampler state to clear any internal buffers
+    src_reset(srcState_);
+    src_delete(srcState_);
+    srcState_ = nullptr;
+  }
+  configured_ = false;
+  converting_ = false;
+  kernels_ = FormatKernels();
+  echoCanceller_.reset();
+  micSuppressor_.reset();
+  systemSuppressor_.reset();
+  micNoiseDb_ = -120.0f;
+  systemNoiseDb_ = -120.0f;
+  asrFastPath_.reset();
+  quantize_ = false;
+}
+
+void AudioEngine::Widen(uint8_t*& system, size_t systemFrames, uint8_t*& mic, size_t micFrames) {
+  if (system && kernels_.widenSystem) {
+    size_t samples = systemFrames * kernels_.systemChannels;
+    widenedSystem_.resize(samples);
+    kernels_.widenSystem(system, samples, widenedSystem_.data());
+    system = reinterpret_cast<uint8_t*>(widenedSystem_.data());
+  }
+  if (mic && kernels_.widenMic) {
+    size_t samples = micFrames * kernels_.micChannels;
+    widenedMic_.resize(samples);
+    kernels_.widenMic(mic, samples, widenedMic_.data());
+    mic = reinterpret_cast<uint8_t*>(widenedMic_.data());
+  }
+}
+
+void AudioEngine::Process(const uint8_t* system, size_t systemFrames, const uint8_t* mic, size_t micFrames,
+                          bool convert, const EngineMeters& meters, std::vector<uint8_t>& output,
+                          std::vector<uint8_t>& delivery) {
+  output.clear();
+  delivery.clear();
+  if (meters.levels) {
+    meters.levels->clear();
+  }
+  if (!configured_) {
+    return;
+  }
+
+  if (convert && asrFastPath_) {
+    MixFastPath(system, mic, systemFrames, micFrames, meters, output);
+    return;
+  }
+  if (convert && quantize_) {
+    MixQuantized(system, mic, systemFrames, micFrames, meters, output, delivery);
+    return;
+  }
+  if (asrFastPath_) {
+    asrFastPath_->Reset();  // Its history is stale once it runs again
+  }
+  Mix(system, mic, systemFrames, micFrames, meters, output);
+
+  // An analysis-only session (meter, spectrum, features) still converts
+  // channels so levels match, but skips resampling
+  if (convert) {
+    ConvertFormat(output, meters);
+  } else if (kernels_.channels) {
+    ConvertChannels(output);
+  }
+}
+
+const uint8_t* AudioEngine::CleanedMic(const uint8_t* mic) const {
+  return (echoCanceller_ || micSuppressor_) && mic ? cleanMic_.data() : mic;
+}
+
+void AudioEngine::CleanSources(const uint8_t*& system, const uint8_t*& mic, size_t systemFrames,
+                               size_t micFrames) {
+  // The loopback is the echo reference (before its own noise suppression);
+  // the sources are mixed and metered with echo and noise removed
+  if (echoCanceller_ && system && systemFrames > 0) {
+    if (kernels_.systemBits == 16) {
+      echoCanceller_->PushReference(reinterpret_cast<const int16_t*>(system), systemFrames);
+    } else {
+      echoCanceller_->PushReference(reinterpret_cast<const float*>(system), systemFrames);
+    }
+  }
+  if ((echoCanceller_ || micSuppressor_) && mic && micFrames > 0) {
+    cleanMic_.resize(micFrames * kernels_.micChannels * (kernels_.micBits / 8));
+    uint8_t* clean = cleanMic_.data();
+    if (echoCanceller_) {
+      ProcessSourcePacket(*echoCanceller_, kernels_.micBits, mic, clean, micFrames);
+    }
+    if (micSuppressor_) {
+      const uint8_t* in = echoCanceller_ ? clean : mic;
+      ProcessSourcePacket(*micSuppressor_, kernels_.micBits, in, clean, micFrames);
+      micNoiseDb_ = micSuppressor_->noiseDb();
+    }
+    mic = clean;
+  }
+  if (systemSuppressor_ && system && systemFrames > 0) {
+    cleanSystem_.resize(systemFrames * kernels_.systemChannels * (kernels_.systemBits / 8));
+    ProcessSourcePacket(*systemSuppressor_, kernels_.systemBits, system, cleanSystem_.data(), systemFrames);
+    systemNoiseDb_ = systemSuppressor_->noiseDb();
+    system = cleanSystem_.data();
+  }
+}
+
+void AudioEngine::Mix(const uint8_t* system, const uint8_t* mic, size_t systemFrames, size_t micFrames,
+                      const EngineMeters& meters, std::vector<uint8_t>& output) {
+  CleanSources(system, mic, systemFrames, micFrames);
+
+  // Only the microphone channels that are mixed are metered. Formats that
+  // are copied through unmixed leave both meters without channels.
+  bool mixable = kernels_.mix != nullptr;
+  if (meters.system) {
+    meters.system->Begin(mixable && system ? kernels_.systemChannels : 0);
+  }
+  if (meters.mic) {
+    meters.mic->Begin(mixable && mic ? kernels_.mixedMicChannels : 0);
+  }
+
+  size_t maxFrames = (std::max)(systemFrames, micFrames);
+  if (!mixable) {
+    // Unsupported format, just copy system audio
+    output.assign(maxFrames * config_.systemBlockAlign, uint8_t(0));
+    if (system && systemFrames > 0) {
+      std::memcpy(output.data(), system, systemFrames * config_.systemBlockAlign);
+    }
+    return;
+  }
+
+  // 16-bit or float loopback, mixed to 16-bit in its own layout by the
+  // kernel chosen for these formats in Configure()
+  output.resize(maxFrames * kernels_.systemChannels * 2);
+  kernels_.mix(system, system ? systemFrames : 0, mic, mic && kernels_.mixedMicChannels ? micFrames : 0,
+               kernels_.systemChannels, kernels_.micChannels, reinterpret_cast<int16_t*>(output.data()),
+               meters.system, meters.mic);
+}
+
+void AudioEngine::MixFastPath(const uint8_t* system, const uint8_t* mic, size_t systemFrames,
+                              size_t micFrames, const EngineMeters& meters, std::vector<uint8_t>& output) {
+  CleanSources(system, mic, systemFrames, micFrames);
+  bool hasMic = mic && micFrames > 0 && kernels_.micBits != 0;
+  uint16_t micChannels = hasMic ? config_.micChannels : 0;
+  if (meters.system) {
+    meters.system->Begin(system ? 2 : 0);
+  }
+  if (meters.mic) {
+    meters.mic->Begin(hasMic ? (std::min)(micChannels, static_cast<uint16_t>(2)) : 0);
+  }
+
+  const float* systemSamples = reinterpret_cast<const float*>(system);
+  output.resize(AsrFastPath::MaxOutput((std::max)(systemFrames, micFrames)) * 2);
+  int16_t* out = reinterpret_cast<int16_t*>(output.data());
+  size_t written;
+  if (hasMic && kernels_.micBits == 32) {
+    written = asrFastPath_->Process(systemSamples, systemFrames, reinterpret_cast<const float*>(mic),
+                                    micChannels, micFrames, out, meters.system, meters.mic);
+  } else {
+    written = asrFastPath_->Process(systemSamples, systemFrames, reinterpret_cast<const int16_t*>(mic),
+                                    micChannels, hasMic ? micFrames : 0, out, meters.system, meters.mic);
+  }
+  output.resize(written * 2);
+}
+
+void AudioEngine::MixQuantized(const uint8_t* system, const uint8_t* mic, size_t systemFrames,
+                               size_t micFrames, const EngineMeters& meters, std::vector<uint8_t>& output,
+                               std::vector<uint8_t>& delivery) {
+  CleanSources(system, mic, systemFrames, micFrames);
+  if (meters.system) {
+    meters.system->Begin(system ? kernels_.systemChannels : 0);
+  }
+  if (meters.mic) {
+    meters.mic->Begin(mic ? kernels_.mixedMicChannels : 0);
+  }
+
+  size_t maxFrames = (std::max)(systemFrames, micFrames);
+  floatMix_.resize(maxFrames * kernels_.systemChannels);
+  kernels_.mixFloat(system, system ? systemFrames : 0, mic, mic && kernels_.mixedMicChannels ? micFrames : 0,
+                    kernels_.systemChannels, kernels_.micChannels, floatMix_.data(), meters.system,
+                    meters.mic);
+
+  // Channel layout, then rate, without leaving float
+  const float* samples = floatMix_.data();
+  size_t frames = maxFrames;
+  if (kernels_.channelsFloat) {
+    floatChannels_.resize(frames * kernels_.outputChannels);
+    kernels_.channelsFloat(samples, frames, kernels_.systemChannels, kernels_.outputChannels,
+                           floatChannels_.data());
+    samples = floatChannels_.data();
+  }
+  if (srcState_) {
+    size_t resampled = 0;
+    if (Resample(samples, frames, resampled)) {
+      frames = resampled;
+      samples = resampled_.data();
+    }
+  }
+
+  // 16-bit output is what every stage reads; deeper output is delivered
+  // as is, and the other stages get the usual 16-bit conversion of it
+  size_t count = frames * config_.outputChannels;
+  if (quantizer_.format() == SampleFormat::PCM16) {
+    output.resize(count * 2);
+    quantizer_.Quantize(samples, frames, output.data());
+  } else {
+    delivery.resize(count * quantizer_.bytesPerSample());
+    quantizer_.Quantize(samples, frames, delivery.data());
+    ConvertFromFloat(samples, count, meters, output);
+  }
+}
+
+void AudioEngine::ConvertFormat(std::vector<uint8_t>& samples, const EngineMeters& meters) {
+  if (!converting_) {
+    return;  // No processing needed
+  }
+
+  // Step 1: Convert channels if necessary
+  if (kernels_.channels) {
+    ConvertChannels(samples);
+  }
+
+  // Step 2: Resample if necessary. Resampled audio is metered during its
+  // conversion back to 16-bit, so the samples are read once.
+  if (srcState_) {
+    // Convert to float for libsamplerate, which processes audio in
+    // float format (-1.0 to 1.0)
+    size_t count = samples.size() / 2;
+    const int16_t* pcm = reinterpret_cast<const int16_t*>(samples.data());
+    floatMix_.resize(count);
+    for (size_t i = 0; i < count; i++) {
+      floatMix_[i] = static_cast<float>(pcm[i]) / 32768.0f;
+    }
+    size_t frames = count / config_.outputChannels;
+    size_t resampled = 0;
+    if (Resample(floatMix_.data(), frames, resampled)) {
+      ConvertFromFloat(resampled_.data(), resampled * config_.outputChannels, meters, samples);
+    }
+  }
+}
+
+void AudioEngine::ConvertChannels(std::vector<uint8_t>& samples) {
+  size_t frames = samples.size() / (2 * kernels_.systemChannels);
+  converted_.resize(frames * kernels_.outputChannels * 2);
+  kernels_.channels(reinterpret_cast<const int16_t*>(samples.data()), frames, kernels_.systemChannels,
+                    kernels_.outputChannels, reinterpret_cast<int16_t*>(converted_.data()));
+  samples.swap(converted_);
+}
+
+bool AudioEngine::Resample(const float* in, size_t frames, size_t& written) {
+  double ratio = static_cast<double>(config_.outputRate) / config_.systemRate;
+  size_t maxOutputFrames = static_cast<size_t>(frames * ratio) + 1024;
+  resampled_.resize(maxOutputFrames * config_.outputChannels);
+
+  SRC_DATA srcData;
+  srcData.data_in = in;
+  srcData.input_frames = static_cast<long>(frames);
+  srcData.data_out = resampled_.data();
+  srcData.output_frames = static_cast<long>(maxOutputFrames);
+  srcData.src_ratio = ratio;
+  srcData.end_of_input = 0;
+  if (src_process(srcState_, &srcData) != 0) {
+    return false;
+  }
+  written = static_cast<size_t>(srcData.output_frames_gen);
+  return true;
+}
+
+void AudioEngine::ConvertFromFloat(const float* in, size_t samples, const EngineMeters& meters,
+                                   std::vector<uint8_t>& output) {
+  output.resize(samples * 2);
+  int16_t* pcm = reinterpret_cast<int16_t*>(output.data());
+
+  // Same conversion, with the levels measured in the same pass
+  if (meters.output && meters.levels && meters.output->channels() == config_.outputChannels) {
+    meters.output->ConvertAndMeasure(in, samples / config_.outputChannels, pcm, *meters.levels);
+    return;
+  }
+
+  for (size_t i = 0; i < samples; i++) {
+    // Clamp and convert float to int16
+    float sample = in[i];
+    if (sample > 1.0f) sample = 1.0f;
+    if (sample < -1.0f) sample = -1.0f;
+    pcm[i] = static_cast<int16_t>(sample * 32767.0f);
+  }
+}
+
+}  // namespace windows_loopback_recorder
@@ -0,0 +1,248 @@
+#include "windows_loopback_recorder/audio_meter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define WLR_METER_SSE2 1
+#endif
+
+namespace windows_loopback_recorder {
+
+namespace {
+
+// ITU-R BS.1770-4 Annex 2 interpolation filter; row k holds tap k of the
+// four phases
+alignas(16) const float kPhaseTaps[12][4] = {
+    {0.0017089843750f, -0.0291748046875f, -0.0189208984375f, -0.0083007812500f},
+    {0.0109863281250f, 0.0292968750000f, 0.0330810546875f, 0.0148925781250f},
+    {-0.0196533203125f, -0.0517578125000f, -0.0582275390625f, -0.0266113281250f},
+    {0.0332031250000f, 0.0891113281250f, 0.1015625000000f, 0.0476074218750f},
+    {-0.0594482421875f, -0.1665039062500f, -0.2003173828125f, -0.1022949218750f},
+    {0.1373291015625f, 0.4650878906250f, 0.7797851562500f, 0.9721679687500f},
+    {0.9721679687500f, 0.7797851562500f, 0.4650878906250f, 0.1373291015625f},
+    {-0.1022949218750f, -0.2003173828125f, -0.1665039062500f, -0.0594482421875f},
+    {0.0476074218750f, 0.1015625000000f, 0.0891113281250f, 0.0332031250000f},
+    {-0.0266113281250f, -0.0582275390625f, -0.0517578125000f, -0.0196533203125f},
+    {0.0148925781250f, 0.0330810546875f, 0.0292968750000f, 0.0109863281250f},
+    {-0.0083007812500f, -0.0189208984375f, -0.0291748046875f, 0.0017089843750f},
+};
+
+// Sum of squares and largest absolute value of |count| samples
+void SquaresAndPeak(const float* x, size_t count, double& sumSquares, float& peak) {
+  size_t i = 0;
+#ifdef WLR_METER_SSE2
+  const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+  __m128 squares = _mm_setzero_ps();
+  __m128 maximum = _mm_setzero_ps();
+  for (; i + 4 <= count; i += 4) {
+    __m128 v = _mm_loadu_ps(x + i);
+    squares = _mm_add_ps(squares, _mm_mul_ps(v, v));
+    maximum = _mm_max_ps(maximum, _mm_and_ps(v, absMask));
+  }
+  alignas(16) float lanes[4];
+  _mm_store_ps(lanes, squares);
+  sumSquares += static_cast<double>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+  _mm_store_ps(lanes, maximum);
+  peak = std::max({peak, lanes[0], lanes[1], lanes[2], lanes[3]});
+#endif
+  float squaresTail = 0.0f;
+  for (; i < count; i++) {
+    squaresTail += x[i] * x[i];
+    peak = std::max(peak, std::fabs(x[i]));
+  }
+  sumSquares += squaresTail;
+}
+
+// Largest absolute value of the four interpolated phases of each sample.
+// |x| points at the first new sample, preceded by 11 samples of history.
+float OversampledPeak(const float* x, size_t count, float peak) {
+  size_t i = 0;
+#ifdef WLR_METER_SSE2
+  // Four consecutive samples per step, one accumulator per phase: the
+  // accumulators are independent, so the adds pipeline instead of waiting
+  // on each other
+  static const struct BroadcastTaps {
+    __m128 tap[12][4];
+    BroadcastTaps() {
+      for (int k = 0; k < 12; k++) {
+        for (int p = 0; p < 4; p++) {
+          tap[k][p] = _mm_set1_ps(kPhaseTaps[k][p]);
+        }
+      }
+    }
+  } taps;
+  const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+  __m128 maximum = _mm_set1_ps(peak);
+  for (; i + 4 <= count; i += 4) {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    __m128 acc2 = _mm_setzero_ps();
+    __m128 acc3 = _mm_setzero_ps();
+    for (int k = 0; k < 12; k++) {
+      __m128 v = _mm_loadu_ps(x + i - k);
+      acc0 = _mm_add_ps(acc0, _mm_mul_ps(v, taps.tap[k][0]));
+      acc1 = _mm_add_ps(acc1, _mm_mul_ps(v, taps.tap[k][1]));
+      acc2 = _mm_add_ps(acc2, _mm_mul_ps(v, taps.tap[k][2]));
+      acc3 = _mm_add_ps(acc3, _mm_mul_ps(v, taps.tap[k][3]));
+    }
+    __m128 m01 = _mm_max_ps(_mm_and_ps(acc0, absMask), _mm_and_ps(acc1, absMask));
+    __m128 m23 = _mm_max_ps(_mm_and_ps(acc2, absMask), _mm_and_ps(acc3, absMask));
+    maximum = _mm_max_ps(maximum, _mm_max_ps(m01, m23));
+  }
+  alignas(16) float lanes[4];
+  _mm_store_ps(lanes, maximum);
+  peak = std::max({lanes[0], lanes[1], lanes[2], lanes[3]});
+#endif
+  for (; i < count; i++) {
+    const float* newest = x + i;
+    float acc[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (int k = 0; k < 12; k++) {
+      for (int p = 0; p < 4; p++) {
+        acc[p] += newest[-k] * kPhaseTaps[k][p];
+      }
+    }
+    for (int p = 0; p < 4; p++) {
+      peak = std::max(peak, std::fabs(acc[p]));
+    }
+  }
+  return peak;
+}
+
+// Same conversion as the resampler path: clamp, scale by 32767, truncate
+void FloatToInt16(const float* in, size_t count, int16_t* out) {
+  size_t i = 0;
+#ifdef WLR_METER_SSE2
+  const __m128 low = _mm_set1_ps(-1.0f);
+  const __m128 high = _mm_set1_ps(1.0f);
+  const __m128 scale = _mm_set1_ps(32767.0f);
+  for (; i + 8 <= count; i += 8) {
+    __m128 a = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i), low), high);
+    __m128 b = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i + 4), low), high);
+    __m128i packed = _mm_packs_epi32(_mm_cvttps_epi32(_mm_mul_ps(a, scale)),
+                                     _mm_cvttps_epi32(_mm_mul_ps(b, scale)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), packed);
+  }
+#endif
+  for (; i < count; i++) {
+    float sample = in[i];
+    if (sample > 1.0f) sample = 1.0f;
+    if (sample < -1.0f) sample = -1.0f;
+    out[i] = static_cast<int16_t>(sample * 32767.0f);
+  }
+}
+
+}  // namespace
+
+AudioMeter::AudioMeter() {
+  Configure(2);
+}
+
+bool AudioMeter::Configure(uint16_t channels) {
+  if (channels == 0 || channels > kMaxChannels) {
+    return false;
+  }
+  channels_ = channels;
+  planar_.assign(channels * (kHistory + kBlockFrames), 0.0f);
+  sumSquares_.assign(channels, 0.0);
+  peak_.assign(channels, 0.0f);
+  truePeak_.assign(channels, 0.0f);
+  return true;
+}
+
+void AudioMeter::Reset() {
+  std::fill(planar_.begin(), planar_.end(), 0.0f);
+}
+
+void AudioMeter::Measure(const int16_t* samples, size_t frames, std::vector<ChannelLevels>& levels) {
+  Begin();
+  const size_t stride = kHistory + kBlockFrames;
+  for (size_t done = 0; done < frames; done += kBlockFrames) {
+    size_t count = std::min(kBlockFrames, frames - done);
+    const int16_t* block = samples + done * channels_;
+    for (uint16_t c = 0; c < channels_; c++) {
+      float* dest = &planar_[c * stride + kHistory];
+      for (size_t i = 0; i < count; i++) {
+        dest[i] = block[i * channels_ + c] * (1.0f / 32768.0f);
+      }
+    }
+    MeasureBlock(count);
+  }
+  Finish(frames, levels);
+}
+
+void AudioMeter::ConvertAndMeasure(const float* in, size_t frames, int16_t* out,
+                                   std::vector<ChannelLevels>& levels) {
+  Begin();
+  const size_t stride = kHistory + kBlockFrames;
+  for (size_t done = 0; done < frames; done += kBlockFrames) {
+    size_t count = std::min(kBlockFrames, frames - done);
+    const float* block = in + done * channels_;
+    FloatToInt16(block, count * channels_, out + done * channels_);
+
+    // The block is in cache now; deinterleaving reads it from there
+    for (uint16_t c = 0; c < channels_; c++) {
+      float* dest = &planar_[c * stride + kHistory];
+      for (size_t i = 0; i < count; i++) {
+        dest[i] = block[i * channels_ + c];
+      }
+    }
+    MeasureBlock(count);
+  }
+  Finish(frames, levels);
+}
+
+ChannelLevels AudioMeter::Combine(const std::vector<ChannelLevels>& levels) {
+  ChannelLevels combined;
+  if (levels.empty()) {
+    return combined;
+  }
+  double power = 0.0;
+  for (const ChannelLevels& channel : levels) {
+    power += static_cast<double>(channel.rms) * channel.rms;
+    combined.peak = std::max(combined.peak, channel.peak);
+    combined.truePeak = std::max(combined.truePeak, channel.truePeak);
+  }
+  combined.rms = static_cast<float>(std::sqrt(power / levels.size()));
+  return combined;
+}
+
+void AudioMeter::Begin() {
+  std::fill(sumSquares_.begin(), sumSquares_.end(), 0.0);
+  std::fill(peak_.begin(), peak_.end(), 0.0f);
+  std::fill(truePeak_.begin(), truePeak_.end(), 0.0f);
+}
+
+void AudioMeter::MeasureBlock(size_t frames) {
+  const size_t stride = kHistory + kBlockFrames;
+  for (uint16_t c = 0; c < channels_; c++) {
+    float* channel = &planar_[c * stride];
+    SquaresAndPeak(channel + kHistory, frames, sumSquares_[c], peak_[c]);
+    truePeak_[c] = OversampledPeak(channel + kHistory, frames, truePeak_[c]);
+    // The newest samples become the history of the next block
+    std::memmove(channel, channel + frames, kHistory * sizeof(float));
+  }
+}
+
+void AudioMeter::Finish(size_t frames, std::vector<ChannelLevels>& levels) {
+  levels.resize(channels_);
+  for (uint16_t c = 0; c < channels_; c++) {
+    levels[c].rms = frames > 0 ? static_cast<float>(std::sqrt(sumSquares_[c] / frames)) : 0.0f;
+    levels[c].peak = peak_[c];
+    // The interpolated signal passes through every sample point
+    levels[c].truePeak = std::max(truePeak_[c], peak_[c]);
+  }
+}
+
+void SourceLevels::Finish(size_t frames, std::vector<ChannelLevels>& levels) const {
+  levels.resize(squares_.size());
+  for (size_t c = 0; c < squares_.size(); c++) {
+    levels[c].rms = frames > 0 ? std::sqrt(squares_[c] / frames) : 0.0f;
+    levels[c].peak = peak_[c];
+    levels[c].truePeak = peak_[c];
+  }
+}
+
+}  // namespace windows_loopback_recorder
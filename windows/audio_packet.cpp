@@ -0,0 +1,90 @@
+#include "windows_loopback_recorder/audio_packet.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace windows_loopback_recorder {
+
+void AudioPacketizer::Configure(bool enabled, uint32_t sampleRate, uint16_t channels,
+                                uint16_t formatId, uint32_t bytesPerFrame) {
+  enabled_ = enabled;
+  sampleRate_ = sampleRate;
+  channels_ = channels;
+  formatId_ = formatId;
+  bytesPerFrame_ = bytesPerFrame > 0 ? bytesPerFrame : 1;
+
+  sequence_ = 0;
+  capturedFrames_ = 0;
+  emittedFrames_ = 0;
+  anchorFrame_ = 0;
+  anchorTime_ = 0;
+  pendingFlags_ = 0;
+  silentRun_ = true;
+  lastPacketSilent_ = false;
+  speechRun_ = false;
+  lastPacketSpeech_ = false;
+  speechProbability_ = -1.0f;
+  lastSpeechProbability_ = -1.0f;
+}
+
+void AudioPacketizer::OnCapturedAudio(size_t bytes, int64_t captureTime, uint16_t flags,
+                                      float speechProbability) {
+  if (!enabled_) {
+    return;
+  }
+
+  anchorFrame_ = capturedFrames_;
+  anchorTime_ = captureTime;
+  capturedFrames_ += bytes / bytesPerFrame_;
+
+  pendingFlags_ |= flags & (AUDIO_PACKET_DISCONTINUITY | AUDIO_PACKET_TIMESTAMP_ERROR);
+  lastPacketSilent_ = (flags & AUDIO_PACKET_SILENT) != 0;
+  silentRun_ = silentRun_ && lastPacketSilent_;
+  lastPacketSpeech_ = (flags & AUDIO_PACKET_SPEECH) != 0;
+  speechRun_ = speechRun_ || lastPacketSpeech_;
+  lastSpeechProbability_ = speechProbability;
+  speechProbability_ = std::max(speechProbability_, speechProbability);
+}
+
+void AudioPacketizer::Discard(size_t bytes) {
+  uint64_t pendingFrames = capturedFrames_ - emittedFrames_;
+  capturedFrames_ -= std::min<uint64_t>(bytes / bytesPerFrame_, pendingFrames);
+  pendingFlags_ |= AUDIO_PACKET_DISCONTINUITY;
+}
+
+void AudioPacketizer::Stamp(std::vector<uint8_t>& chunk, uint16_t extraFlags) {
+  Stamp(chunk, static_cast<uint32_t>(chunk.size() / bytesPerFrame_), extraFlags);
+}
+
+void AudioPacketizer::Stamp(std::vector<uint8_t>& chunk, uint32_t frames, uint16_t extraFlags) {
+  AudioPacketHeader header;
+  header.magic = kAudioPacketMagic;
+  header.headerSize = static_cast<uint8_t>(sizeof(AudioPacketHeader));
+  header.version = kAudioPacketVersion;
+  header.flags = static_cast<uint16_t>(pendingFlags_ | extraFlags | (silentRun_ ? AUDIO_PACKET_SILENT : 0) |
+                                       (speechRun_ ? AUDIO_PACKET_SPEECH : 0));
+  header.sequence = sequence_++;
+  header.frameCount = frames;
+  header.firstSampleIndex = emittedFrames_;
+  int64_t offsetFrames = static_cast<int64_t>(emittedFrames_) - static_cast<int64_t>(anchorFrame_);
+  header.captureTime = sampleRate_ > 0
+      ? anchorTime_ + offsetFrames * 10000000 / static_cast<int64_t>(sampleRate_)
+      : anchorTime_;
+  header.sampleRate = sampleRate_;
+  header.channels = channels_;
+  header.formatId = formatId_;
+  header.speechProbability = speechProbability_;
+  header.reserved = 0;
+
+  emittedFrames_ += frames;
+  pendingFlags_ = 0;
+  // Whatever is still pending in the chunker belongs to the latest packet.
+  silentRun_ = lastPacketSilent_;
+  speechRun_ = lastPacketSpeech_;
+  speechProbability_ = lastSpeechProbability_;
+
+  chunk.insert(chunk.begin(), sizeof(AudioPacketHeader), 0);
+  std::memcpy(chunk.data(), &header, sizeof(AudioPacketHeader));
+}
+
+}  // namespace windows_loopback_recorder
@@ -0,0 +1,111 @@
+// Measures AudioEngine::Process() on 10 ms packets of 48 kHz float stereo
+// loopback and mono microphone, for the sessions the plugin runs most:
+// the plain mix, the fused speech recognition path, a rate conversion,
+// deeper dithered output, and the mix with echo cancellation and noise
+// suppression on both sources. Source and output meters are fed as in a
+// session with a volume stream.
+//
+//   audio_engine_benchmark [seconds]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "windows_loopback_recorder/audio_engine.h"
+
+using windows_loopback_recorder::AudioEngine;
+using windows_loopback_recorder::AudioMeter;
+using windows_loopback_recorder::ChannelLevels;
+using windows_loopback_recorder::DitherMode;
+using windows_loopback_recorder::EngineConfig;
+using windows_loopback_recorder::EngineMeters;
+using windows_loopback_recorder::SampleFormat;
+using windows_loopback_recorder::SourceLevels;
+
+namespace {
+
+constexpr size_t kPacketFrames = 480;  // 10 ms at 48 kHz
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  double seconds = argc > 1 ? std::atof(argv[1]) : 20.0;
+  size_t packets = static_cast<size_t>(seconds * 100);
+
+  std::mt19937 random(2);
+  std::normal_distribution<float> normal(0.0f, 0.1f);
+  std::vector<float> system(kPacketFrames * 2 * 100);
+  std::vector<float> mic(kPacketFrames * 100);
+  for (float& sample : system) sample = normal(random);
+  for (float& sample : mic) sample = normal(random);
+
+  EngineConfig base;
+  base.systemFormat = SampleFormat::FLOAT32;
+  base.systemRate = 48000;
+  base.systemChannels = 2;
+  base.micFormat = SampleFormat::FLOAT32;
+  base.micRate = 48000;
+  base.micChannels = 1;
+  base.outputRate = 48000;
+  base.outputChannels = 2;
+
+  struct Row {
+    const char* name;
+    EngineConfig config;
+  };
+  std::vector<Row> rows;
+  rows.push_back({"mix, 48 kHz stereo", base});
+  rows.push_back({"16 kHz mono (fused)", base});
+  rows.back().config.outputRate = 16000;
+  rows.back().config.outputChannels = 1;
+  rows.push_back({"44.1 kHz stereo", base});
+  rows.back().config.outputRate = 44100;
+  rows.push_back({"24-bit, shaped dither", base});
+  rows.back().config.outputFormat = SampleFormat::PCM24;
+  rows.back().config.dither = DitherMode::SHAPED;
+  rows.push_back({"echo + noise suppression", base});
+  rows.back().config.echoCancellation = true;
+  rows.back().config.micNoiseSuppression = true;
+  rows.back().config.systemNoiseSuppression = true;
+
+  std::printf("%.0f s of 48 kHz stereo loopback and mono microphone in 10 ms packets\n", seconds);
+  std::printf("                             us/packet  realtime\n");
+  for (const Row& row : rows) {
+    AudioEngine engine;
+    if (!engine.Configure(row.config)) {
+      std::printf("  %-26s unavailable\n", row.name);
+      continue;
+    }
+    AudioMeter meter;
+    meter.Configure(row.config.outputChannels);
+    SourceLevels systemMeter;
+    SourceLevels micMeter;
+    std::vector<ChannelLevels> levels;
+    EngineMeters meters;
+    meters.system = &systemMeter;
+    meters.mic = &micMeter;
+    meters.output = &meter;
+    meters.levels = &levels;
+    std::vector<uint8_t> output;
+    std::vector<uint8_t> delivery;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t packet = 0; packet < packets; packet++) {
+      size_t offset = packet % 100;
+      const uint8_t* systemBytes = reinterpret_cast<const uint8_t*>(&system[offset * kPacketFrames * 2]);
+      const uint8_t* micBytes = reinterpret_cast<const uint8_t*>(&mic[offset * kPacketFrames]);
+      engine.Process(systemBytes, kPacketFrames, micBytes, kPacketFrames, true, meters, output, delivery);
+      if (levels.empty() && !output.empty()) {
+        meter.Measure(reinterpret_cast<const int16_t*>(output.data()),
+                      output.size() / (row.config.outputChannels * 2), levels);
+      }
+    }
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    std::printf("  %-26s %9.2f  %7.4f%%\n", row.name, us / packets, us / (seconds * 1e4));
+  }
+  return 0;
+}
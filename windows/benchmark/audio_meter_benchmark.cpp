@@ -0,0 +1,103 @@
+// Measures the metering cost per 10 ms capture packet: the previous
+// CalculateRMS() loop, the fused meter on 16-bit input, and the fused
+// convert-and-measure kernel against a separate conversion plus RMS pass.
+//
+//   audio_meter_benchmark [seconds]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "windows_loopback_recorder/audio_meter.h"
+
+using windows_loopback_recorder::AudioMeter;
+using windows_loopback_recorder::ChannelLevels;
+
+namespace {
+
+constexpr uint32_t kSampleRate = 48000;
+constexpr uint16_t kChannels = 2;
+constexpr size_t kPacketFrames = kSampleRate / 100;
+
+// The metering loop the plugin used before the fused meter
+double LegacyRms(const int16_t* samples, size_t count) {
+  double sum = 0.0;
+  for (size_t i = 0; i < count; i++) {
+    double sample = static_cast<double>(samples[i]) / 32768.0;
+    sum += sample * sample;
+  }
+  return std::sqrt(sum / count);
+}
+
+void LegacyConvert(const float* in, size_t count, int16_t* out) {
+  for (size_t i = 0; i < count; i++) {
+    float sample = in[i];
+    if (sample > 1.0f) sample = 1.0f;
+    if (sample < -1.0f) sample = -1.0f;
+    out[i] = static_cast<int16_t>(sample * 32767.0f);
+  }
+}
+
+template <typename Function>
+double NanosecondsPerPacket(size_t packets, Function&& run) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t p = 0; p < packets; p++) {
+    run(p);
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  return ns / packets;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  uint32_t seconds = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 600;
+  size_t packets = static_cast<size_t>(seconds) * 100;
+  size_t packetSamples = kPacketFrames * kChannels;
+
+  // A few distinct packets, so the input isn't a single cache-hot buffer
+  constexpr size_t kDistinct = 64;
+  std::mt19937 random(3);
+  std::uniform_real_distribution<float> noise(-0.9f, 0.9f);
+  std::vector<float> floats(kDistinct * packetSamples);
+  for (float& value : floats) {
+    value = noise(random);
+  }
+  std::vector<int16_t> pcm(floats.size());
+  LegacyConvert(floats.data(), floats.size(), pcm.data());
+  std::vector<int16_t> out(packetSamples);
+
+  AudioMeter meter;
+  meter.Configure(kChannels);
+  std::vector<ChannelLevels> levels;
+  volatile double sink = 0.0;
+
+  double legacy = NanosecondsPerPacket(packets, [&](size_t p) {
+    sink = LegacyRms(&pcm[(p % kDistinct) * packetSamples], packetSamples);
+  });
+  double fused = NanosecondsPerPacket(packets, [&](size_t p) {
+    meter.Measure(&pcm[(p % kDistinct) * packetSamples], kPacketFrames, levels);
+    sink = levels[0].truePeak;
+  });
+  std::printf("16-bit input, ns per 10 ms packet:\n");
+  std::printf("  legacy RMS only:              %8.0f\n", legacy);
+  std::printf("  fused RMS/peak/true peak:     %8.0f\n", fused);
+
+  double separate = NanosecondsPerPacket(packets, [&](size_t p) {
+    LegacyConvert(&floats[(p % kDistinct) * packetSamples], packetSamples, out.data());
+    sink = LegacyRms(out.data(), packetSamples);
+  });
+  double convertAndMeasure = NanosecondsPerPacket(packets, [&](size_t p) {
+    meter.ConvertAndMeasure(&floats[(p % kDistinct) * packetSamples], kPacketFrames, out.data(), levels);
+    sink = levels[0].truePeak;
+  });
+  std::printf("float input (resampler output), ns per 10 ms packet:\n");
+  std::printf("  convert, then legacy RMS:     %8.0f\n", separate);
+  std::printf("  fused convert + all levels:   %8.0f\n", convertAndMeasure);
+  std::printf("realtime share of one core:     %8.4f%%\n", convertAndMeasure / 1e7 * 100);
+  return 0;
+}
@@ -0,0 +1,80 @@
+// Measures the echo canceller on synthetic echo-path data: the cost of one
+// block and its share of real time, and the echo return loss enhancement
+// reached after a few seconds, for several tail lengths at 48 kHz. The echo
+// path is a 30 ms delay followed by an exponentially decaying random tail.
+//
+//   echo_canceller_benchmark [seconds]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "windows_loopback_recorder/echo_canceller.h"
+
+using windows_loopback_recorder::EchoCanceller;
+
+namespace {
+
+constexpr uint32_t kSampleRate = 48000;
+constexpr uint16_t kChannels = 2;
+
+// Stereo 16-bit loopback noise and the mono microphone echo it causes
+void MakeEcho(size_t frames, std::vector<int16_t>& loopback, std::vector<int16_t>& mic) {
+  std::mt19937 random(11);
+  std::normal_distribution<float> normal(0.0f, 3000.0f);
+  loopback.resize(frames * kChannels);
+  for (int16_t& sample : loopback) {
+    sample = static_cast<int16_t>(std::fmax(-32768.0f, std::fmin(32767.0f, normal(random))));
+  }
+
+  std::vector<float> taps(kSampleRate * 120 / 1000, 0.0f);
+  size_t delay = kSampleRate * 30 / 1000;
+  std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+  for (size_t i = delay; i < taps.size(); i++) {
+    taps[i] = 0.03f * uniform(random) * std::exp(-static_cast<float>(i - delay) / (kSampleRate * 0.015f));
+  }
+
+  mic.resize(frames);
+  for (size_t n = 0; n < frames; n++) {
+    double sum = 0.0;
+    for (size_t t = delay; t < taps.size() && t <= n; t++) {
+      size_t at = (n - t) * kChannels;
+      sum += taps[t] * 0.5 * (loopback[at] + loopback[at + 1]);
+    }
+    mic[n] = static_cast<int16_t>(std::lround(sum));
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  double seconds = argc > 1 ? std::atof(argv[1]) : 8.0;
+  size_t frames = static_cast<size_t>(seconds * kSampleRate);
+  std::vector<int16_t> loopback, mic;
+  MakeEcho(frames, loopback, mic);
+
+  std::printf("tail ms  partitions  us per block  %% of real time  ERLE dB\n");
+  for (uint32_t tailMs : {64u, 128u, 250u, 500u}) {
+    EchoCanceller canceller;
+    canceller.Configure(kSampleRate, kChannels, 1, tailMs);
+    std::vector<int16_t> out(frames);
+
+    // 10 ms capture packets, as the capture thread sees them
+    size_t packet = kSampleRate / 100;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i + packet <= frames; i += packet) {
+      canceller.PushReference(&loopback[i * kChannels], packet);
+      canceller.Process(&mic[i], &out[i], packet);
+    }
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    double blocks = static_cast<double>(frames) / canceller.blockSize();
+    double realTime = us / (seconds * 1e6) * 100.0;
+    std::printf("  %5u  %10zu  %12.2f  %14.2f  %7.1f\n", tailMs, canceller.partitions(), us / blocks,
+                realTime, canceller.erleDb());
+  }
+  return 0;
+}
@@ -0,0 +1,59 @@
+// Measures the feature stream: the cost of one 10 ms row and its share of
+// real time for log-mel and MFCC rows at common capture rates, and the bytes
+// per second sent to Dart compared with the 16-bit PCM they replace.
+//
+//   feature_extractor_benchmark [seconds]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "windows_loopback_recorder/feature_extractor.h"
+
+using windows_loopback_recorder::FeatureExtractor;
+using windows_loopback_recorder::FeatureOptions;
+using windows_loopback_recorder::FEATURE_FRAME_FIELDS;
+
+int main(int argc, char** argv) {
+  double seconds = argc > 1 ? std::atof(argv[1]) : 20.0;
+  std::mt19937 random(3);
+  std::uniform_int_distribution<int> noise(-12000, 12000);
+
+  std::printf("rate   ch  rows      us/row  realtime   PCM B/s  feature B/s  ratio\n");
+  for (uint32_t rate : {16000u, 44100u, 48000u}) {
+    for (uint32_t mfcc : {0u, 13u}) {
+      const uint16_t channels = 2;
+      size_t frames = static_cast<size_t>(rate * seconds);
+      std::vector<int16_t> pcm(frames * channels);
+      for (int16_t& sample : pcm) {
+        sample = static_cast<int16_t>(noise(random));
+      }
+
+      FeatureOptions options;
+      options.mfcc = mfcc;
+      FeatureExtractor extractor;
+      extractor.Configure(rate, channels, options);
+      std::vector<float> rows;
+      rows.reserve((frames / extractor.hopFrames() + 1) * extractor.valuesPerRow());
+
+      // 10 ms capture packets
+      size_t packet = rate / 100;
+      auto start = std::chrono::steady_clock::now();
+      for (size_t i = 0; i + packet <= frames; i += packet) {
+        extractor.Push(&pcm[i * channels], packet, rows);
+      }
+      double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+      // Updates of 10 rows, each with its header
+      double pcmBytes = rate * channels * 2.0;
+      double rowsPerSecond = 1000.0 / FeatureExtractor::kHopMs;
+      double featureBytes = (rowsPerSecond * extractor.valuesPerRow() + rowsPerSecond / 10 * FEATURE_FRAME_FIELDS) * 4;
+      std::printf("%5u  %2u  %-6s  %8.2f  %7.3f%%  %8.0f  %11.0f  %5.1fx\n", rate, channels,
+                  mfcc ? "mfcc13" : "mel80", us / extractor.rows(), us / (seconds * 1e4),
+                  pcmBytes, featureBytes, pcmBytes / featureBytes);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,102 @@
+// Measures FLAC encode speed as a multiple of realtime, on one thread and on
+// the worker pool, and the compression ratio on a music-like test signal.
+//
+//   flac_encoder_benchmark [seconds] [threads]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "windows_loopback_recorder/flac_encoder.h"
+
+using windows_loopback_recorder::FlacEncoderConfig;
+using windows_loopback_recorder::FlacStreamEncoder;
+using windows_loopback_recorder::WorkerPool;
+
+namespace {
+
+// Harmonic tones with slow vibrato plus a little noise: predictable like
+// real program material, but never constant
+std::vector<int16_t> MakeProgram(uint32_t sampleRate, uint32_t seconds) {
+  std::vector<int16_t> samples(static_cast<size_t>(sampleRate) * seconds * 2);
+  std::mt19937 random(1);
+  std::normal_distribution<double> noise(0.0, 40.0);
+  const double pi = 3.14159265358979323846;
+  double phase[2] = {0.0, 0.0};
+  for (size_t i = 0; i < samples.size() / 2; i++) {
+    double t = static_cast<double>(i) / sampleRate;
+    for (int c = 0; c < 2; c++) {
+      double pitch = (c ? 330.0 : 220.0) * (1.0 + 0.01 * std::sin(2 * pi * 5 * t));
+      phase[c] += 2 * pi * pitch / sampleRate;
+      double value = 0.0;
+      for (int h = 1; h <= 6; h++) {
+        value += std::sin(h * phase[c]) / h;
+      }
+      samples[i * 2 + c] = static_cast<int16_t>(5000.0 * value + noise(random));
+    }
+  }
+  return samples;
+}
+
+struct Result {
+  double seconds = 0.0;
+  uint64_t bytes = 0;
+};
+
+Result Encode(const FlacEncoderConfig& config, const std::vector<int16_t>& samples, WorkerPool* pool) {
+  FlacStreamEncoder encoder(pool);
+  encoder.Configure(config);
+
+  Result result;
+  auto count = [&result](std::vector<uint8_t>& frame, uint32_t) { result.bytes += frame.size(); };
+
+  // 10 ms capture packets, as WASAPI delivers them
+  const uint8_t* pcm = reinterpret_cast<const uint8_t*>(samples.data());
+  size_t total = samples.size() * sizeof(int16_t);
+  size_t packet = config.sampleRate / 100 * 4;
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t offset = 0; offset < total; offset += packet) {
+    encoder.Push(pcm + offset, std::min(packet, total - offset));
+    encoder.Collect(count);
+  }
+  encoder.Finish(count);
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  uint32_t seconds = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 60;
+  size_t threads = argc > 2 ? static_cast<size_t>(std::atoi(argv[2])) : 4;
+
+  FlacEncoderConfig config;
+  config.sampleRate = 48000;
+  config.channels = 2;
+  config.bitsPerSample = 16;
+
+  std::vector<int16_t> samples = MakeProgram(config.sampleRate, seconds);
+  double pcmBytes = static_cast<double>(samples.size() * sizeof(int16_t));
+  std::printf("input:       %u s of 48 kHz stereo 16-bit (%.1f MB)\n", seconds, pcmBytes / (1 << 20));
+
+  Result single = Encode(config, samples, nullptr);
+  std::printf("1 thread:    %.1f s, %.0fx realtime, ratio %.3f\n", single.seconds,
+              seconds / single.seconds, single.bytes / pcmBytes);
+
+  WorkerPool pool(threads);
+  Result pooled = Encode(config, samples, &pool);
+  std::printf("%zu threads:   %.1f s, %.0fx realtime, ratio %.3f\n", threads, pooled.seconds,
+              seconds / pooled.seconds, pooled.bytes / pcmBytes);
+
+  // Fixed predictors only: the cheap end of the speed/size trade-off
+  config.maxLpcOrder = 0;
+  Result fixed = Encode(config, samples, nullptr);
+  std::printf("fixed only:  %.1f s, %.0fx realtime, ratio %.3f (1 thread)\n", fixed.seconds,
+              seconds / fixed.seconds, fixed.bytes / pcmBytes);
+  return 0;
+}
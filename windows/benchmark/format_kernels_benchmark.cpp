@@ -0,0 +1,149 @@
+// Measures the mix of a loopback and microphone packet as
+// MixAudioBuffers() did it, branching on the sample formats and bounds
+// inside its loops, against the kernel SelectFormatKernels() resolves for
+// the same formats, for common shared-mode layouts in 10 ms packets.
+//
+//   format_kernels_benchmark [seconds]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "windows_loopback_recorder/format_kernels.h"
+
+using windows_loopback_recorder::FormatKernels;
+using windows_loopback_recorder::SampleFormat;
+using windows_loopback_recorder::SelectFormatKernels;
+using windows_loopback_recorder::SourceLevels;
+
+namespace {
+
+struct Layout {
+  uint16_t systemBits;
+  uint16_t systemChannels;
+  uint16_t micBits;
+  uint16_t micChannels;
+};
+
+// The loops the kernels replaced, with their per-sample checks
+void BranchingMix(const Layout& layout, const uint8_t* system, size_t systemFrames, const uint8_t* mic,
+                  size_t micFrames, std::vector<uint8_t>& out, SourceLevels* systemMeter,
+                  SourceLevels* micMeter) {
+  size_t maxFrames = std::max(systemFrames, micFrames);
+  size_t systemBlockAlign = layout.systemChannels * layout.systemBits / 8;
+  size_t micBlockAlign = layout.micChannels * layout.micBits / 8;
+  out.resize(maxFrames * systemBlockAlign);
+  std::fill(out.begin(), out.end(), uint8_t(0));
+  out.resize(maxFrames * layout.systemChannels * 2);
+  for (size_t frame = 0; frame < systemFrames && frame < maxFrames; frame++) {
+    for (size_t channel = 0; channel < layout.systemChannels; channel++) {
+      size_t index = frame * layout.systemChannels + channel;
+      if (layout.systemBits == 16) {
+        if (index * 2 + 1 < out.size()) {
+          int16_t sample;
+          std::memcpy(&sample, system + index * 2, 2);
+          std::memcpy(&out[index * 2], &sample, 2);
+          if (systemMeter) systemMeter->Add(static_cast<uint16_t>(channel), sample * (1.0f / 32768.0f));
+        }
+      } else if (index * 4 + 3 < systemFrames * systemBlockAlign && index * 2 + 1 < out.size()) {
+        float sample;
+        std::memcpy(&sample, system + index * 4, 4);
+        int16_t pcm = static_cast<int16_t>(sample * 32767.0f);
+        std::memcpy(&out[index * 2], &pcm, 2);
+        if (systemMeter) systemMeter->Add(static_cast<uint16_t>(channel), sample);
+      }
+    }
+  }
+  size_t minChannels = std::min(layout.micChannels, layout.systemChannels);
+  for (size_t frame = 0; frame < micFrames && frame < maxFrames; frame++) {
+    for (size_t channel = 0; channel < minChannels; channel++) {
+      size_t outIndex = (frame * layout.systemChannels + channel) * 2;
+      size_t micIndex = frame * layout.micChannels + channel;
+      int16_t micSample = 0;
+      if (layout.micBits == 16 && micIndex * 2 + 1 < micFrames * micBlockAlign) {
+        std::memcpy(&micSample, mic + micIndex * 2, 2);
+        if (micMeter) micMeter->Add(static_cast<uint16_t>(channel), micSample * (1.0f / 32768.0f));
+      } else if (layout.micBits == 32 && micIndex * 4 + 3 < micFrames * micBlockAlign) {
+        float sample;
+        std::memcpy(&sample, mic + micIndex * 4, 4);
+        micSample = static_cast<int16_t>(sample * 32767.0f);
+        if (micMeter) micMeter->Add(static_cast<uint16_t>(channel), sample);
+      }
+      if (outIndex + 1 < out.size()) {
+        int16_t sample;
+        std::memcpy(&sample, &out[outIndex], 2);
+        int32_t mixed = static_cast<int32_t>(sample) + micSample;
+        sample = static_cast<int16_t>(std::min(32767, std::max(-32768, mixed)));
+        std::memcpy(&out[outIndex], &sample, 2);
+      }
+    }
+  }
+}
+
+std::vector<uint8_t> MakeSource(size_t samples, uint16_t bits, std::mt19937& random) {
+  std::uniform_real_distribution<float> level(-0.5f, 0.5f);
+  std::vector<uint8_t> bytes(samples * bits / 8);
+  for (size_t i = 0; i < samples; i++) {
+    float value = level(random);
+    if (bits == 16) {
+      int16_t sample = static_cast<int16_t>(value * 32767.0f);
+      std::memcpy(&bytes[i * 2], &sample, 2);
+    } else {
+      std::memcpy(&bytes[i * 4], &value, 4);
+    }
+  }
+  return bytes;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  double seconds = argc > 1 ? std::atof(argv[1]) : 20.0;
+  const size_t packet = 480;  // 10 ms at 48 kHz
+  size_t packets = static_cast<size_t>(seconds * 100);
+  std::mt19937 random(11);
+
+  std::printf("loopback      mic          metered  branching us  kernel us  speedup\n");
+  const Layout layouts[] = {{32, 2, 32, 2}, {32, 2, 16, 1}, {16, 2, 16, 2}, {32, 6, 32, 2}};
+  for (const Layout& layout : layouts) {
+    for (bool metered : {false, true}) {
+      std::vector<uint8_t> system = MakeSource(packet * layout.systemChannels, layout.systemBits, random);
+      std::vector<uint8_t> mic = MakeSource(packet * layout.micChannels, layout.micBits, random);
+      auto format = [](uint16_t bits) { return bits == 16 ? SampleFormat::PCM16 : SampleFormat::FLOAT32; };
+      FormatKernels kernels = SelectFormatKernels(format(layout.systemBits), layout.systemChannels,
+                                                  format(layout.micBits), layout.micChannels, 2);
+      SourceLevels systemMeter;
+      SourceLevels micMeter;
+      std::vector<uint8_t> out;
+
+      auto start = std::chrono::steady_clock::now();
+      for (size_t i = 0; i < packets; i++) {
+        systemMeter.Begin(layout.systemChannels);
+        micMeter.Begin(kernels.mixedMicChannels);
+        BranchingMix(layout, system.data(), packet, mic.data(), packet, out,
+                     metered ? &systemMeter : nullptr, metered ? &micMeter : nullptr);
+      }
+      double branchingUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+      start = std::chrono::steady_clock::now();
+      for (size_t i = 0; i < packets; i++) {
+        systemMeter.Begin(layout.systemChannels);
+        micMeter.Begin(kernels.mixedMicChannels);
+        out.resize(packet * layout.systemChannels * 2);
+        kernels.mix(system.data(), packet, mic.data(), packet, layout.systemChannels, layout.micChannels,
+                    reinterpret_cast<int16_t*>(out.data()), metered ? &systemMeter : nullptr,
+                    metered ? &micMeter : nullptr);
+      }
+      double kernelUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+      std::printf("%2u-bit x%u    %2u-bit x%u    %-7s  %12.2f  %9.2f  %6.1fx\n", layout.systemBits,
+                  layout.systemChannels, layout.micBits, layout.micChannels, metered ? "yes" : "no",
+                  branchingUs / packets, kernelUs / packets, branchingUs / kernelUs);
+    }
+  }
+  return 0;
+}
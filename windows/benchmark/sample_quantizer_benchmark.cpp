@@ -0,0 +1,93 @@
+// Measures SampleQuantizer on 10 ms packets of 48 kHz stereo against the
+// scalar clamp-and-truncate loop of ConvertFromFloat() it replaces, for
+// every output format and dither mode. The 24-bit rows with and without
+// triangular dither differ only by the noise, which is what the generators
+// cost.
+//
+//   sample_quantizer_benchmark [seconds]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "windows_loopback_recorder/sample_quantizer.h"
+
+using windows_loopback_recorder::DitherMode;
+using windows_loopback_recorder::SampleFormat;
+using windows_loopback_recorder::SampleQuantizer;
+
+namespace {
+
+constexpr size_t kPacketFrames = 480;  // 10 ms at 48 kHz
+constexpr uint16_t kChannels = 2;
+
+// Best of |passes| runs over the input in 10 ms packets
+template <typename Convert>
+double Time(const std::vector<float>& in, Convert&& convert, int passes = 5) {
+  double best = 0.0;
+  for (int pass = 0; pass < passes; pass++) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i + kPacketFrames * kChannels <= in.size(); i += kPacketFrames * kChannels) {
+      convert(&in[i]);
+    }
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    best = pass == 0 ? us : std::min(best, us);
+  }
+  return best;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  double seconds = argc > 1 ? std::atof(argv[1]) : 20.0;
+  size_t frames = static_cast<size_t>(48000 * seconds);
+  size_t packets = frames / kPacketFrames;
+
+  std::mt19937 random(6);
+  std::normal_distribution<float> normal(0.0f, 0.2f);
+  std::vector<float> in(frames * kChannels);
+  for (float& sample : in) {
+    sample = normal(random);
+  }
+  std::vector<uint8_t> out(kPacketFrames * kChannels * 4);
+
+  double legacyUs = Time(in, [&](const float* packet) {
+    int16_t* pcm = reinterpret_cast<int16_t*>(out.data());
+    for (size_t i = 0; i < kPacketFrames * kChannels; i++) {
+      float sample = packet[i];
+      if (sample > 1.0f) sample = 1.0f;
+      if (sample < -1.0f) sample = -1.0f;
+      pcm[i] = static_cast<int16_t>(sample * 32767.0f);
+    }
+  });
+
+  struct Row {
+    const char* name;
+    SampleFormat format;
+    DitherMode dither;
+  };
+  const Row rows[] = {
+      {"16-bit, undithered", SampleFormat::PCM16, DitherMode::NONE},
+      {"16-bit, triangular", SampleFormat::PCM16, DitherMode::TRIANGULAR},
+      {"16-bit, shaped", SampleFormat::PCM16, DitherMode::SHAPED},
+      {"24-bit, undithered", SampleFormat::PCM24, DitherMode::NONE},
+      {"24-bit, triangular", SampleFormat::PCM24, DitherMode::TRIANGULAR},
+      {"32-bit integer", SampleFormat::PCM32, DitherMode::NONE},
+      {"32-bit float", SampleFormat::FLOAT32, DitherMode::NONE},
+  };
+
+  std::printf("%.0f s of 48 kHz stereo in 10 ms packets\n", seconds);
+  std::printf("                             us/packet  realtime\n");
+  std::printf("  ConvertFromFloat() loop    %9.3f  %7.4f%%\n", legacyUs / packets, legacyUs / (seconds * 1e4));
+  for (const Row& row : rows) {
+    SampleQuantizer quantizer;
+    quantizer.Configure(row.format, kChannels, row.dither);
+    double us = Time(in, [&](const float* packet) { quantizer.Quantize(packet, kPacketFrames, out.data()); });
+    std::printf("  %-26s %9.3f  %7.4f%%   (%.2fx)\n", row.name, us / packets, us / (seconds * 1e4),
+                legacyUs / us);
+  }
+  return 0;
+}
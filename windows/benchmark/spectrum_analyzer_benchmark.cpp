@@ -0,0 +1,98 @@
+// Measures the cost of one spectrum update: the real FFT against a textbook
+// complex radix-2 FFT of the full length, and a whole Analyze() (window,
+// transform, power and band reduction) at each supported display size.
+//
+//   spectrum_analyzer_benchmark [updates]
+
+#include <chrono>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "windows_loopback_recorder/spectrum_analyzer.h"
+
+using windows_loopback_recorder::RealFft;
+using windows_loopback_recorder::SpectrumAnalyzer;
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Recursive complex FFT, the way a spectrum is usually computed in Dart
+void NaiveFft(std::vector<std::complex<float>>& x) {
+  size_t n = x.size();
+  if (n < 2) {
+    return;
+  }
+  std::vector<std::complex<float>> even(n / 2), odd(n / 2);
+  for (size_t i = 0; i < n / 2; i++) {
+    even[i] = x[2 * i];
+    odd[i] = x[2 * i + 1];
+  }
+  NaiveFft(even);
+  NaiveFft(odd);
+  for (size_t k = 0; k < n / 2; k++) {
+    std::complex<float> t = std::polar(1.0f, static_cast<float>(-2.0 * kPi * k / n)) * odd[k];
+    x[k] = even[k] + t;
+    x[k + n / 2] = even[k] - t;
+  }
+}
+
+template <typename Function>
+double MicrosecondsPerUpdate(size_t updates, Function&& run) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t u = 0; u < updates; u++) {
+    run();
+  }
+  double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  return us / updates;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t updates = argc > 1 ? static_cast<size_t>(std::atoi(argv[1])) : 20000;
+  std::mt19937 random(5);
+  std::uniform_int_distribution<int> noise(-20000, 20000);
+
+  std::printf("us per update     fft  naive complex  analyze (32 bands)\n");
+  for (size_t size : {512u, 1024u, 2048u, 4096u, 8192u}) {
+    std::vector<int16_t> pcm(size * 2);
+    for (int16_t& sample : pcm) {
+      sample = static_cast<int16_t>(noise(random));
+    }
+    std::vector<float> in(size);
+    for (size_t i = 0; i < size; i++) {
+      in[i] = pcm[2 * i] / 32768.0f;
+    }
+    std::vector<float> re(size / 2 + 1), im(size / 2 + 1);
+    RealFft fft(size);
+    volatile float sink = 0.0f;
+
+    double real = MicrosecondsPerUpdate(updates, [&] {
+      fft.Forward(in.data(), re.data(), im.data());
+      sink = re[1];
+    });
+    std::vector<std::complex<float>> buffer(size);
+    double naive = MicrosecondsPerUpdate(updates / 10 + 1, [&] {
+      for (size_t i = 0; i < size; i++) {
+        buffer[i] = in[i];
+      }
+      NaiveFft(buffer);
+      sink = buffer[1].real();
+    });
+
+    SpectrumAnalyzer analyzer;
+    analyzer.Configure(48000, 2, size, 32, 20.0f, 20000.0f);
+    analyzer.Push(pcm.data(), size);
+    std::vector<float> bands;
+    double analyze = MicrosecondsPerUpdate(updates, [&] {
+      analyzer.Analyze(bands);
+      sink = bands[0];
+    });
+    std::printf("  %5zu  %10.2f  %13.2f  %18.2f\n", size, real, naive, analyze);
+  }
+  return 0;
+}
@@ -0,0 +1,54 @@
+#include "windows_loopback_recorder/dart_native_port.h"
+
+namespace windows_loopback_recorder {
+
+namespace {
+
+// Runs on the Dart side once the Uint8List is garbage collected.
+void FreePostedBuffer(void* isolate_callback_data, void* peer) {
+  delete static_cast<std::vector<uint8_t>*>(peer);
+}
+
+}  // namespace
+
+DartNativePort::DartNativePort(Dart_Port port, Dart_PostCObject_Type postCObject)
+    : port_(port), postCObject_(postCObject) {}
+
+bool DartNativePort::PostBuffer(std::vector<uint8_t>& buffer) {
+  if (!postCObject_ || buffer.empty()) {
+    return false;
+  }
+
+  // Move the vector to the heap so its storage can outlive this call without
+  // copying; the vector itself becomes the finalizer peer.
+  auto* owned = new std::vector<uint8_t>(std::move(buffer));
+
+  Dart_CObject message;
+  message.type = Dart_CObject_kExternalTypedData;
+  message.value.as_external_typed_data.type = Dart_TypedData_kUint8;
+  message.value.as_external_typed_data.length = static_cast<intptr_t>(owned->size());
+  message.value.as_external_typed_data.data = owned->data();
+  message.value.as_external_typed_data.peer = owned;
+  message.value.as_external_typed_data.callback = FreePostedBuffer;
+
+  if (!postCObject_(port_, &message)) {
+    // Port closed or isolate gone: ownership stays with us.
+    buffer = std::move(*owned);
+    delete owned;
+    return false;
+  }
+  return true;
+}
+
+bool DartNativePort::PostInt64(int64_t value) {
+  if (!postCObject_) {
+    return false;
+  }
+
+  Dart_CObject message;
+  message.type = Dart_CObject_kInt64;
+  message.value.as_int64 = value;
+  return postCObject_(port_, &message);
+}
+
+}  // namespace windows_loopback_recorder
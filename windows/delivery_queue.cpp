@@ -0,0 +1,188 @@
+#include "windows_loopback_recorder/delivery_queue.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#include "windows_loopback_recorder/audio_packet.h"
+
+namespace windows_loopback_recorder {
+
+void DeliveryQueue::SetSender(SendFunction sender) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  sender_ = std::move(sender);
+}
+
+void DeliveryQueue::Configure(BackpressurePolicy policy, size_t maxChunks, uint32_t bytesPerFrame,
+                              uint32_t headerBytes, uint8_t silenceByte) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  policy_ = policy;
+  // A silence marker and the chunk after it need two slots.
+  maxChunks_ = std::max<size_t>(maxChunks, 2);
+  bytesPerFrame_ = bytesPerFrame;
+  headerBytes_ = headerBytes;
+  silenceByte_ = silenceByte;
+  closed_ = false;
+
+  queue_.clear();
+  queuedBytes_ = 0;
+  inFlight_ = 0;
+  pendingSilenceBytes_ = 0;
+  droppedHeader_.clear();
+  sequence_ = 0;
+  stats_ = DeliveryStats();
+}
+
+void DeliveryQueue::Push(std::vector<uint8_t>&& chunk) {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  if (policy_ == BackpressurePolicy::NONE) {
+    DeliveryItem item;
+    item.data = std::move(chunk);
+    if (sender_) {
+      sender_(item);
+    }
+    stats_.deliveredChunks++;
+    return;
+  }
+
+  DrainLocked();
+
+  size_t needed = pendingSilenceBytes_ > 0 ? 2 : 1;
+  if (queue_.size() + needed > maxChunks_) {
+    switch (policy_) {
+      case BackpressurePolicy::BLOCK:
+        spaceAvailable_.wait(lock, [this, needed] {
+          return queue_.size() + needed <= maxChunks_ || closed_;
+        });
+        if (queue_.size() + needed > maxChunks_) {
+          // Closed while still full: nobody is going to drain us.
+          RecordDropLocked(chunk.size());
+          sequence_++;
+          return;
+        }
+        break;
+
+      case BackpressurePolicy::DROP_OLDEST:
+        while (!queue_.empty() && queue_.size() + needed > maxChunks_) {
+          queuedBytes_ -= queue_.front().data.size();
+          RecordDropLocked(queue_.front().data.size());
+          queue_.pop_front();
+        }
+        break;
+
+      case BackpressurePolicy::DROP_NEWEST: {
+        size_t silence = RecordDropLocked(chunk.size());
+        if (silence > 0 && pendingSilenceBytes_ == 0 && headerBytes_ > 0) {
+          droppedHeader_.assign(chunk.begin(), chunk.begin() + headerBytes_);
+        }
+        pendingSilenceBytes_ += silence;
+        return;
+      }
+
+      case BackpressurePolicy::NONE:
+        break;
+    }
+  }
+
+  if (pendingSilenceBytes_ > 0) {
+    DeliveryItem marker;
+    if (headerBytes_ > 0) {
+      marker.data = SilentPacketLocked();
+      queuedBytes_ += marker.data.size();
+    } else {
+      marker.silenceBytes = pendingSilenceBytes_;
+    }
+    queue_.push_back(std::move(marker));
+    pendingSilenceBytes_ = 0;
+  }
+
+  DeliveryItem item;
+  item.data = std::move(chunk);
+  NumberLocked(item.data);
+  queuedBytes_ += item.data.size();
+  queue_.push_back(std::move(item));
+
+  stats_.highWatermarkChunks = std::max<uint64_t>(stats_.highWatermarkChunks, queue_.size());
+  stats_.highWatermarkBytes = std::max<uint64_t>(stats_.highWatermarkBytes, queuedBytes_);
+
+  DrainLocked();
+}
+
+void DeliveryQueue::Acknowledge(uint64_t count) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  inFlight_ -= std::min(count, inFlight_);
+  DrainLocked();
+}
+
+void DeliveryQueue::Close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  closed_ = true;
+  spaceAvailable_.notify_all();
+}
+
+DeliveryStats DeliveryQueue::GetStats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  DeliveryStats stats = stats_;
+  stats.queuedChunks = queue_.size();
+  stats.inFlightChunks = inFlight_;
+  return stats;
+}
+
+void DeliveryQueue::DrainLocked() {
+  bool drained = false;
+  while (!queue_.empty() && inFlight_ < maxChunks_) {
+    DeliveryItem item = std::move(queue_.front());
+    queue_.pop_front();
+    queuedBytes_ -= item.data.size();
+    drained = true;
+
+    // Items nobody is listening for are consumed on the spot.
+    if (sender_ && sender_(item)) {
+      inFlight_++;
+    }
+    stats_.deliveredChunks++;
+  }
+
+  if (drained) {
+    spaceAvailable_.notify_all();
+  }
+}
+
+size_t DeliveryQueue::RecordDropLocked(size_t bytes) {
+  size_t payload = bytes > headerBytes_ ? bytes - headerBytes_ : 0;
+  stats_.droppedChunks++;
+  if (bytesPerFrame_ == 0) {
+    return 0;  // Frame count unknown; nothing to pad with
+  }
+  stats_.droppedFrames += payload / bytesPerFrame_;
+  return payload;
+}
+
+void DeliveryQueue::NumberLocked(std::vector<uint8_t>& chunk) {
+  if (headerBytes_ == 0 || chunk.size() < headerBytes_) {
+    return;
+  }
+  uint32_t sequence = sequence_++;
+  std::memcpy(chunk.data() + offsetof(AudioPacketHeader, sequence), &sequence, sizeof(sequence));
+}
+
+std::vector<uint8_t> DeliveryQueue::SilentPacketLocked() {
+  AudioPacketHeader header;
+  std::memcpy(&header, droppedHeader_.data(), sizeof(AudioPacketHeader));
+  // Timing and format stay the first dropped chunk's; the rest describes
+  // the silence
+  header.flags = static_cast<uint16_t>((header.flags & (AUDIO_PACKET_DISCONTINUITY | AUDIO_PACKET_TIMESTAMP_ERROR)) |
+                                       AUDIO_PACKET_SILENT | AUDIO_PACKET_DROPPED);
+  header.frameCount = static_cast<uint32_t>(pendingSilenceBytes_ / bytesPerFrame_);
+  if (header.speechProbability > 0.0f) {
+    header.speechProbability = 0.0f;
+  }
+
+  std::vector<uint8_t> packet(headerBytes_ + pendingSilenceBytes_, silenceByte_);
+  std::memcpy(packet.data(), &header, sizeof(AudioPacketHeader));
+  NumberLocked(packet);
+  return packet;
+}
+
+}  // namespace windows_loopback_recorder
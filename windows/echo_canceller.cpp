@@ -0,0 +1,334 @@
+#include "windows_loopback_recorder/echo_canceller.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace windows_loopback_recorder {
+
+namespace {
+
+// Block of about 4 ms, rounded up to a power of two
+constexpr uint32_t kBlockMs = 4;
+// Loopback audio the microphone may lag behind before the oldest is dropped;
+// bounds the drift between the two device clocks
+constexpr uint32_t kMaxBacklogMs = 100;
+// Normalized LMS step
+constexpr float kStep = 0.5f;
+// Regularization of the normalization, as a loopback power of -60 dBFS
+constexpr float kRegularization = 1e-6f;
+// Adaptation pauses while the microphone peak exceeds the loopback peaks
+// within the tail by this ratio, or the loopback is quieter than kQuietPeak
+constexpr float kDoubleTalkRatio = 0.5f;
+constexpr float kQuietPeak = 1e-4f;
+// Weight of the newest block in the smoothed energies
+constexpr float kSmoothing = 0.2f;
+// The foreground filter takes the background coefficients once they have
+// left this much less error than both the foreground and the microphone for
+// kAdoptBlocks in a row; the background restarts from the foreground when it
+// leaves this much more
+constexpr float kAdoptRatio = 0.5f;
+constexpr uint32_t kAdoptBlocks = 10;
+constexpr float kRestartRatio = 4.0f;
+
+inline float ToFloat(int16_t sample) { return sample * (1.0f / 32768.0f); }
+inline float ToFloat(float sample) { return sample; }
+
+inline void FromFloat(float value, int16_t& sample) {
+  float scaled = std::round(value * 32768.0f);
+  sample = static_cast<int16_t>(std::clamp(scaled, -32768.0f, 32767.0f));
+}
+inline void FromFloat(float value, float& sample) { sample = value; }
+
+}  // namespace
+
+bool EchoCanceller::Configure(uint32_t sampleRate, uint16_t referenceChannels, uint16_t micChannels,
+                              uint32_t tailMs) {
+  fft_.reset();
+  if (sampleRate < 8000 || referenceChannels == 0 || micChannels == 0 || tailMs == 0 ||
+      tailMs > kMaxTailMs) {
+    return false;
+  }
+  sampleRate_ = sampleRate;
+  referenceChannels_ = referenceChannels;
+  micChannels_ = micChannels;
+
+  blockSize_ = RealFft::kMinSize / 2;
+  while (blockSize_ < static_cast<size_t>(sampleRate) * kBlockMs / 1000) {
+    blockSize_ *= 2;
+  }
+  size_t tailSamples = static_cast<size_t>(sampleRate) * tailMs / 1000;
+  partitions_ = std::max<size_t>(1, (tailSamples + blockSize_ - 1) / blockSize_);
+  bins_ = blockSize_ + 1;
+  fft_ = std::make_unique<RealFft>(2 * blockSize_);
+
+  referenceRing_.resize(static_cast<size_t>(sampleRate) * kMaxBacklogMs / 1000);
+  micIn_.resize(blockSize_ * micChannels);
+  micMono_.resize(blockSize_);
+  reference_.resize(2 * blockSize_);
+  micOut_.resize(blockSize_ * micChannels);
+  xRe_.resize(partitions_ * bins_);
+  xIm_.resize(partitions_ * bins_);
+  wRe_.resize(partitions_ * bins_);
+  wIm_.resize(partitions_ * bins_);
+  foregroundRe_.resize(partitions_ * bins_);
+  foregroundIm_.resize(partitions_ * bins_);
+  power_.resize(bins_);
+  blockPeaks_.resize(partitions_);
+  time_.resize(2 * blockSize_);
+  re_.resize(bins_);
+  im_.resize(bins_);
+  echo_.resize(blockSize_);
+  Reset();
+  return true;
+}
+
+void EchoCanceller::Reset() {
+  referenceRead_ = 0;
+  referenceCount_ = 0;
+  filled_ = 0;
+  std::fill(reference_.begin(), reference_.end(), 0.0f);
+  std::fill(micOut_.begin(), micOut_.end(), 0.0f);
+  std::fill(xRe_.begin(), xRe_.end(), 0.0f);
+  std::fill(xIm_.begin(), xIm_.end(), 0.0f);
+  std::fill(wRe_.begin(), wRe_.end(), 0.0f);
+  std::fill(wIm_.begin(), wIm_.end(), 0.0f);
+  std::fill(foregroundRe_.begin(), foregroundRe_.end(), 0.0f);
+  std::fill(foregroundIm_.begin(), foregroundIm_.end(), 0.0f);
+  std::fill(blockPeaks_.begin(), blockPeaks_.end(), 0.0f);
+  xHead_ = 0;
+  constrainNext_ = 0;
+  micEnergy_ = 0.0f;
+  outEnergy_ = 0.0f;
+  backgroundEnergy_ = 0.0f;
+  betterBlocks_ = 0;
+  erleDb_ = 0.0f;
+}
+
+void EchoCanceller::PushReference(const int16_t* samples, size_t frames) {
+  if (!fft_) {
+    return;
+  }
+  float scale = 1.0f / (32768.0f * referenceChannels_);
+  for (size_t i = 0; i < frames; i++) {
+    int32_t sum = 0;
+    for (uint16_t c = 0; c < referenceChannels_; c++) {
+      sum += samples[c];
+    }
+    samples += referenceChannels_;
+    PushReferenceSample(sum * scale);
+  }
+}
+
+void EchoCanceller::PushReference(const float* samples, size_t frames) {
+  if (!fft_) {
+    return;
+  }
+  float scale = 1.0f / referenceChannels_;
+  for (size_t i = 0; i < frames; i++) {
+    float sum = 0.0f;
+    for (uint16_t c = 0; c < referenceChannels_; c++) {
+      sum += samples[c];
+    }
+    samples += referenceChannels_;
+    PushReferenceSample(sum * scale);
+  }
+}
+
+void EchoCanceller::PushReferenceSample(float sample) {
+  size_t capacity = referenceRing_.size();
+  if (referenceCount_ == capacity) {
+    // The microphone fell too far behind; drop the oldest
+    referenceRead_ = (referenceRead_ + 1) % capacity;
+    referenceCount_--;
+  }
+  referenceRing_[(referenceRead_ + referenceCount_) % capacity] = sample;
+  referenceCount_++;
+}
+
+float EchoCanceller::PopReferenceSample() {
+  if (referenceCount_ == 0) {
+    return 0.0f;
+  }
+  float sample = referenceRing_[referenceRead_];
+  referenceRead_ = (referenceRead_ + 1) % referenceRing_.size();
+  referenceCount_--;
+  return sample;
+}
+
+void EchoCanceller::Process(const int16_t* in, int16_t* out, size_t frames) {
+  ProcessFrames(in, out, frames);
+}
+
+void EchoCanceller::Process(const float* in, float* out, size_t frames) {
+  ProcessFrames(in, out, frames);
+}
+
+template <typename Sample>
+void EchoCanceller::ProcessFrames(const Sample* in, Sample* out, size_t frames) {
+  if (!fft_) {
+    if (out != in) {
+      std::copy(in, in + frames * micChannels_, out);
+    }
+    return;
+  }
+  float scale = 1.0f / micChannels_;
+  for (size_t i = 0; i < frames; i++) {
+    // The input is read before the delayed output overwrites it
+    float* block = &micIn_[filled_ * micChannels_];
+    float sum = 0.0f;
+    for (uint16_t c = 0; c < micChannels_; c++) {
+      block[c] = ToFloat(in[c]);
+      sum += block[c];
+    }
+    const float* cancelled = &micOut_[filled_ * micChannels_];
+    for (uint16_t c = 0; c < micChannels_; c++) {
+      FromFloat(cancelled[c], out[c]);
+    }
+    in += micChannels_;
+    out += micChannels_;
+
+    micMono_[filled_] = sum * scale;
+    reference_[blockSize_ + filled_] = PopReferenceSample();
+    if (++filled_ == blockSize_) {
+      ProcessBlock();
+      filled_ = 0;
+    }
+  }
+}
+
+void EchoCanceller::ProcessBlock() {
+  const size_t n = blockSize_;
+
+  // Newest loopback spectrum over the last 2N samples
+  xHead_ = (xHead_ + partitions_ - 1) % partitions_;
+  fft_->Forward(reference_.data(), &xRe_[xHead_ * bins_], &xIm_[xHead_ * bins_]);
+  float referencePeak = 0.0f;
+  for (size_t i = n; i < 2 * n; i++) {
+    referencePeak = std::max(referencePeak, std::fabs(reference_[i]));
+  }
+  blockPeaks_[xHead_] = referencePeak;
+  std::copy(reference_.begin() + n, reference_.end(), reference_.begin());
+
+  // Echo estimates Y = sum of W_p X_p of both filters, and the loopback
+  // power in each bin over the whole tail for the step normalization
+  std::fill(re_.begin(), re_.end(), 0.0f);
+  std::fill(im_.begin(), im_.end(), 0.0f);
+  std::fill(power_.begin(), power_.end(), 0.0f);
+  for (size_t p = 0; p < partitions_; p++) {
+    size_t at = ((xHead_ + p) % partitions_) * bins_;
+    const float* xr = &xRe_[at];
+    const float* xi = &xIm_[at];
+    const float* wr = &foregroundRe_[p * bins_];
+    const float* wi = &foregroundIm_[p * bins_];
+    for (size_t k = 0; k < bins_; k++) {
+      re_[k] += wr[k] * xr[k] - wi[k] * xi[k];
+      im_[k] += wr[k] * xi[k] + wi[k] * xr[k];
+      power_[k] += xr[k] * xr[k] + xi[k] * xi[k];
+    }
+  }
+  fft_->Inverse(re_.data(), im_.data(), time_.data());
+  std::copy(time_.begin() + n, time_.end(), echo_.begin());
+
+  std::fill(re_.begin(), re_.end(), 0.0f);
+  std::fill(im_.begin(), im_.end(), 0.0f);
+  for (size_t p = 0; p < partitions_; p++) {
+    size_t at = ((xHead_ + p) % partitions_) * bins_;
+    const float* xr = &xRe_[at];
+    const float* xi = &xIm_[at];
+    const float* wr = &wRe_[p * bins_];
+    const float* wi = &wIm_[p * bins_];
+    for (size_t k = 0; k < bins_; k++) {
+      re_[k] += wr[k] * xr[k] - wi[k] * xi[k];
+      im_[k] += wr[k] * xi[k] + wi[k] * xr[k];
+    }
+  }
+  fft_->Inverse(re_.data(), im_.data(), time_.data());
+
+  // Errors against the microphone. The background error goes to the
+  // second half of time_, after zeros, to drive the adaptation.
+  float micEnergy = 0.0f;
+  float errorEnergy = 0.0f;
+  float backgroundEnergy = 0.0f;
+  float micPeak = 0.0f;
+  for (size_t i = 0; i < n; i++) {
+    float error = micMono_[i] - echo_[i];
+    float backgroundError = micMono_[i] - time_[n + i];
+    micEnergy += micMono_[i] * micMono_[i];
+    errorEnergy += error * error;
+    backgroundEnergy += backgroundError * backgroundError;
+    micPeak = std::max(micPeak, std::fabs(micMono_[i]));
+    time_[i] = 0.0f;
+    time_[n + i] = backgroundError;
+  }
+
+  // Never make the microphone louder: a filter that is off track (e.g.
+  // after the echo path changed) leaves the block alone while it recovers
+  bool diverged = errorEnergy > micEnergy;
+  for (size_t i = 0; i < n; i++) {
+    float echo = diverged ? 0.0f : echo_[i];
+    for (uint16_t c = 0; c < micChannels_; c++) {
+      micOut_[i * micChannels_ + c] = micIn_[i * micChannels_ + c] - echo;
+    }
+  }
+  micEnergy_ += kSmoothing * (micEnergy - micEnergy_);
+  outEnergy_ += kSmoothing * ((diverged ? micEnergy : errorEnergy) - outEnergy_);
+  backgroundEnergy_ += kSmoothing * (backgroundEnergy - backgroundEnergy_);
+  erleDb_ = outEnergy_ > 0.0f && micEnergy_ > outEnergy_
+      ? 10.0f * std::log10(micEnergy_ / outEnergy_)
+      : 0.0f;
+
+  // Hand the coefficients over in whichever direction helps
+  bool better = backgroundEnergy_ < kAdoptRatio * outEnergy_ && backgroundEnergy_ < kAdoptRatio * micEnergy_;
+  betterBlocks_ = better ? betterBlocks_ + 1 : 0;
+  if (betterBlocks_ >= kAdoptBlocks) {
+    foregroundRe_ = wRe_;
+    foregroundIm_ = wIm_;
+    outEnergy_ = backgroundEnergy_;
+    betterBlocks_ = 0;
+  } else if (backgroundEnergy_ > kRestartRatio * outEnergy_) {
+    wRe_ = foregroundRe_;
+    wIm_ = foregroundIm_;
+    backgroundEnergy_ = outEnergy_;
+  }
+
+  // Adapt unless there is nothing to learn from or the near end talks
+  float tailPeak = *std::max_element(blockPeaks_.begin(), blockPeaks_.end());
+  if (tailPeak < kQuietPeak || micPeak > kDoubleTalkRatio * tailPeak) {
+    return;
+  }
+
+  fft_->Forward(time_.data(), re_.data(), im_.data());
+  float regularization = kRegularization * 2.0f * n * partitions_;
+  for (size_t k = 0; k < bins_; k++) {
+    float step = kStep / (power_[k] + regularization);
+    re_[k] *= step;
+    im_[k] *= step;
+  }
+  for (size_t p = 0; p < partitions_; p++) {
+    size_t at = ((xHead_ + p) % partitions_) * bins_;
+    const float* xr = &xRe_[at];
+    const float* xi = &xIm_[at];
+    float* wr = &wRe_[p * bins_];
+    float* wi = &wIm_[p * bins_];
+    // W_p += step conj(X_p) E
+    for (size_t k = 0; k < bins_; k++) {
+      wr[k] += xr[k] * re_[k] + xi[k] * im_[k];
+      wi[k] += xr[k] * im_[k] - xi[k] * re_[k];
+    }
+  }
+
+  Constrain(constrainNext_);
+  constrainNext_ = (constrainNext_ + 1) % partitions_;
+}
+
+void EchoCanceller::Constrain(size_t partition) {
+  // Keep the partition a linear (N-tap) filter: circular wrap-around from
+  // the unconstrained update lands in the second half and is cleared
+  float* wr = &wRe_[partition * bins_];
+  float* wi = &wIm_[partition * bins_];
+  fft_->Inverse(wr, wi, time_.data());
+  std::fill(time_.begin() + blockSize_, time_.end(), 0.0f);
+  fft_->Forward(time_.data(), wr, wi);
+}
+
+}  // namespace windows_loopback_recorder
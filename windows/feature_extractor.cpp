@@ -0,0 +1,228 @@
+#include "windows_loopback_recorder/feature_extractor.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define WLR_FEATURES_SSE2 1
+#endif
+
+namespace windows_loopback_recorder {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Energy below which a filter reads kLogFloor
+constexpr float kEnergyFloor = 1e-10f;
+
+double HzToMel(double hz) { return 2595.0 * std::log10(1.0 + hz / 700.0); }
+double MelToHz(double mel) { return 700.0 * (std::pow(10.0, mel / 2595.0) - 1.0); }
+
+float Dot(const float* a, const float* b, size_t count) {
+  size_t i = 0;
+  float sum = 0.0f;
+#ifdef WLR_FEATURES_SSE2
+  __m128 acc = _mm_setzero_ps();
+  for (; i + 4 <= count; i += 4) {
+    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, acc);
+  sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+  for (; i < count; i++) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+// re[k] = re[k]^2 + im[k]^2
+void Power(float* re, const float* im, size_t count) {
+  size_t k = 0;
+#ifdef WLR_FEATURES_SSE2
+  for (; k + 4 <= count; k += 4) {
+    __m128 r = _mm_loadu_ps(re + k);
+    __m128 i = _mm_loadu_ps(im + k);
+    _mm_storeu_ps(re + k, _mm_add_ps(_mm_mul_ps(r, r), _mm_mul_ps(i, i)));
+  }
+#endif
+  for (; k < count; k++) {
+    re[k] = re[k] * re[k] + im[k] * im[k];
+  }
+}
+
+}  // namespace
+
+bool FeatureExtractor::Configure(uint32_t sampleRate, uint16_t channels, const FeatureOptions& options) {
+  fft_.reset();
+  double maxHz = std::min(options.maxHz, sampleRate / 2.0);
+  if (sampleRate < 8000 || channels == 0 || options.melBins == 0 || options.melBins > kMaxMelBins ||
+      options.mfcc > options.melBins || !(options.minHz >= 0.0) || !(options.minHz < maxHz) ||
+      !(options.preEmphasis >= 0.0) || !(options.preEmphasis < 1.0)) {
+    return false;
+  }
+  sampleRate_ = sampleRate;
+  channels_ = channels;
+  windowFrames_ = static_cast<size_t>(sampleRate) * kWindowMs / 1000;
+  hopFrames_ = static_cast<size_t>(sampleRate) * kHopMs / 1000;
+  preEmphasis_ = static_cast<float>(options.preEmphasis);
+  minHz_ = static_cast<float>(options.minHz);
+  maxHz_ = static_cast<float>(maxHz);
+
+  size_t fftSize = RealFft::kMinSize;
+  while (fftSize < windowFrames_) {
+    fftSize *= 2;
+  }
+  if (!RealFft::IsValidSize(fftSize)) {
+    return false;
+  }
+  fft_ = std::make_unique<RealFft>(fftSize);
+
+  // Periodic Hann over the window; the zero padding stays zero
+  window_.assign(windowFrames_, 0.0f);
+  for (size_t n = 0; n < windowFrames_; n++) {
+    window_[n] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * kPi * n / windowFrames_));
+  }
+
+  // Triangles between neighbouring points evenly spaced in mel. A filter
+  // narrower than a bin takes the bin its center falls into.
+  size_t bins = fftSize / 2 + 1;
+  double binHz = static_cast<double>(sampleRate) / fftSize;
+  double lowMel = HzToMel(options.minHz);
+  double highMel = HzToMel(maxHz);
+  filterFirst_.resize(options.melBins);
+  filterLength_.resize(options.melBins);
+  filterOffset_.resize(options.melBins);
+  weights_.clear();
+  for (size_t f = 0; f < options.melBins; f++) {
+    double left = MelToHz(lowMel + (highMel - lowMel) * f / (options.melBins + 1));
+    double center = MelToHz(lowMel + (highMel - lowMel) * (f + 1) / (options.melBins + 1));
+    double right = MelToHz(lowMel + (highMel - lowMel) * (f + 2) / (options.melBins + 1));
+    size_t first = bins;
+    size_t end = 0;
+    size_t offset = weights_.size();
+    for (size_t k = static_cast<size_t>(std::ceil(left / binHz)); k < bins && k * binHz < right; k++) {
+      double hz = k * binHz;
+      double weight = hz <= center ? (hz - left) / (center - left) : (right - hz) / (right - center);
+      if (weight <= 0.0) {
+        continue;
+      }
+      if (first == bins) {
+        first = k;
+      }
+      // Zeros between non-zero weights cannot occur in a triangle
+      weights_.push_back(static_cast<float>(weight));
+      end = k + 1;
+    }
+    if (first == bins) {
+      first = std::min(bins - 1, static_cast<size_t>(std::lround(center / binHz)));
+      end = first + 1;
+      weights_.push_back(1.0f);
+    }
+    filterFirst_[f] = static_cast<uint32_t>(first);
+    filterLength_[f] = static_cast<uint32_t>(end - first);
+    filterOffset_[f] = static_cast<uint32_t>(offset);
+  }
+
+  // Orthonormal DCT-II rows
+  dct_.resize(static_cast<size_t>(options.mfcc) * options.melBins);
+  for (size_t c = 0; c < options.mfcc; c++) {
+    double scale = std::sqrt((c == 0 ? 1.0 : 2.0) / options.melBins);
+    for (size_t m = 0; m < options.melBins; m++) {
+      dct_[c * options.melBins + m] =
+          static_cast<float>(scale * std::cos(kPi * c * (m + 0.5) / options.melBins));
+    }
+  }
+
+  input_.resize(windowFrames_);
+  windowed_.assign(fftSize, 0.0f);
+  re_.resize(bins);
+  im_.resize(bins);
+  logMel_.resize(options.melBins);
+  Reset();
+  return true;
+}
+
+void FeatureExtractor::Reset() {
+  std::fill(input_.begin(), input_.end(), 0.0f);
+  filled_ = 0;
+  lastSample_ = 0.0f;
+  rows_ = 0;
+}
+
+size_t FeatureExtractor::Push(const int16_t* samples, size_t frames, std::vector<float>& rows) {
+  if (!fft_) {
+    return 0;
+  }
+  size_t appended = 0;
+  float scale = 1.0f / (32768.0f * channels_);
+  for (size_t i = 0; i < frames; i++) {
+    int32_t sum = 0;
+    for (uint16_t c = 0; c < channels_; c++) {
+      sum += samples[c];
+    }
+    samples += channels_;
+    float sample = sum * scale;
+    input_[filled_++] = sample - preEmphasis_ * lastSample_;
+    lastSample_ = sample;
+
+    if (filled_ == windowFrames_) {
+      size_t at = rows.size();
+      rows.resize(at + valuesPerRow());
+      ComputeRow(&rows[at]);
+      // The next window starts one hop later
+      std::copy(input_.begin() + hopFrames_, input_.end(), input_.begin());
+      filled_ -= hopFrames_;
+      rows_++;
+      appended++;
+    }
+  }
+  return appended;
+}
+
+void FeatureExtractor::ComputeRow(float* row) {
+  for (size_t n = 0; n < windowFrames_; n++) {
+    windowed_[n] = input_[n] * window_[n];
+  }
+  fft_->Forward(windowed_.data(), re_.data(), im_.data());
+  Power(re_.data(), im_.data(), re_.size());
+
+  for (size_t f = 0; f < logMel_.size(); f++) {
+    float energy = Dot(&weights_[filterOffset_[f]], &re_[filterFirst_[f]], filterLength_[f]);
+    logMel_[f] = energy > kEnergyFloor ? std::max(kLogFloor, std::log(energy)) : kLogFloor;
+  }
+
+  if (dct_.empty()) {
+    std::copy(logMel_.begin(), logMel_.end(), row);
+    return;
+  }
+  size_t mfcc = valuesPerRow();
+  for (size_t c = 0; c < mfcc; c++) {
+    row[c] = Dot(&dct_[c * logMel_.size()], logMel_.data(), logMel_.size());
+  }
+}
+
+std::vector<float> BuildFeatureFrame(uint64_t firstRow, const FeatureExtractor& extractor,
+                                     const std::vector<float>& rows) {
+  size_t valuesPerRow = extractor.valuesPerRow();
+  std::vector<float> frame(FEATURE_FRAME_FIELDS + rows.size());
+  frame[FEATURE_FRAME_HEADER_SIZE] = static_cast<float>(FEATURE_FRAME_FIELDS);
+  frame[FEATURE_FRAME_VERSION] = kFeatureFrameVersion;
+  frame[FEATURE_FRAME_SAMPLE_RATE] = static_cast<float>(extractor.sampleRate());
+  frame[FEATURE_FRAME_HOP_MS] =
+      static_cast<float>(1000.0 * extractor.hopFrames() / extractor.sampleRate());
+  frame[FEATURE_FRAME_WINDOW_MS] =
+      static_cast<float>(1000.0 * extractor.windowFrames() / extractor.sampleRate());
+  frame[FEATURE_FRAME_FIRST_ROW] = static_cast<float>(firstRow);
+  frame[FEATURE_FRAME_ROWS] = static_cast<float>(valuesPerRow ? rows.size() / valuesPerRow : 0);
+  frame[FEATURE_FRAME_VALUES_PER_ROW] = static_cast<float>(valuesPerRow);
+  frame[FEATURE_FRAME_MEL_BINS] = static_cast<float>(extractor.melBins());
+  frame[FEATURE_FRAME_MIN_HZ] = extractor.minHz();
+  frame[FEATURE_FRAME_MAX_HZ] = extractor.maxHz();
+  std::copy(rows.begin(), rows.end(), frame.begin() + FEATURE_FRAME_FIELDS);
+  return frame;
+}
+
+}  // namespace windows_loopback_recorder
@@ -0,0 +1,284 @@
+#include "windows_loopback_recorder/file_writer.h"
+
+#ifdef _WIN32
+#include <windows.h>
+
+#include <string>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+
+namespace windows_loopback_recorder {
+
+FileWriter::~FileWriter() {
+  Close();
+}
+
+FileReader::~FileReader() {
+  Close();
+}
+
+#ifdef _WIN32
+
+namespace {
+
+std::wstring ToWidePath(const std::string& path) {
+  int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+  if (length <= 0) {
+    return std::wstring();
+  }
+  std::wstring widePath(static_cast<size_t>(length), L'\0');
+  MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &widePath[0], length);
+  return widePath;
+}
+
+}  // namespace
+
+bool FileWriter::Open(const std::string& path) {
+  Close();
+
+  std::wstring widePath = ToWidePath(path);
+  if (widePath.empty()) {
+    return false;
+  }
+
+  HANDLE handle = CreateFileW(widePath.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                              CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                              nullptr);
+  if (handle == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  handle_ = handle;
+  return true;
+}
+
+void FileWriter::Close() {
+  if (handle_) {
+    CloseHandle(static_cast<HANDLE>(handle_));
+    handle_ = nullptr;
+  }
+}
+
+bool FileWriter::isOpen() const {
+  return handle_ != nullptr;
+}
+
+bool FileWriter::WriteAt(uint64_t offset, const void* data, size_t size) {
+  if (!handle_) {
+    return false;
+  }
+
+  const BYTE* bytes = static_cast<const BYTE*>(data);
+  while (size > 0) {
+    DWORD toWrite = static_cast<DWORD>(std::min<size_t>(size, 0x40000000));
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+    overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+    DWORD written = 0;
+    if (!WriteFile(static_cast<HANDLE>(handle_), bytes, toWrite, &written, &overlapped) ||
+        written == 0) {
+      return false;
+    }
+    bytes += written;
+    offset += written;
+    size -= written;
+  }
+  return true;
+}
+
+bool FileWriter::Preallocate(uint64_t size) {
+  if (!handle_) {
+    return false;
+  }
+
+  // Reserves clusters; the end of file stays where it is
+  FILE_ALLOCATION_INFO info = {};
+  info.AllocationSize.QuadPart = static_cast<LONGLONG>(size);
+  return SetFileInformationByHandle(static_cast<HANDLE>(handle_), FileAllocationInfo,
+                                    &info, sizeof(info)) != FALSE;
+}
+
+bool FileWriter::Flush() {
+  return handle_ && FlushFileBuffers(static_cast<HANDLE>(handle_));
+}
+
+bool FileWriter::Remove(const std::string& path) {
+  std::wstring widePath = ToWidePath(path);
+  return !widePath.empty() && DeleteFileW(widePath.c_str()) != FALSE;
+}
+
+bool FileReader::Open(const std::string& path) {
+  Close();
+
+  std::wstring widePath = ToWidePath(path);
+  if (widePath.empty()) {
+    return false;
+  }
+
+  HANDLE handle = CreateFileW(widePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+  if (handle == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  handle_ = handle;
+  return true;
+}
+
+void FileReader::Close() {
+  if (handle_) {
+    CloseHandle(static_cast<HANDLE>(handle_));
+    handle_ = nullptr;
+  }
+}
+
+bool FileReader::isOpen() const {
+  return handle_ != nullptr;
+}
+
+bool FileReader::ReadAt(uint64_t offset, void* data, size_t size) {
+  if (!handle_) {
+    return false;
+  }
+
+  BYTE* bytes = static_cast<BYTE*>(data);
+  while (size > 0) {
+    DWORD toRead = static_cast<DWORD>(std::min<size_t>(size, 0x40000000));
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+    overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+    DWORD read = 0;
+    if (!ReadFile(static_cast<HANDLE>(handle_), bytes, toRead, &read, &overlapped) || read == 0) {
+      return false;
+    }
+    bytes += read;
+    offset += read;
+    size -= read;
+  }
+  return true;
+}
+
+uint64_t FileReader::size() const {
+  LARGE_INTEGER size = {};
+  if (!handle_ || !GetFileSizeEx(static_cast<HANDLE>(handle_), &size)) {
+    return 0;
+  }
+  return static_cast<uint64_t>(size.QuadPart);
+}
+
+#else
+
+bool FileWriter::Open(const std::string& path) {
+  Close();
+  fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  return fd_ >= 0;
+}
+
+void FileWriter::Close() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+}
+
+bool FileWriter::isOpen() const {
+  return fd_ >= 0;
+}
+
+bool FileWriter::WriteAt(uint64_t offset, const void* data, size_t size) {
+  if (fd_ < 0) {
+    return false;
+  }
+
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  while (size > 0) {
+    ssize_t written = ::pwrite(fd_, bytes, size, static_cast<off_t>(offset));
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      return false;
+    }
+    bytes += written;
+    offset += static_cast<uint64_t>(written);
+    size -= static_cast<size_t>(written);
+  }
+  return true;
+}
+
+bool FileWriter::Preallocate(uint64_t size) {
+  if (fd_ < 0) {
+    return false;
+  }
+#ifdef __linux__
+  return ::fallocate(fd_, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(size)) == 0;
+#else
+  (void)size;
+  return false;
+#endif
+}
+
+bool FileWriter::Flush() {
+  return fd_ >= 0 && ::fsync(fd_) == 0;
+}
+
+bool FileWriter::Remove(const std::string& path) {
+  return ::unlink(path.c_str()) == 0;
+}
+
+bool FileReader::Open(const std::string& path) {
+  Close();
+  fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  return fd_ >= 0;
+}
+
+void FileReader::Close() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+}
+
+bool FileReader::isOpen() const {
+  return fd_ >= 0;
+}
+
+bool FileReader::ReadAt(uint64_t offset, void* data, size_t size) {
+  if (fd_ < 0) {
+    return false;
+  }
+
+  uint8_t* bytes = static_cast<uint8_t*>(data);
+  while (size > 0) {
+    ssize_t read = ::pread(fd_, bytes, size, static_cast<off_t>(offset));
+    if (read < 0 && errno == EINTR) {
+      continue;
+    }
+    if (read <= 0) {
+      return false;
+    }
+    bytes += read;
+    offset += static_cast<uint64_t>(read);
+    size -= static_cast<size_t>(read);
+  }
+  return true;
+}
+
+uint64_t FileReader::size() const {
+  struct stat info;
+  if (fd_ < 0 || ::fstat(fd_, &info) != 0) {
+    return 0;
+  }
+  return static_cast<uint64_t>(info.st_size);
+}
+
+#endif
+
+}  // namespace windows_loopback_recorder
@@ -0,0 +1,1034 @@
+#include "windows_loopback_recorder/flac_encoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+namespace windows_loopback_recorder {
+
+namespace {
+
+constexpr uint32_t kMaxFixedOrder = 4;
+constexpr uint32_t kMaxLpcOrder = 32;
+constexpr uint32_t kMaxPartitionOrder = 8;
+constexpr uint32_t kMaxRiceParameter = 14;   // 4-bit parameters; 15 is the escape code
+constexpr uint32_t kMaxRice2Parameter = 30;  // 5-bit parameters; 31 is the escape code
+
+enum ChannelAssignment : uint32_t {
+  LEFT_SIDE = 8,
+  RIGHT_SIDE = 9,
+  MID_SIDE = 10,
+};
+
+enum SubframeType {
+  SUBFRAME_CONSTANT,
+  SUBFRAME_VERBATIM,
+  SUBFRAME_FIXED,
+  SUBFRAME_LPC,
+};
+
+// MSB-first bit packer appending to a byte vector.
+class BitWriter {
+ public:
+  explicit BitWriter(std::vector<uint8_t>& out) : out_(out) {}
+
+  // |bits| <= 32
+  void Write(uint32_t value, uint32_t bits) {
+    if (bits == 0) {
+      return;
+    }
+    accumulator_ = (accumulator_ << bits) | (value & (0xFFFFFFFFu >> (32 - bits)));
+    count_ += bits;
+    while (count_ >= 8) {
+      count_ -= 8;
+      out_.push_back(static_cast<uint8_t>(accumulator_ >> count_));
+    }
+  }
+
+  void WriteSigned(int32_t value, uint32_t bits) {
+    Write(static_cast<uint32_t>(value), bits);
+  }
+
+  // Unary quotient (zeros closed by a one) followed by |parameter| low bits.
+  void WriteRice(uint32_t value, uint32_t parameter) {
+    uint32_t quotient = value >> parameter;
+    while (quotient >= 31) {
+      Write(0, 31);
+      quotient -= 31;
+    }
+    Write(1, quotient + 1);
+    Write(value, parameter);
+  }
+
+  void AlignToByte() {
+    if (count_ > 0) {
+      Write(0, 8 - count_);
+    }
+  }
+
+ private:
+  std::vector<uint8_t>& out_;
+  uint64_t accumulator_ = 0;
+  uint32_t count_ = 0;
+};
+
+struct CrcTables {
+  uint8_t crc8[256];
+  uint16_t crc16[256];
+
+  CrcTables() {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c8 = i;
+      uint32_t c16 = i << 8;
+      for (int bit = 0; bit < 8; bit++) {
+        c8 = (c8 & 0x80) ? ((c8 << 1) ^ 0x07) : (c8 << 1);
+        c16 = (c16 & 0x8000) ? ((c16 << 1) ^ 0x8005) : (c16 << 1);
+      }
+      crc8[i] = static_cast<uint8_t>(c8);
+      crc16[i] = static_cast<uint16_t>(c16);
+    }
+  }
+};
+
+const CrcTables& Crc() {
+  static const CrcTables tables;
+  return tables;
+}
+
+uint8_t Crc8(const uint8_t* data, size_t size) {
+  const CrcTables& tables = Crc();
+  uint8_t crc = 0;
+  for (size_t i = 0; i < size; i++) {
+    crc = tables.crc8[crc ^ data[i]];
+  }
+  return crc;
+}
+
+uint16_t Crc16(const uint8_t* data, size_t size) {
+  const CrcTables& tables = Crc();
+  uint16_t crc = 0;
+  for (size_t i = 0; i < size; i++) {
+    crc = static_cast<uint16_t>((crc << 8) ^ tables.crc16[(crc >> 8) ^ data[i]]);
+  }
+  return crc;
+}
+
+uint32_t BlockSizeCode(uint32_t frames) {
+  switch (frames) {
+    case 192: return 1;
+    case 576: return 2;
+    case 1152: return 3;
+    case 2304: return 4;
+    case 4608: return 5;
+    case 256: return 8;
+    case 512: return 9;
+    case 1024: return 10;
+    case 2048: return 11;
+    case 4096: return 12;
+    case 8192: return 13;
+    case 16384: return 14;
+    case 32768: return 15;
+    default: return frames <= 256 ? 6 : 7;  // 8- or 16-bit size after the header
+  }
+}
+
+uint32_t SampleRateCode(uint32_t rate) {
+  switch (rate) {
+    case 88200: return 1;
+    case 176400: return 2;
+    case 192000: return 3;
+    case 8000: return 4;
+    case 16000: return 5;
+    case 22050: return 6;
+    case 24000: return 7;
+    case 32000: return 8;
+    case 44100: return 9;
+    case 48000: return 10;
+    case 96000: return 11;
+    default:
+      if (rate % 1000 == 0 && rate / 1000 <= 255) return 12;
+      if (rate <= 65535) return 13;
+      if (rate % 10 == 0 && rate / 10 <= 65535) return 14;
+      return 0;  // Taken from STREAMINFO
+  }
+}
+
+uint32_t SampleSizeCode(uint32_t bits) {
+  switch (bits) {
+    case 8: return 1;
+    case 12: return 2;
+    case 16: return 4;
+    case 20: return 5;
+    case 24: return 6;
+    default: return 0;  // Taken from STREAMINFO
+  }
+}
+
+// The frame number uses the extended UTF-8 scheme (up to 36 bits).
+void WriteUtf8(BitWriter& writer, uint64_t value) {
+  if (value < 0x80) {
+    writer.Write(static_cast<uint32_t>(value), 8);
+    return;
+  }
+
+  uint32_t continuation = 1;
+  while (continuation < 6 && value >= (uint64_t(1) << (5 * continuation + 6))) {
+    continuation++;
+  }
+  uint32_t leadBits = 6 - continuation;  // Payload bits in the first byte
+  uint32_t leadMarker = (0xFF00u >> (continuation + 1)) & 0xFF;
+  writer.Write(leadMarker | (static_cast<uint32_t>(value >> (6 * continuation)) & ((1u << leadBits) - 1)), 8);
+  for (uint32_t i = continuation; i > 0; i--) {
+    writer.Write(0x80 | static_cast<uint32_t>((value >> (6 * (i - 1))) & 0x3F), 8);
+  }
+}
+
+uint32_t ZigZag(int32_t value) {
+  return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+struct ResidualPlan {
+  uint32_t partitionOrder = 0;
+  bool rice2 = false;
+  uint32_t parameters[1 << kMaxPartitionOrder];
+  uint64_t bits = 0;  // Coding method and partition order included
+};
+
+struct SubframePlan {
+  SubframeType type = SUBFRAME_VERBATIM;
+  uint32_t bitsPerSample = 16;  // Before removing wasted bits
+  uint32_t wastedBits = 0;
+  uint32_t order = 0;
+  uint32_t precision = 0;
+  int32_t shift = 0;
+  int32_t coefficients[kMaxLpcOrder];
+  std::vector<int32_t> samples;    // Wasted bits already removed
+  std::vector<int32_t> residual;   // Prediction error, indexed from the first sample
+  std::vector<int32_t> candidate;  // Scratch for the predictor not (yet) chosen
+  ResidualPlan rice;
+  uint64_t bits = 0;
+};
+
+uint32_t RiceBits(uint64_t sum, uint32_t count, uint32_t parameter) {
+  return static_cast<uint32_t>(std::min<uint64_t>(count * uint64_t(parameter + 1) + (sum >> parameter),
+                                                  std::numeric_limits<uint32_t>::max()));
+}
+
+// Chooses the partition order and per-partition Rice parameters for
+// residual[order..n). Parameters are picked from the partition sums, which
+// estimates each partition's size closely; the returned size is exact.
+uint64_t PlanResidual(const int32_t* residual, uint32_t n, uint32_t order,
+                      uint32_t maxPartitionOrder, ResidualPlan& plan) {
+  uint32_t maxOrder = std::min(maxPartitionOrder, kMaxPartitionOrder);
+  while (maxOrder > 0 && ((n & ((1u << maxOrder) - 1)) != 0 || (n >> maxOrder) <= order)) {
+    maxOrder--;
+  }
+
+  uint64_t sums[2][1 << kMaxPartitionOrder];
+  uint32_t partitions = 1u << maxOrder;
+  uint32_t partitionSize = n >> maxOrder;
+  for (uint32_t p = 0, i = order; p < partitions; p++) {
+    uint32_t end = (p + 1) * partitionSize;
+    uint64_t sum = 0;
+    for (; i < end; i++) {
+      sum += ZigZag(residual[i]);
+    }
+    sums[0][p] = sum;
+  }
+
+  uint64_t bestBits = std::numeric_limits<uint64_t>::max();
+  uint64_t* current = sums[0];
+  uint64_t* merged = sums[1];
+  for (int partitionOrder = static_cast<int>(maxOrder); partitionOrder >= 0; partitionOrder--) {
+    uint32_t count = 1u << partitionOrder;
+    uint32_t size = n >> partitionOrder;
+    uint32_t parameters[1 << kMaxPartitionOrder];
+    uint64_t bits = 0;
+    uint32_t maxParameter = 0;
+    for (uint32_t p = 0; p < count; p++) {
+      uint32_t samples = p == 0 ? size - order : size;
+      uint64_t mean = samples > 0 ? current[p] / samples : 0;
+      uint32_t guess = 0;
+      while (guess < kMaxRice2Parameter && (mean >> guess) > 1) {
+        guess++;
+      }
+      uint32_t best = guess;
+      uint32_t partitionBits = RiceBits(current[p], samples, guess);
+      for (uint32_t k = guess > 0 ? guess - 1 : 0; k <= std::min(guess + 1, kMaxRice2Parameter); k++) {
+        uint32_t candidate = RiceBits(current[p], samples, k);
+        if (candidate < partitionBits) {
+          partitionBits = candidate;
+          best = k;
+        }
+      }
+      parameters[p] = best;
+      maxParameter = std::max(maxParameter, best);
+      bits += partitionBits;
+    }
+    bits += count * (maxParameter > kMaxRiceParameter ? 5 : 4);
+
+    if (bits < bestBits) {
+      bestBits = bits;
+      plan.partitionOrder = static_cast<uint32_t>(partitionOrder);
+      plan.rice2 = maxParameter > kMaxRiceParameter;
+      std::memcpy(plan.parameters, parameters, count * sizeof(uint32_t));
+    }
+
+    // Pairwise sums give the next lower partition order
+    for (uint32_t p = 0; p < count / 2; p++) {
+      merged[p] = current[2 * p] + current[2 * p + 1];
+    }
+    std::swap(current, merged);
+  }
+
+  // Exact size of the chosen layout
+  uint64_t bits = 2 + 4;
+  uint32_t count = 1u << plan.partitionOrder;
+  uint32_t size = n >> plan.partitionOrder;
+  for (uint32_t p = 0, i = order; p < count; p++) {
+    uint32_t k = plan.parameters[p];
+    uint32_t end = (p + 1) * size;
+    bits += plan.rice2 ? 5 : 4;
+    bits += uint64_t(end - i) * (k + 1);
+    for (; i < end; i++) {
+      bits += ZigZag(residual[i]) >> k;
+    }
+  }
+  plan.bits = bits;
+  return bits;
+}
+
+void WriteResidual(BitWriter& writer, const int32_t* residual, uint32_t n, uint32_t order,
+                   const ResidualPlan& plan) {
+  writer.Write(plan.rice2 ? 1 : 0, 2);
+  writer.Write(plan.partitionOrder, 4);
+  uint32_t count = 1u << plan.partitionOrder;
+  uint32_t size = n >> plan.partitionOrder;
+  for (uint32_t p = 0, i = order; p < count; p++) {
+    uint32_t k = plan.parameters[p];
+    writer.Write(k, plan.rice2 ? 5 : 4);
+    for (uint32_t end = (p + 1) * size; i < end; i++) {
+      writer.WriteRice(ZigZag(residual[i]), k);
+    }
+  }
+}
+
+// Fills residual[order..n) for the fixed polynomial predictor of |order|.
+void FixedResidual(const int32_t* x, uint32_t n, uint32_t order, int32_t* residual) {
+  for (uint32_t i = order; i < n; i++) {
+    switch (order) {
+      case 0: residual[i] = x[i]; break;
+      case 1: residual[i] = x[i] - x[i - 1]; break;
+      case 2: residual[i] = x[i] - 2 * x[i - 1] + x[i - 2]; break;
+      case 3: residual[i] = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3]; break;
+      default: residual[i] = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4]; break;
+    }
+  }
+}
+
+// Picks the fixed order with the smallest total absolute error.
+uint32_t BestFixedOrder(const int32_t* x, uint32_t n) {
+  if (n <= kMaxFixedOrder) {
+    return 0;
+  }
+
+  uint64_t totals[kMaxFixedOrder + 1] = {};
+  int64_t last0 = x[3];
+  int64_t last1 = x[3] - x[2];
+  int64_t last2 = last1 - (x[2] - x[1]);
+  int64_t last3 = last2 - ((x[2] - x[1]) - (x[1] - x[0]));
+  for (uint32_t i = kMaxFixedOrder; i < n; i++) {
+    int64_t e0 = x[i];
+    int64_t e1 = e0 - last0;
+    int64_t e2 = e1 - last1;
+    int64_t e3 = e2 - last2;
+    int64_t e4 = e3 - last3;
+    totals[0] += static_cast<uint64_t>(std::llabs(e0));
+    totals[1] += static_cast<uint64_t>(std::llabs(e1));
+    totals[2] += static_cast<uint64_t>(std::llabs(e2));
+    totals[3] += static_cast<uint64_t>(std::llabs(e3));
+    totals[4] += static_cast<uint64_t>(std::llabs(e4));
+    last0 = e0;
+    last1 = e1;
+    last2 = e2;
+    last3 = e3;
+  }
+
+  uint32_t best = 0;
+  for (uint32_t order = 1; order <= kMaxFixedOrder; order++) {
+    if (totals[order] < totals[best]) {
+      best = order;
+    }
+  }
+  return best;
+}
+
+void TukeyWindow(uint32_t n, std::vector<double>& window) {
+  // Tukey(0.5): flat middle, raised-cosine tapers over a quarter each side
+  window.assign(n, 1.0);
+  uint32_t taper = n / 4;
+  if (taper == 0) {
+    return;
+  }
+  for (uint32_t i = 0; i < taper; i++) {
+    double w = 0.5 - 0.5 * std::cos(3.14159265358979323846 * i / taper);
+    window[i] = w;
+    window[n - 1 - i] = w;
+  }
+}
+
+// Levinson-Durbin recursion; lpc[o][0..o] holds the predictor of order o+1.
+// Returns the highest usable order.
+uint32_t ComputeLpc(const double* autoc, uint32_t maxOrder, double lpc[][kMaxLpcOrder],
+                    double* error) {
+  double reflection[kMaxLpcOrder];
+  double err = autoc[0];
+  for (uint32_t i = 0; i < maxOrder; i++) {
+    double r = -autoc[i + 1];
+    for (uint32_t j = 0; j < i; j++) {
+      r -= reflection[j] * autoc[i - j];
+    }
+    r /= err;
+
+    reflection[i] = r;
+    uint32_t j = 0;
+    for (; j < (i >> 1); j++) {
+      double tmp = reflection[j];
+      reflection[j] += r * reflection[i - 1 - j];
+      reflection[i - 1 - j] += r * tmp;
+    }
+    if (i & 1) {
+      reflection[j] += reflection[j] * r;
+    }
+
+    err *= 1.0 - r * r;
+    for (j = 0; j <= i; j++) {
+      lpc[i][j] = -reflection[j];
+    }
+    error[i] = err;
+    if (err <= 0.0) {
+      return i + 1;
+    }
+  }
+  return maxOrder;
+}
+
+// Quantizes to |precision|-bit coefficients with a shared right shift,
+// carrying the rounding error forward. False if the predictor cannot be
+// represented with a non-negative shift.
+bool QuantizeLpc(const double* lpc, uint32_t order, uint32_t precision, int32_t* coefficients,
+                 int32_t* shift) {
+  double cmax = 0.0;
+  for (uint32_t i = 0; i < order; i++) {
+    cmax = std::max(cmax, std::fabs(lpc[i]));
+  }
+  if (cmax <= 0.0) {
+    return false;
+  }
+
+  int exponent;
+  std::frexp(cmax, &exponent);
+  int s = static_cast<int>(precision) - 1 - exponent;
+  if (s < 0) {
+    return false;
+  }
+  s = std::min(s, 15);
+
+  int32_t maxCoefficient = (1 << (precision - 1)) - 1;
+  int32_t minCoefficient = -(1 << (precision - 1));
+  double carried = 0.0;
+  for (uint32_t i = 0; i < order; i++) {
+    carried += lpc[i] * (1 << s);
+    long q = std::lround(carried);
+    q = std::clamp<long>(q, minCoefficient, maxCoefficient);
+    carried -= q;
+    coefficients[i] = static_cast<int32_t>(q);
+  }
+  *shift = s;
+  return true;
+}
+
+// False if some residual does not fit in 32 bits.
+bool LpcResidual(const int32_t* x, uint32_t n, const int32_t* coefficients, uint32_t order,
+                 int32_t shift, int32_t* residual) {
+  for (uint32_t i = order; i < n; i++) {
+    int64_t sum = 0;
+    for (uint32_t j = 0; j < order; j++) {
+      sum += static_cast<int64_t>(coefficients[j]) * x[i - 1 - j];
+    }
+    int64_t error = static_cast<int64_t>(x[i]) - (sum >> shift);
+    if (error > std::numeric_limits<int32_t>::max() || error < -std::numeric_limits<int32_t>::max()) {
+      return false;
+    }
+    residual[i] = static_cast<int32_t>(error);
+  }
+  return true;
+}
+
+uint32_t WastedBits(const int32_t* x, uint32_t n) {
+  uint32_t combined = 0;
+  for (uint32_t i = 0; i < n && (combined & 1) == 0; i++) {
+    combined |= static_cast<uint32_t>(x[i]);
+  }
+  if (combined == 0) {
+    return 0;
+  }
+  uint32_t wasted = 0;
+  while ((combined & 1) == 0) {
+    combined >>= 1;
+    wasted++;
+  }
+  return wasted;
+}
+
+struct Scratch {
+  std::vector<int32_t> channels[8];
+  std::vector<int32_t> mid;
+  std::vector<int32_t> side;
+  std::vector<double> windowed;
+  std::vector<double> window;  // For short final blocks
+  SubframePlan plans[8];
+  SubframePlan midPlan;
+  SubframePlan sidePlan;
+};
+
+void PlanSubframe(const int32_t* x, uint32_t n, uint32_t bitsPerSample, const FlacEncoderConfig& config,
+                  uint32_t qlpPrecision, const std::vector<double>& window, Scratch& scratch,
+                  SubframePlan& plan) {
+  plan.bitsPerSample = bitsPerSample;
+  plan.wastedBits = 0;
+  plan.order = 0;
+
+  bool constant = true;
+  for (uint32_t i = 1; i < n && constant; i++) {
+    constant = x[i] == x[0];
+  }
+  if (constant) {
+    plan.type = SUBFRAME_CONSTANT;
+    plan.samples.assign(x, x + 1);
+    plan.bits = 8 + bitsPerSample;
+    return;
+  }
+
+  plan.wastedBits = WastedBits(x, n);
+  uint32_t bits = bitsPerSample - plan.wastedBits;
+  uint32_t headerBits = 8 + plan.wastedBits;
+  plan.samples.resize(n);
+  for (uint32_t i = 0; i < n; i++) {
+    plan.samples[i] = x[i] >> plan.wastedBits;
+  }
+  const int32_t* s = plan.samples.data();
+
+  plan.type = SUBFRAME_VERBATIM;
+  plan.bits = headerBits + uint64_t(n) * bits;
+
+  plan.residual.resize(n);
+  plan.candidate.resize(n);
+
+  // Fixed polynomial predictor
+  uint32_t fixedOrder = BestFixedOrder(s, n);
+  if (n > fixedOrder) {
+    FixedResidual(s, n, fixedOrder, plan.residual.data());
+    ResidualPlan rice;
+    uint64_t fixedBits = headerBits + uint64_t(fixedOrder) * bits +
+                         PlanResidual(plan.residual.data(), n, fixedOrder, config.maxPartitionOrder, rice);
+    if (fixedBits < plan.bits) {
+      plan.type = SUBFRAME_FIXED;
+      plan.order = fixedOrder;
+      plan.rice = rice;
+      plan.bits = fixedBits;
+    }
+  }
+
+  // Linear prediction
+  uint32_t maxOrder = std::min(config.maxLpcOrder, kMaxLpcOrder);
+  if (maxOrder == 0 || n <= maxOrder * 2) {
+    return;
+  }
+
+  const double* w = window.data();
+  if (window.size() != n) {
+    TukeyWindow(n, scratch.window);
+    w = scratch.window.data();
+  }
+  scratch.windowed.resize(n);
+  for (uint32_t i = 0; i < n; i++) {
+    scratch.windowed[i] = s[i] * w[i];
+  }
+
+  double autoc[kMaxLpcOrder + 1];
+  const double* d = scratch.windowed.data();
+  for (uint32_t lag = 0; lag <= maxOrder; lag++) {
+    double sum = 0.0;
+    for (uint32_t i = lag; i < n; i++) {
+      sum += d[i] * d[i - lag];
+    }
+    autoc[lag] = sum;
+  }
+  if (autoc[0] <= 0.0) {
+    return;
+  }
+
+  double lpc[kMaxLpcOrder][kMaxLpcOrder];
+  double error[kMaxLpcOrder];
+  maxOrder = ComputeLpc(autoc, maxOrder, lpc, error);
+
+  // Estimate each order's cost from its prediction error, then code the best
+  uint32_t order = 0;
+  double bestEstimate = std::numeric_limits<double>::max();
+  for (uint32_t o = 1; o <= maxOrder; o++) {
+    double perSample = error[o - 1] > 0.0 ? 0.5 * std::log2(0.5 * error[o - 1] / n) : 0.0;
+    double estimate = std::max(perSample, 0.0) * (n - o) + o * double(bits + qlpPrecision);
+    if (estimate < bestEstimate) {
+      bestEstimate = estimate;
+      order = o;
+    }
+  }
+
+  int32_t coefficients[kMaxLpcOrder];
+  int32_t shift = 0;
+  if (order == 0 || !QuantizeLpc(lpc[order - 1], order, qlpPrecision, coefficients, &shift) ||
+      !LpcResidual(s, n, coefficients, order, shift, plan.candidate.data())) {
+    return;
+  }
+
+  ResidualPlan rice;
+  uint64_t lpcBits = headerBits + uint64_t(order) * bits + 4 + 5 + uint64_t(order) * qlpPrecision +
+                     PlanResidual(plan.candidate.data(), n, order, config.maxPartitionOrder, rice);
+  if (lpcBits < plan.bits) {
+    plan.type = SUBFRAME_LPC;
+    plan.order = order;
+    plan.precision = qlpPrecision;
+    plan.shift = shift;
+    std::memcpy(plan.coefficients, coefficients, order * sizeof(int32_t));
+    plan.rice = rice;
+    plan.bits = lpcBits;
+    plan.residual.swap(plan.candidate);
+  }
+}
+
+void WriteSubframe(BitWriter& writer, const SubframePlan& plan, uint32_t n) {
+  uint32_t typeBits = 0;
+  switch (plan.type) {
+    case SUBFRAME_CONSTANT: typeBits = 0x00; break;
+    case SUBFRAME_VERBATIM: typeBits = 0x01; break;
+    case SUBFRAME_FIXED: typeBits = 0x08 | plan.order; break;
+    case SUBFRAME_LPC: typeBits = 0x20 | (plan.order - 1); break;
+  }
+
+  writer.Write(0, 1);
+  writer.Write(typeBits, 6);
+  if (plan.wastedBits > 0) {
+    writer.Write(1, 1);
+    writer.Write(1, plan.wastedBits);  // Unary: wastedBits - 1 zeros, then a one
+  } else {
+    writer.Write(0, 1);
+  }
+
+  uint32_t bits = plan.bitsPerSample - plan.wastedBits;
+  const int32_t* s = plan.samples.data();
+  switch (plan.type) {
+    case SUBFRAME_CONSTANT:
+      writer.WriteSigned(s[0], plan.bitsPerSample);
+      break;
+
+    case SUBFRAME_VERBATIM:
+      for (uint32_t i = 0; i < n; i++) {
+        writer.WriteSigned(s[i], bits);
+      }
+      break;
+
+    case SUBFRAME_FIXED:
+      for (uint32_t i = 0; i < plan.order; i++) {
+        writer.WriteSigned(s[i], bits);
+      }
+      WriteResidual(writer, plan.residual.data(), n, plan.order, plan.rice);
+      break;
+
+    case SUBFRAME_LPC:
+      for (uint32_t i = 0; i < plan.order; i++) {
+        writer.WriteSigned(s[i], bits);
+      }
+      writer.Write(plan.precision - 1, 4);
+      writer.WriteSigned(plan.shift, 5);
+      for (uint32_t i = 0; i < plan.order; i++) {
+        writer.WriteSigned(plan.coefficients[i], plan.precision);
+      }
+      WriteResidual(writer, plan.residual.data(), n, plan.order, plan.rice);
+      break;
+  }
+}
+
+uint32_t QlpPrecisionFor(uint32_t blockSize) {
+  if (blockSize <= 192) return 7;
+  if (blockSize <= 384) return 8;
+  if (blockSize <= 576) return 9;
+  if (blockSize <= 1152) return 10;
+  if (blockSize <= 2304) return 11;
+  if (blockSize <= 4608) return 12;
+  return 13;
+}
+
+void PutBE(std::vector<uint8_t>& buffer, size_t offset, uint64_t value, size_t bytes) {
+  for (size_t i = 0; i < bytes; i++) {
+    buffer[offset + i] = static_cast<uint8_t>(value >> (8 * (bytes - 1 - i)));
+  }
+}
+
+}  // namespace
+
+bool FlacEncoder::Configure(const FlacEncoderConfig& config) {
+  if (config.channels < 1 || config.channels > 8 ||
+      config.bitsPerSample < 4 || config.bitsPerSample > 24 ||
+      config.sampleRate == 0 || config.sampleRate > 655350 ||
+      config.blockSize < 16 || config.blockSize > 65535 ||
+      config.maxLpcOrder > kMaxLpcOrder) {
+    return false;
+  }
+
+  config_ = config;
+  qlpPrecision_ = QlpPrecisionFor(config.blockSize);
+  TukeyWindow(config.blockSize, window_);
+  return true;
+}
+
+void FlacEncoder::EncodeFrame(const int32_t* samples, uint32_t frames, uint64_t frameNumber,
+                              std::vector<uint8_t>& out) const {
+  thread_local Scratch scratch;
+
+  uint32_t channels = config_.channels;
+  uint32_t bps = config_.bitsPerSample;
+  for (uint32_t c = 0; c < channels; c++) {
+    std::vector<int32_t>& channel = scratch.channels[c];
+    channel.resize(frames);
+    for (uint32_t i = 0; i < frames; i++) {
+      channel[i] = samples[i * channels + c];
+    }
+  }
+
+  for (uint32_t c = 0; c < channels; c++) {
+    PlanSubframe(scratch.channels[c].data(), frames, bps, config_, qlpPrecision_, window_,
+                 scratch, scratch.plans[c]);
+  }
+
+  // Stereo decorrelation: code whichever pair is smallest
+  uint32_t assignment = channels - 1;
+  const SubframePlan* order[8];
+  for (uint32_t c = 0; c < channels; c++) {
+    order[c] = &scratch.plans[c];
+  }
+  if (channels == 2) {
+    const std::vector<int32_t>& left = scratch.channels[0];
+    const std::vector<int32_t>& right = scratch.channels[1];
+    scratch.mid.resize(frames);
+    scratch.side.resize(frames);
+    for (uint32_t i = 0; i < frames; i++) {
+      scratch.mid[i] = (left[i] + right[i]) >> 1;
+      scratch.side[i] = left[i] - right[i];
+    }
+    PlanSubframe(scratch.mid.data(), frames, bps, config_, qlpPrecision_, window_, scratch,
+                 scratch.midPlan);
+    PlanSubframe(scratch.side.data(), frames, bps + 1, config_, qlpPrecision_, window_, scratch,
+                 scratch.sidePlan);
+
+    uint64_t leftBits = scratch.plans[0].bits;
+    uint64_t rightBits = scratch.plans[1].bits;
+    uint64_t midBits = scratch.midPlan.bits;
+    uint64_t sideBits = scratch.sidePlan.bits;
+    uint64_t best = leftBits + rightBits;
+    if (leftBits + sideBits < best) {
+      best = leftBits + sideBits;
+      assignment = LEFT_SIDE;
+      order[1] = &scratch.sidePlan;
+    }
+    if (sideBits + rightBits < best) {
+      best = sideBits + rightBits;
+      assignment = RIGHT_SIDE;
+      order[0] = &scratch.sidePlan;
+      order[1] = &scratch.plans[1];
+    }
+    if (midBits + sideBits < best) {
+      assignment = MID_SIDE;
+      order[0] = &scratch.midPlan;
+      order[1] = &scratch.sidePlan;
+    }
+  }
+
+  size_t start = out.size();
+  BitWriter writer(out);
+
+  // Frame header
+  uint32_t blockSizeCode = BlockSizeCode(frames);
+  uint32_t sampleRateCode = SampleRateCode(config_.sampleRate);
+  writer.Write(0x3FFE, 14);  // Sync code
+  writer.Write(0, 1);
+  writer.Write(0, 1);        // Fixed block size; the header carries the frame number
+  writer.Write(blockSizeCode, 4);
+  writer.Write(sampleRateCode, 4);
+  writer.Write(assignment, 4);
+  writer.Write(SampleSizeCode(bps), 3);
+  writer.Write(0, 1);
+  WriteUtf8(writer, frameNumber);
+  if (blockSizeCode == 6) {
+    writer.Write(frames - 1, 8);
+  } else if (blockSizeCode == 7) {
+    writer.Write(frames - 1, 16);
+  }
+  if (sampleRateCode == 12) {
+    writer.Write(config_.sampleRate / 1000, 8);
+  } else if (sampleRateCode == 13) {
+    writer.Write(config_.sampleRate, 16);
+  } else if (sampleRateCode == 14) {
+    writer.Write(config_.sampleRate / 10, 16);
+  }
+  writer.Write(Crc8(out.data() + start, out.size() - start), 8);
+
+  for (uint32_t c = 0; c < channels; c++) {
+    WriteSubframe(writer, *order[c], frames);
+  }
+
+  writer.AlignToByte();
+  uint16_t crc = Crc16(out.data() + start, out.size() - start);
+  writer.Write(crc, 16);
+}
+
+bool RenumberFlacFrame(const uint8_t* frame, size_t size, uint64_t frameNumber,
+                       std::vector<uint8_t>& out) {
+  // Only fixed-blocksize frames, as EncodeFrame() writes them
+  if (size < 7 || frame[0] != 0xFF || (frame[1] & 0xFE) != 0xF8 || (frame[1] & 0x01) != 0) {
+    return false;
+  }
+
+  // Length of the old UTF-8 frame number from its lead byte
+  size_t numberBytes = 1;
+  if (frame[4] & 0x80) {
+    while (numberBytes < 7 && (frame[4] & (0x80 >> numberBytes))) {
+      numberBytes++;
+    }
+    if (numberBytes == 1 || numberBytes == 7) {
+      return false;
+    }
+  }
+
+  uint32_t blockSizeCode = frame[2] >> 4;
+  uint32_t sampleRateCode = frame[2] & 0x0F;
+  size_t extraBytes = (blockSizeCode == 6 ? 1 : blockSizeCode == 7 ? 2 : 0) +
+                      (sampleRateCode == 12 ? 1 : (sampleRateCode == 13 || sampleRateCode == 14) ? 2 : 0);
+  size_t bodyStart = 4 + numberBytes + extraBytes + 1;
+  if (size < bodyStart + 2) {
+    return false;
+  }
+
+  size_t start = out.size();
+  out.insert(out.end(), frame, frame + 4);
+  {
+    BitWriter writer(out);
+    WriteUtf8(writer, frameNumber);
+  }
+  out.insert(out.end(), frame + 4 + numberBytes, frame + 4 + numberBytes + extraBytes);
+  out.push_back(Crc8(out.data() + start, out.size() - start));
+  out.insert(out.end(), frame + bodyStart, frame + size - 2);
+  uint16_t crc = Crc16(out.data() + start, out.size() - start);
+  out.push_back(static_cast<uint8_t>(crc >> 8));
+  out.push_back(static_cast<uint8_t>(crc & 0xFF));
+  return true;
+}
+
+std::vector<uint8_t> BuildFlacHeader(const FlacEncoderConfig& config, const FlacStreamInfo& info,
+                                     size_t paddedSize) {
+  constexpr size_t kStreamInfoEnd = 4 + 4 + 34;
+  bool padded = paddedSize >= kStreamInfoEnd + 4;
+  std::vector<uint8_t> header(padded ? paddedSize : kStreamInfoEnd, 0);
+
+  std::memcpy(header.data(), "fLaC", 4);
+  header[4] = padded ? 0x00 : 0x80;  // Last-block flag, type 0 (STREAMINFO)
+  PutBE(header, 5, 34, 3);
+
+  PutBE(header, 8, config.blockSize, 2);   // Minimum block size
+  PutBE(header, 10, config.blockSize, 2);  // Maximum block size
+  PutBE(header, 12, info.minFrameBytes, 3);
+  PutBE(header, 15, info.maxFrameBytes, 3);
+  // 20-bit rate, 3-bit channels - 1, 5-bit bits - 1, 36-bit total frames
+  uint64_t packed = (uint64_t(config.sampleRate) << 44) |
+                    (uint64_t(config.channels - 1) << 41) |
+                    (uint64_t(config.bitsPerSample - 1) << 36) |
+                    (info.totalFrames & 0xFFFFFFFFFull);
+  PutBE(header, 18, packed, 8);
+  // 16-byte MD5 signature stays zero ("not computed")
+
+  if (padded) {
+    header[kStreamInfoEnd] = 0x81;  // Last-block flag, type 1 (PADDING)
+    PutBE(header, kStreamInfoEnd + 1, paddedSize - kStreamInfoEnd - 4, 3);
+  }
+  return header;
+}
+
+FlacStreamEncoder::FlacStreamEncoder(WorkerPool* pool) : pool_(pool) {}
+
+FlacStreamEncoder::~FlacStreamEncoder() {
+  WaitForJobs();
+}
+
+bool FlacStreamEncoder::Configure(const FlacEncoderConfig& config) {
+  WaitForJobs();
+  if (!encoder_.Configure(config)) {
+    return false;
+  }
+
+  bytesPerSample_ = (config.bitsPerSample + 7) / 8;
+  partialFrame_.clear();
+  pending_.clear();
+  pending_.reserve(static_cast<size_t>(config.blockSize) * config.channels);
+  nextFrameNumber_ = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.clear();
+  }
+  info_ = FlacStreamInfo();
+  return true;
+}
+
+void FlacStreamEncoder::Push(const uint8_t* pcm, size_t size) {
+  const FlacEncoderConfig& config = encoder_.config();
+  uint32_t frameBytes = bytesPerSample_ * config.channels;
+  uint32_t shift = bytesPerSample_ * 8 - config.bitsPerSample;
+  size_t blockSamples = static_cast<size_t>(config.blockSize) * config.channels;
+
+  auto appendFrame = [&](const uint8_t* frame) {
+    for (uint32_t c = 0; c < config.channels; c++) {
+      const uint8_t* bytes = frame + c * bytesPerSample_;
+      int32_t value;
+      if (bytesPerSample_ == 1) {
+        value = static_cast<int32_t>(bytes[0]) - 128;  // 8-bit WAV samples are unsigned
+      } else {
+        uint32_t raw = 0;
+        for (uint32_t b = 0; b < bytesPerSample_; b++) {
+          raw |= static_cast<uint32_t>(bytes[b]) << (8 * b);
+        }
+        // Sign-extend from the container, then drop the left-justified padding
+        uint32_t unused = 32 - 8 * bytesPerSample_;
+        value = static_cast<int32_t>(raw << unused) >> unused;
+      }
+      pending_.push_back(value >> shift);
+    }
+    if (pending_.size() == blockSamples) {
+      SubmitPending();
+    }
+  };
+
+  if (!partialFrame_.empty()) {
+    size_t count = std::min<size_t>(size, frameBytes - partialFrame_.size());
+    partialFrame_.insert(partialFrame_.end(), pcm, pcm + count);
+    pcm += count;
+    size -= count;
+    if (partialFrame_.size() < frameBytes) {
+      return;
+    }
+    appendFrame(partialFrame_.data());
+    partialFrame_.clear();
+  }
+
+  for (; size >= frameBytes; pcm += frameBytes, size -= frameBytes) {
+    appendFrame(pcm);
+  }
+  partialFrame_.assign(pcm, pcm + size);
+}
+
+void FlacStreamEncoder::Collect(const EmitFunction& emit) {
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (jobs_.empty() || !jobs_.front()->done) {
+        return;
+      }
+    }
+    EmitFront(emit);
+  }
+}
+
+void FlacStreamEncoder::Finish(const EmitFunction& emit) {
+  // A trailing partial sample frame cannot be coded and is dropped
+  partialFrame_.clear();
+  if (!pending_.empty()) {
+    SubmitPending();
+  }
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (jobs_.empty()) {
+        return;
+      }
+      std::shared_ptr<Job> front = jobs_.front();
+      jobDone_.wait(lock, [&front] { return front->done; });
+    }
+    EmitFront(emit);
+  }
+}
+
+uint32_t FlacStreamEncoder::DiscardPending() {
+  uint32_t frames = static_cast<uint32_t>(pending_.size() / encoder_.config().channels);
+  pending_.clear();
+  partialFrame_.clear();
+  return frames;
+}
+
+void FlacStreamEncoder::SubmitPending() {
+  auto job = std::make_shared<Job>();
+  job->frames = static_cast<uint32_t>(pending_.size() / encoder_.config().channels);
+  job->frameNumber = nextFrameNumber_++;
+  job->samples.swap(pending_);
+  pending_.reserve(job->samples.size());
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back(job);
+  }
+
+  auto encode = [this, job] {
+    std::vector<uint8_t> output;
+    output.reserve(job->samples.size() * bytesPerSample_ / 2);
+    encoder_.EncodeFrame(job->samples.data(), job->frames, job->frameNumber, output);
+
+    // Notify under the lock: the destructor may be waiting to free us
+    std::lock_guard<std::mutex> lock(mutex_);
+    job->output.swap(output);
+    job->samples = std::vector<int32_t>();
+    job->done = true;
+    jobDone_.notify_all();
+  };
+
+  if (pool_) {
+    pool_->Submit(std::move(encode));
+  } else {
+    encode();
+  }
+}
+
+void FlacStreamEncoder::EmitFront(const EmitFunction& emit) {
+  std::shared_ptr<Job> job;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    job = std::move(jobs_.front());
+    jobs_.pop_front();
+  }
+
+  uint32_t size = static_cast<uint32_t>(job->output.size());
+  info_.minFrameBytes = info_.minFrameBytes == 0 ? size : std::min(info_.minFrameBytes, size);
+  info_.maxFrameBytes = std::max(info_.maxFrameBytes, size);
+  info_.totalFrames += job->frames;
+  if (emit) {
+    emit(job->output, job->frames);
+  }
+}
+
+void FlacStreamEncoder::WaitForJobs() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  jobDone_.wait(lock, [this] {
+    return std::all_of(jobs_.begin(), jobs_.end(), [](const std::shared_ptr<Job>& job) { return job->done; });
+  });
+}
+
+}  // namespace windows_loopback_recorder
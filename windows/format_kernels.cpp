@@ -0,0 +1,379 @@
+#include "windows_loopback_recorder/format_kernels.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define WLR_FORMAT_SSE2 1
+#endif
+
+namespace windows_loopback_recorder {
+
+namespace {
+
+constexpr uint16_t kTagPcm = 0x0001;
+constexpr uint16_t kTagFloat = 0x0003;
+constexpr uint16_t kTagExtensible = 0xFFFE;
+
+// WAVEFORMATEX field offsets, and the extension WAVEFORMATEXTENSIBLE adds
+constexpr size_t kBitsOffset = 14;
+constexpr size_t kExtensionSizeOffset = 16;
+constexpr size_t kValidBitsOffset = 18;
+constexpr size_t kSubFormatOffset = 24;
+constexpr size_t kExtensibleSize = 40;
+
+// KSDATAFORMAT_SUBTYPE_* GUIDs are the format tag followed by these bytes
+constexpr uint8_t kSubFormatSuffix[14] = {0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80,
+                                          0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+
+constexpr float kInt32Scale = 1.0f / 2147483648.0f;
+
+uint16_t ReadU16(const uint8_t* bytes) {
+  return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+}
+
+int32_t ReadInt32(const uint8_t* bytes) {
+  int32_t value;
+  std::memcpy(&value, bytes, 4);
+  return value;
+}
+
+void WidenPcm16(const uint8_t* in, size_t samples, float* out) {
+  size_t i = 0;
+#ifdef WLR_FORMAT_SSE2
+  const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+  for (; i + 8 <= samples; i += 8) {
+    __m128i pcm = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * 2));
+    // Each sample into the high half of a 32-bit lane, then shifted down
+    // with its sign
+    __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(pcm, pcm), 16);
+    __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(pcm, pcm), 16);
+    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+    _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+  }
+#endif
+  for (; i < samples; i++) {
+    int16_t sample;
+    std::memcpy(&sample, in + i * 2, 2);
+    out[i] = sample * (1.0f / 32768.0f);
+  }
+}
+
+// Packed little-endian 24-bit: four samples are three 32-bit words, each
+// sample moved into the top of a 32-bit lane so the sign comes along
+void WidenPcm24(const uint8_t* in, size_t samples, float* out) {
+  size_t i = 0;
+#ifdef WLR_FORMAT_SSE2
+  const __m128 scale = _mm_set1_ps(kInt32Scale);
+  for (; i + 4 <= samples; i += 4) {
+    const uint8_t* bytes = in + i * 3;
+    uint32_t w0;
+    uint32_t w1;
+    uint32_t w2;
+    std::memcpy(&w0, bytes, 4);
+    std::memcpy(&w1, bytes + 4, 4);
+    std::memcpy(&w2, bytes + 8, 4);
+    __m128i words = _mm_set_epi32(static_cast<int32_t>(w2 & 0xFFFFFF00u),
+                                  static_cast<int32_t>((w1 >> 16 << 8) | (w2 << 24)),
+                                  static_cast<int32_t>((w0 >> 24 << 8) | (w1 << 16)),
+                                  static_cast<int32_t>(w0 << 8));
+    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(words), scale));
+  }
+#endif
+  for (; i < samples; i++) {
+    const uint8_t* bytes = in + i * 3;
+    uint32_t word = (static_cast<uint32_t>(bytes[0]) << 8) | (static_cast<uint32_t>(bytes[1]) << 16) |
+                    (static_cast<uint32_t>(bytes[2]) << 24);
+    out[i] = static_cast<int32_t>(word) * kInt32Scale;
+  }
+}
+
+void WidenPcm32(const uint8_t* in, size_t samples, float* out) {
+  size_t i = 0;
+#ifdef WLR_FORMAT_SSE2
+  const __m128 scale = _mm_set1_ps(kInt32Scale);
+  for (; i + 4 <= samples; i += 4) {
+    __m128i pcm = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * 4));
+    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(pcm), scale));
+  }
+#endif
+  for (; i < samples; i++) {
+    out[i] = ReadInt32(in + i * 4) * kInt32Scale;
+  }
+}
+
+// Stands in for the microphone when its samples are not mixed
+struct NoMic {};
+
+inline float ToLevel(int16_t sample) { return sample * (1.0f / 32768.0f); }
+inline float ToLevel(float sample) { return sample; }
+
+// Loopback sample into an output sample
+inline void Store(int16_t sample, int16_t& out) { out = sample; }
+inline void Store(float sample, int16_t& out) { out = static_cast<int16_t>(sample * 32767.0f); }
+inline void Store(int16_t sample, float& out) { out = ToLevel(sample); }
+inline void Store(float sample, float& out) { out = sample; }
+
+// Microphone sample added to an output sample, saturating at full scale
+template <typename MicSample>
+inline void Accumulate(MicSample sample, int16_t& out) {
+  int16_t pcm;
+  Store(sample, pcm);
+  int32_t sum = static_cast<int32_t>(out) + pcm;
+  out = static_cast<int16_t>(std::min(32767, std::max(-32768, sum)));
+}
+
+template <typename MicSample>
+inline void Accumulate(MicSample sample, float& out) {
+  out = std::min(1.0f, std::max(-1.0f, out + ToLevel(sample)));
+}
+
+inline int16_t Average(int16_t a, int16_t b) {
+  return static_cast<int16_t>((static_cast<int32_t>(a) + b) / 2);
+}
+inline float Average(float a, float b) { return (a + b) * 0.5f; }
+
+template <typename Out>
+using MixInto = void (*)(const uint8_t*, size_t, const uint8_t*, size_t, uint16_t, uint16_t, Out*,
+                         SourceLevels*, SourceLevels*);
+
+// A channel count fixed by the instance, or 0 for the one given at run time
+template <uint16_t kChannels>
+inline uint16_t Channels(uint16_t runtime) {
+  return kChannels ? kChannels : runtime;
+}
+
+template <typename Sample>
+void Meter(const Sample* samples, size_t frames, uint16_t stride, uint16_t channels,
+           SourceLevels& meter) {
+  for (size_t frame = 0; frame < frames; frame++) {
+    for (uint16_t channel = 0; channel < channels; channel++) {
+      meter.Add(channel, ToLevel(samples[frame * stride + channel]));
+    }
+  }
+}
+
+template <typename MicSample, uint16_t kSystemChannels, uint16_t kMicChannels>
+struct MicMixer {
+  template <typename Out>
+  static void Add(const uint8_t* mic, size_t micFrames, uint16_t systemChannels,
+                  uint16_t micChannels, Out* out, SourceLevels* micMeter) {
+    const uint16_t systemStride = Channels<kSystemChannels>(systemChannels);
+    const uint16_t micStride = Channels<kMicChannels>(micChannels);
+    const uint16_t mixed = std::min(systemStride, micStride);
+    const MicSample* samples = reinterpret_cast<const MicSample*>(mic);
+    for (size_t frame = 0; frame < micFrames; frame++) {
+      for (uint16_t channel = 0; channel < mixed; channel++) {
+        Accumulate(samples[frame * micStride + channel], out[frame * systemStride + channel]);
+      }
+    }
+    if (micMeter) {
+      Meter(samples, micFrames, micStride, mixed, *micMeter);
+    }
+  }
+};
+
+template <uint16_t kSystemChannels, uint16_t kMicChannels>
+struct MicMixer<NoMic, kSystemChannels, kMicChannels> {
+  template <typename Out>
+  static void Add(const uint8_t*, size_t, uint16_t, uint16_t, Out*, SourceLevels*) {}
+};
+
+template <typename SystemSample, typename MicSample, uint16_t kSystemChannels, uint16_t kMicChannels,
+          typename Out>
+void MixFrames(const uint8_t* system, size_t systemFrames, const uint8_t* mic, size_t micFrames,
+               uint16_t systemChannels, uint16_t micChannels, Out* out,
+               SourceLevels* systemMeter, SourceLevels* micMeter) {
+  const uint16_t stride = Channels<kSystemChannels>(systemChannels);
+  const SystemSample* samples = reinterpret_cast<const SystemSample*>(system);
+
+  // The loopback keeps its layout, so it converts as one run of samples
+  size_t systemSamples = systemFrames * stride;
+  for (size_t i = 0; i < systemSamples; i++) {
+    Store(samples[i], out[i]);
+  }
+  std::fill(out + systemSamples, out + std::max(systemFrames, micFrames) * stride, Out(0));
+  if (systemMeter) {
+    Meter(samples, systemFrames, stride, stride, *systemMeter);
+  }
+  MicMixer<MicSample, kSystemChannels, kMicChannels>::Add(mic, micFrames, systemChannels,
+                                                          micChannels, out, micMeter);
+}
+
+template <typename Out, typename SystemSample, typename MicSample, uint16_t kSystemChannels>
+MixInto<Out> PickMicChannels(uint16_t micChannels) {
+  switch (micChannels) {
+    case 1:
+      return &MixFrames<SystemSample, MicSample, kSystemChannels, 1, Out>;
+    case 2:
+      return &MixFrames<SystemSample, MicSample, kSystemChannels, 2, Out>;
+    default:
+      return &MixFrames<SystemSample, MicSample, kSystemChannels, 0, Out>;
+  }
+}
+
+template <typename Out, typename SystemSample, typename MicSample>
+MixInto<Out> PickSystemChannels(uint16_t systemChannels, uint16_t micChannels) {
+  switch (systemChannels) {
+    case 1:
+      return PickMicChannels<Out, SystemSample, MicSample, 1>(micChannels);
+    case 2:
+      return PickMicChannels<Out, SystemSample, MicSample, 2>(micChannels);
+    default:
+      return PickMicChannels<Out, SystemSample, MicSample, 0>(micChannels);
+  }
+}
+
+template <typename Out, typename SystemSample>
+MixInto<Out> PickNoMic(uint16_t systemChannels) {
+  return systemChannels == 1   ? &MixFrames<SystemSample, NoMic, 1, 0, Out>
+         : systemChannels == 2 ? &MixFrames<SystemSample, NoMic, 2, 0, Out>
+                               : &MixFrames<SystemSample, NoMic, 0, 0, Out>;
+}
+
+template <typename Out, typename SystemSample>
+MixInto<Out> PickMic(uint16_t micBits, uint16_t systemChannels, uint16_t micChannels) {
+  if (micBits == 16 && micChannels > 0) {
+    return PickSystemChannels<Out, SystemSample, int16_t>(systemChannels, micChannels);
+  }
+  if (micBits == 32 && micChannels > 0) {
+    return PickSystemChannels<Out, SystemSample, float>(systemChannels, micChannels);
+  }
+  return PickNoMic<Out, SystemSample>(systemChannels);
+}
+
+template <typename Out>
+MixInto<Out> PickSystem(uint16_t systemBits, uint16_t micBits, uint16_t systemChannels,
+                        uint16_t micChannels) {
+  if (systemBits == 16) {
+    return PickMic<Out, int16_t>(micBits, systemChannels, micChannels);
+  }
+  if (systemBits == 32) {
+    return PickMic<Out, float>(micBits, systemChannels, micChannels);
+  }
+  return nullptr;
+}
+
+template <typename Sample>
+void StereoToMono(const Sample* in, size_t frames, uint16_t, uint16_t, Sample* out) {
+  for (size_t frame = 0; frame < frames; frame++) {
+    out[frame] = Average(in[frame * 2], in[frame * 2 + 1]);
+  }
+}
+
+template <typename Sample>
+void MonoToStereo(const Sample* in, size_t frames, uint16_t, uint16_t, Sample* out) {
+  for (size_t frame = 0; frame < frames; frame++) {
+    out[frame * 2] = in[frame];
+    out[frame * 2 + 1] = in[frame];
+  }
+}
+
+template <typename Sample>
+void CopyChannels(const Sample* in, size_t frames, uint16_t inChannels, uint16_t outChannels,
+                  Sample* out) {
+  uint16_t shared = std::min(inChannels, outChannels);
+  for (size_t frame = 0; frame < frames; frame++) {
+    const Sample* source = in + frame * inChannels;
+    Sample* dest = out + frame * outChannels;
+    std::copy(source, source + shared, dest);
+    std::fill(dest + shared, dest + outChannels, Sample(0));
+  }
+}
+
+template <typename Sample>
+void (*PickChannels(uint16_t inChannels, uint16_t outChannels))(const Sample*, size_t, uint16_t,
+                                                                uint16_t, Sample*) {
+  if (inChannels == 2 && outChannels == 1) {
+    return &StereoToMono<Sample>;
+  }
+  if (inChannels == 1 && outChannels == 2) {
+    return &MonoToStereo<Sample>;
+  }
+  if (inChannels != outChannels) {
+    return &CopyChannels<Sample>;
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+SampleFormat ParseSampleFormat(const uint8_t* waveFormat, size_t size) {
+  if (!waveFormat || size < kExtensionSizeOffset) {
+    return SampleFormat::UNSUPPORTED;
+  }
+  uint16_t tag = ReadU16(waveFormat);
+  uint16_t bits = ReadU16(waveFormat + kBitsOffset);
+  if (tag == kTagExtensible) {
+    if (size < kExtensibleSize || ReadU16(waveFormat + kExtensionSizeOffset) < kExtensibleSize - 18 ||
+        std::memcmp(waveFormat + kSubFormatOffset + 2, kSubFormatSuffix, sizeof(kSubFormatSuffix)) != 0) {
+      return SampleFormat::UNSUPPORTED;
+    }
+    uint16_t validBits = ReadU16(waveFormat + kValidBitsOffset);
+    if (validBits > bits) {
+      return SampleFormat::UNSUPPORTED;
+    }
+    tag = ReadU16(waveFormat + kSubFormatOffset);
+  }
+  if (tag == kTagFloat) {
+    return bits == 32 ? SampleFormat::FLOAT32 : SampleFormat::UNSUPPORTED;
+  }
+  if (tag == kTagPcm) {
+    switch (bits) {
+      case 16:
+        return SampleFormat::PCM16;
+      case 24:
+        return SampleFormat::PCM24;
+      case 32:
+        return SampleFormat::PCM32;
+    }
+  }
+  return SampleFormat::UNSUPPORTED;
+}
+
+WidenKernel SelectWidenKernel(SampleFormat format) {
+  switch (format) {
+    case SampleFormat::PCM16:
+      return &WidenPcm16;
+    case SampleFormat::PCM24:
+      return &WidenPcm24;
+    case SampleFormat::PCM32:
+      return &WidenPcm32;
+    default:
+      return nullptr;
+  }
+}
+
+FormatKernels SelectFormatKernels(SampleFormat system, uint16_t systemChannels, SampleFormat mic,
+                                  uint16_t micChannels, uint16_t outputChannels) {
+  FormatKernels kernels;
+  kernels.systemChannels = systemChannels;
+  kernels.micChannels = micChannels;
+  kernels.outputChannels = outputChannels;
+
+  // 16-bit sources are mixed as they are; the integer ones are widened
+  auto prepare = [](SampleFormat format, WidenKernel& widen) -> uint16_t {
+    if (format == SampleFormat::PCM24 || format == SampleFormat::PCM32) {
+      widen = SelectWidenKernel(format);
+    }
+    return format == SampleFormat::PCM16 ? 16 : format == SampleFormat::UNSUPPORTED ? 0 : 32;
+  };
+  kernels.systemBits = prepare(system, kernels.widenSystem);
+  kernels.micBits = prepare(mic, kernels.widenMic);
+  uint16_t systemBits = kernels.systemBits;
+  uint16_t micBits = kernels.micBits;
+
+  bool micMixed = micBits != 0 && micChannels > 0;
+  kernels.mix = PickSystem<int16_t>(systemBits, micBits, systemChannels, micChannels);
+  kernels.mixFloat = PickSystem<float>(systemBits, micBits, systemChannels, micChannels);
+  if (kernels.mix && micMixed) {
+    kernels.mixedMicChannels = std::min(systemChannels, micChannels);
+  }
+
+  kernels.channels = PickChannels<int16_t>(systemChannels, outputChannels);
+  kernels.channelsFloat = PickChannels<float>(systemChannels, outputChannels);
+  return kernels;
+}
+
+}  // namespace windows_loopback_recorder
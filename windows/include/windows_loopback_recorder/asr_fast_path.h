@@ -0,0 +1,78 @@
+#ifndef FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_ASR_FAST_PATH_H_
+#define FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_ASR_FAST_PATH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "windows_loopback_recorder/audio_meter.h"
+
+namespace windows_loopback_recorder {
+
+// The usual speech recognition setup in one pass: 48 kHz float stereo
+// loopback plus the microphone in, 16 kHz mono 16-bit out.
+//
+// The generic chain mixes to 16-bit, averages the channels, converts back
+// to float, resamples and converts to 16-bit again, with a buffer per step.
+// Here each frame is mixed the way the engine mixes it (microphone
+// channel c onto loopback channel c, clamped to full scale), averaged to
+// mono in float, and every third output of a 121-tap Kaiser-windowed
+// low-pass is computed and quantized as the resampler output is. The
+// passband reaches 7 kHz and everything from 9 kHz, which would fold back
+// below 7 kHz, is 80 dB down; only the 7 to 8 kHz edge may see aliases. The
+// symmetric filter runs as folded SSE2 dot products where available over a
+// fixed history buffer, in blocks that stay in L1; nothing is allocated per
+// packet. Used from a single thread.
+class AsrFastPath {
+ public:
+  static constexpr uint32_t kInputRate = 48000;
+  static constexpr uint32_t kOutputRate = 16000;
+  static constexpr size_t kFactor = kInputRate / kOutputRate;
+  static constexpr size_t kTaps = 121;
+  // Input frames between a sample going in and its filtered output
+  static constexpr size_t kDelayFrames = (kTaps - 1) / 2;
+
+  AsrFastPath();
+
+  // True for the formats the fast path replaces the generic chain for:
+  // 32-bit float stereo loopback at 48 kHz, delivered as 16 kHz mono
+  // 16-bit. The microphone may be 16-bit or float with any channel count.
+  static bool Supports(uint32_t systemRate, uint16_t systemChannels, uint16_t systemBits,
+                       uint32_t outputRate, uint16_t outputChannels, uint16_t outputBits);
+
+  // Forgets the filter history, e.g. after the generic chain ran instead.
+  void Reset();
+
+  // Samples Process() writes at most for |frames| input frames.
+  static size_t MaxOutput(size_t frames) { return frames / kFactor + 1; }
+
+  // Mixes |systemFrames| loopback frames with |micFrames| microphone frames,
+  // either of which may be missing, and writes the 16 kHz output to |out|.
+  // Meters, when given, receive the sources as they are mixed; the caller
+  // begins and finishes them. Returns the samples written.
+  size_t Process(const float* system, size_t systemFrames, const float* mic, uint16_t micChannels,
+                 size_t micFrames, int16_t* out, SourceLevels* systemMeter, SourceLevels* micMeter);
+  size_t Process(const float* system, size_t systemFrames, const int16_t* mic, uint16_t micChannels,
+                 size_t micFrames, int16_t* out, SourceLevels* systemMeter, SourceLevels* micMeter);
+
+ private:
+  static constexpr size_t kBlockFrames = 256;
+  // The filter is symmetric: the taps before the center, a multiple of 4
+  static constexpr size_t kHalfTaps = (kTaps - 1) / 2;
+  static constexpr size_t kHistory = kTaps - 1;
+
+  template <typename MicSample>
+  size_t ProcessFrames(const float* system, size_t systemFrames, const MicSample* mic,
+                       uint16_t micChannels, size_t micFrames, int16_t* out,
+                       SourceLevels* systemMeter, SourceLevels* micMeter);
+
+  std::vector<float> taps_;    // kHalfTaps, then the center tap
+  std::vector<float> buffer_;  // kHistory mono samples, then the current block
+  size_t next_ = 0;            // Start in buffer_ of the next output's window
+  float left_[kBlockFrames];   // The current block's mixed channels
+  float right_[kBlockFrames];
+};
+
+}  // namespace windows_loopback_recorder
+
+#endif  // FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_ASR_FAST_PATH_H_
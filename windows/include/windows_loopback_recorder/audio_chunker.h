@@ -0,0 +1,58 @@
+#ifndef FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_AUDIO_CHUNKER_H_
+#define FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_AUDIO_CHUNKER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace windows_loopback_recorder {
+
+// Output chunking parameters. All zero means every processed capture packet
+// is delivered as-is.
+struct ChunkingConfig {
+  // Emit exact frames of this duration (e.g. 10/20/40 ms). Takes precedence
+  // over the coalescing limits below.
+  uint32_t frameDurationMs = 0;
+  // Coalesce packets until at least this many bytes are pending...
+  uint32_t minChunkBytes = 0;
+  // ...or until this much audio is pending, whichever comes first.
+  uint32_t maxLatencyMs = 0;
+};
+
+// Re-slices processed audio into fixed-duration frames or coalesced chunks.
+// Chunk boundaries always fall on whole sample frames. Used only from the
+// capture thread (and from StopRecording once that thread has exited).
+class AudioChunker {
+ public:
+  using EmitFunction = std::function<void(std::vector<uint8_t>& chunk)>;
+
+  void Configure(const ChunkingConfig& config, uint32_t sampleRate,
+                 uint32_t bytesPerFrame);
+  void Reset();
+
+  bool enabled() const { return exactBytes_ > 0 || minBytes_ > 0 || latencyBytes_ > 0; }
+  bool exactFrames() const { return exactBytes_ > 0; }
+
+  // Appends audio and emits every chunk that became complete.
+  void Push(const uint8_t* data, size_t size, const EmitFunction& emit);
+
+  // Emits whatever is pending. In exact-frame mode the final frame is padded
+  // with silence so consumers only ever see full frames.
+  void Flush(const EmitFunction& emit);
+
+  size_t pendingBytes() const { return pending_.size(); }
+
+ private:
+  void EmitPending(const EmitFunction& emit);
+
+  size_t exactBytes_ = 0;
+  size_t minBytes_ = 0;
+  size_t latencyBytes_ = 0;
+  uint32_t bytesPerFrame_ = 0;
+  std::vector<uint8_t> pending_;
+};
+
+}  // namespace windows_loopback_recorder
+
+#endif  // FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_AUDIO_CHUNKER_H_
@@ -0,0 +1,180 @@
+#ifndef FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_AUDIO_ENGINE_H_
+#define FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_AUDIO_ENGINE_H_
+
+#include <samplerate.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "windows_loopback_recorder/asr_fast_path.h"
+#include "windows_loopback_recorder/audio_meter.h"
+#include "windows_loopback_recorder/echo_canceller.h"
+#include "windows_loopback_recorder/format_kernels.h"
+#include "windows_loopback_recorder/noise_suppressor.h"
+#include "windows_loopback_recorder/sample_quantizer.h"
+
+namespace windows_loopback_recorder {
+
+// The capture formats of one recording and the processing asked for.
+struct EngineConfig {
+  // Loopback device. |systemBlockAlign| is only read when the format is
+  // one the mix cannot read, whose frames are then copied through.
+  SampleFormat systemFormat = SampleFormat::UNSUPPORTED;
+  uint32_t systemRate = 0;
+  uint16_t systemChannels = 0;
+  uint16_t systemBlockAlign = 0;
+  // Microphone; no channels without one
+  SampleFormat micFormat = SampleFormat::UNSUPPORTED;
+  uint32_t micRate = 0;
+  uint16_t micChannels = 0;
+
+  // Output rate, layout and delivered sample format. Encoded output is
+  // always made from 16-bit samples.
+  uint32_t outputRate = 0;
+  uint16_t outputChannels = 0;
+  SampleFormat outputFormat = SampleFormat::PCM16;
+  DitherMode dither = DitherMode::NONE;
+  bool encoded = false;
+
+  bool echoCancellation = false;
+  uint32_t echoTailMs = EchoCanceller::kDefaultTailMs;
+  bool micNoiseSuppression = false;
+  bool systemNoiseSuppression = false;
+  float noiseSuppressionDb = NoiseSuppressor::kDefaultAttenuationDb;
+};
+
+// Where Process() reports levels; any may be null.
+struct EngineMeters {
+  // Begun and fed with every source sample mixed
+  SourceLevels* system = nullptr;
+  SourceLevels* mic = nullptr;
+  // Measures the output while the final conversion back to 16-bit writes
+  // it, into |levels|; |levels| is left empty when no conversion did
+  AudioMeter* output = nullptr;
+  std::vector<ChannelLevels>* levels = nullptr;
+};
+
+// The platform-independent half of a recording: cleans, mixes, converts
+// and quantizes the capture packets of one session into the output format,
+// metering the sources on the way. The platform layer only captures
+// packets and hands them in as plain buffers, so everything here builds and
+// is tested on any platform.
+//
+// Configure() picks the kernels and the stages the formats allow once per
+// recording; Process() then runs on the capture thread alone. The
+// suppressor noise floors are mirrored into atomics for other threads.
+class AudioEngine {
+ public:
+  AudioEngine() = default;
+  ~AudioEngine();
+
+  AudioEngine(const AudioEngine&) = delete;
+  AudioEngine& operator=(const AudioEngine&) = delete;
+
+  // Sets up every stage for |config|. Whatever the formats do not allow is
+  // left off and can be read back below: deeper output and dither need the
+  // float mix and unencoded output, echo cancellation needs both devices
+  // at one rate and sample size. Returns false without a loopback format
+  // or when the resampler cannot be created.
+  bool Configure(const EngineConfig& config);
+
+  // Releases the resampler and the stages; Process() does nothing until
+  // the next Configure().
+  void Clear();
+
+  // 24-bit and 32-bit integer packets become float once, as they arrive;
+  // the pointers are moved to the engine's copies, which stay valid until
+  // the next call. Packets of other formats are left alone.
+  void Widen(uint8_t*& system, size_t systemFrames, uint8_t*& mic, size_t micFrames);
+
+  // Cleans and mixes one loopback and one microphone packet, either of which
+  // may be missing. With |convert| the result has the output rate, layout
+  // and sample format; without it, for analysis, only the layout changes
+  // and the rate stays the device's. |output| receives the 16-bit samples
+  // every stage but delivery reads; |delivery| the delivered samples when
+  // they are deeper than those, and is left empty otherwise.
+  void Process(const uint8_t* system, size_t systemFrames, const uint8_t* mic, size_t micFrames,
+               bool convert, const EngineMeters& meters, std::vector<uint8_t>& output,
+               std::vector<uint8_t>& delivery);
+
+  // The microphone samples the last Process() mixed: |mic| itself unless
+  // echo cancellation or noise suppression replaced them.
+  const uint8_t* CleanedMic(const uint8_t* mic) const;
+
+  const EngineConfig& config() const { return config_; }
+  const FormatKernels& kernels() const { return kernels_; }
+  // Delivered samples after Configure() settled them
+  SampleFormat outputFormat() const { return quantize_ ? quantizer_.format() : SampleFormat::PCM16; }
+  DitherMode dither() const { return quantize_ ? quantizer_.dither() : DitherMode::NONE; }
+  uint16_t bytesPerSample() const { return quantize_ ? quantizer_.bytesPerSample() : 2; }
+  // Whether rate or layout change between device and output
+  bool converting() const { return converting_; }
+  bool fastPath() const { return asrFastPath_ != nullptr; }
+  bool quantizing() const { return quantize_; }
+  const EchoCanceller* echoCanceller() const { return echoCanceller_.get(); }
+  const NoiseSuppressor* micSuppressor() const { return micSuppressor_.get(); }
+  const NoiseSuppressor* systemSuppressor() const { return systemSuppressor_.get(); }
+  float micNoiseDb() const { return micNoiseDb_.load(); }
+  float systemNoiseDb() const { return systemNoiseDb_.load(); }
+
+ private:
+  // Runs echo cancellation and noise suppression; the pointers are moved
+  // to the cleaned packets
+  void CleanSources(const uint8_t*& system, const uint8_t*& mic, size_t systemFrames, size_t micFrames);
+  // Mixes in the loopback's rate and layout
+  void Mix(const uint8_t* system, const uint8_t* mic, size_t systemFrames, size_t micFrames,
+           const EngineMeters& meters, std::vector<uint8_t>& output);
+  // Mix() and ConvertFormat() in one pass through asrFastPath_
+  void MixFastPath(const uint8_t* system, const uint8_t* mic, size_t systemFrames, size_t micFrames,
+                   const EngineMeters& meters, std::vector<uint8_t>& output);
+  // Mix() and ConvertFormat() in float, rounded once by quantizer_
+  void MixQuantized(const uint8_t* system, const uint8_t* mic, size_t systemFrames, size_t micFrames,
+                    const EngineMeters& meters, std::vector<uint8_t>& output,
+                    std::vector<uint8_t>& delivery);
+  // Channel layout, then rate, of 16-bit mixed samples
+  void ConvertFormat(std::vector<uint8_t>& samples, const EngineMeters& meters);
+  void ConvertChannels(std::vector<uint8_t>& samples);
+  // Resamples |frames| output-layout float frames into resampled_; false
+  // when libsamplerate fails, and the caller then keeps the input
+  bool Resample(const float* in, size_t frames, size_t& written);
+  // The 16-bit conversion the resampler output always had, metered on the
+  // way when |meters| asks for it
+  void ConvertFromFloat(const float* in, size_t samples, const EngineMeters& meters,
+                        std::vector<uint8_t>& output);
+
+  EngineConfig config_;
+  bool configured_ = false;
+  bool converting_ = false;
+  FormatKernels kernels_;
+
+  // libsamplerate state; null when the rates match
+  SRC_STATE* srcState_ = nullptr;
+
+  std::unique_ptr<EchoCanceller> echoCanceller_;
+  std::unique_ptr<NoiseSuppressor> micSuppressor_;
+  std::unique_ptr<NoiseSuppressor> systemSuppressor_;
+  std::atomic<float> micNoiseDb_{-120.0f};
+  std::atomic<float> systemNoiseDb_{-120.0f};
+
+  std::unique_ptr<AsrFastPath> asrFastPath_;
+
+  SampleQuantizer quantizer_;
+  bool quantize_ = false;
+
+  // Reused from packet to packet
+  std::vector<float> widenedSystem_;
+  std::vector<float> widenedMic_;
+  std::vector<uint8_t> cleanMic_;
+  std::vector<uint8_t> cleanSystem_;
+  std::vector<uint8_t> converted_;
+  std::vector<float> floatMix_;
+  std::vector<float> floatChannels_;
+  std::vector<float> resampled_;
+};
+
+}  // namespace windows_loopback_recorder
+
+#endif  // FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_AUDIO_ENGINE_H_
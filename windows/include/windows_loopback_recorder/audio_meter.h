@@ -0,0 +1,100 @@
+#ifndef FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_AUDIO_METER_H_
+#define FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_AUDIO_METER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace windows_loopback_recorder {
+
+// Levels of one channel over one buffer, linear with 1.0 = full scale.
+struct ChannelLevels {
+  float rms = 0.0f;
+  float peak = 0.0f;      // Largest absolute sample
+  float truePeak = 0.0f;  // Largest absolute value of the 4x oversampled signal
+};
+
+// Measures per-channel RMS, sample peak and true peak (ITU-R BS.1770-4
+// Annex 2: 4x polyphase interpolation with the 48-tap reference filter) in a
+// single pass. Input is processed in blocks small enough to stay in L1: each
+// block is read once, deinterleaved to float and then run through the
+// vectorized kernels (SSE2 where available, scalar otherwise).
+//
+// The interpolation filter history carries over from one call to the next,
+// so a peak between two capture packets is not missed. Used from a single
+// thread.
+class AudioMeter {
+ public:
+  static constexpr uint16_t kMaxChannels = 8;
+
+  AudioMeter();
+
+  bool Configure(uint16_t channels);
+  uint16_t channels() const { return channels_; }
+
+  // Forgets the filter history, e.g. after a gap in the audio.
+  void Reset();
+
+  // Measures |frames| interleaved 16-bit sample frames. |levels| receives one
+  // entry per channel.
+  void Measure(const int16_t* samples, size_t frames, std::vector<ChannelLevels>& levels);
+
+  // Converts interleaved float samples to 16-bit the way the resampler output
+  // always has been (clamped to [-1, 1], scaled by 32767, truncated) and
+  // measures them on the way. Levels are taken before clamping, so a sample
+  // peak above 1.0 means the conversion clipped. |out| may not alias |in|.
+  void ConvertAndMeasure(const float* in, size_t frames, int16_t* out,
+                         std::vector<ChannelLevels>& levels);
+
+  // Power-weighted average of the channels' RMS and the largest peaks.
+  static ChannelLevels Combine(const std::vector<ChannelLevels>& levels);
+
+ private:
+  static constexpr size_t kBlockFrames = 256;
+  static constexpr size_t kHistory = 11;  // Taps per phase - 1
+
+  void Begin();
+  void MeasureBlock(size_t frames);
+  void Finish(size_t frames, std::vector<ChannelLevels>& levels);
+
+  uint16_t channels_ = 0;
+
+  // Per channel: kHistory samples of filter history, then the current block
+  std::vector<float> planar_;
+  std::vector<double> sumSquares_;
+  std::vector<float> peak_;
+  std::vector<float> truePeak_;
+};
+
+// Running sums for metering a signal from inside another loop over its
+// samples, such as the mix, instead of a pass of its own. Only RMS and
+// sample peak: there is no room for the oversampling filter in such a loop,
+// so Finish() reports the sample peak as the true peak too.
+class SourceLevels {
+ public:
+  void Begin(uint16_t channels) {
+    squares_.assign(channels, 0.0f);
+    peak_.assign(channels, 0.0f);
+  }
+
+  // |sample| is linear, 1.0 = full scale.
+  void Add(uint16_t channel, float sample) {
+    squares_[channel] += sample * sample;
+    float magnitude = sample < 0.0f ? -sample : sample;
+    if (magnitude > peak_[channel]) {
+      peak_[channel] = magnitude;
+    }
+  }
+
+  uint16_t channels() const { return static_cast<uint16_t>(squares_.size()); }
+
+  void Finish(size_t frames, std::vector<ChannelLevels>& levels) const;
+
+ private:
+  std::vector<float> squares_;
+  std::vector<float> peak_;
+};
+
+}  // namespace windows_loopback_recorder
+
+#endif  // FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_AUDIO_METER_H_
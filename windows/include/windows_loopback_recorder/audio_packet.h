@@ -0,0 +1,109 @@
+#ifndef FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_AUDIO_PACKET_H_
+#define FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_AUDIO_PACKET_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace windows_loopback_recorder {
+
+// Sample encoding of the payload that follows a packet header.
+enum AudioFormatId : uint16_t {
+  AUDIO_FORMAT_UNKNOWN = 0,
+  AUDIO_FORMAT_PCM_S16 = 1,
+  AUDIO_FORMAT_FLAC = 2,     // One FLAC frame per packet; the first also carries the stream header
+  AUDIO_FORMAT_MULAW = 3,    // G.711 µ-law bytes
+  AUDIO_FORMAT_ALAW = 4,     // G.711 A-law bytes
+  AUDIO_FORMAT_IMA_ADPCM = 5,  // One IMA ADPCM block per packet (WAVE_FORMAT_IMA_ADPCM layout)
+  AUDIO_FORMAT_PCM_S24 = 6,  // Packed little-endian, three bytes per sample
+  AUDIO_FORMAT_PCM_S32 = 7,
+  AUDIO_FORMAT_F32 = 8,      // IEEE float in [-1, 1]
+};
+
+enum AudioPacketFlags : uint16_t {
+  AUDIO_PACKET_SILENT = 0x0001,           // Every source reported silence
+  AUDIO_PACKET_DISCONTINUITY = 0x0002,    // A source glitched before this packet
+  AUDIO_PACKET_TIMESTAMP_ERROR = 0x0004,  // The capture time is unreliable
+  AUDIO_PACKET_PADDED = 0x0008,           // Final packet, padded with silence
+  AUDIO_PACKET_SPEECH = 0x0010,           // The voice activity detector heard speech
+  AUDIO_PACKET_DROPPED = 0x0020,          // Silence standing in for audio the consumer fell behind on
+};
+
+constexpr uint32_t kAudioPacketMagic = 0x50524C57;  // "WLRP" in little endian
+constexpr uint8_t kAudioPacketVersion = 2;
+
+// Fixed 48-byte little-endian header prepended to each audio chunk when
+// AudioConfig::packetHeader is set. Every field is naturally aligned so both
+// native readers (memcpy into this struct) and Dart (ByteData) parse it with
+// plain loads. Layout is part of the public API; only append new fields.
+struct AudioPacketHeader {
+  uint32_t magic;             //  0: kAudioPacketMagic
+  uint8_t headerSize;         //  4: sizeof(AudioPacketHeader)
+  uint8_t version;            //  5: kAudioPacketVersion
+  uint16_t flags;             //  6: AudioPacketFlags
+  uint32_t sequence;          //  8: increments by one per packet
+  uint32_t frameCount;        // 12: sample frames in the payload
+  uint64_t firstSampleIndex;  // 16: frames emitted before this packet
+  int64_t captureTime;        // 24: QPC time of the first frame, 100 ns units
+  uint32_t sampleRate;        // 32
+  uint16_t channels;          // 36
+  uint16_t formatId;          // 38: AudioFormatId
+  float speechProbability;    // 40: highest VAD probability, -1 when VAD is off (version 2)
+  uint32_t reserved;          // 44: zero; keeps the size a multiple of 8
+};
+static_assert(sizeof(AudioPacketHeader) == 48, "AudioPacketHeader layout changed");
+
+// Assigns sequence numbers, sample indices and capture times to outgoing
+// chunks. Capture packets are reported as they enter the chunker; headers are
+// stamped as chunks leave it, so timing survives re-slicing.
+class AudioPacketizer {
+ public:
+  void Configure(bool enabled, uint32_t sampleRate, uint16_t channels,
+                 uint16_t formatId, uint32_t bytesPerFrame);
+
+  bool enabled() const { return enabled_; }
+
+  // Reports |bytes| of processed audio whose first frame was captured at
+  // |captureTime| (100 ns units), with the WASAPI-derived |flags| and the
+  // voice activity detector's |speechProbability| (-1 when it is off).
+  void OnCapturedAudio(size_t bytes, int64_t captureTime, uint16_t flags,
+                       float speechProbability = -1.0f);
+
+  // Forgets |bytes| of reported audio that will never be stamped (e.g.
+  // discarded from the chunker) and flags the next packet as discontinuous.
+  void Discard(size_t bytes);
+
+  // Prepends a header to |chunk|.
+  void Stamp(std::vector<uint8_t>& chunk, uint16_t extraFlags = 0);
+  // Same for encoded chunks, whose size says nothing about |frames|.
+  void Stamp(std::vector<uint8_t>& chunk, uint32_t frames, uint16_t extraFlags);
+
+ private:
+  bool enabled_ = false;
+  uint32_t sampleRate_ = 0;
+  uint16_t channels_ = 0;
+  uint16_t formatId_ = AUDIO_FORMAT_UNKNOWN;
+  uint32_t bytesPerFrame_ = 1;
+
+  uint32_t sequence_ = 0;
+  uint64_t capturedFrames_ = 0;
+  uint64_t emittedFrames_ = 0;
+
+  // Most recent (frame index, capture time) pair; later chunk times are
+  // extrapolated from it at the nominal sample rate.
+  uint64_t anchorFrame_ = 0;
+  int64_t anchorTime_ = 0;
+
+  uint16_t pendingFlags_ = 0;
+  bool silentRun_ = true;
+  bool lastPacketSilent_ = false;
+  // Speech is the opposite of silence: any speech packet marks the chunk.
+  bool speechRun_ = false;
+  bool lastPacketSpeech_ = false;
+  float speechProbability_ = -1.0f;
+  float lastSpeechProbability_ = -1.0f;
+};
+
+}  // namespace windows_loopback_recorder
+
+#endif  // FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_AUDIO_PACKET_H_
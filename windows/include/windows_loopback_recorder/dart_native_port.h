@@ -0,0 +1,80 @@
+#ifndef FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_DART_NATIVE_PORT_H_
+#define FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_DART_NATIVE_PORT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace windows_loopback_recorder {
+
+// Minimal mirror of the Dart_CObject ABI from dart_native_api.h.
+// Only the members needed to post external typed data are declared; the
+// layout must stay identical to the Dart SDK definition.
+typedef int64_t Dart_Port;
+typedef void (*Dart_HandleFinalizer)(void* isolate_callback_data, void* peer);
+
+enum Dart_TypedData_Type {
+  Dart_TypedData_kByteData = 0,
+  Dart_TypedData_kInt8,
+  Dart_TypedData_kUint8,
+};
+
+enum Dart_CObject_Type {
+  Dart_CObject_kNull = 0,
+  Dart_CObject_kBool,
+  Dart_CObject_kInt32,
+  Dart_CObject_kInt64,
+  Dart_CObject_kDouble,
+  Dart_CObject_kString,
+  Dart_CObject_kArray,
+  Dart_CObject_kTypedData,
+  Dart_CObject_kExternalTypedData,
+};
+
+struct Dart_CObject {
+  Dart_CObject_Type type;
+  union {
+    bool as_bool;
+    int32_t as_int32;
+    int64_t as_int64;
+    double as_double;
+    struct {
+      Dart_TypedData_Type type;
+      intptr_t length;
+      uint8_t* data;
+      void* peer;
+      Dart_HandleFinalizer callback;
+    } as_external_typed_data;
+    // Keeps the union as large as the SDK one (largest member has 5 words).
+    intptr_t padding[5];
+  } value;
+};
+
+// Signature of NativeApi.postCObject on the Dart side.
+typedef bool (*Dart_PostCObject_Type)(Dart_Port port_id, Dart_CObject* message);
+
+// A caller-supplied Dart SendPort that receives audio as Uint8List messages
+// without going through the platform thread. Posting is thread safe, so the
+// capture thread delivers directly.
+class DartNativePort {
+ public:
+  DartNativePort(Dart_Port port, Dart_PostCObject_Type postCObject);
+
+  // Hands the buffer to Dart as external typed data. On success ownership of
+  // the storage moves to the receiving isolate and it is freed by the Dart
+  // finalizer; |buffer| is left empty. On failure |buffer| is untouched.
+  bool PostBuffer(std::vector<uint8_t>& buffer);
+
+  // Posts a plain integer message (used for silence markers).
+  bool PostInt64(int64_t value);
+
+  Dart_Port port() const { return port_; }
+
+ private:
+  Dart_Port port_;
+  Dart_PostCObject_Type postCObject_;
+};
+
+}  // namespace windows_loopback_recorder
+
+#endif  // FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_DART_NATIVE_PORT_H_
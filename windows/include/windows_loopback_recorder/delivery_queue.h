@@ -0,0 +1,104 @@
+#ifndef FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_DELIVERY_QUEUE_H_
+#define FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_DELIVERY_QUEUE_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace windows_loopback_recorder {
+
+// What to do when the consumer falls behind and the queue is full.
+enum class BackpressurePolicy {
+  NONE = 0,         // Unbounded: deliver immediately, never wait for acks
+  BLOCK = 1,        // Stall the capture thread until the consumer catches up
+  DROP_OLDEST = 2,  // Discard the oldest queued chunk to make room
+  DROP_NEWEST = 3   // Discard incoming chunks, then send a silence marker
+};
+
+// One unit handed to the sink: either audio, or a marker standing in for
+// |silenceBytes| of audio that was dropped. Streams with packet headers get
+// a stamped silent packet in |data| instead of a marker.
+struct DeliveryItem {
+  std::vector<uint8_t> data;
+  uint64_t silenceBytes = 0;
+};
+
+struct DeliveryStats {
+  uint64_t deliveredChunks = 0;
+  uint64_t droppedChunks = 0;
+  uint64_t droppedFrames = 0;
+  uint64_t queuedChunks = 0;
+  uint64_t inFlightChunks = 0;
+  uint64_t highWatermarkChunks = 0;
+  uint64_t highWatermarkBytes = 0;
+};
+
+// Bounded, credit-based queue between the capture thread and the Dart side.
+// At most |maxChunks| items are in flight (sent but not yet acknowledged by
+// the consumer) and at most |maxChunks| more wait here; the policy decides
+// what happens beyond that.
+class DeliveryQueue {
+ public:
+  // Returns true if the item reached a consumer that will acknowledge it.
+  using SendFunction = std::function<bool(DeliveryItem& item)>;
+
+  void SetSender(SendFunction sender);
+  // |headerBytes| is the AudioPacketHeader prefixed to every chunk, or zero
+  // without one; it is excluded from frame counts. A zero |bytesPerFrame|
+  // marks compressed chunks: drops are counted but never replaced by
+  // silence, which would corrupt the stream. Silence is |silenceByte|
+  // repeated.
+  void Configure(BackpressurePolicy policy, size_t maxChunks, uint32_t bytesPerFrame,
+                 uint32_t headerBytes = 0, uint8_t silenceByte = 0);
+
+  // Producer side. May block under BackpressurePolicy::BLOCK until the
+  // consumer acknowledges or Close() is called.
+  void Push(std::vector<uint8_t>&& chunk);
+
+  // Consumer side: |count| more items were consumed.
+  void Acknowledge(uint64_t count);
+
+  // Wakes a blocked producer; later pushes never block.
+  void Close();
+
+  DeliveryStats GetStats();
+
+ private:
+  void DrainLocked();
+  // Records a dropped chunk; returns the silence that stands in for it, in
+  // bytes.
+  size_t RecordDropLocked(size_t bytes);
+  // Headered chunks are renumbered as they are accepted, so the silent
+  // packet standing in for chunks dropped under DROP_NEWEST takes their
+  // place in the sequence. Chunks lost any other way still leave a gap.
+  void NumberLocked(std::vector<uint8_t>& chunk);
+  // The packet for pendingSilenceBytes_, stamped from the first dropped
+  // chunk's header
+  std::vector<uint8_t> SilentPacketLocked();
+
+  std::mutex mutex_;
+  std::condition_variable spaceAvailable_;
+  SendFunction sender_;
+  BackpressurePolicy policy_ = BackpressurePolicy::NONE;
+  size_t maxChunks_ = 0;
+  uint32_t bytesPerFrame_ = 1;  // Zero for compressed chunks
+  uint32_t headerBytes_ = 0;
+  uint8_t silenceByte_ = 0;
+  bool closed_ = false;
+
+  std::deque<DeliveryItem> queue_;
+  size_t queuedBytes_ = 0;
+  uint64_t inFlight_ = 0;
+  uint64_t pendingSilenceBytes_ = 0;
+  std::vector<uint8_t> droppedHeader_;
+  uint32_t sequence_ = 0;
+  DeliveryStats stats_;
+};
+
+}  // namespace windows_loopback_recorder
+
+#endif  // FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_DELIVERY_QUEUE_H_
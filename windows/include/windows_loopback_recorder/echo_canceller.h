@@ -0,0 +1,121 @@
+#ifndef FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_ECHO_CANCELLER_H_
+#define FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_ECHO_CANCELLER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "windows_loopback_recorder/spectrum_analyzer.h"
+
+namespace windows_loopback_recorder {
+
+// Removes the loopback (far-end) signal that the microphone picks up from
+// the speakers.
+//
+// A partitioned-block frequency-domain adaptive filter (overlap-save, block
+// length N, FFT length 2N) models the echo path from the mono downmix of the
+// loopback to the mono downmix of the microphone over |tailMs|; its estimate
+// is subtracted from every microphone channel. Each of the P = tailMs / N
+// partitions adapts by normalized LMS with per-bin power normalization. The
+// gradient constraint, which costs two FFTs, is applied to one partition per
+// block in turn, so a block always costs 6 FFTs of 2N plus 3P complex
+// multiply-adds per bin, whatever the tail length.
+//
+// Near-end speech makes an adaptive filter drift, so two filters run: a
+// background filter that always adapts and a foreground filter that
+// produces the output and takes over the background coefficients only while
+// they cancel better. Adaptation also pauses while the microphone peak
+// exceeds half the loopback peak within the tail (Geigel double-talk
+// detection) or there is no loopback audio, and a block whose output would
+// be louder than its input is passed through untouched. The microphone
+// comes out one block (about 5 ms) late. Used from a single thread.
+class EchoCanceller {
+ public:
+  static constexpr uint32_t kDefaultTailMs = 250;
+  static constexpr uint32_t kMaxTailMs = 1000;
+
+  // Also resets. False for rates below 8 kHz, no channels or a tail longer
+  // than kMaxTailMs.
+  bool Configure(uint32_t sampleRate, uint16_t referenceChannels, uint16_t micChannels,
+                 uint32_t tailMs = kDefaultTailMs);
+  bool configured() const { return fft_ != nullptr; }
+
+  // Forgets the learned echo path and all buffered audio.
+  void Reset();
+
+  // Feeds interleaved loopback frames, as played.
+  void PushReference(const int16_t* samples, size_t frames);
+  void PushReference(const float* samples, size_t frames);
+
+  // Cancels the echo from interleaved microphone frames; |out| may be |in|.
+  // Each microphone frame consumes one buffered loopback frame (silence if
+  // none is buffered).
+  void Process(const int16_t* in, int16_t* out, size_t frames);
+  void Process(const float* in, float* out, size_t frames);
+
+  size_t blockSize() const { return blockSize_; }
+  size_t partitions() const { return partitions_; }
+
+  // Echo return loss enhancement over the recent blocks: how much quieter
+  // the output is than the microphone, in dB. 0 until the filter converges
+  // or while the near end talks.
+  float erleDb() const { return erleDb_; }
+
+ private:
+  void PushReferenceSample(float sample);
+  float PopReferenceSample();
+  template <typename Sample>
+  void ProcessFrames(const Sample* in, Sample* out, size_t frames);
+  void ProcessBlock();
+  void Constrain(size_t partition);
+
+  uint32_t sampleRate_ = 0;
+  uint16_t referenceChannels_ = 0;
+  uint16_t micChannels_ = 0;
+  size_t blockSize_ = 0;   // N
+  size_t partitions_ = 0;  // P
+  size_t bins_ = 0;        // N + 1
+
+  std::unique_ptr<RealFft> fft_;  // Length 2N
+
+  // Loopback frames waiting for their microphone frames
+  std::vector<float> referenceRing_;
+  size_t referenceRead_ = 0;
+  size_t referenceCount_ = 0;
+
+  // Current block as it fills, and the cancelled previous block going out
+  size_t filled_ = 0;
+  std::vector<float> micIn_;      // Interleaved
+  std::vector<float> micMono_;
+  std::vector<float> reference_;  // Last 2N loopback samples
+  std::vector<float> micOut_;     // Interleaved
+
+  // Loopback spectra of the last P blocks (newest at xHead_) and the filter
+  std::vector<float> xRe_;
+  std::vector<float> xIm_;
+  size_t xHead_ = 0;
+  std::vector<float> wRe_;         // Background filter, adapting
+  std::vector<float> wIm_;
+  std::vector<float> foregroundRe_; // Foreground filter, cancelling
+  std::vector<float> foregroundIm_;
+  std::vector<float> power_;      // Loopback power per bin, summed over the partitions each block
+  std::vector<float> blockPeaks_; // Loopback peak of the last P blocks
+  size_t constrainNext_ = 0;
+
+  // FFT work buffers
+  std::vector<float> time_;
+  std::vector<float> re_;
+  std::vector<float> im_;
+  std::vector<float> echo_;
+
+  float micEnergy_ = 0.0f;  // Smoothed block energies
+  float outEnergy_ = 0.0f;
+  float backgroundEnergy_ = 0.0f;
+  uint32_t betterBlocks_ = 0;       // Blocks the background has been ahead
+  float erleDb_ = 0.0f;
+};
+
+}  // namespace windows_loopback_recorder
+
+#endif  // FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_ECHO_CANCELLER_H_
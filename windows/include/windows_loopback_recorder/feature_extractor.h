@@ -0,0 +1,124 @@
+#ifndef FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_FEATURE_EXTRACTOR_H_
+#define FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_FEATURE_EXTRACTOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "windows_loopback_recorder/spectrum_analyzer.h"
+
+namespace windows_loopback_recorder {
+
+// Settings of a FeatureExtractor. The integer and double fields are read
+// straight from method channel arguments.
+struct FeatureOptions {
+  uint32_t melBins = 80;
+  uint32_t mfcc = 0;         // Cepstral coefficients per row; 0 for log-mel rows
+  double minHz = 20.0;       // Lower edge of the first mel filter
+  double maxHz = 8000.0;     // Upper edge of the last one, limited to Nyquist
+  double preEmphasis = 0.97; // y[n] = x[n] - a x[n - 1]; 0 turns it off
+};
+
+// Log-mel filterbank and MFCC rows for speech models, one per 10 ms.
+//
+// Channels are downmixed to mono and pre-emphasized as they arrive. Every
+// hop, the last 25 ms are Hann-windowed, zero-padded to a power of two and
+// transformed; the power spectrum goes through |melBins| triangular filters
+// spaced evenly on the HTK mel scale, and each row holds the natural log of
+// the filter energies of samples in [-1, 1], floored at kLogFloor. With
+// |mfcc| set, rows hold the first coefficients of the orthonormal DCT-II of
+// the log energies instead.
+//
+// The filters are stored as runs of non-zero weights, so the filterbank and
+// the DCT are short dot products, run four lanes at a time with SSE2 where
+// available. Every buffer is sized by Configure(); Push() does not allocate
+// beyond growing the caller's output. Used from a single thread.
+class FeatureExtractor {
+ public:
+  static constexpr uint32_t kWindowMs = 25;
+  static constexpr uint32_t kHopMs = 10;
+  static constexpr uint32_t kMaxMelBins = 256;
+  static constexpr float kLogFloor = -23.0259f;  // ln(1e-10)
+
+  // Also resets. False when the options are out of range for |sampleRate|.
+  bool Configure(uint32_t sampleRate, uint16_t channels, const FeatureOptions& options);
+  bool configured() const { return fft_ != nullptr; }
+
+  // Forgets the audio seen so far; the next row is row 0 again.
+  void Reset();
+
+  // Feeds interleaved 16-bit sample frames. Each finished hop appends one
+  // row of valuesPerRow() values to |rows|. Returns the rows appended.
+  size_t Push(const int16_t* samples, size_t frames, std::vector<float>& rows);
+
+  uint32_t sampleRate() const { return sampleRate_; }
+  size_t windowFrames() const { return windowFrames_; }
+  size_t hopFrames() const { return hopFrames_; }
+  size_t fftSize() const { return fft_ ? fft_->size() : 0; }
+  size_t melBins() const { return filterFirst_.size(); }
+  size_t valuesPerRow() const { return dct_.empty() ? melBins() : dct_.size() / melBins(); }
+  float minHz() const { return minHz_; }
+  float maxHz() const { return maxHz_; }
+  uint64_t rows() const { return rows_; }  // Since Configure() or Reset()
+
+ private:
+  void ComputeRow(float* row);
+
+  uint32_t sampleRate_ = 0;
+  uint16_t channels_ = 0;
+  size_t windowFrames_ = 0;
+  size_t hopFrames_ = 0;
+  float preEmphasis_ = 0.0f;
+  float minHz_ = 0.0f;
+  float maxHz_ = 0.0f;
+  std::unique_ptr<RealFft> fft_;
+  std::vector<float> window_;  // Hann over windowFrames_, zero beyond
+
+  // Filter f weighs bins [filterFirst_[f], + filterLength_[f]) with the
+  // weights at filterOffset_[f]
+  std::vector<uint32_t> filterFirst_;
+  std::vector<uint32_t> filterLength_;
+  std::vector<uint32_t> filterOffset_;
+  std::vector<float> weights_;
+  std::vector<float> dct_;  // mfcc x melBins, row-major; empty for log-mel
+
+  std::vector<float> input_;  // Pre-emphasized mono, oldest first
+  size_t filled_ = 0;
+  float lastSample_ = 0.0f;   // Input before the pre-emphasis, for the next one
+  uint64_t rows_ = 0;
+
+  std::vector<float> windowed_;
+  std::vector<float> re_;
+  std::vector<float> im_;
+  std::vector<float> logMel_;
+};
+
+// Float32 layout of a feature update on the feature stream: a header of
+// FEATURE_FRAME_FIELDS values, then FEATURE_FRAME_ROWS rows of
+// FEATURE_FRAME_VALUES_PER_ROW values, oldest first. New header fields are
+// appended; readers locate the rows through FEATURE_FRAME_HEADER_SIZE.
+enum FeatureFrameField : size_t {
+  FEATURE_FRAME_HEADER_SIZE = 0,
+  FEATURE_FRAME_VERSION = 1,
+  FEATURE_FRAME_SAMPLE_RATE = 2,
+  FEATURE_FRAME_HOP_MS = 3,      // Exact hop: hop frames / sample rate
+  FEATURE_FRAME_WINDOW_MS = 4,
+  FEATURE_FRAME_FIRST_ROW = 5,   // Rows before this update since the stream started
+  FEATURE_FRAME_ROWS = 6,
+  FEATURE_FRAME_VALUES_PER_ROW = 7,
+  FEATURE_FRAME_MEL_BINS = 8,    // Equal to the values per row for log-mel rows
+  FEATURE_FRAME_MIN_HZ = 9,
+  FEATURE_FRAME_MAX_HZ = 10,
+  FEATURE_FRAME_FIELDS = 11,
+};
+
+constexpr float kFeatureFrameVersion = 1.0f;
+
+// |rows| holds whole rows of |extractor|.
+std::vector<float> BuildFeatureFrame(uint64_t firstRow, const FeatureExtractor& extractor,
+                                     const std::vector<float>& rows);
+
+}  // namespace windows_loopback_recorder
+
+#endif  // FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_FEATURE_EXTRACTOR_H_
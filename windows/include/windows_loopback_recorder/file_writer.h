@@ -0,0 +1,77 @@
+#ifndef FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_FILE_WRITER_H_
+#define FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_FILE_WRITER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace windows_loopback_recorder {
+
+// Minimal positional file writer. Uses Win32 handles on Windows and POSIX
+// file descriptors elsewhere so the sinks built on it stay portable.
+class FileWriter {
+ public:
+  FileWriter() = default;
+  ~FileWriter();
+
+  FileWriter(const FileWriter&) = delete;
+  FileWriter& operator=(const FileWriter&) = delete;
+
+  // Creates (or truncates) the file at |path|, which is UTF-8 encoded.
+  bool Open(const std::string& path);
+  void Close();
+  bool isOpen() const;
+
+  // Writes all of |data| at |offset|, independent of any previous write.
+  bool WriteAt(uint64_t offset, const void* data, size_t size);
+
+  // Reserves disk space for |size| bytes without changing the file length,
+  // so later writes neither fragment the file nor fail for lack of space.
+  // Best effort; returns false where the platform cannot reserve.
+  bool Preallocate(uint64_t size);
+
+  // Commits written data to the storage device.
+  bool Flush();
+
+  // Deletes the file at |path| (UTF-8).
+  static bool Remove(const std::string& path);
+
+ private:
+#ifdef _WIN32
+  void* handle_ = nullptr;  // HANDLE; nullptr when closed
+#else
+  int fd_ = -1;
+#endif
+};
+
+// Positional reader counterpart of FileWriter, for files the sinks wrote.
+class FileReader {
+ public:
+  FileReader() = default;
+  ~FileReader();
+
+  FileReader(const FileReader&) = delete;
+  FileReader& operator=(const FileReader&) = delete;
+
+  // Opens the existing file at |path| (UTF-8) for reading.
+  bool Open(const std::string& path);
+  void Close();
+  bool isOpen() const;
+
+  // Reads exactly |size| bytes at |offset|; false on error or end of file.
+  bool ReadAt(uint64_t offset, void* data, size_t size);
+
+  // Length of the file; 0 when closed.
+  uint64_t size() const;
+
+ private:
+#ifdef _WIN32
+  void* handle_ = nullptr;  // HANDLE; nullptr when closed
+#else
+  int fd_ = -1;
+#endif
+};
+
+}  // namespace windows_loopback_recorder
+
+#endif  // FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_FILE_WRITER_H_
@@ -0,0 +1,138 @@
+#ifndef FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_FLAC_ENCODER_H_
+#define FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_FLAC_ENCODER_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "worker_pool.h"
+
+namespace windows_loopback_recorder {
+
+struct FlacEncoderConfig {
+  uint32_t sampleRate = 44100;
+  uint16_t channels = 2;         // 1..8
+  uint16_t bitsPerSample = 16;   // 4..24
+  uint32_t blockSize = 4096;     // Sample frames per FLAC frame
+  // Highest LPC order tried; zero limits the search to fixed predictors.
+  uint32_t maxLpcOrder = 8;
+  // Residuals are split into up to 2^maxPartitionOrder Rice partitions.
+  uint32_t maxPartitionOrder = 6;
+};
+
+// Stream totals that end up in STREAMINFO. Zero means unknown.
+struct FlacStreamInfo {
+  uint32_t minFrameBytes = 0;
+  uint32_t maxFrameBytes = 0;
+  uint64_t totalFrames = 0;  // Sample frames, not FLAC frames
+};
+
+// Encodes independent FLAC frames (fixed block size). Each frame picks the
+// cheapest of constant, verbatim, fixed (orders 0-4) and quantized LPC
+// subframes with partitioned Rice residuals, and stereo frames the cheapest
+// of independent, left/side, right/side and mid/side coding. EncodeFrame()
+// is const and keeps its scratch space per thread, so one encoder can serve
+// several worker threads at once.
+class FlacEncoder {
+ public:
+  bool Configure(const FlacEncoderConfig& config);
+  const FlacEncoderConfig& config() const { return config_; }
+
+  // Appends one frame holding |frames| interleaved sample frames (right
+  // justified). Only the last frame of a stream may be shorter than
+  // blockSize; |frameNumber| counts frames from the start of the stream.
+  void EncodeFrame(const int32_t* samples, uint32_t frames, uint64_t frameNumber,
+                   std::vector<uint8_t>& out) const;
+
+ private:
+  FlacEncoderConfig config_;
+  uint32_t qlpPrecision_ = 12;
+  std::vector<double> window_;  // Analysis window for full blocks
+};
+
+// "fLaC" followed by STREAMINFO. A non-zero |paddedSize| appends a PADDING
+// block so the header fills exactly that many bytes and can be rewritten in
+// place once the totals are known. The MD5 signature is left unset.
+std::vector<uint8_t> BuildFlacHeader(const FlacEncoderConfig& config, const FlacStreamInfo& info,
+                                     size_t paddedSize = 0);
+
+// Appends |frame| to |out| with its frame number replaced, fixing up both
+// CRCs. Lets frames cut from the middle of a stream start a file of their
+// own, since decoders expect numbering to begin at zero. Returns false if
+// |frame| is not a fixed-blocksize FLAC frame.
+bool RenumberFlacFrame(const uint8_t* frame, size_t size, uint64_t frameNumber,
+                       std::vector<uint8_t>& out);
+
+// Turns a PCM byte stream into FLAC frames, encoding whole blocks on a
+// worker pool so a slow frame never holds up the caller. Frames come back
+// in stream order. Not thread-safe: one producer drives Push/Collect/Finish.
+class FlacStreamEncoder {
+ public:
+  // Receives each finished frame and the sample frames it holds; the frame
+  // buffer may be moved from.
+  using EmitFunction = std::function<void(std::vector<uint8_t>& frame, uint32_t sampleFrames)>;
+
+  // A null |pool| encodes synchronously inside Push().
+  explicit FlacStreamEncoder(WorkerPool* pool = &WorkerPool::Shared());
+  // Waits for frames still being encoded.
+  ~FlacStreamEncoder();
+
+  FlacStreamEncoder(const FlacStreamEncoder&) = delete;
+  FlacStreamEncoder& operator=(const FlacStreamEncoder&) = delete;
+
+  bool Configure(const FlacEncoderConfig& config);
+
+  // Appends little-endian PCM with (bitsPerSample + 7) / 8 bytes per sample,
+  // laid out as in a WAV file. Sample frames may straddle calls.
+  void Push(const uint8_t* pcm, size_t size);
+
+  // Emits the frames finished so far, in order, without waiting.
+  void Collect(const EmitFunction& emit);
+
+  // Encodes the remaining partial block and emits every outstanding frame.
+  void Finish(const EmitFunction& emit);
+
+  // Drops audio still waiting for a full block, e.g. across a gap in the
+  // input. Returns the sample frames dropped.
+  uint32_t DiscardPending();
+
+  const FlacEncoderConfig& config() const { return encoder_.config(); }
+  // Totals over the frames emitted so far.
+  const FlacStreamInfo& info() const { return info_; }
+
+ private:
+  struct Job {
+    std::vector<int32_t> samples;
+    uint32_t frames = 0;
+    uint64_t frameNumber = 0;
+    std::vector<uint8_t> output;
+    bool done = false;
+  };
+
+  void SubmitPending();
+  void EmitFront(const EmitFunction& emit);
+  void WaitForJobs();
+
+  FlacEncoder encoder_;
+  WorkerPool* pool_;
+  uint32_t bytesPerSample_ = 2;
+
+  std::vector<uint8_t> partialFrame_;  // Bytes of a sample frame split across Push() calls
+  std::vector<int32_t> pending_;       // Interleaved samples of the block being filled
+  uint64_t nextFrameNumber_ = 0;
+
+  std::mutex mutex_;
+  std::condition_variable jobDone_;
+  std::deque<std::shared_ptr<Job>> jobs_;
+
+  FlacStreamInfo info_;
+};
+
+}  // namespace windows_loopback_recorder
+
+#endif  // FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_FLAC_ENCODER_H_
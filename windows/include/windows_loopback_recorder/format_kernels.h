@@ -0,0 +1,86 @@
+#ifndef FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_FORMAT_KERNELS_H_
+#define FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_FORMAT_KERNELS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "windows_loopback_recorder/audio_meter.h"
+
+namespace windows_loopback_recorder {
+
+// Sample encodings a capture device can deliver. 24-bit samples in a 32-bit
+// container are read as PCM32: their valid bits are the high ones.
+enum class SampleFormat { UNSUPPORTED = 0, PCM16, PCM24, PCM32, FLOAT32 };
+
+// Reads the sample encoding from the |size| bytes of a WAVEFORMATEX, and
+// from the SubFormat and valid bits of a WAVEFORMATEXTENSIBLE when its tag
+// says it is one. Byte-level, so it does not depend on the Windows headers.
+SampleFormat ParseSampleFormat(const uint8_t* waveFormat, size_t size);
+
+// Converts |samples| samples to float in [-1, 1).
+using WidenKernel = void (*)(const uint8_t* in, size_t samples, float* out);
+
+// The converter for |format|, SSE2 where available; nullptr for FLOAT32 and
+// UNSUPPORTED.
+WidenKernel SelectWidenKernel(SampleFormat format);
+
+// Mixes |systemFrames| loopback frames with |micFrames| microphone frames
+// into 16-bit samples in the loopback's channel layout, |out| holding the
+// longer of the two. Microphone channel c is added to loopback channel c,
+// saturating, for the channels both have. Meters, when given, are fed every
+// sample mixed; the caller begins and finishes them.
+using MixKernel = void (*)(const uint8_t* system, size_t systemFrames, const uint8_t* mic,
+                           size_t micFrames, uint16_t systemChannels, uint16_t micChannels,
+                           int16_t* out, SourceLevels* systemMeter, SourceLevels* micMeter);
+
+// Maps |frames| 16-bit frames from |inChannels| to |outChannels|: stereo is
+// averaged to mono, mono duplicated to stereo, and otherwise the channels
+// both layouts have are copied and the rest are silent.
+using ChannelKernel = void (*)(const int16_t* in, size_t frames, uint16_t inChannels,
+                               uint16_t outChannels, int16_t* out);
+
+// The same two steps in float, for output that is deeper than 16 bits or
+// dithered. 16-bit sources are scaled by 1/32768 and the microphone is
+// added clamped to [-1, 1]; stereo to mono averages without truncating.
+using FloatMixKernel = void (*)(const uint8_t* system, size_t systemFrames, const uint8_t* mic,
+                                size_t micFrames, uint16_t systemChannels, uint16_t micChannels,
+                                float* out, SourceLevels* systemMeter, SourceLevels* micMeter);
+using FloatChannelKernel = void (*)(const float* in, size_t frames, uint16_t inChannels,
+                                    uint16_t outChannels, float* out);
+
+// The mix and channel conversion for one session's formats, resolved once
+// when recording starts so the per-packet loops carry no format checks.
+// Each kernel is a template instance for its sample types, with mono and
+// stereo layouts fixed at compile time and other channel counts read at run
+// time.
+struct FormatKernels {
+  // 24-bit and 32-bit integer sources are widened to float as each packet
+  // is captured, and every later stage sees float; nullptr for the others
+  WidenKernel widenSystem = nullptr;
+  WidenKernel widenMic = nullptr;
+  // Sample size after widening: 16, 32 for float, 0 when unsupported
+  uint16_t systemBits = 0;
+  uint16_t micBits = 0;
+  // nullptr when the loopback encoding is unsupported; its bytes are then
+  // copied through unmixed
+  MixKernel mix = nullptr;
+  FloatMixKernel mixFloat = nullptr;
+  // nullptr when the device and output channel counts match
+  ChannelKernel channels = nullptr;
+  FloatChannelKernel channelsFloat = nullptr;
+  uint16_t systemChannels = 0;
+  uint16_t micChannels = 0;
+  // Microphone channels added to the loopback; 0 when the microphone's
+  // sample format is not one the mix reads
+  uint16_t mixedMicChannels = 0;
+  uint16_t outputChannels = 0;
+};
+
+// Picks the kernels for the loopback and microphone encodings (|mic|
+// UNSUPPORTED without one) and the output channel count.
+FormatKernels SelectFormatKernels(SampleFormat system, uint16_t systemChannels, SampleFormat mic,
+                                  uint16_t micChannels, uint16_t outputChannels);
+
+}  // namespace windows_loopback_recorder
+
+#endif  // FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_FORMAT_KERNELS_H_
@@ -0,0 +1,88 @@
+#ifndef FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_LOUDNESS_METER_H_
+#define FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_LOUDNESS_METER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace windows_loopback_recorder {
+
+// Loudness in LUFS. Negative infinity until a window has filled, or when no
+// block has passed the gates yet.
+struct LoudnessReading {
+  double momentary = -std::numeric_limits<double>::infinity();   // 400 ms window
+  double shortTerm = -std::numeric_limits<double>::infinity();   // 3 s window
+  double integrated = -std::numeric_limits<double>::infinity();  // Gated, since Reset()
+};
+
+// Streaming ITU-R BS.1770-4 / EBU R128 loudness meter.
+//
+// Audio is K-weighted per channel and reduced to the mean square of each
+// 100 ms sub-block. Momentary and short-term loudness average the last 4 and
+// 30 sub-blocks; every 400 ms gating block (75% overlap) lands in a 0.1 LU
+// histogram whose count and energy are kept in Fenwick trees, so the
+// absolute (-70 LUFS) and relative (-10 LU) gates cost O(log bins) per block
+// however long the program runs. Used from a single thread.
+class LoudnessMeter {
+ public:
+  static constexpr double kAbsoluteGate = -70.0;
+  static constexpr double kRelativeGate = -10.0;
+
+  // Also resets. On failure the meter ignores input until configured.
+  bool Configure(uint32_t sampleRate, uint16_t channels);
+
+  // Starts a new program: clears the windows and the integrated loudness.
+  void Reset();
+
+  // Feeds interleaved 16-bit sample frames.
+  void Process(const int16_t* samples, size_t frames);
+
+  LoudnessReading reading() const;
+
+  // BS.1770 channel weight for |channel| of a |channels|-channel stream in
+  // WAVE_FORMAT_EXTENSIBLE order: surrounds count 1.41, the LFE not at all.
+  static double ChannelWeight(uint16_t channel, uint16_t channels);
+
+ private:
+  static constexpr size_t kShortTermBlocks = 30;
+  static constexpr size_t kMomentaryBlocks = 4;
+  static constexpr size_t kHistogramBins = 750;  // -70 to +5 LUFS in 0.1 LU
+
+  struct Biquad {
+    double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+  };
+
+  void FinishSubBlock();
+  void AddGatingBlock(double energy);
+  double WindowEnergy(size_t blocks) const;
+  void HistogramAdd(size_t bin, double energy);
+  void HistogramPrefix(size_t bins, uint64_t& count, double& energy) const;
+
+  uint32_t sampleRate_ = 0;
+  uint16_t channels_ = 0;
+  uint32_t subBlockFrames_ = 0;
+  Biquad shelf_;
+  Biquad highPass_;
+  std::vector<double> weights_;
+
+  // Per channel: two filter states of two values each, and the sub-block sum
+  std::vector<double> state_;
+  std::vector<double> squares_;
+  uint32_t subBlockFilled_ = 0;
+
+  // Weighted mean squares of the last sub-blocks, newest at ringHead_ - 1
+  double ring_[kShortTermBlocks] = {};
+  size_t ringHead_ = 0;
+  uint64_t subBlocks_ = 0;
+
+  // Gating blocks above the absolute gate
+  std::vector<uint64_t> binCounts_;    // Fenwick trees over the histogram
+  std::vector<double> binEnergies_;
+  uint64_t gatedCount_ = 0;
+  double gatedEnergy_ = 0.0;
+};
+
+}  // namespace windows_loopback_recorder
+
+#endif  // FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_LOUDNESS_METER_H_
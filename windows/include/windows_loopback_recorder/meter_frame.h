@@ -0,0 +1,74 @@
+#ifndef FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_METER_FRAME_H_
+#define FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_METER_FRAME_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "audio_meter.h"
+#include "loudness_meter.h"
+
+namespace windows_loopback_recorder {
+
+// Float32 layout of a meter update on the volume stream: a header of
+// METER_FRAME_FIELDS values, then rms/peak/truePeak triples for
+//   - each channel of the output,
+//   - each capture source as a whole (system, then microphone),
+//   - each channel of the system source, then of the microphone.
+// Sources are metered before the mix, without oversampling: their true peak
+// is the sample peak. Layout is part of the public API; new header fields
+// are appended and readers locate the triples through
+// METER_FRAME_HEADER_SIZE.
+enum MeterFrameField : size_t {
+  METER_FRAME_HEADER_SIZE = 0,  // Values before the first triple
+  METER_FRAME_VERSION = 1,      // kMeterFrameVersion
+  METER_FRAME_ELAPSED_MS = 2,   // Since the recording started
+  METER_FRAME_RMS = 3,          // All channels combined
+  METER_FRAME_PEAK = 4,
+  METER_FRAME_TRUE_PEAK = 5,
+  METER_FRAME_MOMENTARY_LUFS = 6,
+  METER_FRAME_SHORT_TERM_LUFS = 7,
+  METER_FRAME_INTEGRATED_LUFS = 8,
+  METER_FRAME_CHANNELS = 9,  // Channel triples that follow the header
+  METER_FRAME_SOURCES = 10,  // Source triples that follow the channels
+  METER_FRAME_SYSTEM_CHANNELS = 11,  // Per-channel triples of each source
+  METER_FRAME_MIC_CHANNELS = 12,
+  METER_FRAME_FIELDS = 13,
+};
+
+constexpr float kMeterFrameVersion = 2.0f;
+constexpr size_t kMeterFrameSources = 2;
+constexpr size_t kMeterFrameStride = 3;  // rms, peak, truePeak
+
+// Aggregates the levels of consecutive buffers until the next meter update:
+// power is averaged over the frames, peaks keep their maximum.
+class LevelAccumulator {
+ public:
+  void Add(const std::vector<ChannelLevels>& levels, size_t frames);
+
+  bool empty() const { return frames_ == 0; }
+  uint64_t frames() const { return frames_; }
+
+  // The aggregate since the last Take() or Clear(); then starts over.
+  void Take(std::vector<ChannelLevels>& levels);
+  void Clear();
+
+ private:
+  std::vector<double> squares_;  // Sum over buffers of rms^2 * frames
+  std::vector<float> peak_;
+  std::vector<float> truePeak_;
+  uint64_t frames_ = 0;
+};
+
+// Builds one meter update. |combined| summarizes |channels|; the source
+// summaries are derived from their channels. A source that is not captured
+// has no channels and reads silent.
+std::vector<float> BuildMeterFrame(double elapsedMs, const ChannelLevels& combined,
+                                   const LoudnessReading& loudness,
+                                   const std::vector<ChannelLevels>& channels,
+                                   const std::vector<ChannelLevels>& systemChannels,
+                                   const std::vector<ChannelLevels>& micChannels);
+
+}  // namespace windows_loopback_recorder
+
+#endif  // FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_METER_FRAME_H_
@@ -0,0 +1,96 @@
+#ifndef FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_NOISE_SUPPRESSOR_H_
+#define FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_NOISE_SUPPRESSOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "windows_loopback_recorder/spectrum_analyzer.h"
+
+namespace windows_loopback_recorder {
+
+// Removes stationary noise (fans, hum, hiss) from a stream.
+//
+// A short-time Fourier transform with a square-root Hann window at 50%
+// overlap splits the audio into frames of at least 10 ms. The noise power
+// in each bin is the minimum of the smoothed power over the last 1.5 s,
+// found over eight sub-windows (minimum statistics), so it follows a
+// changing noise floor without a speech detector. Each bin is scaled by a
+// Wiener gain from a decision-directed a priori SNR, no lower than
+// -maxAttenuationDb, and the frames are overlap-added back. All channels
+// get the same gains, taken from their average power, so the stereo image
+// stays put.
+//
+// The output lags the input by latencyFrames() (one FFT length). Buffers
+// are sized by Configure, so Process never allocates. Used from a single
+// thread; suppressors on the same thread may share one RealFft.
+class NoiseSuppressor {
+ public:
+  static constexpr float kDefaultAttenuationDb = 20.0f;
+  static constexpr float kMaxAttenuationDb = 40.0f;
+
+  // Also resets. False for rates below 8 kHz, no channels or an attenuation
+  // outside (0, kMaxAttenuationDb]. |fft| is used when it has the size this
+  // rate needs; otherwise a new one is made.
+  bool Configure(uint32_t sampleRate, uint16_t channels, float maxAttenuationDb = kDefaultAttenuationDb,
+                 std::shared_ptr<RealFft> fft = nullptr);
+  bool configured() const { return fft_ != nullptr; }
+
+  // Forgets the noise estimate and all buffered audio.
+  void Reset();
+
+  // Suppresses noise in interleaved frames; |out| may be |in|.
+  void Process(const int16_t* in, int16_t* out, size_t frames);
+  void Process(const float* in, float* out, size_t frames);
+
+  const std::shared_ptr<RealFft>& fft() const { return fft_; }
+  size_t frameSize() const { return frameSize_; }
+  size_t latencyFrames() const { return frameSize_; }
+  double latencyMs() const { return sampleRate_ > 0 ? 1000.0 * frameSize_ / sampleRate_ : 0.0; }
+
+  // Estimated noise floor over all bins, in dBFS; -120 before the first frame.
+  float noiseDb() const { return noiseDb_; }
+
+ private:
+  template <typename Sample>
+  void ProcessFrames(const Sample* in, Sample* out, size_t frames);
+  void ProcessFrame();
+  void TrackNoise();
+
+  uint32_t sampleRate_ = 0;
+  uint16_t channels_ = 0;
+  size_t frameSize_ = 0;  // N
+  size_t hop_ = 0;        // N / 2
+  size_t bins_ = 0;       // N / 2 + 1
+  float gainFloor_ = 0.0f;
+
+  std::shared_ptr<RealFft> fft_;
+  std::vector<float> window_;  // Square-root Hann, for analysis and synthesis
+
+  size_t filled_ = 0;
+  std::vector<float> input_;    // Last N samples per channel
+  std::vector<float> overlap_;  // Pending overlap-add tail per channel
+  std::vector<float> output_;   // Interleaved hop going out
+  std::vector<float> time_;
+  std::vector<float> re_;       // Spectra per channel
+  std::vector<float> im_;
+
+  // Per bin
+  std::vector<float> power_;         // Average power of this frame
+  std::vector<float> smoothed_;      // Smoothed power
+  std::vector<float> subMinimum_;    // Minimum of the current sub-window
+  std::vector<float> minima_;        // Minima of the last sub-windows
+  std::vector<float> noise_;
+  std::vector<float> gain_;
+  std::vector<float> lastSnr_;       // A posteriori SNR of the previous frame
+  size_t subFrames_ = 0;             // Frames per sub-window
+  size_t subFrame_ = 0;
+  size_t subWindow_ = 0;
+  bool primed_ = false;
+  float noiseDb_ = -120.0f;
+};
+
+}  // namespace windows_loopback_recorder
+
+#endif  // FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_NOISE_SUPPRESSOR_H_
@@ -0,0 +1,100 @@
+#ifndef FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_PEAK_PYRAMID_H_
+#define FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_PEAK_PYRAMID_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace windows_loopback_recorder {
+
+// Waveform columns for a frame range, as returned by a peak query.
+struct PeakColumns {
+  uint32_t sampleRate = 0;
+  uint16_t channels = 0;
+  uint64_t frames = 0;       // Frames the pyramid covers
+  uint32_t bucketFrames = 0; // Resolution the columns were built from
+  size_t columns = 0;
+  // columns x channels x {min, max, rms}, in [-1, 1]
+  std::vector<float> values;
+};
+
+// Min/max/RMS summary of 16-bit audio at several resolutions, built while
+// recording so a waveform of any range and zoom is drawn from at most
+// kFanout buckets per column instead of from the samples.
+//
+// Level 0 holds one bucket per kBaseFrames frames and channel; each higher
+// level merges kFanout buckets of the one below (256, 4096 and 65536
+// frames). Buckets store min, max and RMS as 16-bit values, 6 bytes per
+// channel, so two hours of 48 kHz stereo take about 17 MB; the stores are
+// deques so growing them never copies what is already there.
+//
+// Push() runs on one thread (the capture thread); Query() may run on any
+// other. Save() writes the pyramid, partial buckets included, to a file
+// that QueryFile() reads back with one read per query; it must not race
+// with Push().
+class PeakPyramid {
+ public:
+  static constexpr uint32_t kBaseFrames = 256;
+  static constexpr uint32_t kFanout = 16;
+  static constexpr size_t kLevels = 3;
+
+  // Also resets. False without channels.
+  bool Configure(uint32_t sampleRate, uint16_t channels);
+  void Reset();
+
+  // Adds interleaved 16-bit sample frames.
+  void Push(const int16_t* samples, size_t frames);
+
+  // Frames covered by finished level 0 buckets; queries stop there.
+  uint64_t frames() const;
+
+  // Reduces frames [first, end) to |columns| columns. Each column is read
+  // from the coarsest level whose buckets still fit in it. False when the
+  // range is empty or outside what has been recorded.
+  bool Query(uint64_t first, uint64_t end, size_t columns, PeakColumns& result) const;
+
+  // Writes the pyramid to |path|; partial buckets at the end are included.
+  bool Save(const std::string& path) const;
+
+  // Query() on a file written by Save(), reading only the buckets needed.
+  static bool QueryFile(const std::string& path, uint64_t first, uint64_t end, size_t columns,
+                        PeakColumns& result);
+
+  // Where the peaks of |audioPath| are saved: "<audioPath>.peaks".
+  static std::string PathFor(const std::string& audioPath);
+
+  static constexpr uint64_t BucketFrames(size_t level) {
+    return static_cast<uint64_t>(kBaseFrames) << (4 * level);
+  }
+
+ private:
+  // A bucket being filled, per channel
+  struct Partial {
+    int16_t min = 0;
+    int16_t max = 0;
+    double energy = 0.0;  // Sum of squares of the samples
+  };
+
+  void FinishBucket(size_t level);
+  void Merge(std::vector<Partial>& into, bool first, const Partial* buckets) const;
+  void Store(const Partial* buckets, uint64_t frames, std::deque<int16_t>& out) const;
+
+  uint32_t sampleRate_ = 0;
+  uint16_t channels_ = 0;
+
+  // Capture thread only
+  std::vector<Partial> partials_[kLevels];  // Per channel
+  uint64_t partialFrames_[kLevels] = {};
+  uint64_t pushedFrames_ = 0;
+
+  // Finished buckets: bucket x channel x {min, max, rms}. Guarded by mutex_.
+  mutable std::mutex mutex_;
+  std::deque<int16_t> levels_[kLevels];
+};
+
+}  // namespace windows_loopback_recorder
+
+#endif  // FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_PEAK_PYRAMID_H_
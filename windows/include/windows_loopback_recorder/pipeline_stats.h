@@ -0,0 +1,89 @@
+#ifndef FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_PIPELINE_STATS_H_
+#define FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_PIPELINE_STATS_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace windows_loopback_recorder {
+
+// Processing stages that run per capture packet. Each stage only runs when
+// some consumer needs its output; see WindowsLoopbackRecorderPlugin::
+// GetPipelineDemand().
+enum class PipelineStage {
+  MIX = 0,      // Combine system and microphone buffers
+  CONVERT = 1,  // Channel conversion and resampling to the user format
+  DELIVER = 2,  // Chunking, packet headers and the delivery queue
+  METER = 3,    // RMS volume updates
+  RECORD = 4,   // Native file sink
+  PREROLL = 5,  // Pre-roll ring
+  SPECTRUM = 6, // FFT band levels for the spectrum stream
+  VAD = 7,      // Voice activity detection for tagging and gating delivery
+  AEC = 8,      // Loopback echo removed from the microphone before mixing
+  DENOISE = 9,  // Stationary noise removed from the sources before mixing
+  FEATURES = 10, // Log-mel or MFCC rows for the feature stream
+  COUNT
+};
+
+constexpr size_t kPipelineStageCount = static_cast<size_t>(PipelineStage::COUNT);
+
+inline const char* PipelineStageName(PipelineStage stage) {
+  switch (stage) {
+    case PipelineStage::MIX: return "mix";
+    case PipelineStage::CONVERT: return "convert";
+    case PipelineStage::DELIVER: return "deliver";
+    case PipelineStage::METER: return "meter";
+    case PipelineStage::RECORD: return "record";
+    case PipelineStage::PREROLL: return "preroll";
+    case PipelineStage::SPECTRUM: return "spectrum";
+    case PipelineStage::VAD: return "vad";
+    case PipelineStage::AEC: return "aec";
+    case PipelineStage::DENOISE: return "denoise";
+    case PipelineStage::FEATURES: return "features";
+    default: return "unknown";
+  }
+}
+
+// Bitmask of stages whose output has a consumer.
+using PipelineDemand = uint32_t;
+
+inline PipelineDemand DemandBit(PipelineStage stage) {
+  return 1u << static_cast<uint32_t>(stage);
+}
+
+inline bool IsDemanded(PipelineDemand demand, PipelineStage stage) {
+  return (demand & DemandBit(stage)) != 0;
+}
+
+// Per-stage run/skip counters, written by the capture thread and read from
+// the platform thread.
+class PipelineStats {
+ public:
+  void Reset() {
+    for (size_t i = 0; i < kPipelineStageCount; i++) {
+      runs_[i] = 0;
+      skips_[i] = 0;
+    }
+  }
+
+  void Record(PipelineStage stage, bool ran) {
+    auto& counter = ran ? runs_[static_cast<size_t>(stage)] : skips_[static_cast<size_t>(stage)];
+    counter.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  uint64_t runs(PipelineStage stage) const {
+    return runs_[static_cast<size_t>(stage)].load(std::memory_order_relaxed);
+  }
+
+  uint64_t skips(PipelineStage stage) const {
+    return skips_[static_cast<size_t>(stage)].load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<uint64_t> runs_[kPipelineStageCount] = {};
+  std::atomic<uint64_t> skips_[kPipelineStageCount] = {};
+};
+
+}  // namespace windows_loopback_recorder
+
+#endif  // FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_PIPELINE_STATS_H_
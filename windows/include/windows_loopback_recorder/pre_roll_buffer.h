@@ -0,0 +1,100 @@
+#ifndef FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_PRE_ROLL_BUFFER_H_
+#define FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_PRE_ROLL_BUFFER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "flac_encoder.h"
+#include "wav_file_sink.h"
+
+namespace windows_loopback_recorder {
+
+struct PreRollOptions {
+  // Memory the ring may hold. Older audio is evicted to stay within it.
+  size_t budgetBytes = 16 << 20;
+  // Hold FLAC frames instead of PCM, roughly doubling the audio that fits
+  // into the budget at the cost of encoding continuously on the worker pool.
+  bool compressed = false;
+};
+
+// Immutable piece of the ring: PCM or one FLAC frame.
+struct PreRollBlock {
+  std::vector<uint8_t> data;
+  uint64_t firstFrame = 0;  // Stream position of the first sample frame
+  uint32_t frames = 0;
+};
+
+// The tail of the ring at the moment Snapshot() was called. Holds references
+// to the ring's blocks rather than copies, so taking one is cheap and the
+// blocks stay valid while the capture thread moves on.
+struct PreRollSnapshot {
+  FileContainer container = FileContainer::WAV;
+  WavFormat format;
+  uint64_t firstFrame = 0;  // Stream position of the first frame
+  uint64_t frames = 0;
+
+  std::vector<std::shared_ptr<const PreRollBlock>> blocks;
+  size_t skipBytes = 0;  // Leading PCM of the first block outside the range
+
+  // Complete WAV or FLAC file image. FLAC frames are renumbered from zero.
+  std::vector<uint8_t> ToFile() const;
+  bool WriteFile(const std::string& path) const;
+};
+
+// Keeps the most recent processed audio within a fixed memory budget so it
+// can be saved after the fact. Write() is called from the capture thread;
+// Snapshot() from any thread, holding the lock only while it collects block
+// references (plus a copy of the partially filled PCM block). Evicted blocks
+// that no snapshot still references are recycled, so a full ring runs
+// without allocating.
+class PreRollBuffer {
+ public:
+  PreRollBuffer() = default;
+
+  PreRollBuffer(const PreRollBuffer&) = delete;
+  PreRollBuffer& operator=(const PreRollBuffer&) = delete;
+
+  // A compressed ring of float or 32-bit samples, which FLAC cannot hold,
+  // keeps PCM instead; options() then reports it uncompressed. Fails when
+  // the budget cannot hold two blocks or the encoder rejects the format.
+  bool Configure(const WavFormat& format, const PreRollOptions& options);
+
+  // Appends whole sample frames.
+  void Write(const uint8_t* data, size_t size);
+
+  // The last |frames| sample frames held (zero: everything). Compressed rings
+  // return whole FLAC frames, so the snapshot may start slightly earlier;
+  // audio still waiting to fill a FLAC frame is not included.
+  PreRollSnapshot Snapshot(uint64_t frames);
+
+  uint64_t heldFrames() const;
+  size_t heldBytes() const;
+  const PreRollOptions& options() const { return options_; }
+
+ private:
+  void PublishLocked(std::shared_ptr<PreRollBlock> block);
+
+  WavFormat format_;
+  PreRollOptions options_;
+  size_t pcmBlockBytes_ = 0;
+
+  // Compressed rings only; driven by the capture thread
+  std::unique_ptr<FlacStreamEncoder> flac_;
+
+  mutable std::mutex mutex_;
+  std::deque<std::shared_ptr<PreRollBlock>> blocks_;
+  std::shared_ptr<PreRollBlock> current_;               // PCM block being filled
+  std::vector<std::shared_ptr<PreRollBlock>> spares_;   // Evicted, unreferenced blocks
+  size_t heldBytes_ = 0;
+  uint64_t heldFrames_ = 0;
+  uint64_t writtenFrames_ = 0;
+};
+
+}  // namespace windows_loopback_recorder
+
+#endif  // FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_PRE_ROLL_BUFFER_H_
@@ -0,0 +1,88 @@
+#ifndef FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_SAMPLE_QUANTIZER_H_
+#define FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_SAMPLE_QUANTIZER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "windows_loopback_recorder/format_kernels.h"
+
+namespace windows_loopback_recorder {
+
+// What is added before float samples are rounded to fewer bits
+enum class DitherMode {
+  NONE = 0,
+  // Triangular noise of +-1 LSB: the rounding error no longer follows the
+  // signal, so quiet passages keep detail below the last bit instead of
+  // turning into distortion
+  TRIANGULAR,
+  // The same noise with first-order error feedback, which moves the noise
+  // from low frequencies towards Nyquist at twice the total power
+  SHAPED,
+};
+
+// Converts float samples in [-1, 1] to the delivered sample encoding.
+//
+// Undithered 16-bit output keeps the truncating x * 32767 conversion the
+// plugin has always used. Everything else rounds to nearest at the scale
+// the capture side widens with (1/32768, 1/2^23, 1/2^31), so deeper
+// integer sources go round trip unchanged. Dither only applies to 16 and
+// 24 bits; 32-bit integers and float carry all a float sample holds.
+//
+// The noise comes from four xorshift32 generators, one per SSE2 lane, each
+// draw summing its two 16-bit halves into one triangular value. Lanes are
+// assigned by sample position across calls, so mono, stereo and four
+// channel output give every channel its own generators, and the output
+// does not depend on how the stream is split into packets. Rounding runs
+// four samples at a time; noise shaping feeds each sample's error into the
+// next one of its channel and runs one sample at a time. Used from a
+// single thread.
+class SampleQuantizer {
+ public:
+  // |format| is PCM16, PCM24 (three bytes per sample), PCM32 or FLOAT32.
+  // Returns false for UNSUPPORTED or no channels.
+  bool Configure(SampleFormat format, uint16_t channels, DitherMode dither,
+                 uint32_t seed = 0x2545F491u);
+
+  // Restarts the generators from the seed and clears the shaping error.
+  void Reset();
+
+  // Converts |frames| interleaved frames from |in| into |out|, which holds
+  // frames * channels * bytesPerSample() bytes.
+  void Quantize(const float* in, size_t frames, uint8_t* out);
+
+  SampleFormat format() const { return format_; }
+  uint16_t channels() const { return channels_; }
+  // NONE for the formats dither does not apply to
+  DitherMode dither() const { return dither_; }
+  uint16_t bytesPerSample() const { return bytesPerSample_; }
+
+ private:
+  static constexpr size_t kBlock = 256;
+
+  void Triangular(float* noise, size_t count);
+  float NextTriangular();
+  void Round(const float* in, const float* noise, size_t count, int32_t* out) const;
+  void Shape(const float* in, const float* noise, size_t count, size_t& channel, int32_t* out);
+  template <uint16_t kChannels>
+  void ShapeFrames(const float* in, const float* noise, size_t count, int32_t* out);
+  void Store(const int32_t* values, size_t count, uint8_t* out) const;
+
+  SampleFormat format_ = SampleFormat::UNSUPPORTED;
+  uint16_t channels_ = 0;
+  DitherMode dither_ = DitherMode::NONE;
+  uint16_t bytesPerSample_ = 0;
+  uint32_t seed_ = 0;
+  float scale_ = 0.0f;  // Full scale in output steps
+  float low_ = 0.0f;    // Output range, in steps
+  float high_ = 0.0f;
+  bool truncate_ = false;  // The legacy 16-bit conversion
+
+  uint32_t lanes_[4] = {1, 1, 1, 1};
+  size_t lane_ = 0;            // Lane of the next sample
+  std::vector<float> error_;   // Shaping error per channel, in steps
+};
+
+}  // namespace windows_loopback_recorder
+
+#endif  // FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_SAMPLE_QUANTIZER_H_
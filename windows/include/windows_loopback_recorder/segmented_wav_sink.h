@@ -0,0 +1,121 @@
+#ifndef FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_SEGMENTED_WAV_SINK_H_
+#define FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_SEGMENTED_WAV_SINK_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "wav_file_sink.h"
+
+namespace windows_loopback_recorder {
+
+// Rotation limits. All zero records a single file at the requested path.
+struct SegmentOptions {
+  uint32_t segmentSeconds = 0;  // Roll over after this much audio...
+  uint64_t segmentBytes = 0;    // ...or before a file exceeds this size
+                                // (FLAC: before its audio would as PCM)
+};
+
+// A finished file and the sample frames it holds.
+struct SegmentInfo {
+  std::string path;
+  uint32_t index = 0;
+  uint64_t firstFrame = 0;  // Frames recorded before this segment
+  uint64_t frameCount = 0;
+  WavSinkStats stats;
+  bool complete = false;    // Every write and the final header succeeded
+};
+
+// Splits one continuous recording across WavFileSink segments. Cuts fall on
+// exact frame positions inside a write, so consecutive segments neither gap
+// nor overlap. A manager thread opens (and preallocates) the next segment
+// ahead of time and closes finished ones, so rollover on the capture thread
+// only swaps pointers.
+class SegmentedWavSink {
+ public:
+  using SegmentCallback = std::function<void(const SegmentInfo& segment)>;
+
+  SegmentedWavSink() = default;
+  ~SegmentedWavSink();
+
+  SegmentedWavSink(const SegmentedWavSink&) = delete;
+  SegmentedWavSink& operator=(const SegmentedWavSink&) = delete;
+
+  // |onSegmentComplete| runs on the manager thread once each file is closed,
+  // including the last one during Close().
+  bool Open(const std::string& path, const WavFormat& format, const SegmentOptions& segments,
+            SegmentCallback onSegmentComplete = nullptr,
+            const WavSinkOptions& options = WavSinkOptions());
+
+  // Capture thread only; must not race with Close(). Never waits for the
+  // disk: if the next segment is not open yet, audio is held back briefly.
+  void Write(const uint8_t* data, size_t size);
+
+  // Finishes the current segment and waits until every file is closed.
+  // Returns false if any segment lost audio to a write error.
+  bool Close();
+
+  bool segmented() const { return segmentFrames_ > 0; }
+  uint64_t segmentFrames() const { return segmentFrames_; }
+  const std::string& path() const { return path_; }
+  const WavFormat& format() const { return format_; }
+
+  // Frames recorded so far; capture thread, or any thread after Close().
+  uint64_t totalFrames() const { return totalFrames_; }
+  uint32_t segmentCount() const;
+  // Totals over finished segments; covers the whole recording after Close().
+  WavSinkStats GetStats() const;
+
+  // |path| with "_<index>" inserted before the extension, e.g.
+  // capture.wav -> capture_000003.wav.
+  static std::string SegmentPath(const std::string& path, uint32_t index);
+
+ private:
+  struct Segment {
+    std::unique_ptr<WavFileSink> sink;
+    SegmentInfo info;
+  };
+
+  std::unique_ptr<Segment> OpenSegment(uint32_t index);
+  void WriteFrames(const uint8_t* data, size_t size);
+  bool AcquireSegment();
+  void HoldBack(const uint8_t* data, size_t size);
+  void Rotate();
+  void ManagerThreadFunction();
+  void FinishSegment(Segment& segment);
+
+  std::string path_;
+  WavFormat format_;
+  WavSinkOptions options_;
+  SegmentCallback onSegmentComplete_;
+  uint64_t segmentFrames_ = 0;
+
+  // Capture-thread state
+  std::unique_ptr<Segment> current_;
+  std::vector<uint8_t> holdover_;  // Audio waiting for the next segment
+  uint64_t gapFrames_ = 0;         // Dropped after the holdover
+  uint64_t totalFrames_ = 0;
+
+  // Shared with the manager thread
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;          // Work for the manager thread
+  std::condition_variable segmentReady_;  // next_ became available
+  std::unique_ptr<Segment> next_;
+  std::deque<std::unique_ptr<Segment>> finished_;
+  uint32_t nextIndex_ = 0;
+  bool stopping_ = false;
+  bool allComplete_ = true;
+  WavSinkStats closedStats_;  // Sum over finished segments
+  std::thread managerThread_;
+};
+
+}  // namespace windows_loopback_recorder
+
+#endif  // FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_SEGMENTED_WAV_SINK_H_
@@ -0,0 +1,126 @@
+#ifndef FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_SPECTRUM_ANALYZER_H_
+#define FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_SPECTRUM_ANALYZER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace windows_loopback_recorder {
+
+// FFT of a real signal whose length is a power of two. The signal is
+// packed into a complex FFT of half the length, whose bins are then split
+// into those of the real signal. Twiddles and the bit-reversal permutation
+// are computed once per size; the radix-2 butterflies run four at a time
+// with SSE2 where available. Not thread-safe: the work buffers are members.
+class RealFft {
+ public:
+  static constexpr size_t kMinSize = 16;
+  static constexpr size_t kMaxSize = 16384;
+
+  // |size| must be a power of two in [kMinSize, kMaxSize].
+  explicit RealFft(size_t size);
+
+  size_t size() const { return size_; }
+
+  // Transforms |size| samples into size / 2 + 1 bins, unnormalized.
+  void Forward(const float* in, float* re, float* im);
+  // Turns size / 2 + 1 bins back into |size| samples, scaled by 1 / size so
+  // that Inverse(Forward(x)) == x. im[0] and im[size / 2] are ignored.
+  void Inverse(const float* re, const float* im, float* out);
+
+  static bool IsValidSize(size_t size);
+
+ private:
+  size_t size_;
+  size_t half_;  // Length of the complex FFT
+  std::vector<uint32_t> bitReverse_;
+  // Per stage of span s: exp(-i pi j / s) for j < s, stored at offset s - 1
+  std::vector<float> twiddleRe_;
+  std::vector<float> twiddleIm_;
+  // exp(-2 pi i k / size) for the split into real bins
+  std::vector<float> splitRe_;
+  std::vector<float> splitIm_;
+  std::vector<float> workRe_;
+  std::vector<float> workIm_;
+};
+
+// Turns the audio into log-spaced band levels for a spectrum display.
+//
+// Channels are downmixed to mono into a ring of the last |fftSize| samples.
+// Analyze() applies a Hann window to them, transforms them and reduces the
+// power spectrum to |bands| bands whose edges are spaced evenly in log
+// frequency between minHz and maxHz. A band reports its strongest bin, so a
+// tone reads the same whether its band is narrow or wide; a band narrower
+// than one bin shows the bin it falls into. Levels are dBFS: a full-scale
+// sine in the middle of a bin reads 0 dB. Used from a single thread.
+class SpectrumAnalyzer {
+ public:
+  static constexpr size_t kDefaultFftSize = 2048;
+  static constexpr size_t kDefaultBands = 32;
+  static constexpr size_t kMaxBands = 256;
+  static constexpr float kFloorDb = -120.0f;
+
+  // Also resets. |maxHz| is limited to the Nyquist frequency.
+  bool Configure(uint32_t sampleRate, uint16_t channels, size_t fftSize, size_t bands,
+                 float minHz, float maxHz);
+  bool configured() const { return fft_ != nullptr; }
+
+  // Forgets the audio seen so far.
+  void Reset();
+
+  // Feeds interleaved 16-bit sample frames.
+  void Push(const int16_t* samples, size_t frames);
+
+  // Band levels in dBFS of the last fftSize samples. False until that many
+  // have been pushed.
+  bool Analyze(std::vector<float>& bands);
+
+  uint32_t sampleRate() const { return sampleRate_; }
+  size_t fftSize() const { return fft_ ? fft_->size() : 0; }
+  float minHz() const { return minHz_; }
+  float maxHz() const { return maxHz_; }
+
+ private:
+  uint32_t sampleRate_ = 0;
+  uint16_t channels_ = 0;
+  float minHz_ = 0.0f;
+  float maxHz_ = 0.0f;
+  std::unique_ptr<RealFft> fft_;
+  std::vector<float> window_;  // Hann, scaled so a full-scale sine bin reads 1.0
+  std::vector<uint32_t> bandFirst_;  // First bin of each band
+  std::vector<uint32_t> bandEnd_;    // One past its last bin
+
+  std::vector<float> ring_;  // Mono history, oldest at ringHead_ once full
+  size_t ringHead_ = 0;
+  uint64_t pushed_ = 0;
+
+  std::vector<float> windowed_;
+  std::vector<float> re_;
+  std::vector<float> im_;
+};
+
+// Float32 layout of a spectrum update on the spectrum stream: a header of
+// SPECTRUM_FRAME_FIELDS values, then one dBFS level per band. New header
+// fields are appended; readers locate the bands through
+// SPECTRUM_FRAME_HEADER_SIZE.
+enum SpectrumFrameField : size_t {
+  SPECTRUM_FRAME_HEADER_SIZE = 0,
+  SPECTRUM_FRAME_VERSION = 1,
+  SPECTRUM_FRAME_ELAPSED_MS = 2,  // Since the recording started
+  SPECTRUM_FRAME_SAMPLE_RATE = 3,
+  SPECTRUM_FRAME_FFT_SIZE = 4,
+  SPECTRUM_FRAME_MIN_HZ = 5,  // Lower edge of the first band
+  SPECTRUM_FRAME_MAX_HZ = 6,  // Upper edge of the last band
+  SPECTRUM_FRAME_BANDS = 7,
+  SPECTRUM_FRAME_FIELDS = 8,
+};
+
+constexpr float kSpectrumFrameVersion = 1.0f;
+
+std::vector<float> BuildSpectrumFrame(double elapsedMs, const SpectrumAnalyzer& analyzer,
+                                      const std::vector<float>& bands);
+
+}  // namespace windows_loopback_recorder
+
+#endif  // FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_SPECTRUM_ANALYZER_H_
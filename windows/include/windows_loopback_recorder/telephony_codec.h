@@ -0,0 +1,80 @@
+#ifndef FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_TELEPHONY_CODEC_H_
+#define FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_TELEPHONY_CODEC_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace windows_loopback_recorder {
+
+// G.711 companding laws: one byte per sample, bit-exact with the ITU
+// reference coder.
+enum class G711Law {
+  MU_LAW = 0,
+  A_LAW = 1,
+};
+
+// Byte that decodes to silence; zero bytes are full-scale under both laws.
+uint8_t G711SilenceByte(G711Law law);
+
+// Compands |samples| little-endian 16-bit samples from |pcm| into |out|, one
+// byte each. Each sample is a single table lookup. |out| may alias |pcm|,
+// which lets a PCM buffer be encoded in place.
+void EncodeG711(G711Law law, const uint8_t* pcm, size_t samples, uint8_t* out);
+
+int16_t DecodeG711(G711Law law, uint8_t value);
+
+// IMA ADPCM (4 bits per sample) in the Microsoft WAVE_FORMAT_IMA_ADPCM block
+// layout: per channel a 4-byte header holding the first sample and the step
+// index, then 4-byte groups of 8 samples per channel, low nibble first. Every
+// block decodes on its own, so each one can travel as a separate chunk.
+// Used from a single thread.
+class ImaAdpcmEncoder {
+ public:
+  // Receives each block and the sample frames it holds; the block may be
+  // moved from.
+  using EmitFunction = std::function<void(std::vector<uint8_t>& block, uint32_t sampleFrames)>;
+
+  // The block length Windows' own codec uses: 256 bytes per channel at
+  // 8-16 kHz, 512 at 22 kHz and 1024 at 44.1/48 kHz.
+  static uint32_t DefaultSamplesPerBlock(uint32_t sampleRate);
+  // Bytes of a block holding |samplesPerBlock| frames.
+  static size_t BlockBytes(uint16_t channels, uint32_t samplesPerBlock);
+
+  // |samplesPerBlock| must be 8n + 1 for some n >= 1.
+  bool Configure(uint16_t channels, uint32_t samplesPerBlock);
+
+  uint16_t channels() const { return channels_; }
+  uint32_t samplesPerBlock() const { return samplesPerBlock_; }
+
+  // Appends little-endian 16-bit PCM and emits every block that became
+  // complete. Sample frames may straddle calls.
+  void Push(const uint8_t* pcm, size_t size, const EmitFunction& emit);
+
+  // Emits the remaining partial block, padded by holding its last sample.
+  // The frame count passed to |emit| excludes the padding.
+  void Flush(const EmitFunction& emit);
+
+  // Drops audio still waiting for a full block. Returns the sample frames
+  // dropped.
+  uint32_t DiscardPending();
+
+ private:
+  void EncodeBlock(const int16_t* samples, std::vector<uint8_t>& out);
+
+  uint16_t channels_ = 0;
+  uint32_t samplesPerBlock_ = 0;
+  std::vector<uint8_t> partialFrame_;  // Bytes of a sample frame split across Push() calls
+  std::vector<int16_t> pending_;       // Interleaved samples of the block being filled
+  std::vector<uint8_t> stepIndex_;     // Per channel; carried from block to block
+};
+
+// Decodes one block produced by ImaAdpcmEncoder (or any encoder using the
+// same layout) into interleaved samples. Returns false on a malformed block.
+bool DecodeImaAdpcmBlock(const uint8_t* block, size_t size, uint16_t channels,
+                         std::vector<int16_t>& samples);
+
+}  // namespace windows_loopback_recorder
+
+#endif  // FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_TELEPHONY_CODEC_H_
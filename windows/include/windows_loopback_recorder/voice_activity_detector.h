@@ -0,0 +1,143 @@
+#ifndef FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_VOICE_ACTIVITY_DETECTOR_H_
+#define FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_VOICE_ACTIVITY_DETECTOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "windows_loopback_recorder/spectrum_analyzer.h"
+
+namespace windows_loopback_recorder {
+
+// Settings shared by the detectors and the delivery gate.
+struct VadOptions {
+  float threshold = 0.5f;     // Smoothed probability that counts as speech
+  uint32_t hangoverMs = 200;  // Speech lasts this long after the last speech frame
+  bool gate = false;          // Deliver only speech plus padding
+  uint32_t paddingMs = 300;   // Audio kept before and after each speech segment
+};
+
+// Frame-based voice activity detector.
+//
+// Audio is downmixed to mono and cut into 10 ms frames. Each frame is scored
+// on four features:
+//   - energy above an adaptive noise floor (follows dips at once, rises by
+//     2 dB/s, or 20 dB/s through noise-like frames, so steady background
+//     sound is learned and ignored),
+//   - the share of power in the 300-3400 Hz speech band,
+//   - spectral flatness within that band (noise is flat, voiced speech has
+//     harmonics),
+//   - zero-crossing rate (high for hiss).
+// A logistic combination gives a per-frame probability, smoothed over a few
+// frames; the decision holds for the hangover after the last speech frame so
+// pauses between words don't chop an utterance. Strongly tonal music can
+// score as speech: the detector errs towards passing audio on. Used from a
+// single thread.
+class VoiceActivityDetector {
+ public:
+  static constexpr uint32_t kFrameMs = 10;
+
+  // Also resets. False for rates below 8 kHz or no channels.
+  bool Configure(uint32_t sampleRate, uint16_t channels, const VadOptions& options);
+  bool configured() const { return fft_ != nullptr; }
+  uint32_t sampleRate() const { return sampleRate_; }
+
+  void Reset();
+
+  // Feed interleaved samples; 16-bit or float with 1.0 = full scale.
+  void Process(const int16_t* samples, size_t frames);
+  void Process(const float* samples, size_t frames);
+
+  // Smoothed speech probability of the latest complete frame, 0 to 1.
+  float probability() const { return probability_; }
+  // Probability above the threshold, or within the hangover after it.
+  bool speech() const { return speech_; }
+
+ private:
+  void PushMono(float sample);
+  void AnalyzeFrame();
+
+  uint32_t sampleRate_ = 0;
+  uint16_t channels_ = 0;
+  VadOptions options_;
+  uint32_t frameSamples_ = 0;
+  uint32_t hangoverFrames_ = 0;
+
+  std::unique_ptr<RealFft> fft_;
+  std::vector<float> window_;  // Hann over frameSamples_, zero padded to the FFT size
+  size_t speechFirst_ = 0;     // Bins of the speech band
+  size_t speechEnd_ = 0;
+  size_t totalFirst_ = 0;      // Bins above 50 Hz, up to 8 kHz
+  size_t totalEnd_ = 0;
+
+  std::vector<float> frame_;
+  uint32_t filled_ = 0;
+  std::vector<float> re_;
+  std::vector<float> im_;
+
+  bool primed_ = false;
+  float noiseDb_ = 0.0f;
+  float probability_ = 0.0f;
+  uint32_t hangover_ = 0;
+  bool speech_ = false;
+};
+
+// Holds delivery back while nobody speaks. Audio passes while the detector
+// reports speech and for |paddingMs| after; meanwhile the last |paddingMs|
+// are held, so each segment also starts |paddingMs| early. Everything else
+// is suppressed. The first audio after a gap carries
+// AUDIO_PACKET_DISCONTINUITY, and emitted audio keeps its own capture time.
+class SpeechGate {
+ public:
+  using EmitFunction =
+      std::function<void(std::vector<uint8_t>& audio, int64_t captureTime, uint16_t flags, float probability)>;
+
+  void Configure(bool enabled, uint32_t sampleRate, uint32_t bytesPerFrame, uint32_t paddingMs);
+  bool enabled() const { return enabled_; }
+
+  // Drops held audio, counting it as suppressed.
+  void Reset();
+
+  // Passes or holds |audio|, captured at |captureTime| (100 ns units).
+  // Returns true when a speech segment ended within it, e.g. to flush a
+  // partial chunk.
+  bool Push(std::vector<uint8_t>& audio, int64_t captureTime, uint16_t flags, float probability,
+            bool speech, const EmitFunction& emit);
+
+  uint64_t passedBytes() const { return passedBytes_; }
+  uint64_t suppressedBytes() const { return suppressedBytes_; }
+
+ private:
+  struct Held {
+    std::vector<uint8_t> audio;
+    int64_t captureTime;
+    uint16_t flags;
+    float probability;
+  };
+
+  void Hold(std::vector<uint8_t>& audio, int64_t captureTime, uint16_t flags, float probability);
+  void Emit(std::vector<uint8_t>& audio, int64_t captureTime, uint16_t flags, float probability,
+            const EmitFunction& emit);
+  int64_t Duration(size_t bytes) const;
+
+  bool enabled_ = false;
+  uint32_t sampleRate_ = 0;
+  uint32_t bytesPerFrame_ = 1;
+  size_t paddingBytes_ = 0;
+
+  std::deque<Held> held_;
+  size_t heldBytes_ = 0;
+  size_t tailBytes_ = 0;  // Padding still to pass after the last speech
+  bool open_ = false;
+  bool gap_ = false;      // Audio was suppressed since the last emission
+
+  uint64_t passedBytes_ = 0;
+  uint64_t suppressedBytes_ = 0;
+};
+
+}  // namespace windows_loopback_recorder
+
+#endif  // FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_VOICE_ACTIVITY_DETECTOR_H_
@@ -0,0 +1,134 @@
+#ifndef FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_WAV_FILE_SINK_H_
+#define FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_WAV_FILE_SINK_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "file_writer.h"
+#include "flac_encoder.h"
+
+namespace windows_loopback_recorder {
+
+struct WavFormat {
+  uint32_t sampleRate = 44100;
+  uint16_t channels = 2;
+  uint16_t bitsPerSample = 16;
+  bool floatSamples = false;
+
+  uint32_t blockAlign() const { return channels * ((bitsPerSample + 7) / 8); }
+};
+
+enum class FileContainer {
+  WAV = 0,   // PCM as written, RF64 past 4 GiB
+  FLAC = 1,  // Lossless, compressed on the shared worker pool
+};
+
+struct WavSinkOptions {
+  FileContainer container = FileContainer::WAV;
+  // Size of each write; the audio data starts 4 KiB into the file so every
+  // full block lands on an aligned offset.
+  size_t blockBytes = 1 << 20;
+  // Blocks available to absorb disk stalls before audio is dropped.
+  size_t blockCount = 8;
+  // How often a partially filled block and the header are committed so an
+  // interrupted recording stays playable. Zero disables checkpoints.
+  uint32_t checkpointIntervalMs = 1000;
+  // Disk space to reserve up front (file size, header included). Zero skips
+  // preallocation. Ignored for FLAC, whose final size is not known.
+  uint64_t preallocateBytes = 0;
+};
+
+struct WavSinkStats {
+  uint64_t dataBytes = 0;     // Audio bytes accepted into the file (as PCM)
+  uint64_t fileBytes = 0;     // Bytes on disk, header included
+  uint64_t droppedBytes = 0;  // Audio bytes lost to a stalled or failed disk
+  uint64_t blockWrites = 0;
+  bool rf64 = false;          // File grew past 4 GiB and uses the RF64 layout
+  bool writeError = false;
+};
+
+// Streams PCM to a WAV file from the capture thread without touching the
+// disk there: Write() copies into preallocated blocks and a writer thread
+// flushes full blocks. Files larger than 4 GiB switch to RF64 (EBU Tech 3306)
+// in place, using the JUNK chunk reserved after the RIFF header.
+//
+// With FileContainer::FLAC the writer thread feeds full blocks to a
+// FlacStreamEncoder instead and appends the frames it returns. Checkpoints
+// then commit finished frames and STREAMINFO; audio still waiting for a full
+// block is only written on Close().
+class WavFileSink {
+ public:
+  static constexpr uint64_t kDataOffset = 4096;
+
+  WavFileSink() = default;
+  ~WavFileSink();
+
+  WavFileSink(const WavFileSink&) = delete;
+  WavFileSink& operator=(const WavFileSink&) = delete;
+
+  bool Open(const std::string& path, const WavFormat& format,
+            const WavSinkOptions& options = WavSinkOptions());
+
+  // Queues |size| bytes of whole sample frames. Never blocks on I/O; if the
+  // writer has fallen too far behind the whole write is dropped.
+  void Write(const uint8_t* data, size_t size);
+
+  // Drains pending blocks, finalizes the header and closes the file.
+  bool Close();
+
+  bool isOpen() const { return writer_.isOpen(); }
+  const std::string& path() const { return path_; }
+  const WavFormat& format() const { return format_; }
+  WavSinkStats GetStats() const;
+
+ private:
+  struct Block {
+    std::vector<uint8_t> storage;
+    uint8_t* data = nullptr;  // storage aligned to kDataOffset
+    size_t size = 0;
+    uint64_t fileOffset = 0;
+  };
+
+  void WriterThreadFunction();
+  bool WriteBlock(const Block& block);
+  bool WriteHeader(uint64_t dataBytes);
+  bool WriteFlacFrames(bool finish);
+
+  FileWriter writer_;
+  std::string path_;
+  WavFormat format_;
+  WavSinkOptions options_;
+
+  std::vector<Block> blocks_;
+  std::vector<Block*> freeBlocks_;
+  std::deque<Block*> fullBlocks_;
+  Block* current_ = nullptr;
+  uint64_t nextOffset_ = kDataOffset;
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  bool closing_ = false;
+  std::thread writerThread_;
+
+  WavSinkStats stats_;
+
+  // FLAC only; used by the writer thread, then by Close() after it exits
+  std::unique_ptr<FlacStreamEncoder> flac_;
+  std::vector<uint8_t> flacFrames_;  // Frames collected for one write
+  uint64_t flacOffset_ = kDataOffset;
+};
+
+// Builds the fixed-size header that precedes the audio data. Exposed for
+// tests; |dataBytes| selects between the RIFF and RF64 layouts.
+std::vector<uint8_t> BuildWavHeader(const WavFormat& format, uint64_t dataBytes);
+
+}  // namespace windows_loopback_recorder
+
+#endif  // FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_WAV_FILE_SINK_H_
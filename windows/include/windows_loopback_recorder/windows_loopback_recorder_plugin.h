@@ -7,6 +7,7 @@
 #include <flutter/event_stream_handler_functions.h>
 #include <flutter_plugin_registrar.h>
 
+#include <chrono>
 #include <memory>
 #include <thread>
 #include <atomic>
@@ -26,8 +27,23 @@
 #include <propvarutil.h>
 #include <combaseapi.h>
 
-// libsamplerate for high-quality audio resampling
-#include <samplerate.h>
+#include "windows_loopback_recorder/audio_chunker.h"
+#include "windows_loopback_recorder/audio_engine.h"
+#include "windows_loopback_recorder/audio_meter.h"
+#include "windows_loopback_recorder/audio_packet.h"
+#include "windows_loopback_recorder/dart_native_port.h"
+#include "windows_loopback_recorder/delivery_queue.h"
+#include "windows_loopback_recorder/feature_extractor.h"
+#include "windows_loopback_recorder/flac_encoder.h"
+#include "windows_loopback_recorder/loudness_meter.h"
+#include "windows_loopback_recorder/meter_frame.h"
+#include "windows_loopback_recorder/peak_pyramid.h"
+#include "windows_loopback_recorder/pipeline_stats.h"
+#include "windows_loopback_recorder/pre_roll_buffer.h"
+#include "windows_loopback_recorder/segmented_wav_sink.h"
+#include "windows_loopback_recorder/spectrum_analyzer.h"
+#include "windows_loopback_recorder/voice_activity_detector.h"
+#include "windows_loopback_recorder/telephony_codec.h"
 
 namespace windows_loopback_recorder {
 
@@ -37,10 +53,65 @@ enum class RecordingState {
   PAUSED = 2
 };
 
+// Encoding of the audio chunks delivered to Dart.
+enum class OutputEncoding {
+  PCM = 0,        // Raw PCM of AudioConfig::bitsPerSample
+  FLAC = 1,       // A lossless FLAC stream, one frame per chunk
+  MU_LAW = 2,     // G.711 µ-law, one byte per sample
+  A_LAW = 3,      // G.711 A-law, one byte per sample
+  IMA_ADPCM = 4,  // IMA ADPCM, one self-contained block per chunk
+};
+
+// Audio between two volume stream updates, unless Dart asks otherwise
+constexpr uint32_t kDefaultMeterIntervalMs = 33;
+
+// Settings of the spectrum stream (see SpectrumAnalyzer)
+struct SpectrumOptions {
+  UINT32 intervalMs = 50;  // Audio between two updates
+  UINT32 fftSize = static_cast<UINT32>(SpectrumAnalyzer::kDefaultFftSize);
+  UINT32 bands = static_cast<UINT32>(SpectrumAnalyzer::kDefaultBands);
+  double minHz = 20.0;
+  double maxHz = 20000.0;
+};
+
+// Settings of the feature stream (see FeatureExtractor)
+struct FeatureStreamOptions {
+  FeatureOptions features;
+  UINT32 rowsPerUpdate = 10;  // 10 ms rows sent together
+};
+
 struct AudioConfig {
   UINT32 sampleRate = 44100;
   UINT32 channels = 2;
-  UINT32 bitsPerSample = 16;
+  UINT32 bitsPerSample = 16;  // 16, 24 or 32; encoded output is 16
+  // With 32 bits, IEEE float samples rather than integers
+  bool floatSamples = false;
+  // Noise added before rounding to 16 or 24 bits (see DitherMode)
+  UINT32 dither = 0;
+
+  // Output chunking (see ChunkingConfig); all zero delivers packets as-is
+  UINT32 frameDurationMs = 0;
+  UINT32 minChunkBytes = 0;
+  UINT32 maxLatencyMs = 0;
+
+  // Flow control towards Dart (see BackpressurePolicy)
+  UINT32 backpressurePolicy = 0;
+  UINT32 maxQueuedChunks = 32;
+
+  // Prepend an AudioPacketHeader to every delivered chunk
+  bool packetHeader = false;
+
+  // Encoding of delivered chunks (see OutputEncoding)
+  UINT32 encoding = 0;
+
+  // Cancel the loopback echo from the microphone (see EchoCanceller)
+  bool echoCancellation = false;
+  UINT32 echoTailMs = EchoCanceller::kDefaultTailMs;
+
+  // Suppress stationary noise per source (see NoiseSuppressor)
+  bool micNoiseSuppression = false;
+  bool systemNoiseSuppression = false;
+  UINT32 noiseSuppressionDb = static_cast<UINT32>(NoiseSuppressor::kDefaultAttenuationDb);
 };
 
 class WindowsLoopbackRecorderPlugin : public flutter::Plugin {
@@ -75,26 +146,62 @@ class WindowsLoopbackRecorderPlugin : public flutter::Plugin {
   HRESULT InitializeSystemAudioCapture();
   HRESULT InitializeMicrophoneCapture();
   void CaptureThreadFunction();
-  void MixAudioBuffers(const BYTE* systemBuffer, const BYTE* micBuffer,
-                       UINT32 systemFrames, UINT32 micFrames,
-                       std::vector<BYTE>& outputBuffer);
-
-  // Audio processing methods
-  bool InitializeResampler();
-  void CleanupResampler();
-  bool ProcessAudioFormat(std::vector<BYTE>& audioBuffer);
-  std::vector<BYTE> ResampleAudio(const std::vector<BYTE>& inputBuffer);
-  std::vector<BYTE> ConvertChannels(const std::vector<BYTE>& inputBuffer);
-  std::vector<float> ConvertToFloat(const std::vector<BYTE>& byteBuffer);
-  std::vector<BYTE> ConvertFromFloat(const std::vector<float>& floatBuffer);
+  PipelineDemand GetPipelineDemand();
+
+  // Audio processing methods. ConfigureEngine() hands the device and user
+  // formats to engine_, settling audioConfig_ to what it delivers;
+  // ReleaseEngine() undoes it.
+  bool ConfigureEngine();
+  void ReleaseEngine();
 
   // Volume monitoring methods
-  double CalculateRMS(const std::vector<BYTE>& audioBuffer);
-  double RMSToDecibels(double rms);
-  int DecibelsToPercentage(double db);
-  void SendVolumeUpdate(double rms);
-  bool StartVolumeMonitoring();
+  void SendVolumeUpdate();
+  bool StartVolumeMonitoring(uint32_t intervalMs = kDefaultMeterIntervalMs);
   bool StopVolumeMonitoring();
+  void MeterLoudness(const int16_t* samples, size_t frames, uint32_t sampleRate);
+
+  // Spectrum stream methods
+  bool StartSpectrum(const SpectrumOptions& options);
+  void StopSpectrum();
+  void AnalyzeSpectrum(const int16_t* samples, size_t frames, uint32_t sampleRate);
+
+  // Feature stream methods
+  bool StartFeatures(const FeatureStreamOptions& options);
+  void StopFeatures();
+  void ExtractFeatures(const int16_t* samples, size_t frames, uint32_t sampleRate);
+
+  // Voice activity detection methods
+  bool StartVad(const VadOptions& options);
+  void StopVad();
+  bool DetectSpeech(const BYTE* micData, UINT32 micFrames, const std::vector<BYTE>& mixedBuffer,
+                    uint32_t sampleRate);
+  void DeliverCapturedAudio(std::vector<BYTE>& audioBuffer, int64_t captureTime, uint16_t flags,
+                            float speechProbability);
+
+  // Audio delivery methods
+  bool AttachAudioPort(int64_t port, int64_t postCObjectAddress);
+  void DetachAudioPort();
+  bool DeliverAudio(DeliveryItem& item);
+  void EmitProcessedAudio(std::vector<BYTE>& audioBuffer);
+  void QueueChunk(std::vector<BYTE>& chunk, uint16_t extraFlags = 0);
+  void QueueEncodedFrame(std::vector<BYTE>& frame, uint32_t frames, uint16_t extraFlags = 0);
+  void FlushChunker();
+  void FlushEncoder();
+
+  // File recording methods
+  bool StartFileRecording(const std::string& path, const SegmentOptions& segments,
+                          FileContainer container, bool peaks);
+  bool StopFileRecording(flutter::EncodableMap& summary);
+  void SendSegmentComplete(const SegmentInfo& segment);
+  // The user's rate and layout in the delivered sample format, which the
+  // file and the pre-roll are written in
+  WavFormat RecordedWavFormat() const;
+
+  // Pre-roll methods
+  bool StartPreRoll(const PreRollOptions& options);
+  void StopPreRoll();
+  bool CreatePreRoll();
+  bool SnapshotPreRoll(uint32_t seconds, PreRollSnapshot& snapshot);
 
   // Audio capture thread management
   std::thread captureThread_;
@@ -116,17 +223,127 @@ class WindowsLoopbackRecorderPlugin : public flutter::Plugin {
   AudioConfig audioConfig_;
   AudioConfig deviceConfig_; // Store actual device format
 
-  // libsamplerate resampling configuration
-  SRC_STATE* srcState_ = nullptr;
-  bool resamplingEnabled_ = false;
+  // Echo cancellation, noise suppression, mixing, conversion and
+  // quantization of the captured packets. Configured by StartRecording and
+  // otherwise used on the capture thread only; getNoiseSuppressionStats
+  // reads its suppressors, which only change in StartRecording.
+  AudioEngine engine_;
 
   // Event stream for sending audio data to Dart
   std::unique_ptr<flutter::EventSink<flutter::EncodableValue>> eventSink_ = nullptr;
   std::mutex eventSinkMutex_;
 
+  // Optional Dart native port; when attached, audio bypasses eventSink_ and
+  // is posted straight to the owning isolate. Guarded by eventSinkMutex_.
+  std::unique_ptr<DartNativePort> audioPort_ = nullptr;
+
+  // Re-slices processed audio into fixed frames or coalesced chunks
+  AudioChunker chunker_;
+
+  // Bounds the audio waiting for a slow Dart consumer
+  DeliveryQueue deliveryQueue_;
+
+  // Stamps delivered chunks with sequence, timing and format metadata
+  AudioPacketizer packetizer_;
+
+  // Compresses delivered audio for OutputEncoding::FLAC; capture thread only.
+  // The stream header rides along with the first frame sent.
+  std::unique_ptr<FlacStreamEncoder> flacEncoder_ = nullptr;
+  bool flacHeaderSent_ = false;
+
+  // Telephony encodings. G.711 compands each chunk in place as it leaves
+  // the chunker; IMA ADPCM, like FLAC, slices the stream into its own blocks.
+  bool companding_ = false;
+  G711Law g711Law_ = G711Law::MU_LAW;
+  std::unique_ptr<ImaAdpcmEncoder> adpcmEncoder_ = nullptr;
+
+  // Native WAV/FLAC writer fed with processed audio; disk I/O happens on its
+  // own thread. Guarded by fileSinkMutex_.
+  std::unique_ptr<SegmentedWavSink> fileSink_ = nullptr;
+  std::mutex fileSinkMutex_;
+
+  // Waveform peaks of the file recording, fed with the same audio and saved
+  // next to it by StopFileRecording. The pointer is guarded by
+  // fileSinkMutex_; queryPeaks copies it and queries outside the lock.
+  std::shared_ptr<PeakPyramid> filePeaks_ = nullptr;
+
+  // Recent processed audio kept for savePreRoll/getPreRoll. Survives
+  // StopRecording so it can still be saved; recreated by StartRecording
+  // while armed. Guarded by preRollMutex_.
+  std::unique_ptr<PreRollBuffer> preRoll_ = nullptr;
+  std::mutex preRollMutex_;
+  PreRollOptions preRollOptions_;
+  bool preRollEnabled_ = false;
+
+  // Event stream for finished file segments
+  std::unique_ptr<flutter::EventSink<flutter::EncodableValue>> fileEventSink_ = nullptr;
+  std::mutex fileEventSinkMutex_;
+
+  // Counts how often each pipeline stage ran or was skipped for lack of demand
+  PipelineStats pipelineStats_;
+
   // Volume monitoring
   std::unique_ptr<flutter::EventSink<flutter::EncodableValue>> volumeEventSink_ = nullptr;
   std::mutex volumeEventSinkMutex_;
+  AudioMeter meter_;                         // Capture thread only
+  std::vector<ChannelLevels> meterLevels_;  // Levels of the current packet
+  LoudnessMeter loudness_;                   // Capture thread only
+  uint32_t loudnessRate_ = 0;                // Rate loudness_ is configured for; 0 to reconfigure
+  std::atomic<bool> loudnessResetRequested_{false};
+  LevelAccumulator meterAccumulator_;        // Levels since the last update
+  SourceLevels systemMeter_;                 // Capture thread only, fed by the mix
+  SourceLevels micMeter_;
+  std::vector<ChannelLevels> sourceLevels_;
+  LevelAccumulator systemAccumulator_;
+  LevelAccumulator micAccumulator_;
+  std::atomic<uint32_t> meterIntervalMs_{kDefaultMeterIntervalMs};
+  std::chrono::steady_clock::time_point recordingStartTime_;
+
+  // Spectrum stream. The options are guarded by spectrumMutex_ and picked up
+  // by the capture thread when spectrumReconfigure_ is set.
+  std::unique_ptr<flutter::EventSink<flutter::EncodableValue>> spectrumEventSink_ = nullptr;
+  std::mutex spectrumEventSinkMutex_;
+  std::atomic<bool> spectrumEnabled_{false};
+  std::mutex spectrumMutex_;
+  SpectrumOptions spectrumOptions_;
+  std::atomic<bool> spectrumReconfigure_{false};
+  SpectrumAnalyzer spectrum_;              // Capture thread only
+  uint32_t spectrumRate_ = 0;              // Rate spectrum_ is configured for; 0 to reconfigure
+  uint32_t spectrumIntervalMs_ = 0;
+  uint64_t spectrumPendingFrames_ = 0;     // Audio since the last update
+  std::vector<float> spectrumBands_;
+
+  // Feature stream, set up like the spectrum stream. Rows are collected in
+  // featureRows_, whose capacity is kept between updates.
+  std::unique_ptr<flutter::EventSink<flutter::EncodableValue>> featureEventSink_ = nullptr;
+  std::mutex featureEventSinkMutex_;
+  std::atomic<bool> featuresEnabled_{false};
+  std::mutex featureMutex_;
+  FeatureStreamOptions featureOptions_;
+  std::atomic<bool> featureReconfigure_{false};
+  FeatureExtractor features_;              // Capture thread only
+  uint32_t featureRate_ = 0;               // Rate features_ is configured for; 0 to reconfigure
+  uint32_t featureRowsPerUpdate_ = 0;
+  uint64_t featureFirstRow_ = 0;           // Row number of the first row in featureRows_
+  std::vector<float> featureRows_;
+
+  // Voice activity detection on the raw microphone and on the delivered mix.
+  // The options are guarded by vadMutex_ and picked up by the capture thread
+  // when vadReconfigure_ is set; the rest is capture thread only, with the
+  // results mirrored into atomics for getVadStats.
+  std::atomic<bool> vadEnabled_{false};
+  std::mutex vadMutex_;
+  VadOptions vadOptions_;
+  std::atomic<bool> vadReconfigure_{false};
+  VoiceActivityDetector micVad_;
+  VoiceActivityDetector mixVad_;
+  SpeechGate speechGate_;
+  uint32_t vadRate_ = 0;                   // Rate mixVad_ is configured for; 0 to reconfigure
+  std::atomic<float> speechProbability_{-1.0f};
+  std::atomic<float> micSpeechProbability_{-1.0f};
+  std::atomic<bool> speaking_{false};
+  std::atomic<uint64_t> vadPassedBytes_{0};
+  std::atomic<uint64_t> vadSuppressedBytes_{0};
 
   // Adaptive capture timing
   DWORD optimalSleepMs = 5; // Default fallback value
@@ -0,0 +1,46 @@
+#ifndef FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_WORKER_POOL_H_
+#define FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_WORKER_POOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace windows_loopback_recorder {
+
+// Small FIFO thread pool for CPU-heavy work that must stay off the capture
+// thread (e.g. compressing audio). Tasks run in submission order, several at
+// a time; callers that need ordered results track completion themselves.
+class WorkerPool {
+ public:
+  explicit WorkerPool(size_t threadCount);
+  // Waits for queued tasks to finish.
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  void Submit(std::function<void()> task);
+
+  size_t threadCount() const { return threads_.size(); }
+
+  // Process-wide pool shared by every recording session, sized to leave a
+  // core for capture: one thread per spare core, at most four.
+  static WorkerPool& Shared();
+
+ private:
+  void WorkerThreadFunction();
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::deque<std::function<void()>> tasks_;
+  bool stopping_ = false;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace windows_loopback_recorder
+
+#endif  // FLUTTER_PLUGIN_WINDOWS_LOOPBACK_RECORDER_WORKER_POOL_H_
@@ -0,0 +1,209 @@
+#include "windows_loopback_recorder/loudness_meter.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace windows_loopback_recorder {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+double ToLufs(double energy) {
+  return energy > 0.0 ? -0.691 + 10.0 * std::log10(energy)
+                      : -std::numeric_limits<double>::infinity();
+}
+
+}  // namespace
+
+bool LoudnessMeter::Configure(uint32_t sampleRate, uint16_t channels) {
+  if (sampleRate < 8000 || channels == 0) {
+    channels_ = 0;
+    return false;
+  }
+  sampleRate_ = sampleRate;
+  channels_ = channels;
+  subBlockFrames_ = (sampleRate + 5) / 10;
+
+  // K-weighting: the BS.1770 high-shelf "head" filter and the RLB high-pass,
+  // derived for this rate from their analog prototypes
+  double f0 = 1681.974450955533;
+  double gain = 3.999843853973347;
+  double q = 0.7071752369554196;
+  double k = std::tan(kPi * f0 / sampleRate);
+  double vh = std::pow(10.0, gain / 20.0);
+  double vb = std::pow(vh, 0.4996667741545416);
+  double a0 = 1.0 + k / q + k * k;
+  shelf_.b0 = (vh + vb * k / q + k * k) / a0;
+  shelf_.b1 = 2.0 * (k * k - vh) / a0;
+  shelf_.b2 = (vh - vb * k / q + k * k) / a0;
+  shelf_.a1 = 2.0 * (k * k - 1.0) / a0;
+  shelf_.a2 = (1.0 - k / q + k * k) / a0;
+
+  f0 = 38.13547087602444;
+  q = 0.5003270373238773;
+  k = std::tan(kPi * f0 / sampleRate);
+  a0 = 1.0 + k / q + k * k;
+  highPass_.b0 = 1.0;
+  highPass_.b1 = -2.0;
+  highPass_.b2 = 1.0;
+  highPass_.a1 = 2.0 * (k * k - 1.0) / a0;
+  highPass_.a2 = (1.0 - k / q + k * k) / a0;
+
+  weights_.resize(channels);
+  for (uint16_t c = 0; c < channels; c++) {
+    weights_[c] = ChannelWeight(c, channels);
+  }
+  Reset();
+  return true;
+}
+
+void LoudnessMeter::Reset() {
+  state_.assign(channels_ * 4, 0.0);
+  squares_.assign(channels_, 0.0);
+  subBlockFilled_ = 0;
+  std::fill(std::begin(ring_), std::end(ring_), 0.0);
+  ringHead_ = 0;
+  subBlocks_ = 0;
+  binCounts_.assign(kHistogramBins + 1, 0);
+  binEnergies_.assign(kHistogramBins + 1, 0.0);
+  gatedCount_ = 0;
+  gatedEnergy_ = 0.0;
+}
+
+void LoudnessMeter::Process(const int16_t* samples, size_t frames) {
+  if (channels_ == 0) {
+    return;
+  }
+  while (frames > 0) {
+    size_t count = std::min<size_t>(frames, subBlockFrames_ - subBlockFilled_);
+    for (uint16_t c = 0; c < channels_; c++) {
+      if (weights_[c] == 0.0) {
+        continue;
+      }
+      // Both biquads in transposed direct form II, states kept in registers
+      double* z = &state_[c * 4];
+      double s1 = z[0], s2 = z[1], h1 = z[2], h2 = z[3];
+      double sum = 0.0;
+      const int16_t* in = samples + c;
+      for (size_t i = 0; i < count; i++) {
+        double x = in[i * channels_] * (1.0 / 32768.0);
+        double y = shelf_.b0 * x + s1;
+        s1 = shelf_.b1 * x - shelf_.a1 * y + s2;
+        s2 = shelf_.b2 * x - shelf_.a2 * y;
+        double w = highPass_.b0 * y + h1;
+        h1 = highPass_.b1 * y - highPass_.a1 * w + h2;
+        h2 = highPass_.b2 * y - highPass_.a2 * w;
+        sum += w * w;
+      }
+      z[0] = s1;
+      z[1] = s2;
+      z[2] = h1;
+      z[3] = h2;
+      squares_[c] += sum;
+    }
+    samples += count * channels_;
+    frames -= count;
+    subBlockFilled_ += static_cast<uint32_t>(count);
+    if (subBlockFilled_ == subBlockFrames_) {
+      FinishSubBlock();
+    }
+  }
+}
+
+void LoudnessMeter::FinishSubBlock() {
+  double energy = 0.0;
+  for (uint16_t c = 0; c < channels_; c++) {
+    energy += weights_[c] * squares_[c] / subBlockFrames_;
+    squares_[c] = 0.0;
+  }
+  // Let the filters settle to zero in silence rather than into denormals
+  for (double& value : state_) {
+    if (std::fabs(value) < 1e-30) {
+      value = 0.0;
+    }
+  }
+  subBlockFilled_ = 0;
+
+  ring_[ringHead_] = energy;
+  ringHead_ = (ringHead_ + 1) % kShortTermBlocks;
+  subBlocks_++;
+  if (subBlocks_ >= kMomentaryBlocks) {
+    AddGatingBlock(WindowEnergy(kMomentaryBlocks));
+  }
+}
+
+void LoudnessMeter::AddGatingBlock(double energy) {
+  double lufs = ToLufs(energy);
+  if (!(lufs >= kAbsoluteGate)) {
+    return;
+  }
+  size_t bin = std::min(kHistogramBins - 1, static_cast<size_t>((lufs - kAbsoluteGate) * 10.0));
+  HistogramAdd(bin, energy);
+  gatedCount_++;
+  gatedEnergy_ += energy;
+}
+
+double LoudnessMeter::WindowEnergy(size_t blocks) const {
+  double sum = 0.0;
+  for (size_t i = 1; i <= blocks; i++) {
+    sum += ring_[(ringHead_ + kShortTermBlocks - i) % kShortTermBlocks];
+  }
+  return sum / blocks;
+}
+
+void LoudnessMeter::HistogramAdd(size_t bin, double energy) {
+  for (size_t i = bin + 1; i <= kHistogramBins; i += i & (~i + 1)) {
+    binCounts_[i]++;
+    binEnergies_[i] += energy;
+  }
+}
+
+void LoudnessMeter::HistogramPrefix(size_t bins, uint64_t& count, double& energy) const {
+  count = 0;
+  energy = 0.0;
+  for (size_t i = bins; i > 0; i -= i & (~i + 1)) {
+    count += binCounts_[i];
+    energy += binEnergies_[i];
+  }
+}
+
+LoudnessReading LoudnessMeter::reading() const {
+  LoudnessReading reading;
+  if (subBlocks_ >= kMomentaryBlocks) {
+    reading.momentary = ToLufs(WindowEnergy(kMomentaryBlocks));
+  }
+  if (subBlocks_ >= kShortTermBlocks) {
+    reading.shortTerm = ToLufs(WindowEnergy(kShortTermBlocks));
+  }
+  if (gatedCount_ == 0) {
+    return reading;
+  }
+
+  // Relative gate: 10 LU below the mean of the blocks past the absolute
+  // gate. Blocks in bins at or above the gate's bin count, the others don't.
+  double gate = ToLufs(gatedEnergy_ / gatedCount_) + kRelativeGate;
+  double gateBin = std::floor((gate - kAbsoluteGate) * 10.0);
+  size_t below = static_cast<size_t>(std::clamp(gateBin, 0.0, static_cast<double>(kHistogramBins)));
+  uint64_t belowCount = 0;
+  double belowEnergy = 0.0;
+  HistogramPrefix(below, belowCount, belowEnergy);
+  uint64_t count = gatedCount_ - belowCount;
+  if (count > 0) {
+    reading.integrated = ToLufs(std::max(0.0, gatedEnergy_ - belowEnergy) / count);
+  }
+  return reading;
+}
+
+double LoudnessMeter::ChannelWeight(uint16_t channel, uint16_t channels) {
+  // L R C LFE Ls Rs (5.1) and L R C Ls Rs (5.0); other layouts weigh evenly
+  if (channels == 6) {
+    return channel == 3 ? 0.0 : channel >= 4 ? 1.41 : 1.0;
+  }
+  if (channels == 5) {
+    return channel >= 3 ? 1.41 : 1.0;
+  }
+  return 1.0;
+}
+
+}  // namespace windows_loopback_recorder
@@ -0,0 +1,81 @@
+#include "windows_loopback_recorder/meter_frame.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace windows_loopback_recorder {
+
+void LevelAccumulator::Add(const std::vector<ChannelLevels>& levels, size_t frames) {
+  if (frames == 0) {
+    return;
+  }
+  if (squares_.size() != levels.size()) {
+    // Layout changed: start over with it
+    squares_.assign(levels.size(), 0.0);
+    peak_.assign(levels.size(), 0.0f);
+    truePeak_.assign(levels.size(), 0.0f);
+    frames_ = 0;
+  }
+  for (size_t c = 0; c < levels.size(); c++) {
+    squares_[c] += static_cast<double>(levels[c].rms) * levels[c].rms * frames;
+    peak_[c] = std::max(peak_[c], levels[c].peak);
+    truePeak_[c] = std::max(truePeak_[c], levels[c].truePeak);
+  }
+  frames_ += frames;
+}
+
+void LevelAccumulator::Take(std::vector<ChannelLevels>& levels) {
+  levels.resize(squares_.size());
+  for (size_t c = 0; c < squares_.size(); c++) {
+    levels[c].rms = frames_ > 0 ? static_cast<float>(std::sqrt(squares_[c] / frames_)) : 0.0f;
+    levels[c].peak = peak_[c];
+    levels[c].truePeak = truePeak_[c];
+  }
+  Clear();
+}
+
+void LevelAccumulator::Clear() {
+  std::fill(squares_.begin(), squares_.end(), 0.0);
+  std::fill(peak_.begin(), peak_.end(), 0.0f);
+  std::fill(truePeak_.begin(), truePeak_.end(), 0.0f);
+  frames_ = 0;
+}
+
+std::vector<float> BuildMeterFrame(double elapsedMs, const ChannelLevels& combined,
+                                   const LoudnessReading& loudness,
+                                   const std::vector<ChannelLevels>& channels,
+                                   const std::vector<ChannelLevels>& systemChannels,
+                                   const std::vector<ChannelLevels>& micChannels) {
+  const std::vector<ChannelLevels> sources = {AudioMeter::Combine(systemChannels),
+                                              AudioMeter::Combine(micChannels)};
+  static_assert(kMeterFrameSources == 2, "system and microphone");
+  size_t triples = channels.size() + sources.size() + systemChannels.size() + micChannels.size();
+  std::vector<float> frame(METER_FRAME_FIELDS + triples * kMeterFrameStride);
+  frame[METER_FRAME_HEADER_SIZE] = static_cast<float>(METER_FRAME_FIELDS);
+  frame[METER_FRAME_VERSION] = kMeterFrameVersion;
+  frame[METER_FRAME_ELAPSED_MS] = static_cast<float>(elapsedMs);
+  frame[METER_FRAME_RMS] = combined.rms;
+  frame[METER_FRAME_PEAK] = combined.peak;
+  frame[METER_FRAME_TRUE_PEAK] = combined.truePeak;
+  frame[METER_FRAME_MOMENTARY_LUFS] = static_cast<float>(loudness.momentary);
+  frame[METER_FRAME_SHORT_TERM_LUFS] = static_cast<float>(loudness.shortTerm);
+  frame[METER_FRAME_INTEGRATED_LUFS] = static_cast<float>(loudness.integrated);
+  frame[METER_FRAME_CHANNELS] = static_cast<float>(channels.size());
+  frame[METER_FRAME_SOURCES] = static_cast<float>(sources.size());
+  frame[METER_FRAME_SYSTEM_CHANNELS] = static_cast<float>(systemChannels.size());
+  frame[METER_FRAME_MIC_CHANNELS] = static_cast<float>(micChannels.size());
+
+  float* triple = &frame[METER_FRAME_FIELDS];
+  const std::vector<ChannelLevels>* sections[] = {&channels, &sources, &systemChannels, &micChannels};
+  for (const std::vector<ChannelLevels>* section : sections) {
+    for (const ChannelLevels& levels : *section) {
+      triple[0] = levels.rms;
+      triple[1] = levels.peak;
+      triple[2] = levels.truePeak;
+      triple += kMeterFrameStride;
+    }
+  }
+  return frame;
+}
+
+}  // namespace windows_loopback_recorder
@@ -0,0 +1,215 @@
+#include "windows_loopback_recorder/noise_suppressor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace windows_loopback_recorder {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Frame of at least 10 ms, rounded up to a power of two
+constexpr uint32_t kFrameMs = 10;
+// The noise floor is the minimum over this long, in kSubWindows pieces
+constexpr uint32_t kMinimumWindowMs = 1500;
+constexpr size_t kSubWindows = 8;
+// Weight of the previous frames in the smoothed power
+constexpr float kPowerSmoothing = 0.7f;
+// The minimum of a smoothed power sits below its mean; this puts it back
+constexpr float kMinimumBias = 2.5f;
+// Weight of the previous frame in the decision-directed a priori SNR
+constexpr float kDecisionDirected = 0.98f;
+
+inline float ToFloat(int16_t sample) { return sample * (1.0f / 32768.0f); }
+inline float ToFloat(float sample) { return sample; }
+
+inline void FromFloat(float value, int16_t& sample) {
+  float scaled = std::round(value * 32768.0f);
+  sample = static_cast<int16_t>(std::clamp(scaled, -32768.0f, 32767.0f));
+}
+inline void FromFloat(float value, float& sample) { sample = value; }
+
+}  // namespace
+
+bool NoiseSuppressor::Configure(uint32_t sampleRate, uint16_t channels, float maxAttenuationDb,
+                                std::shared_ptr<RealFft> fft) {
+  fft_.reset();
+  if (sampleRate < 8000 || channels == 0 || !(maxAttenuationDb > 0.0f) ||
+      maxAttenuationDb > kMaxAttenuationDb) {
+    return false;
+  }
+  sampleRate_ = sampleRate;
+  channels_ = channels;
+  gainFloor_ = std::pow(10.0f, -maxAttenuationDb / 20.0f);
+
+  frameSize_ = RealFft::kMinSize;
+  while (frameSize_ < static_cast<size_t>(sampleRate) * kFrameMs / 1000) {
+    frameSize_ *= 2;
+  }
+  hop_ = frameSize_ / 2;
+  bins_ = frameSize_ / 2 + 1;
+  fft_ = fft && fft->size() == frameSize_ ? std::move(fft) : std::make_shared<RealFft>(frameSize_);
+
+  // sin(pi n / N) squared sums to one over two frames half a frame apart
+  window_.resize(frameSize_);
+  for (size_t n = 0; n < frameSize_; n++) {
+    window_[n] = static_cast<float>(std::sin(kPi * n / frameSize_));
+  }
+  size_t windowFrames = static_cast<size_t>(sampleRate) * kMinimumWindowMs / 1000 / hop_;
+  subFrames_ = std::max<size_t>(1, windowFrames / kSubWindows);
+
+  input_.resize(frameSize_ * channels);
+  overlap_.resize(hop_ * channels);
+  output_.resize(hop_ * channels);
+  time_.resize(frameSize_);
+  re_.resize(bins_ * channels);
+  im_.resize(bins_ * channels);
+  power_.resize(bins_);
+  smoothed_.resize(bins_);
+  subMinimum_.resize(bins_);
+  minima_.resize(bins_ * kSubWindows);
+  noise_.resize(bins_);
+  gain_.resize(bins_);
+  lastSnr_.resize(bins_);
+  Reset();
+  return true;
+}
+
+void NoiseSuppressor::Reset() {
+  filled_ = 0;
+  std::fill(input_.begin(), input_.end(), 0.0f);
+  std::fill(overlap_.begin(), overlap_.end(), 0.0f);
+  std::fill(output_.begin(), output_.end(), 0.0f);
+  std::fill(gain_.begin(), gain_.end(), 1.0f);
+  std::fill(lastSnr_.begin(), lastSnr_.end(), 1.0f);
+  subFrame_ = 0;
+  subWindow_ = 0;
+  primed_ = false;
+  noiseDb_ = -120.0f;
+}
+
+void NoiseSuppressor::Process(const int16_t* in, int16_t* out, size_t frames) {
+  ProcessFrames(in, out, frames);
+}
+
+void NoiseSuppressor::Process(const float* in, float* out, size_t frames) {
+  ProcessFrames(in, out, frames);
+}
+
+template <typename Sample>
+void NoiseSuppressor::ProcessFrames(const Sample* in, Sample* out, size_t frames) {
+  if (!fft_) {
+    if (out != in) {
+      std::copy(in, in + frames * channels_, out);
+    }
+    return;
+  }
+  for (size_t i = 0; i < frames; i++) {
+    // The input is read before the delayed output overwrites it
+    for (uint16_t c = 0; c < channels_; c++) {
+      input_[c * frameSize_ + hop_ + filled_] = ToFloat(in[c]);
+    }
+    const float* suppressed = &output_[filled_ * channels_];
+    for (uint16_t c = 0; c < channels_; c++) {
+      FromFloat(suppressed[c], out[c]);
+    }
+    in += channels_;
+    out += channels_;
+
+    if (++filled_ == hop_) {
+      ProcessFrame();
+      filled_ = 0;
+    }
+  }
+}
+
+void NoiseSuppressor::ProcessFrame() {
+  // Spectra of every channel and their average power
+  std::fill(power_.begin(), power_.end(), 0.0f);
+  float channelScale = 1.0f / channels_;
+  for (uint16_t c = 0; c < channels_; c++) {
+    float* samples = &input_[c * frameSize_];
+    for (size_t n = 0; n < frameSize_; n++) {
+      time_[n] = samples[n] * window_[n];
+    }
+    // The newer half is the older half of the next frame
+    std::copy(samples + hop_, samples + frameSize_, samples);
+
+    float* re = &re_[c * bins_];
+    float* im = &im_[c * bins_];
+    fft_->Forward(time_.data(), re, im);
+    for (size_t k = 0; k < bins_; k++) {
+      power_[k] += (re[k] * re[k] + im[k] * im[k]) * channelScale;
+    }
+  }
+
+  TrackNoise();
+
+  // Wiener gain from the decision-directed a priori SNR
+  for (size_t k = 0; k < bins_; k++) {
+    float snr = power_[k] / (noise_[k] + std::numeric_limits<float>::min());
+    float prior = kDecisionDirected * gain_[k] * gain_[k] * lastSnr_[k] +
+                  (1.0f - kDecisionDirected) * std::max(snr - 1.0f, 0.0f);
+    gain_[k] = std::max(prior / (1.0f + prior), gainFloor_);
+    lastSnr_[k] = snr;
+  }
+
+  // Back to the time domain; the first half completes the pending hop
+  for (uint16_t c = 0; c < channels_; c++) {
+    float* re = &re_[c * bins_];
+    float* im = &im_[c * bins_];
+    for (size_t k = 0; k < bins_; k++) {
+      re[k] *= gain_[k];
+      im[k] *= gain_[k];
+    }
+    fft_->Inverse(re, im, time_.data());
+    float* overlap = &overlap_[c * hop_];
+    for (size_t n = 0; n < hop_; n++) {
+      output_[n * channels_ + c] = overlap[n] + time_[n] * window_[n];
+      overlap[n] = time_[hop_ + n] * window_[hop_ + n];
+    }
+  }
+}
+
+void NoiseSuppressor::TrackNoise() {
+  if (!primed_) {
+    std::copy(power_.begin(), power_.end(), smoothed_.begin());
+    std::copy(power_.begin(), power_.end(), subMinimum_.begin());
+    for (size_t w = 0; w < kSubWindows; w++) {
+      std::copy(power_.begin(), power_.end(), minima_.begin() + w * bins_);
+    }
+    primed_ = true;
+  }
+
+  for (size_t k = 0; k < bins_; k++) {
+    smoothed_[k] = kPowerSmoothing * smoothed_[k] + (1.0f - kPowerSmoothing) * power_[k];
+    subMinimum_[k] = std::min(subMinimum_[k], smoothed_[k]);
+  }
+
+  // A full sub-window replaces the oldest minimum
+  if (++subFrame_ == subFrames_) {
+    std::copy(subMinimum_.begin(), subMinimum_.end(), minima_.begin() + subWindow_ * bins_);
+    std::copy(smoothed_.begin(), smoothed_.end(), subMinimum_.begin());
+    subWindow_ = (subWindow_ + 1) % kSubWindows;
+    subFrame_ = 0;
+  }
+
+  double total = 0.0;
+  for (size_t k = 0; k < bins_; k++) {
+    float minimum = subMinimum_[k];
+    for (size_t w = 0; w < kSubWindows; w++) {
+      minimum = std::min(minimum, minima_[w * bins_ + k]);
+    }
+    noise_[k] = kMinimumBias * minimum;
+    total += noise_[k];
+  }
+
+  // One-sided bins of a window whose squares sum to N / 2: white noise of
+  // variance s^2 sums to about s^2 N^2 / 4
+  double variance = total * 4.0 / (static_cast<double>(frameSize_) * frameSize_);
+  noiseDb_ = static_cast<float>(std::max(-120.0, 10.0 * std::log10(variance + 1e-12)));
+}
+
+}  // namespace windows_loopback_recorder
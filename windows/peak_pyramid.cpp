@@ -0,0 +1,376 @@
+#include "windows_loopback_recorder/peak_pyramid.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "windows_loopback_recorder/file_writer.h"
+
+namespace windows_loopback_recorder {
+
+namespace {
+
+// "WLPK", then the version
+constexpr uint32_t kMagic = 0x4B504C57;
+constexpr uint16_t kVersion = 1;
+// magic, version, channels, sampleRate, baseFrames, fanout, levels, frames,
+// then the bucket count of each level
+constexpr size_t kHeaderBytes = 32 + 8 * PeakPyramid::kLevels;
+// Values per bucket and channel: min, max, rms
+constexpr size_t kValues = 3;
+// Bytes of bucket data written at a time by Save()
+constexpr size_t kWriteBytes = 1 << 16;
+
+void PutLE(std::vector<uint8_t>& buffer, size_t offset, uint64_t value, size_t bytes) {
+  for (size_t i = 0; i < bytes; i++) {
+    buffer[offset + i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+}
+
+uint64_t GetLE(const uint8_t* data, size_t bytes) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < bytes; i++) {
+    value |= static_cast<uint64_t>(data[i]) << (8 * i);
+  }
+  return value;
+}
+
+// Min, max and energy of the frames a column covers, per channel
+struct ColumnAccumulator {
+  std::vector<float> min;
+  std::vector<float> max;
+  std::vector<double> energy;
+  uint64_t frames = 0;
+
+  explicit ColumnAccumulator(uint16_t channels)
+      : min(channels, 0.0f), max(channels, 0.0f), energy(channels, 0.0) {}
+
+  void Clear() {
+    std::fill(min.begin(), min.end(), 0.0f);
+    std::fill(max.begin(), max.end(), 0.0f);
+    std::fill(energy.begin(), energy.end(), 0.0);
+    frames = 0;
+  }
+
+  // |get(i)| returns value i of the bucket: channel * kValues + {0, 1, 2}
+  template <typename Get>
+  void Add(const Get& get, uint64_t bucketFrames) {
+    for (size_t c = 0; c < min.size(); c++) {
+      float low = get(c * kValues) / 32768.0f;
+      float high = get(c * kValues + 1) / 32768.0f;
+      float rms = get(c * kValues + 2) / 32768.0f;
+      min[c] = frames == 0 ? low : std::min(min[c], low);
+      max[c] = frames == 0 ? high : std::max(max[c], high);
+      energy[c] += static_cast<double>(rms) * rms * bucketFrames;
+    }
+    frames += bucketFrames;
+  }
+
+  void Emit(std::vector<float>& out) const {
+    for (size_t c = 0; c < min.size(); c++) {
+      out.push_back(min[c]);
+      out.push_back(max[c]);
+      out.push_back(frames > 0 ? static_cast<float>(std::sqrt(energy[c] / frames)) : 0.0f);
+    }
+  }
+};
+
+// Frames in bucket |bucket| of a level of |frames| frames: all of
+// |bucketFrames| but for the partial tail bucket Save() writes at the end
+uint64_t FramesIn(uint64_t bucket, uint64_t bucketFrames, uint64_t frames) {
+  uint64_t start = bucket * bucketFrames;
+  return start < frames ? std::min(bucketFrames, frames - start) : 0;
+}
+
+// The coarsest level with at least one whole bucket per column
+size_t LevelFor(uint64_t frames, size_t columns) {
+  size_t level = 0;
+  while (level + 1 < PeakPyramid::kLevels &&
+         PeakPyramid::BucketFrames(level + 1) * columns <= frames) {
+    level++;
+  }
+  return level;
+}
+
+// Splits [first, end) into |columns| columns and has |add| fold the buckets
+// of each into the accumulator
+template <typename AddRange>
+void BuildColumns(uint64_t first, uint64_t end, size_t columns, uint16_t channels, const AddRange& add,
+                  std::vector<float>& out) {
+  ColumnAccumulator column(channels);
+  out.clear();
+  out.reserve(columns * channels * kValues);
+  uint64_t range = end - first;
+  for (size_t i = 0; i < columns; i++) {
+    uint64_t a = first + range * i / columns;
+    uint64_t b = std::max(a + 1, first + range * (i + 1) / columns);
+    column.Clear();
+    add(a, b, column);
+    column.Emit(out);
+  }
+}
+
+}  // namespace
+
+bool PeakPyramid::Configure(uint32_t sampleRate, uint16_t channels) {
+  if (channels == 0) {
+    return false;
+  }
+  sampleRate_ = sampleRate;
+  channels_ = channels;
+  for (auto& partials : partials_) {
+    partials.assign(channels, Partial());
+  }
+  Reset();
+  return true;
+}
+
+void PeakPyramid::Reset() {
+  for (size_t level = 0; level < kLevels; level++) {
+    partialFrames_[level] = 0;
+  }
+  pushedFrames_ = 0;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& level : levels_) {
+    level.clear();
+  }
+}
+
+void PeakPyramid::Push(const int16_t* samples, size_t frames) {
+  if (channels_ == 0) {
+    return;
+  }
+  std::vector<Partial>& partials = partials_[0];
+  for (size_t i = 0; i < frames; i++) {
+    bool first = partialFrames_[0] == 0;
+    for (uint16_t c = 0; c < channels_; c++) {
+      int16_t sample = samples[c];
+      Partial& partial = partials[c];
+      partial.min = first ? sample : std::min(partial.min, sample);
+      partial.max = first ? sample : std::max(partial.max, sample);
+      partial.energy += static_cast<double>(sample) * sample;
+    }
+    samples += channels_;
+    if (++partialFrames_[0] == kBaseFrames) {
+      FinishBucket(0);
+    }
+  }
+  pushedFrames_ += frames;
+}
+
+void PeakPyramid::FinishBucket(size_t level) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Store(partials_[level].data(), partialFrames_[level], levels_[level]);
+  }
+  if (level + 1 < kLevels) {
+    Merge(partials_[level + 1], partialFrames_[level + 1] == 0, partials_[level].data());
+    partialFrames_[level + 1] += partialFrames_[level];
+    if (partialFrames_[level + 1] == BucketFrames(level + 1)) {
+      FinishBucket(level + 1);
+    }
+  }
+  for (Partial& partial : partials_[level]) {
+    partial = Partial();
+  }
+  partialFrames_[level] = 0;
+}
+
+void PeakPyramid::Merge(std::vector<Partial>& into, bool first, const Partial* buckets) const {
+  for (uint16_t c = 0; c < channels_; c++) {
+    Partial& partial = into[c];
+    partial.min = first ? buckets[c].min : std::min(partial.min, buckets[c].min);
+    partial.max = first ? buckets[c].max : std::max(partial.max, buckets[c].max);
+    partial.energy += buckets[c].energy;
+  }
+}
+
+void PeakPyramid::Store(const Partial* buckets, uint64_t frames, std::deque<int16_t>& out) const {
+  for (uint16_t c = 0; c < channels_; c++) {
+    double rms = frames > 0 ? std::sqrt(buckets[c].energy / frames) : 0.0;
+    out.push_back(buckets[c].min);
+    out.push_back(buckets[c].max);
+    out.push_back(static_cast<int16_t>(std::min(32767.0, std::round(rms))));
+  }
+}
+
+uint64_t PeakPyramid::frames() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return channels_ > 0 ? levels_[0].size() / (channels_ * kValues) * kBaseFrames : 0;
+}
+
+bool PeakPyramid::Query(uint64_t first, uint64_t end, size_t columns, PeakColumns& result) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t stride = channels_ * kValues;
+  uint64_t covered = stride > 0 ? levels_[0].size() / stride * kBaseFrames : 0;
+  end = std::min(end, covered);
+  if (columns == 0 || first >= end) {
+    return false;
+  }
+
+  size_t level = LevelFor(end - first, columns);
+  result.sampleRate = sampleRate_;
+  result.channels = channels_;
+  result.frames = covered;
+  result.bucketFrames = static_cast<uint32_t>(BucketFrames(level));
+  result.columns = columns;
+
+  // A coarse level lags the finer ones by up to one bucket; the end of a
+  // column it does not cover yet is read from the level below. Only
+  // finished, full buckets are held here.
+  auto addRange = [&](uint64_t a, uint64_t b, ColumnAccumulator& column) {
+    for (size_t l = level + 1; l-- > 0;) {
+      uint64_t bucketFrames = BucketFrames(l);
+      const std::deque<int16_t>& store = levels_[l];
+      uint64_t count = store.size() / stride;
+      uint64_t last = std::min<uint64_t>((b + bucketFrames - 1) / bucketFrames, count);
+      for (uint64_t bucket = a / bucketFrames; bucket < last; bucket++) {
+        size_t base = static_cast<size_t>(bucket * stride);
+        column.Add([&](size_t i) { return store[base + i]; }, bucketFrames);
+      }
+      uint64_t available = count * bucketFrames;
+      if (b <= available) {
+        break;
+      }
+      a = std::max(a, available);
+    }
+  };
+  BuildColumns(first, end, columns, channels_, addRange, result.values);
+  return true;
+}
+
+bool PeakPyramid::Save(const std::string& path) const {
+  if (channels_ == 0) {
+    return false;
+  }
+
+  // Finished buckets plus a last one per level for the frames after them;
+  // what a level has not finished is not in the level above yet either
+  size_t stride = channels_ * kValues;
+  std::deque<int16_t> tails[kLevels];
+  std::vector<Partial> carry;
+  uint64_t carryFrames = 0;
+  for (size_t level = 0; level < kLevels; level++) {
+    std::vector<Partial> tail = partials_[level];
+    uint64_t tailFrames = partialFrames_[level];
+    if (carryFrames > 0) {
+      Merge(tail, tailFrames == 0, carry.data());
+      tailFrames += carryFrames;
+    }
+    if (tailFrames > 0) {
+      Store(tail.data(), tailFrames, tails[level]);
+    }
+    carry = std::move(tail);
+    carryFrames = tailFrames;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<uint8_t> header(kHeaderBytes, 0);
+  PutLE(header, 0, kMagic, 4);
+  PutLE(header, 4, kVersion, 2);
+  PutLE(header, 6, channels_, 2);
+  PutLE(header, 8, sampleRate_, 4);
+  PutLE(header, 12, kBaseFrames, 4);
+  PutLE(header, 16, kFanout, 4);
+  PutLE(header, 20, kLevels, 4);
+  PutLE(header, 24, pushedFrames_, 8);
+  for (size_t level = 0; level < kLevels; level++) {
+    PutLE(header, 32 + 8 * level, (levels_[level].size() + tails[level].size()) / stride, 8);
+  }
+
+  FileWriter writer;
+  if (!writer.Open(path)) {
+    return false;
+  }
+  bool ok = writer.WriteAt(0, header.data(), header.size());
+  uint64_t offset = header.size();
+  std::vector<uint8_t> buffer;
+  buffer.reserve(kWriteBytes);
+  auto flush = [&]() {
+    ok = ok && writer.WriteAt(offset, buffer.data(), buffer.size());
+    offset += buffer.size();
+    buffer.clear();
+  };
+  for (size_t level = 0; level < kLevels; level++) {
+    const std::deque<int16_t>* stores[] = {&levels_[level], &tails[level]};
+    for (const std::deque<int16_t>* store : stores) {
+      for (int16_t value : *store) {
+        buffer.push_back(static_cast<uint8_t>(value & 0xFF));
+        buffer.push_back(static_cast<uint8_t>((value >> 8) & 0xFF));
+        if (buffer.size() >= kWriteBytes) {
+          flush();
+        }
+      }
+    }
+  }
+  flush();
+  writer.Close();
+
+  if (!ok) {
+    FileWriter::Remove(path);
+  }
+  return ok;
+}
+
+bool PeakPyramid::QueryFile(const std::string& path, uint64_t first, uint64_t end, size_t columns,
+                            PeakColumns& result) {
+  FileReader reader;
+  uint8_t header[kHeaderBytes];
+  if (!reader.Open(path) || !reader.ReadAt(0, header, sizeof(header)) ||
+      GetLE(header, 4) != kMagic || GetLE(header + 4, 2) != kVersion ||
+      GetLE(header + 12, 4) != kBaseFrames || GetLE(header + 16, 4) != kFanout ||
+      GetLE(header + 20, 4) != kLevels) {
+    return false;
+  }
+  uint16_t channels = static_cast<uint16_t>(GetLE(header + 6, 2));
+  uint64_t frames = GetLE(header + 24, 8);
+  uint64_t counts[kLevels];
+  for (size_t level = 0; level < kLevels; level++) {
+    counts[level] = GetLE(header + 32 + 8 * level, 8);
+  }
+
+  end = std::min(end, frames);
+  if (channels == 0 || columns == 0 || first >= end) {
+    return false;
+  }
+
+  // Every level covers the whole file, so one contiguous read of the chosen
+  // level serves all columns
+  size_t level = LevelFor(end - first, columns);
+  uint64_t bucketFrames = BucketFrames(level);
+  size_t stride = channels * kValues;
+  uint64_t levelOffset = kHeaderBytes;
+  for (size_t l = 0; l < level; l++) {
+    levelOffset += counts[l] * stride * 2;
+  }
+  uint64_t firstBucket = first / bucketFrames;
+  uint64_t lastBucket = std::min((end + bucketFrames - 1) / bucketFrames, counts[level]);
+  if (firstBucket >= lastBucket) {
+    return false;
+  }
+  std::vector<uint8_t> bytes(static_cast<size_t>((lastBucket - firstBucket) * stride * 2));
+  if (!reader.ReadAt(levelOffset + firstBucket * stride * 2, bytes.data(), bytes.size())) {
+    return false;
+  }
+
+  result.sampleRate = static_cast<uint32_t>(GetLE(header + 8, 4));
+  result.channels = channels;
+  result.frames = frames;
+  result.bucketFrames = static_cast<uint32_t>(bucketFrames);
+  result.columns = columns;
+  auto addRange = [&](uint64_t a, uint64_t b, ColumnAccumulator& column) {
+    uint64_t last = std::min((b + bucketFrames - 1) / bucketFrames, lastBucket);
+    for (uint64_t bucket = a / bucketFrames; bucket < last; bucket++) {
+      const uint8_t* values = &bytes[static_cast<size_t>((bucket - firstBucket) * stride * 2)];
+      column.Add([&](size_t i) { return static_cast<int16_t>(GetLE(values + 2 * i, 2)); },
+                 FramesIn(bucket, bucketFrames, frames));
+    }
+  };
+  BuildColumns(first, end, columns, channels, addRange, result.values);
+  return true;
+}
+
+std::string PeakPyramid::PathFor(const std::string& audioPath) {
+  return audioPath + ".peaks";
+}
+
+}  // namespace windows_loopback_recorder
@@ -0,0 +1,235 @@
+#include "windows_loopback_recorder/pre_roll_buffer.h"
+
+#include <algorithm>
+
+#include "windows_loopback_recorder/file_writer.h"
+
+namespace windows_loopback_recorder {
+
+namespace {
+
+// PCM is held in blocks of this duration; snapshots copy at most one
+constexpr uint32_t kPcmBlockMs = 100;
+
+// Spare PCM blocks kept for reuse after eviction
+constexpr size_t kMaxSpares = 2;
+
+FlacEncoderConfig FlacConfigFor(const WavFormat& format) {
+  FlacEncoderConfig config;
+  config.sampleRate = format.sampleRate;
+  config.channels = format.channels;
+  config.bitsPerSample = format.bitsPerSample;
+  return config;
+}
+
+std::vector<uint8_t> BuildSnapshotHeader(const PreRollSnapshot& snapshot) {
+  if (snapshot.container == FileContainer::FLAC) {
+    // Frame sizes change slightly with renumbering; leave them unknown
+    FlacStreamInfo info;
+    info.totalFrames = snapshot.frames;
+    return BuildFlacHeader(FlacConfigFor(snapshot.format), info);
+  }
+
+  size_t dataBytes = 0;
+  for (const auto& block : snapshot.blocks) {
+    dataBytes += block->data.size();
+  }
+  dataBytes -= std::min(snapshot.skipBytes, dataBytes);
+  return BuildWavHeader(snapshot.format, dataBytes);
+}
+
+// Appends what block |index| contributes to the file
+void AppendBlock(const PreRollSnapshot& snapshot, size_t index, std::vector<uint8_t>& out) {
+  const std::vector<uint8_t>& data = snapshot.blocks[index]->data;
+  if (snapshot.container == FileContainer::FLAC) {
+    // Numbered from zero again so the snapshot decodes as a stream of its own
+    if (!RenumberFlacFrame(data.data(), data.size(), index, out)) {
+      out.insert(out.end(), data.begin(), data.end());
+    }
+    return;
+  }
+  size_t skip = index == 0 ? std::min(snapshot.skipBytes, data.size()) : 0;
+  out.insert(out.end(), data.begin() + skip, data.end());
+}
+
+}  // namespace
+
+std::vector<uint8_t> PreRollSnapshot::ToFile() const {
+  std::vector<uint8_t> file = BuildSnapshotHeader(*this);
+  for (size_t i = 0; i < blocks.size(); i++) {
+    AppendBlock(*this, i, file);
+  }
+  return file;
+}
+
+bool PreRollSnapshot::WriteFile(const std::string& path) const {
+  FileWriter writer;
+  if (!writer.Open(path)) {
+    return false;
+  }
+
+  std::vector<uint8_t> bytes = BuildSnapshotHeader(*this);
+  bool ok = writer.WriteAt(0, bytes.data(), bytes.size());
+  uint64_t offset = bytes.size();
+  for (size_t i = 0; ok && i < blocks.size(); i++) {
+    bytes.clear();
+    AppendBlock(*this, i, bytes);
+    ok = writer.WriteAt(offset, bytes.data(), bytes.size());
+    offset += bytes.size();
+  }
+  writer.Close();
+
+  if (!ok) {
+    FileWriter::Remove(path);
+  }
+  return ok;
+}
+
+bool PreRollBuffer::Configure(const WavFormat& format, const PreRollOptions& options) {
+  uint32_t blockAlign = format.blockAlign();
+  if (format.sampleRate == 0 || blockAlign == 0) {
+    return false;
+  }
+
+  // FLAC takes integers of at most 24 bits; deeper samples stay PCM
+  PreRollOptions settled = options;
+  if (settled.compressed && (format.floatSamples || format.bitsPerSample > 24)) {
+    settled.compressed = false;
+  }
+
+  std::unique_ptr<FlacStreamEncoder> flac;
+  uint64_t blockFrames = std::max<uint64_t>(1, static_cast<uint64_t>(format.sampleRate) * kPcmBlockMs / 1000);
+  if (settled.compressed) {
+    flac = std::make_unique<FlacStreamEncoder>();
+    if (!flac->Configure(FlacConfigFor(format))) {
+      return false;
+    }
+    blockFrames = flac->config().blockSize;
+  }
+
+  // The ring must hold at least two blocks (for FLAC, two verbatim frames)
+  // to keep anything once it starts evicting
+  if (settled.budgetBytes < 2 * blockFrames * blockAlign) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  format_ = format;
+  options_ = settled;
+  pcmBlockBytes_ = settled.compressed ? 0 : static_cast<size_t>(blockFrames) * blockAlign;
+  flac_ = std::move(flac);
+  blocks_.clear();
+  current_.reset();
+  spares_.clear();
+  heldBytes_ = 0;
+  heldFrames_ = 0;
+  writtenFrames_ = 0;
+  return true;
+}
+
+void PreRollBuffer::Write(const uint8_t* data, size_t size) {
+  if (flac_) {
+    // Encoding runs on the worker pool; frames join the ring as they finish
+    flac_->Push(data, size);
+    flac_->Collect([this](std::vector<uint8_t>& frame, uint32_t frames) {
+      auto block = std::make_shared<PreRollBlock>();
+      block->data = std::move(frame);
+      block->frames = frames;
+      std::lock_guard<std::mutex> lock(mutex_);
+      block->firstFrame = writtenFrames_;
+      writtenFrames_ += frames;
+      PublishLocked(std::move(block));
+    });
+    return;
+  }
+
+  uint32_t blockAlign = format_.blockAlign();
+  std::lock_guard<std::mutex> lock(mutex_);
+  while (size > 0) {
+    if (!current_) {
+      if (!spares_.empty()) {
+        current_ = std::move(spares_.back());
+        spares_.pop_back();
+      } else {
+        current_ = std::make_shared<PreRollBlock>();
+        current_->data.reserve(pcmBlockBytes_);
+      }
+      current_->data.clear();
+      current_->firstFrame = writtenFrames_;
+      current_->frames = 0;
+    }
+
+    size_t count = std::min(size, pcmBlockBytes_ - current_->data.size());
+    current_->data.insert(current_->data.end(), data, data + count);
+    current_->frames += static_cast<uint32_t>(count / blockAlign);
+    writtenFrames_ += count / blockAlign;
+    data += count;
+    size -= count;
+
+    if (current_->data.size() == pcmBlockBytes_) {
+      PublishLocked(std::move(current_));
+    }
+  }
+}
+
+void PreRollBuffer::PublishLocked(std::shared_ptr<PreRollBlock> block) {
+  heldBytes_ += block->data.size();
+  heldFrames_ += block->frames;
+  blocks_.push_back(std::move(block));
+
+  // Leave room for the PCM block about to be filled
+  while (blocks_.size() > 1 && heldBytes_ + pcmBlockBytes_ > options_.budgetBytes) {
+    std::shared_ptr<PreRollBlock> evicted = std::move(blocks_.front());
+    blocks_.pop_front();
+    heldBytes_ -= evicted->data.size();
+    heldFrames_ -= evicted->frames;
+    // Blocks pinned by a snapshot are released when the snapshot goes away
+    if (!flac_ && evicted.use_count() == 1 && spares_.size() < kMaxSpares) {
+      spares_.push_back(std::move(evicted));
+    }
+  }
+}
+
+PreRollSnapshot PreRollBuffer::Snapshot(uint64_t frames) {
+  PreRollSnapshot snapshot;
+  std::lock_guard<std::mutex> lock(mutex_);
+  snapshot.container = flac_ ? FileContainer::FLAC : FileContainer::WAV;
+  snapshot.format = format_;
+
+  uint64_t available = heldFrames_ + (current_ ? current_->frames : 0);
+  uint64_t wanted = frames == 0 ? available : std::min(frames, available);
+  if (wanted == 0) {
+    return snapshot;
+  }
+
+  // Walk back from the newest audio; the partial block is the only copy
+  uint64_t covered = 0;
+  if (current_ && current_->frames > 0) {
+    snapshot.blocks.push_back(std::make_shared<const PreRollBlock>(*current_));
+    covered += current_->frames;
+  }
+  for (auto it = blocks_.rbegin(); it != blocks_.rend() && covered < wanted; ++it) {
+    snapshot.blocks.push_back(*it);
+    covered += (*it)->frames;
+  }
+  std::reverse(snapshot.blocks.begin(), snapshot.blocks.end());
+
+  // PCM trims to the exact frame; FLAC keeps whole frames
+  uint64_t skipFrames = flac_ ? 0 : covered - wanted;
+  snapshot.skipBytes = static_cast<size_t>(skipFrames * format_.blockAlign());
+  snapshot.firstFrame = snapshot.blocks.front()->firstFrame + skipFrames;
+  snapshot.frames = covered - skipFrames;
+  return snapshot;
+}
+
+uint64_t PreRollBuffer::heldFrames() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return heldFrames_ + (current_ ? current_->frames : 0);
+}
+
+size_t PreRollBuffer::heldBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return heldBytes_ + (current_ ? current_->data.size() : 0);
+}
+
+}  // namespace windows_loopback_recorder
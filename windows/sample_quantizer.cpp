@@ -0,0 +1,273 @@
+#include "windows_loopback_recorder/sample_quantizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define WLR_QUANTIZER_SSE2 1
+#endif
+
+namespace windows_loopback_recorder {
+
+namespace {
+
+// The two 16-bit halves of a draw sum to 0..131070; centered and scaled,
+// that is triangular over (-1, 1) steps
+constexpr float kTriangularScale = 1.0f / 65536.0f;
+constexpr int32_t kTriangularCenter = 65535;
+
+// Largest float below 2^31, the top of the 32-bit range
+constexpr float kInt32High = 2147483520.0f;
+
+uint32_t Xorshift(uint32_t x) {
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return x;
+}
+
+// Spreads the seed so neighbouring lanes start far apart; never zero,
+// which xorshift could not leave
+uint32_t SeedLane(uint32_t seed, uint32_t lane) {
+  uint32_t z = seed + 0x9E3779B9u * (lane + 1);
+  z = (z ^ (z >> 16)) * 0x85EBCA6Bu;
+  z = (z ^ (z >> 13)) * 0xC2B2AE35u;
+  z ^= z >> 16;
+  return z ? z : 1;
+}
+
+// Round to nearest even, one instruction with SSE2
+int32_t RoundToInt(float value) {
+#ifdef WLR_QUANTIZER_SSE2
+  return _mm_cvtss_si32(_mm_set_ss(value));
+#else
+  return static_cast<int32_t>(std::lrintf(value));
+#endif
+}
+
+float TriangularFrom(uint32_t draw) {
+  int32_t sum = static_cast<int32_t>((draw & 0xFFFF) + (draw >> 16));
+  return static_cast<float>(sum - kTriangularCenter) * kTriangularScale;
+}
+
+}  // namespace
+
+bool SampleQuantizer::Configure(SampleFormat format, uint16_t channels, DitherMode dither, uint32_t seed) {
+  format_ = SampleFormat::UNSUPPORTED;
+  if (channels == 0) {
+    return false;
+  }
+  truncate_ = false;
+  switch (format) {
+    case SampleFormat::PCM16:
+      bytesPerSample_ = 2;
+      truncate_ = dither == DitherMode::NONE;
+      scale_ = truncate_ ? 32767.0f : 32768.0f;
+      low_ = -32768.0f;
+      high_ = 32767.0f;
+      break;
+    case SampleFormat::PCM24:
+      bytesPerSample_ = 3;
+      scale_ = 8388608.0f;
+      low_ = -8388608.0f;
+      high_ = 8388607.0f;
+      break;
+    case SampleFormat::PCM32:
+      bytesPerSample_ = 4;
+      scale_ = 2147483648.0f;
+      low_ = -2147483648.0f;
+      high_ = kInt32High;
+      dither = DitherMode::NONE;
+      break;
+    case SampleFormat::FLOAT32:
+      bytesPerSample_ = 4;
+      dither = DitherMode::NONE;
+      break;
+    default:
+      return false;
+  }
+  format_ = format;
+  channels_ = channels;
+  dither_ = dither;
+  seed_ = seed;
+  Reset();
+  return true;
+}
+
+void SampleQuantizer::Reset() {
+  for (uint32_t lane = 0; lane < 4; lane++) {
+    lanes_[lane] = SeedLane(seed_, lane);
+  }
+  lane_ = 0;
+  error_.assign(channels_, 0.0f);
+}
+
+float SampleQuantizer::NextTriangular() {
+  lanes_[lane_] = Xorshift(lanes_[lane_]);
+  float value = TriangularFrom(lanes_[lane_]);
+  lane_ = (lane_ + 1) & 3;
+  return value;
+}
+
+void SampleQuantizer::Triangular(float* noise, size_t count) {
+  size_t i = 0;
+  // Draw one at a time up to the next first lane, so the vector steps
+  // below keep every lane's sequence intact
+  for (; i < count && lane_ != 0; i++) {
+    noise[i] = NextTriangular();
+  }
+#ifdef WLR_QUANTIZER_SSE2
+  __m128i state = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes_));
+  const __m128i halfMask = _mm_set1_epi32(0xFFFF);
+  const __m128i center = _mm_set1_epi32(kTriangularCenter);
+  const __m128 scale = _mm_set1_ps(kTriangularScale);
+  for (; i + 4 <= count; i += 4) {
+    state = _mm_xor_si128(state, _mm_slli_epi32(state, 13));
+    state = _mm_xor_si128(state, _mm_srli_epi32(state, 17));
+    state = _mm_xor_si128(state, _mm_slli_epi32(state, 5));
+    __m128i sum = _mm_add_epi32(_mm_and_si128(state, halfMask), _mm_srli_epi32(state, 16));
+    _mm_storeu_ps(noise + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(sum, center)), scale));
+  }
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes_), state);
+#endif
+  for (; i < count; i++) {
+    noise[i] = NextTriangular();
+  }
+}
+
+void SampleQuantizer::Round(const float* in, const float* noise, size_t count, int32_t* out) const {
+  size_t i = 0;
+#ifdef WLR_QUANTIZER_SSE2
+  const __m128 scale = _mm_set1_ps(scale_);
+  const __m128 low = _mm_set1_ps(low_);
+  const __m128 high = _mm_set1_ps(high_);
+  if (truncate_) {
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 minusOne = _mm_set1_ps(-1.0f);
+    for (; i + 4 <= count; i += 4) {
+      __m128 x = _mm_max_ps(_mm_min_ps(_mm_loadu_ps(in + i), one), minusOne);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_cvttps_epi32(_mm_mul_ps(x, scale)));
+    }
+  } else {
+    for (; i + 4 <= count; i += 4) {
+      __m128 v = _mm_mul_ps(_mm_loadu_ps(in + i), scale);
+      if (noise) {
+        v = _mm_add_ps(v, _mm_loadu_ps(noise + i));
+      }
+      v = _mm_max_ps(_mm_min_ps(v, high), low);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_cvtps_epi32(v));
+    }
+  }
+#endif
+  for (; i < count; i++) {
+    if (truncate_) {
+      float x = std::max(-1.0f, std::min(1.0f, in[i]));
+      out[i] = static_cast<int32_t>(x * scale_);
+      continue;
+    }
+    float v = in[i] * scale_ + (noise ? noise[i] : 0.0f);
+    out[i] = RoundToInt(std::max(low_, std::min(high_, v)));
+  }
+}
+
+void SampleQuantizer::Shape(const float* in, const float* noise, size_t count, size_t& channel,
+                            int32_t* out) {
+  // Mono and stereo keep their errors in registers; blocks hold whole
+  // frames of either
+  if (channels_ == 1) {
+    ShapeFrames<1>(in, noise, count, out);
+    return;
+  }
+  if (channels_ == 2) {
+    ShapeFrames<2>(in, noise, count, out);
+    return;
+  }
+  for (size_t i = 0; i < count; i++) {
+    float& error = error_[channel];
+    float wanted = std::max(-1.0f, std::min(1.0f, in[i])) * scale_ - error;
+    float rounded = static_cast<float>(RoundToInt(wanted + noise[i]));
+    // The error is taken before clipping so a clipped run cannot wind it up
+    error = rounded - wanted;
+    out[i] = static_cast<int32_t>(std::max(low_, std::min(high_, rounded)));
+    if (++channel == channels_) {
+      channel = 0;
+    }
+  }
+}
+
+template <uint16_t kChannels>
+void SampleQuantizer::ShapeFrames(const float* in, const float* noise, size_t count, int32_t* out) {
+  float errors[kChannels];
+  std::copy(error_.begin(), error_.end(), errors);
+  for (size_t i = 0; i < count; i += kChannels) {
+    for (uint16_t c = 0; c < kChannels; c++) {
+      float wanted = std::max(-1.0f, std::min(1.0f, in[i + c])) * scale_ - errors[c];
+      float rounded = static_cast<float>(RoundToInt(wanted + noise[i + c]));
+      errors[c] = rounded - wanted;
+      out[i + c] = static_cast<int32_t>(std::max(low_, std::min(high_, rounded)));
+    }
+  }
+  std::copy(errors, errors + kChannels, error_.begin());
+}
+
+void SampleQuantizer::Store(const int32_t* values, size_t count, uint8_t* out) const {
+  switch (format_) {
+    case SampleFormat::PCM16:
+      for (size_t i = 0; i < count; i++) {
+        int16_t sample = static_cast<int16_t>(values[i]);
+        std::memcpy(out + i * 2, &sample, 2);
+      }
+      break;
+    case SampleFormat::PCM24:
+      for (size_t i = 0; i < count; i++) {
+        uint32_t sample = static_cast<uint32_t>(values[i]);
+        out[i * 3] = static_cast<uint8_t>(sample);
+        out[i * 3 + 1] = static_cast<uint8_t>(sample >> 8);
+        out[i * 3 + 2] = static_cast<uint8_t>(sample >> 16);
+      }
+      break;
+    default:
+      std::memcpy(out, values, count * 4);
+      break;
+  }
+}
+
+void SampleQuantizer::Quantize(const float* in, size_t frames, uint8_t* out) {
+  size_t samples = frames * channels_;
+  if (format_ == SampleFormat::FLOAT32) {
+    float* dest = reinterpret_cast<float*>(out);
+    for (size_t i = 0; i < samples; i++) {
+      dest[i] = std::max(-1.0f, std::min(1.0f, in[i]));
+    }
+    return;
+  }
+  if (format_ == SampleFormat::UNSUPPORTED) {
+    return;
+  }
+
+  // Block by block on the stack, so the noise and the integers stay in L1
+  float noise[kBlock];
+  int32_t values[kBlock];
+  size_t channel = 0;
+  for (size_t start = 0; start < samples; start += kBlock) {
+    size_t count = std::min(kBlock, samples - start);
+    switch (dither_) {
+      case DitherMode::TRIANGULAR:
+        Triangular(noise, count);
+        Round(in + start, noise, count, values);
+        break;
+      case DitherMode::SHAPED:
+        Triangular(noise, count);
+        Shape(in + start, noise, count, channel, values);
+        break;
+      default:
+        Round(in + start, nullptr, count, values);
+        break;
+    }
+    Store(values, count, out + start * bytesPerSample_);
+  }
+}
+
+}  // namespace windows_loopback_recorder
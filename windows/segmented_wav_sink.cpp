@@ -0,0 +1,289 @@
+#include "windows_loopback_recorder/segmented_wav_sink.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#include "windows_loopback_recorder/file_writer.h"
+
+namespace windows_loopback_recorder {
+
+SegmentedWavSink::~SegmentedWavSink() {
+  Close();
+}
+
+std::string SegmentedWavSink::SegmentPath(const std::string& path, uint32_t index) {
+  char suffix[16];
+  std::snprintf(suffix, sizeof(suffix), "_%06u", index);
+
+  size_t slash = path.find_last_of("/\\");
+  size_t dot = path.find_last_of('.');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+    return path + suffix;
+  }
+  return path.substr(0, dot) + suffix + path.substr(dot);
+}
+
+bool SegmentedWavSink::Open(const std::string& path, const WavFormat& format,
+                            const SegmentOptions& segments, SegmentCallback onSegmentComplete,
+                            const WavSinkOptions& options) {
+  Close();
+
+  uint32_t blockAlign = format.blockAlign();
+  if (blockAlign == 0) {
+    return false;
+  }
+
+  uint64_t segmentFrames = static_cast<uint64_t>(segments.segmentSeconds) * format.sampleRate;
+  if (segments.segmentBytes > 0) {
+    uint64_t byteFrames = segments.segmentBytes > WavFileSink::kDataOffset
+        ? (segments.segmentBytes - WavFileSink::kDataOffset) / blockAlign : 0;
+    if (byteFrames == 0) {
+      return false;
+    }
+    segmentFrames = segmentFrames > 0 ? std::min(segmentFrames, byteFrames) : byteFrames;
+  }
+
+  path_ = path;
+  format_ = format;
+  options_ = options;
+  onSegmentComplete_ = std::move(onSegmentComplete);
+  segmentFrames_ = segmentFrames;
+  if (segmentFrames_ > 0) {
+    // Every segment has a known final size; reserve it (plus the pad byte)
+    options_.preallocateBytes = WavFileSink::kDataOffset + segmentFrames_ * blockAlign + 1;
+  }
+
+  totalFrames_ = 0;
+  gapFrames_ = 0;
+  nextIndex_ = 0;
+  stopping_ = false;
+  allComplete_ = true;
+  closedStats_ = WavSinkStats();
+
+  // The first file opens synchronously so a bad path fails here
+  current_ = OpenSegment(0);
+  if (!current_) {
+    return false;
+  }
+  nextIndex_ = 1;
+
+  managerThread_ = std::thread(&SegmentedWavSink::ManagerThreadFunction, this);
+  return true;
+}
+
+void SegmentedWavSink::Write(const uint8_t* data, size_t size) {
+  if (!holdover_.empty() && (current_ || AcquireSegment())) {
+    std::vector<uint8_t> pending;
+    pending.swap(holdover_);
+    uint64_t gap = gapFrames_;
+    gapFrames_ = 0;
+    WriteFrames(pending.data(), pending.size());
+    // The audio dropped after the holdover follows it, unless part of the
+    // holdover had to wait again
+    if (holdover_.empty()) {
+      totalFrames_ += gap;
+    } else {
+      gapFrames_ += gap;
+    }
+  }
+  WriteFrames(data, size);
+}
+
+bool SegmentedWavSink::Close() {
+  if (!managerThread_.joinable()) {
+    return true;
+  }
+
+  // Held-back audio may need several more segments
+  while (!holdover_.empty()) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (!segmentReady_.wait_for(lock, std::chrono::seconds(2), [this] { return next_ != nullptr; })) {
+        closedStats_.droppedBytes += holdover_.size();
+        totalFrames_ += gapFrames_;
+        holdover_.clear();
+        gapFrames_ = 0;
+        break;
+      }
+    }
+    Write(nullptr, 0);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (current_) {
+      finished_.push_back(std::move(current_));
+    }
+    stopping_ = true;
+  }
+  wake_.notify_one();
+  managerThread_.join();
+
+  return allComplete_;
+}
+
+uint32_t SegmentedWavSink::segmentCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return nextIndex_;
+}
+
+WavSinkStats SegmentedWavSink::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return closedStats_;
+}
+
+std::unique_ptr<SegmentedWavSink::Segment> SegmentedWavSink::OpenSegment(uint32_t index) {
+  auto segment = std::make_unique<Segment>();
+  segment->info.path = segmented() ? SegmentPath(path_, index) : path_;
+  segment->info.index = index;
+  segment->sink = std::make_unique<WavFileSink>();
+  if (!segment->sink->Open(segment->info.path, format_, options_)) {
+    return nullptr;
+  }
+  return segment;
+}
+
+void SegmentedWavSink::WriteFrames(const uint8_t* data, size_t size) {
+  uint32_t blockAlign = format_.blockAlign();
+
+  while (size > 0) {
+    if (!current_ && !AcquireSegment()) {
+      HoldBack(data, size);
+      return;
+    }
+
+    size_t count = size;
+    if (segmentFrames_ > 0) {
+      uint64_t room = (segmentFrames_ - current_->info.frameCount) * blockAlign;
+      count = static_cast<size_t>(std::min<uint64_t>(size, room));
+    }
+
+    current_->sink->Write(data, count);
+    uint64_t frames = count / blockAlign;
+    current_->info.frameCount += frames;
+    totalFrames_ += frames;
+    data += count;
+    size -= count;
+
+    if (segmentFrames_ > 0 && current_->info.frameCount == segmentFrames_) {
+      Rotate();
+    }
+  }
+}
+
+bool SegmentedWavSink::AcquireSegment() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    current_ = std::move(next_);
+  }
+  if (!current_) {
+    return false;
+  }
+  wake_.notify_one();  // Prepare the one after
+  current_->info.firstFrame = totalFrames_;
+  return true;
+}
+
+void SegmentedWavSink::HoldBack(const uint8_t* data, size_t size) {
+  // The manager has not opened the next file yet. Keep a bounded backlog so
+  // a slow file system delays the cut instead of leaving a gap.
+  // Nothing is appended once audio was dropped, so the holdover never
+  // spans a gap.
+  size_t limit = options_.blockBytes * options_.blockCount;
+  if (gapFrames_ == 0 && holdover_.size() + size <= limit) {
+    holdover_.insert(holdover_.end(), data, data + size);
+    return;
+  }
+
+  // Still nothing after a full pool's worth of audio. Advance the timeline
+  // so the next segment's range shows the gap; with audio held back, only
+  // once that audio has been written.
+  uint64_t frames = size / format_.blockAlign();
+  if (holdover_.empty()) {
+    totalFrames_ += frames;
+  } else {
+    gapFrames_ += frames;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  closedStats_.droppedBytes += size;
+}
+
+void SegmentedWavSink::Rotate() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_.push_back(std::move(current_));
+  }
+  wake_.notify_one();
+  // The next write picks up the segment the manager prepared
+}
+
+void SegmentedWavSink::ManagerThreadFunction() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    if (!finished_.empty()) {
+      std::unique_ptr<Segment> segment = std::move(finished_.front());
+      finished_.pop_front();
+      lock.unlock();
+      FinishSegment(*segment);
+      lock.lock();
+      continue;
+    }
+
+    if (stopping_) {
+      break;
+    }
+
+    if (segmented() && !next_) {
+      uint32_t index = nextIndex_;
+      lock.unlock();
+      std::unique_ptr<Segment> segment = OpenSegment(index);
+      lock.lock();
+      if (segment) {
+        next_ = std::move(segment);
+        nextIndex_ = index + 1;
+        segmentReady_.notify_all();
+      } else {
+        // Disk full or path gone; try again shortly
+        wake_.wait_for(lock, std::chrono::seconds(1));
+      }
+      continue;
+    }
+
+    wake_.wait(lock);
+  }
+
+  // The prepared segment never received audio
+  std::unique_ptr<Segment> unused = std::move(next_);
+  if (unused) {
+    nextIndex_--;
+  }
+  lock.unlock();
+  if (unused) {
+    unused->sink->Close();
+    FileWriter::Remove(unused->info.path);
+  }
+}
+
+void SegmentedWavSink::FinishSegment(Segment& segment) {
+  bool closed = segment.sink->Close();
+  segment.info.stats = segment.sink->GetStats();
+  segment.info.complete = closed && !segment.info.stats.writeError;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closedStats_.dataBytes += segment.info.stats.dataBytes;
+    closedStats_.fileBytes += segment.info.stats.fileBytes;
+    closedStats_.droppedBytes += segment.info.stats.droppedBytes;
+    closedStats_.blockWrites += segment.info.stats.blockWrites;
+    closedStats_.rf64 = closedStats_.rf64 || segment.info.stats.rf64;
+    closedStats_.writeError = closedStats_.writeError || segment.info.stats.writeError;
+    allComplete_ = allComplete_ && segment.info.complete;
+  }
+
+  if (onSegmentComplete_) {
+    onSegmentComplete_(segment.info);
+  }
+}
+
+}  // namespace windows_loopback_recorder
@@ -0,0 +1,271 @@
+#include "windows_loopback_recorder/spectrum_analyzer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define WLR_FFT_SSE2 1
+#endif
+
+namespace windows_loopback_recorder {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// One radix-2 stage: for each pair (a, b = a + span) in each block,
+// a' = a + w b and b' = a - w b with w = exp(-i pi j / span)
+void ButterflyStage(float* re, float* im, size_t count, size_t span,
+                    const float* twRe, const float* twIm) {
+  for (size_t block = 0; block < count; block += 2 * span) {
+    float* aRe = re + block;
+    float* aIm = im + block;
+    float* bRe = aRe + span;
+    float* bIm = aIm + span;
+    size_t j = 0;
+#ifdef WLR_FFT_SSE2
+    for (; j + 4 <= span; j += 4) {
+      __m128 wr = _mm_loadu_ps(twRe + j);
+      __m128 wi = _mm_loadu_ps(twIm + j);
+      __m128 xr = _mm_loadu_ps(bRe + j);
+      __m128 xi = _mm_loadu_ps(bIm + j);
+      __m128 tr = _mm_sub_ps(_mm_mul_ps(wr, xr), _mm_mul_ps(wi, xi));
+      __m128 ti = _mm_add_ps(_mm_mul_ps(wr, xi), _mm_mul_ps(wi, xr));
+      __m128 ar = _mm_loadu_ps(aRe + j);
+      __m128 ai = _mm_loadu_ps(aIm + j);
+      _mm_storeu_ps(bRe + j, _mm_sub_ps(ar, tr));
+      _mm_storeu_ps(bIm + j, _mm_sub_ps(ai, ti));
+      _mm_storeu_ps(aRe + j, _mm_add_ps(ar, tr));
+      _mm_storeu_ps(aIm + j, _mm_add_ps(ai, ti));
+    }
+#endif
+    for (; j < span; j++) {
+      float tr = twRe[j] * bRe[j] - twIm[j] * bIm[j];
+      float ti = twRe[j] * bIm[j] + twIm[j] * bRe[j];
+      bRe[j] = aRe[j] - tr;
+      bIm[j] = aIm[j] - ti;
+      aRe[j] += tr;
+      aIm[j] += ti;
+    }
+  }
+}
+
+}  // namespace
+
+bool RealFft::IsValidSize(size_t size) {
+  return size >= kMinSize && size <= kMaxSize && (size & (size - 1)) == 0;
+}
+
+RealFft::RealFft(size_t size) : size_(size), half_(size / 2) {
+  size_t bits = 0;
+  while ((size_t{1} << bits) < half_) {
+    bits++;
+  }
+  bitReverse_.resize(half_);
+  for (size_t i = 0; i < half_; i++) {
+    uint32_t reversed = 0;
+    for (size_t b = 0; b < bits; b++) {
+      reversed |= ((i >> b) & 1u) << (bits - 1 - b);
+    }
+    bitReverse_[i] = reversed;
+  }
+
+  twiddleRe_.resize(half_);
+  twiddleIm_.resize(half_);
+  for (size_t span = 1; span < half_; span *= 2) {
+    for (size_t j = 0; j < span; j++) {
+      double angle = -kPi * j / span;
+      twiddleRe_[span - 1 + j] = static_cast<float>(std::cos(angle));
+      twiddleIm_[span - 1 + j] = static_cast<float>(std::sin(angle));
+    }
+  }
+
+  splitRe_.resize(half_ + 1);
+  splitIm_.resize(half_ + 1);
+  for (size_t k = 0; k <= half_; k++) {
+    double angle = -2.0 * kPi * k / size_;
+    splitRe_[k] = static_cast<float>(std::cos(angle));
+    splitIm_[k] = static_cast<float>(std::sin(angle));
+  }
+
+  workRe_.resize(half_);
+  workIm_.resize(half_);
+}
+
+void RealFft::Forward(const float* in, float* re, float* im) {
+  // Even samples as the real part, odd samples as the imaginary part, in
+  // bit-reversed order for the in-place decimation in time
+  for (size_t i = 0; i < half_; i++) {
+    workRe_[i] = in[2 * bitReverse_[i]];
+    workIm_[i] = in[2 * bitReverse_[i] + 1];
+  }
+  for (size_t span = 1; span < half_; span *= 2) {
+    ButterflyStage(workRe_.data(), workIm_.data(), half_, span,
+                   &twiddleRe_[span - 1], &twiddleIm_[span - 1]);
+  }
+
+  // X[k] = E[k] + W^k O[k], where E and O, the transforms of the even and
+  // odd samples, are the conjugate-symmetric and -antisymmetric parts of Z
+  for (size_t k = 0; k <= half_; k++) {
+    size_t a = k % half_;
+    size_t b = (half_ - k) % half_;
+    float evenRe = 0.5f * (workRe_[a] + workRe_[b]);
+    float evenIm = 0.5f * (workIm_[a] - workIm_[b]);
+    float diffRe = 0.5f * (workRe_[a] - workRe_[b]);
+    float diffIm = 0.5f * (workIm_[a] + workIm_[b]);
+    // O[k] = -i * diff
+    float oddRe = diffIm;
+    float oddIm = -diffRe;
+    re[k] = evenRe + splitRe_[k] * oddRe - splitIm_[k] * oddIm;
+    im[k] = evenIm + splitRe_[k] * oddIm + splitIm_[k] * oddRe;
+  }
+}
+
+void RealFft::Inverse(const float* re, const float* im, float* out) {
+  // Undo the split: E[k] = (X[k] + X*[N/2 - k]) / 2 and
+  // O[k] = (X[k] - X*[N/2 - k]) W^-k / 2 rebuild Z[k] = E[k] + i O[k].
+  // Z is conjugated on the way in and out so the forward butterflies run
+  // the inverse transform.
+  for (size_t i = 0; i < half_; i++) {
+    size_t k = bitReverse_[i];
+    size_t m = half_ - k;
+    float evenRe = 0.5f * (re[k] + re[m]);
+    float evenIm = 0.5f * (im[k] - im[m]);
+    float diffRe = 0.5f * (re[k] - re[m]);
+    float diffIm = 0.5f * (im[k] + im[m]);
+    if (k == 0) {
+      evenIm = 0.0f;
+      diffIm = 0.0f;
+    }
+    float oddRe = diffRe * splitRe_[k] + diffIm * splitIm_[k];
+    float oddIm = diffIm * splitRe_[k] - diffRe * splitIm_[k];
+    workRe_[i] = evenRe - oddIm;
+    workIm_[i] = -(evenIm + oddRe);
+  }
+  for (size_t span = 1; span < half_; span *= 2) {
+    ButterflyStage(workRe_.data(), workIm_.data(), half_, span,
+                   &twiddleRe_[span - 1], &twiddleIm_[span - 1]);
+  }
+  float scale = 1.0f / half_;
+  for (size_t n = 0; n < half_; n++) {
+    out[2 * n] = workRe_[n] * scale;
+    out[2 * n + 1] = -workIm_[n] * scale;
+  }
+}
+
+bool SpectrumAnalyzer::Configure(uint32_t sampleRate, uint16_t channels, size_t fftSize,
+                                 size_t bands, float minHz, float maxHz) {
+  fft_.reset();
+  maxHz = std::min(maxHz, sampleRate / 2.0f);
+  if (sampleRate < 8000 || channels == 0 || !RealFft::IsValidSize(fftSize) || bands == 0 ||
+      bands > kMaxBands || !(minHz > 0.0f) || !(minHz < maxHz)) {
+    return false;
+  }
+  sampleRate_ = sampleRate;
+  channels_ = channels;
+  minHz_ = minHz;
+  maxHz_ = maxHz;
+  fft_ = std::make_unique<RealFft>(fftSize);
+
+  // Periodic Hann; its coherent gain is 1/2, so 2 / (N / 2) brings a
+  // full-scale sine back to 1.0
+  window_.resize(fftSize);
+  for (size_t n = 0; n < fftSize; n++) {
+    double hann = 0.5 - 0.5 * std::cos(2.0 * kPi * n / fftSize);
+    window_[n] = static_cast<float>(hann * 4.0 / fftSize / 32768.0);
+  }
+
+  double binHz = static_cast<double>(sampleRate) / fftSize;
+  size_t lastBin = fftSize / 2;
+  bandFirst_.resize(bands);
+  bandEnd_.resize(bands);
+  for (size_t b = 0; b < bands; b++) {
+    double lo = minHz * std::pow(static_cast<double>(maxHz) / minHz, static_cast<double>(b) / bands);
+    double hi = minHz * std::pow(static_cast<double>(maxHz) / minHz, static_cast<double>(b + 1) / bands);
+    size_t first = std::min(lastBin, static_cast<size_t>(std::lround(lo / binHz)));
+    size_t end = std::min(lastBin + 1, static_cast<size_t>(std::lround(hi / binHz)));
+    if (end <= first) {
+      first = std::min(lastBin, static_cast<size_t>(std::lround(std::sqrt(lo * hi) / binHz)));
+      end = first + 1;
+    }
+    bandFirst_[b] = static_cast<uint32_t>(first);
+    bandEnd_[b] = static_cast<uint32_t>(end);
+  }
+
+  ring_.resize(fftSize);
+  windowed_.resize(fftSize);
+  re_.resize(fftSize / 2 + 1);
+  im_.resize(fftSize / 2 + 1);
+  Reset();
+  return true;
+}
+
+void SpectrumAnalyzer::Reset() {
+  std::fill(ring_.begin(), ring_.end(), 0.0f);
+  ringHead_ = 0;
+  pushed_ = 0;
+}
+
+void SpectrumAnalyzer::Push(const int16_t* samples, size_t frames) {
+  if (!fft_) {
+    return;
+  }
+  float scale = 1.0f / channels_;
+  for (size_t i = 0; i < frames; i++) {
+    int32_t sum = 0;
+    for (uint16_t c = 0; c < channels_; c++) {
+      sum += samples[c];
+    }
+    samples += channels_;
+    ring_[ringHead_] = sum * scale;
+    if (++ringHead_ == ring_.size()) {
+      ringHead_ = 0;
+    }
+  }
+  pushed_ += frames;
+}
+
+bool SpectrumAnalyzer::Analyze(std::vector<float>& bands) {
+  if (!fft_ || pushed_ < ring_.size()) {
+    return false;
+  }
+
+  // Oldest sample first; the window also scales 16-bit to full scale
+  size_t size = ring_.size();
+  size_t tail = size - ringHead_;
+  for (size_t n = 0; n < tail; n++) {
+    windowed_[n] = ring_[ringHead_ + n] * window_[n];
+  }
+  for (size_t n = 0; n < ringHead_; n++) {
+    windowed_[tail + n] = ring_[n] * window_[tail + n];
+  }
+  fft_->Forward(windowed_.data(), re_.data(), im_.data());
+
+  for (size_t k = 0; k < re_.size(); k++) {
+    re_[k] = re_[k] * re_[k] + im_[k] * im_[k];
+  }
+  bands.resize(bandFirst_.size());
+  for (size_t b = 0; b < bands.size(); b++) {
+    float power = *std::max_element(re_.begin() + bandFirst_[b], re_.begin() + bandEnd_[b]);
+    bands[b] = power > 0.0f ? std::max(kFloorDb, 10.0f * std::log10(power)) : kFloorDb;
+  }
+  return true;
+}
+
+std::vector<float> BuildSpectrumFrame(double elapsedMs, const SpectrumAnalyzer& analyzer,
+                                      const std::vector<float>& bands) {
+  std::vector<float> frame(SPECTRUM_FRAME_FIELDS + bands.size());
+  frame[SPECTRUM_FRAME_HEADER_SIZE] = static_cast<float>(SPECTRUM_FRAME_FIELDS);
+  frame[SPECTRUM_FRAME_VERSION] = kSpectrumFrameVersion;
+  frame[SPECTRUM_FRAME_ELAPSED_MS] = static_cast<float>(elapsedMs);
+  frame[SPECTRUM_FRAME_SAMPLE_RATE] = static_cast<float>(analyzer.sampleRate());
+  frame[SPECTRUM_FRAME_FFT_SIZE] = static_cast<float>(analyzer.fftSize());
+  frame[SPECTRUM_FRAME_MIN_HZ] = analyzer.minHz();
+  frame[SPECTRUM_FRAME_MAX_HZ] = analyzer.maxHz();
+  frame[SPECTRUM_FRAME_BANDS] = static_cast<float>(bands.size());
+  std::copy(bands.begin(), bands.end(), frame.begin() + SPECTRUM_FRAME_FIELDS);
+  return frame;
+}
+
+}  // namespace windows_loopback_recorder
@@ -0,0 +1,345 @@
+#include "windows_loopback_recorder/telephony_codec.h"
+
+#include <algorithm>
+
+namespace windows_loopback_recorder {
+
+namespace {
+
+// ---------------------------------------------------------------------------
+// G.711
+// ---------------------------------------------------------------------------
+
+// Reference encoders (ITU-T G.711 / Sun g711.c). Only used to fill the
+// lookup tables below.
+uint8_t MuLawFromLinear(int16_t sample) {
+  constexpr int kBias = 0x84;
+  constexpr int kClip = 8159;
+  static const int kSegmentEnd[8] = {0x3F, 0x7F, 0xFF, 0x1FF, 0x3FF, 0x7FF, 0xFFF, 0x1FFF};
+
+  int value = sample >> 2;
+  uint8_t mask = 0xFF;
+  if (value < 0) {
+    value = -value;
+    mask = 0x7F;
+  }
+  value = std::min(value, kClip) + (kBias >> 2);
+
+  int segment = 0;
+  while (segment < 8 && value > kSegmentEnd[segment]) {
+    segment++;
+  }
+  if (segment >= 8) {
+    return static_cast<uint8_t>(0x7F ^ mask);
+  }
+  return static_cast<uint8_t>(((segment << 4) | ((value >> (segment + 1)) & 0x0F)) ^ mask);
+}
+
+uint8_t ALawFromLinear(int16_t sample) {
+  static const int kSegmentEnd[8] = {0x1F, 0x3F, 0x7F, 0xFF, 0x1FF, 0x3FF, 0x7FF, 0xFFF};
+
+  int value = sample >> 3;
+  uint8_t mask = 0xD5;
+  if (value < 0) {
+    value = -value - 1;
+    mask = 0x55;
+  }
+
+  int segment = 0;
+  while (segment < 8 && value > kSegmentEnd[segment]) {
+    segment++;
+  }
+  if (segment >= 8) {
+    return static_cast<uint8_t>(0x7F ^ mask);
+  }
+  int code = segment << 4;
+  code |= (segment < 2 ? value >> 1 : value >> segment) & 0x0F;
+  return static_cast<uint8_t>(code ^ mask);
+}
+
+// µ-law only looks at the top 14 bits of a sample and A-law at the top 13,
+// so both encoders fit in a table indexed by the sample's raw bits.
+struct G711Tables {
+  uint8_t muLaw[1 << 14];
+  uint8_t aLaw[1 << 13];
+  int16_t muLawDecode[256];
+  int16_t aLawDecode[256];
+
+  G711Tables() {
+    for (uint32_t i = 0; i < (1u << 14); i++) {
+      muLaw[i] = MuLawFromLinear(static_cast<int16_t>(i << 2));
+    }
+    for (uint32_t i = 0; i < (1u << 13); i++) {
+      aLaw[i] = ALawFromLinear(static_cast<int16_t>(i << 3));
+    }
+    for (int i = 0; i < 256; i++) {
+      uint8_t u = static_cast<uint8_t>(~i);
+      int t = (((u & 0x0F) << 3) + 0x84) << ((u & 0x70) >> 4);
+      muLawDecode[i] = static_cast<int16_t>((u & 0x80) ? 0x84 - t : t - 0x84);
+
+      uint8_t a = static_cast<uint8_t>(i ^ 0x55);
+      int segment = (a & 0x70) >> 4;
+      int magnitude = (a & 0x0F) << 4;
+      magnitude += segment == 0 ? 8 : 0x108;
+      if (segment > 1) {
+        magnitude <<= segment - 1;
+      }
+      aLawDecode[i] = static_cast<int16_t>((a & 0x80) ? magnitude : -magnitude);
+    }
+  }
+};
+
+const G711Tables& Tables() {
+  static const G711Tables tables;
+  return tables;
+}
+
+template <int kShift>
+void EncodeWithTable(const uint8_t* table, const uint8_t* pcm, size_t samples, uint8_t* out) {
+  // Byte-wise loads keep this alias-safe for in-place encoding: sample i is
+  // read from bytes 2i and 2i+1 before byte i is written.
+  size_t i = 0;
+  for (; i + 4 <= samples; i += 4) {
+    const uint8_t* p = pcm + i * 2;
+    uint32_t s0 = p[0] | (p[1] << 8);
+    uint32_t s1 = p[2] | (p[3] << 8);
+    uint32_t s2 = p[4] | (p[5] << 8);
+    uint32_t s3 = p[6] | (p[7] << 8);
+    out[i] = table[s0 >> kShift];
+    out[i + 1] = table[s1 >> kShift];
+    out[i + 2] = table[s2 >> kShift];
+    out[i + 3] = table[s3 >> kShift];
+  }
+  for (; i < samples; i++) {
+    uint32_t s = pcm[i * 2] | (pcm[i * 2 + 1] << 8);
+    out[i] = table[s >> kShift];
+  }
+}
+
+// ---------------------------------------------------------------------------
+// IMA ADPCM
+// ---------------------------------------------------------------------------
+
+constexpr int kMaxStepIndex = 88;
+
+const int16_t kStepTable[kMaxStepIndex + 1] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,    19,    21,    23,
+    25,    28,    31,    34,    37,    41,    45,    50,    55,    60,    66,    73,    80,
+    88,    97,    107,   118,   130,   143,   157,   173,   190,   209,   230,   253,   279,
+    307,   337,   371,   408,   449,   494,   544,   598,   658,   724,   796,   876,   963,
+    1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,  2272,  2499,  2749,  3024,  3327,
+    3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,  9493,  10442, 11487,
+    12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+const int8_t kIndexTable[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+struct AdpcmState {
+  int predictor = 0;
+  int stepIndex = 0;
+};
+
+// Applies |code| to |state| exactly as a decoder would.
+inline void ApplyNibble(AdpcmState& state, uint8_t code) {
+  int step = kStepTable[state.stepIndex];
+  int delta = step >> 3;
+  if (code & 4) delta += step;
+  if (code & 2) delta += step >> 1;
+  if (code & 1) delta += step >> 2;
+  state.predictor += (code & 8) ? -delta : delta;
+  state.predictor = std::clamp(state.predictor, -32768, 32767);
+  state.stepIndex = std::clamp(state.stepIndex + kIndexTable[code & 7], 0, kMaxStepIndex);
+}
+
+inline uint8_t EncodeNibble(AdpcmState& state, int sample) {
+  int step = kStepTable[state.stepIndex];
+  int diff = sample - state.predictor;
+  uint8_t code = 0;
+  if (diff < 0) {
+    code = 8;
+    diff = -diff;
+  }
+  if (diff >= step) {
+    code |= 4;
+    diff -= step;
+  }
+  step >>= 1;
+  if (diff >= step) {
+    code |= 2;
+    diff -= step;
+  }
+  step >>= 1;
+  if (diff >= step) {
+    code |= 1;
+  }
+  ApplyNibble(state, code);
+  return code;
+}
+
+}  // namespace
+
+uint8_t G711SilenceByte(G711Law law) {
+  return law == G711Law::MU_LAW ? 0xFF : 0xD5;
+}
+
+void EncodeG711(G711Law law, const uint8_t* pcm, size_t samples, uint8_t* out) {
+  const G711Tables& tables = Tables();
+  if (law == G711Law::MU_LAW) {
+    EncodeWithTable<2>(tables.muLaw, pcm, samples, out);
+  } else {
+    EncodeWithTable<3>(tables.aLaw, pcm, samples, out);
+  }
+}
+
+int16_t DecodeG711(G711Law law, uint8_t value) {
+  const G711Tables& tables = Tables();
+  return law == G711Law::MU_LAW ? tables.muLawDecode[value] : tables.aLawDecode[value];
+}
+
+uint32_t ImaAdpcmEncoder::DefaultSamplesPerBlock(uint32_t sampleRate) {
+  uint32_t bytesPerChannel = 256 * std::max<uint32_t>(1, sampleRate / 11025);
+  return (bytesPerChannel - 4) * 2 + 1;
+}
+
+size_t ImaAdpcmEncoder::BlockBytes(uint16_t channels, uint32_t samplesPerBlock) {
+  return static_cast<size_t>(channels) * (4 + (samplesPerBlock - 1) / 2);
+}
+
+bool ImaAdpcmEncoder::Configure(uint16_t channels, uint32_t samplesPerBlock) {
+  if (channels < 1 || channels > 8 || samplesPerBlock < 9 || (samplesPerBlock - 1) % 8 != 0) {
+    return false;
+  }
+  channels_ = channels;
+  samplesPerBlock_ = samplesPerBlock;
+  partialFrame_.clear();
+  pending_.clear();
+  pending_.reserve(static_cast<size_t>(samplesPerBlock) * channels);
+  stepIndex_.assign(channels, 0);
+  return true;
+}
+
+void ImaAdpcmEncoder::Push(const uint8_t* pcm, size_t size, const EmitFunction& emit) {
+  size_t frameBytes = static_cast<size_t>(channels_) * 2;
+  size_t blockSamples = static_cast<size_t>(samplesPerBlock_) * channels_;
+
+  auto appendFrame = [&](const uint8_t* frame) {
+    for (uint16_t c = 0; c < channels_; c++) {
+      pending_.push_back(static_cast<int16_t>(frame[c * 2] | (frame[c * 2 + 1] << 8)));
+    }
+    if (pending_.size() == blockSamples) {
+      std::vector<uint8_t> block;
+      EncodeBlock(pending_.data(), block);
+      pending_.clear();
+      emit(block, samplesPerBlock_);
+    }
+  };
+
+  if (!partialFrame_.empty()) {
+    size_t count = std::min(size, frameBytes - partialFrame_.size());
+    partialFrame_.insert(partialFrame_.end(), pcm, pcm + count);
+    pcm += count;
+    size -= count;
+    if (partialFrame_.size() < frameBytes) {
+      return;
+    }
+    appendFrame(partialFrame_.data());
+    partialFrame_.clear();
+  }
+
+  for (; size >= frameBytes; pcm += frameBytes, size -= frameBytes) {
+    appendFrame(pcm);
+  }
+  partialFrame_.assign(pcm, pcm + size);
+}
+
+void ImaAdpcmEncoder::Flush(const EmitFunction& emit) {
+  partialFrame_.clear();
+  if (pending_.empty()) {
+    return;
+  }
+  uint32_t frames = static_cast<uint32_t>(pending_.size() / channels_);
+  size_t blockSamples = static_cast<size_t>(samplesPerBlock_) * channels_;
+  while (pending_.size() < blockSamples) {
+    pending_.push_back(pending_[pending_.size() - channels_]);
+  }
+  std::vector<uint8_t> block;
+  EncodeBlock(pending_.data(), block);
+  pending_.clear();
+  emit(block, frames);
+}
+
+uint32_t ImaAdpcmEncoder::DiscardPending() {
+  uint32_t frames = channels_ ? static_cast<uint32_t>(pending_.size() / channels_) : 0;
+  pending_.clear();
+  partialFrame_.clear();
+  return frames;
+}
+
+void ImaAdpcmEncoder::EncodeBlock(const int16_t* samples, std::vector<uint8_t>& out) {
+  out.assign(BlockBytes(channels_, samplesPerBlock_), 0);
+  uint8_t* p = out.data();
+
+  // The header restarts the predictor at the first sample of each channel
+  AdpcmState state[8];
+  for (uint16_t c = 0; c < channels_; c++) {
+    state[c].predictor = samples[c];
+    state[c].stepIndex = stepIndex_[c];
+    *p++ = static_cast<uint8_t>(samples[c] & 0xFF);
+    *p++ = static_cast<uint8_t>((samples[c] >> 8) & 0xFF);
+    *p++ = static_cast<uint8_t>(state[c].stepIndex);
+    *p++ = 0;
+  }
+
+  // Then, per group of 8 frames, 4 bytes for each channel in turn
+  for (uint32_t frame = 1; frame < samplesPerBlock_; frame += 8) {
+    for (uint16_t c = 0; c < channels_; c++) {
+      const int16_t* s = samples + static_cast<size_t>(frame) * channels_ + c;
+      for (int i = 0; i < 8; i += 2) {
+        uint8_t low = EncodeNibble(state[c], s[i * channels_]);
+        uint8_t high = EncodeNibble(state[c], s[(i + 1) * channels_]);
+        *p++ = static_cast<uint8_t>(low | (high << 4));
+      }
+    }
+  }
+
+  for (uint16_t c = 0; c < channels_; c++) {
+    stepIndex_[c] = static_cast<uint8_t>(state[c].stepIndex);
+  }
+}
+
+bool DecodeImaAdpcmBlock(const uint8_t* block, size_t size, uint16_t channels,
+                         std::vector<int16_t>& samples) {
+  size_t headerBytes = static_cast<size_t>(channels) * 4;
+  if (channels < 1 || channels > 8 || size < headerBytes || (size - headerBytes) % headerBytes != 0) {
+    return false;
+  }
+  uint32_t frames = static_cast<uint32_t>((size - headerBytes) / channels * 2 + 1);
+  samples.assign(static_cast<size_t>(frames) * channels, 0);
+
+  AdpcmState state[8];
+  const uint8_t* p = block;
+  for (uint16_t c = 0; c < channels; c++) {
+    state[c].predictor = static_cast<int16_t>(p[0] | (p[1] << 8));
+    if (p[2] > kMaxStepIndex) {
+      return false;
+    }
+    state[c].stepIndex = p[2];
+    samples[c] = static_cast<int16_t>(state[c].predictor);
+    p += 4;
+  }
+
+  for (uint32_t frame = 1; frame < frames; frame += 8) {
+    for (uint16_t c = 0; c < channels; c++) {
+      int16_t* s = samples.data() + static_cast<size_t>(frame) * channels + c;
+      for (int i = 0; i < 8; i += 2) {
+        uint8_t byte = *p++;
+        ApplyNibble(state[c], byte & 0x0F);
+        s[i * channels] = static_cast<int16_t>(state[c].predictor);
+        ApplyNibble(state[c], byte >> 4);
+        s[(i + 1) * channels] = static_cast<int16_t>(state[c].predictor);
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace windows_loopback_recorder
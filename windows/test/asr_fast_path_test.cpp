@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "windows_loopback_recorder/asr_fast_path.h"
+
+namespace windows_loopback_recorder {
+namespace test {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Stereo float loopback: the same tone in both channels
+std::vector<float> Tone(double hz, double amplitude, size_t frames) {
+  std::vector<float> samples(frames * 2);
+  for (size_t i = 0; i < frames; i++) {
+    float value = static_cast<float>(amplitude * std::sin(2.0 * kPi * hz * i / AsrFastPath::kInputRate));
+    samples[i * 2] = value;
+    samples[i * 2 + 1] = value;
+  }
+  return samples;
+}
+
+std::vector<int16_t> Decimate(AsrFastPath& path, const std::vector<float>& system, size_t packet) {
+  size_t frames = system.size() / 2;
+  std::vector<int16_t> out(AsrFastPath::MaxOutput(frames) + frames / packet + 1);
+  size_t written = 0;
+  for (size_t i = 0; i < frames; i += packet) {
+    size_t count = std::min(packet, frames - i);
+    written += path.Process(&system[i * 2], count, static_cast<const int16_t*>(nullptr), 0, 0,
+                            &out[written], nullptr, nullptr);
+  }
+  out.resize(written);
+  return out;
+}
+
+double Rms(const std::vector<int16_t>& samples, size_t first) {
+  double sum = 0.0;
+  for (size_t i = first; i < samples.size(); i++) {
+    sum += static_cast<double>(samples[i]) * samples[i];
+  }
+  return std::sqrt(sum / (samples.size() - first)) / 32767.0;
+}
+
+}  // namespace
+
+TEST(AsrFastPath, KeepsSpeechAndRejectsWhatWouldAlias) {
+  AsrFastPath path;
+  std::vector<int16_t> speech = Decimate(path, Tone(1000.0, 0.5, 48000), 480);
+  EXPECT_EQ(speech.size(), 16000u);
+  EXPECT_NEAR(Rms(speech, 1000), 0.5 / std::sqrt(2.0), 0.005);
+
+  // 9 kHz would fold back to 7 kHz at 16 kHz
+  path.Reset();
+  std::vector<int16_t> alias = Decimate(path, Tone(9000.0, 0.5, 48000), 480);
+  EXPECT_LT(20.0 * std::log10(Rms(alias, 1000) / (0.5 / std::sqrt(2.0)) + 1e-9), -70.0);
+}
+
+TEST(AsrFastPath, OutputDoesNotDependOnPacketSize) {
+  std::vector<float> system = Tone(440.0, 0.3, 9600);
+  AsrFastPath whole;
+  AsrFastPath pieces;
+  std::vector<int16_t> a = Decimate(whole, system, 9600);
+  std::vector<int16_t> b = Decimate(pieces, system, 441);
+  EXPECT_EQ(a, b);
+
+  // An impulse comes out kDelayFrames / kFactor samples later
+  AsrFastPath impulse;
+  std::vector<float> click(4800 * 2, 0.0f);
+  click[1200 * 2] = 1.0f;
+  click[1200 * 2 + 1] = 1.0f;
+  std::vector<int16_t> out = Decimate(impulse, click, 480);
+  size_t peak = std::max_element(out.begin(), out.end()) - out.begin();
+  EXPECT_EQ(peak, (1200 + AsrFastPath::kDelayFrames) / AsrFastPath::kFactor);
+}
+
+TEST(AsrFastPath, MixesTheMicrophoneLikeTheGenericMix) {
+  // Constant levels pass the low-pass unchanged once it settles
+  size_t frames = 4800;
+  std::vector<float> system(frames * 2);
+  for (size_t i = 0; i < frames; i++) {
+    system[i * 2] = 0.2f;
+    system[i * 2 + 1] = 0.9f;
+  }
+  // A mono microphone lands on the left channel; the right one clips
+  std::vector<float> mic(frames, 0.25f);
+  std::vector<float> stereoMic(frames * 2, 0.25f);
+
+  SourceLevels systemMeter;
+  SourceLevels micMeter;
+  systemMeter.Begin(2);
+  micMeter.Begin(1);
+  AsrFastPath path;
+  std::vector<int16_t> out(AsrFastPath::MaxOutput(frames));
+  size_t written = path.Process(system.data(), frames, mic.data(), 1, frames, out.data(),
+                                &systemMeter, &micMeter);
+  EXPECT_EQ(written, frames / 3);
+  EXPECT_NEAR(out[written - 1] / 32767.0, 0.5 * (0.45 + 0.9), 1e-3);
+  std::vector<ChannelLevels> levels;
+  micMeter.Finish(frames, levels);
+  ASSERT_EQ(levels.size(), 1u);
+  EXPECT_NEAR(levels[0].rms, 0.25f, 1e-4);
+
+  path.Reset();
+  written = path.Process(system.data(), frames, stereoMic.data(), 2, frames, out.data(), nullptr, nullptr);
+  EXPECT_NEAR(out[written - 1] / 32767.0, 0.5 * (0.45 + 1.0), 1e-3);
+
+  // A short microphone packet only adds to the frames it has
+  path.Reset();
+  std::vector<int16_t> quiet(frames / 2, 8192);
+  written = path.Process(system.data(), frames, quiet.data(), 1, frames / 2, out.data(), nullptr, nullptr);
+  EXPECT_NEAR(out[written - 1] / 32767.0, 0.5 * (0.2 + 0.9), 1e-3);
+  EXPECT_NEAR(out[written / 2 - 100] / 32767.0, 0.5 * (0.45 + 0.9), 1e-3);
+}
+
+TEST(AsrFastPath, SupportsOnlyTheAsrFormats) {
+  EXPECT_TRUE(AsrFastPath::Supports(48000, 2, 32, 16000, 1, 16));
+  EXPECT_FALSE(AsrFastPath::Supports(44100, 2, 32, 16000, 1, 16));
+  EXPECT_FALSE(AsrFastPath::Supports(48000, 6, 32, 16000, 1, 16));
+  EXPECT_FALSE(AsrFastPath::Supports(48000, 2, 16, 16000, 1, 16));
+  EXPECT_FALSE(AsrFastPath::Supports(48000, 2, 32, 16000, 2, 16));
+  EXPECT_FALSE(AsrFastPath::Supports(48000, 2, 32, 8000, 1, 16));
+}
+
+}  // namespace test
+}  // namespace windows_loopback_recorder
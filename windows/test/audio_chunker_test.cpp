@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "windows_loopback_recorder/audio_chunker.h"
+
+namespace windows_loopback_recorder {
+namespace test {
+
+namespace {
+
+// 48 kHz stereo 16-bit: 4 bytes per frame, 10 ms = 480 frames = 1920 bytes.
+constexpr uint32_t kSampleRate = 48000;
+constexpr uint32_t kBytesPerFrame = 4;
+
+std::vector<uint8_t> MakeRamp(size_t size, uint8_t start) {
+  std::vector<uint8_t> data(size);
+  for (size_t i = 0; i < size; i++) {
+    data[i] = static_cast<uint8_t>(start + i);
+  }
+  return data;
+}
+
+}  // namespace
+
+TEST(AudioChunker, DisabledByDefault) {
+  AudioChunker chunker;
+  chunker.Configure(ChunkingConfig(), kSampleRate, kBytesPerFrame);
+  EXPECT_FALSE(chunker.enabled());
+}
+
+TEST(AudioChunker, EmitsExactFramesAcrossIrregularPackets) {
+  AudioChunker chunker;
+  ChunkingConfig config;
+  config.frameDurationMs = 10;
+  chunker.Configure(config, kSampleRate, kBytesPerFrame);
+
+  std::vector<uint8_t> input;
+  std::vector<std::vector<uint8_t>> chunks;
+  auto emit = [&chunks](std::vector<uint8_t>& chunk) { chunks.push_back(chunk); };
+
+  // Packets of 3, 7, 20 and 13 ms, as WASAPI tends to produce.
+  for (uint32_t ms : {3u, 7u, 20u, 13u}) {
+    auto packet = MakeRamp(kSampleRate * ms / 1000 * kBytesPerFrame, static_cast<uint8_t>(input.size()));
+    input.insert(input.end(), packet.begin(), packet.end());
+    chunker.Push(packet.data(), packet.size(), emit);
+  }
+
+  ASSERT_EQ(chunks.size(), 4u);
+  std::vector<uint8_t> output;
+  for (const auto& chunk : chunks) {
+    EXPECT_EQ(chunk.size(), 1920u);
+    output.insert(output.end(), chunk.begin(), chunk.end());
+  }
+  EXPECT_TRUE(std::equal(output.begin(), output.end(), input.begin()));
+  EXPECT_EQ(chunker.pendingBytes(), 144u * kBytesPerFrame);
+
+  // The flushed tail is padded to a full frame with silence.
+  chunker.Flush(emit);
+  ASSERT_EQ(chunks.size(), 5u);
+  EXPECT_EQ(chunks.back().size(), 1920u);
+  EXPECT_EQ(chunks.back()[1440], 0);
+  EXPECT_EQ(chunker.pendingBytes(), 0u);
+}
+
+TEST(AudioChunker, CoalescesToMinimumSize) {
+  AudioChunker chunker;
+  ChunkingConfig config;
+  config.minChunkBytes = 4000;
+  chunker.Configure(config, kSampleRate, kBytesPerFrame);
+
+  std::vector<size_t> sizes;
+  auto emit = [&sizes](std::vector<uint8_t>& chunk) { sizes.push_back(chunk.size()); };
+
+  auto packet = MakeRamp(1920, 0);
+  for (int i = 0; i < 5; i++) {
+    chunker.Push(packet.data(), packet.size(), emit);
+  }
+
+  // Emitted once 4000 bytes were reached, never splitting a packet.
+  ASSERT_EQ(sizes.size(), 1u);
+  EXPECT_EQ(sizes[0], 5760u);
+  chunker.Flush(emit);
+  ASSERT_EQ(sizes.size(), 2u);
+  EXPECT_EQ(sizes[1], 3840u);
+}
+
+TEST(AudioChunker, MaxLatencyBoundsPendingAudio) {
+  AudioChunker chunker;
+  ChunkingConfig config;
+  config.minChunkBytes = 1000000;
+  config.maxLatencyMs = 25;
+  chunker.Configure(config, kSampleRate, kBytesPerFrame);
+
+  std::vector<size_t> sizes;
+  auto emit = [&sizes](std::vector<uint8_t>& chunk) { sizes.push_back(chunk.size()); };
+
+  auto packet = MakeRamp(1920, 0);  // 10 ms
+  for (int i = 0; i < 6; i++) {
+    chunker.Push(packet.data(), packet.size(), emit);
+  }
+
+  ASSERT_EQ(sizes.size(), 2u);
+  EXPECT_EQ(sizes[0], 3u * 1920);
+  EXPECT_EQ(sizes[1], 3u * 1920);
+}
+
+}  // namespace test
+}  // namespace windows_loopback_recorder
@@ -0,0 +1,300 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "windows_loopback_recorder/audio_engine.h"
+
+namespace windows_loopback_recorder {
+namespace test {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Loopback only, 16-bit output in the loopback's rate and layout
+EngineConfig Session(SampleFormat format, uint32_t rate, uint16_t channels) {
+  EngineConfig config;
+  config.systemFormat = format;
+  config.systemRate = rate;
+  config.systemChannels = channels;
+  config.outputRate = rate;
+  config.outputChannels = channels;
+  return config;
+}
+
+template <typename Sample>
+std::vector<uint8_t> Bytes(const std::vector<Sample>& samples) {
+  std::vector<uint8_t> bytes(samples.size() * sizeof(Sample));
+  std::memcpy(bytes.data(), samples.data(), bytes.size());
+  return bytes;
+}
+
+template <typename Sample>
+std::vector<Sample> Samples(const std::vector<uint8_t>& bytes) {
+  std::vector<Sample> samples(bytes.size() / sizeof(Sample));
+  std::memcpy(samples.data(), bytes.data(), samples.size() * sizeof(Sample));
+  return samples;
+}
+
+// The same tone in every channel
+std::vector<float> Tone(double hz, double amplitude, uint32_t rate, uint16_t channels, size_t frames,
+                        size_t first = 0) {
+  std::vector<float> samples(frames * channels);
+  for (size_t i = 0; i < frames; i++) {
+    float value = static_cast<float>(amplitude * std::sin(2.0 * kPi * hz * (first + i) / rate));
+    std::fill_n(&samples[i * channels], channels, value);
+  }
+  return samples;
+}
+
+double Rms(const std::vector<int16_t>& samples, size_t first) {
+  double sum = 0.0;
+  for (size_t i = first; i < samples.size(); i++) {
+    sum += static_cast<double>(samples[i]) * samples[i];
+  }
+  return std::sqrt(sum / (samples.size() - first)) / 32767.0;
+}
+
+}  // namespace
+
+TEST(AudioEngine, MixesSixteenBitSourcesAsTheyAre) {
+  EngineConfig config = Session(SampleFormat::PCM16, 48000, 2);
+  config.micFormat = SampleFormat::PCM16;
+  config.micRate = 48000;
+  config.micChannels = 2;
+  AudioEngine engine;
+  ASSERT_TRUE(engine.Configure(config));
+  EXPECT_FALSE(engine.converting());
+  EXPECT_FALSE(engine.fastPath());
+  EXPECT_FALSE(engine.quantizing());
+  EXPECT_EQ(engine.bytesPerSample(), 2);
+
+  std::vector<int16_t> system = {1000, -1000, 32000, -32000, 7, 0};
+  std::vector<int16_t> mic = {500, 500, 1000, -1000};
+  std::vector<uint8_t> systemBytes = Bytes(system);
+  std::vector<uint8_t> micBytes = Bytes(mic);
+  std::vector<uint8_t> output;
+  std::vector<uint8_t> delivery;
+  SourceLevels systemMeter;
+  SourceLevels micMeter;
+  EngineMeters meters;
+  meters.system = &systemMeter;
+  meters.mic = &micMeter;
+  engine.Process(systemBytes.data(), 3, micBytes.data(), 2, true, meters, output, delivery);
+  EXPECT_EQ(Samples<int16_t>(output), (std::vector<int16_t>{1500, -500, 32767, -32768, 7, 0}));
+  EXPECT_TRUE(delivery.empty());
+  EXPECT_EQ(engine.CleanedMic(micBytes.data()), micBytes.data());
+
+  std::vector<ChannelLevels> levels;
+  systemMeter.Finish(3, levels);
+  ASSERT_EQ(levels.size(), 2u);
+  EXPECT_NEAR(levels[0].peak, 32000.0f / 32768.0f, 1e-4);
+  micMeter.Finish(2, levels);
+  ASSERT_EQ(levels.size(), 2u);
+
+  // A loopback encoding the mix cannot read is copied through
+  config = Session(SampleFormat::UNSUPPORTED, 48000, 2);
+  config.systemBlockAlign = 16;
+  ASSERT_TRUE(engine.Configure(config));
+  std::vector<uint8_t> raw(32);
+  for (size_t i = 0; i < raw.size(); i++) raw[i] = static_cast<uint8_t>(i);
+  engine.Process(raw.data(), 2, nullptr, 0, true, EngineMeters(), output, delivery);
+  EXPECT_EQ(output, raw);
+
+  // And nothing happens unconfigured
+  engine.Clear();
+  engine.Process(systemBytes.data(), 3, nullptr, 0, true, EngineMeters(), output, delivery);
+  EXPECT_TRUE(output.empty());
+  EXPECT_FALSE(engine.Configure(Session(SampleFormat::PCM16, 48000, 0)));
+}
+
+TEST(AudioEngine, ConvertsLayoutThenRate) {
+  EngineConfig config = Session(SampleFormat::FLOAT32, 44100, 2);
+  config.outputRate = 48000;
+  config.outputChannels = 1;
+  AudioEngine engine;
+  ASSERT_TRUE(engine.Configure(config));
+  EXPECT_TRUE(engine.converting());
+
+  std::vector<int16_t> mono;
+  std::vector<uint8_t> output;
+  std::vector<uint8_t> delivery;
+  std::vector<ChannelLevels> levels;
+  AudioMeter meter;
+  ASSERT_TRUE(meter.Configure(1));
+  EngineMeters meters;
+  meters.output = &meter;
+  meters.levels = &levels;
+  for (size_t packet = 0; packet < 100; packet++) {
+    std::vector<uint8_t> system = Bytes(Tone(1000.0, 0.5, 44100, 2, 441, packet * 441));
+    engine.Process(system.data(), 441, nullptr, 0, true, meters, output, delivery);
+    std::vector<int16_t> samples = Samples<int16_t>(output);
+    mono.insert(mono.end(), samples.begin(), samples.end());
+    // Resampled audio is metered as it is converted back to 16-bit
+    EXPECT_EQ(levels.size(), 1u);
+  }
+  EXPECT_NEAR(static_cast<double>(mono.size()), 48000.0, 100.0);
+  EXPECT_NEAR(Rms(mono, 1000), 0.5 / std::sqrt(2.0), 0.01);
+
+  // Analysis converts the layout only, at the device rate
+  std::vector<uint8_t> system = Bytes(Tone(1000.0, 0.5, 44100, 2, 441));
+  engine.Process(system.data(), 441, nullptr, 0, false, meters, output, delivery);
+  EXPECT_EQ(output.size(), 441u * 2);
+  EXPECT_TRUE(levels.empty());
+}
+
+TEST(AudioEngine, DeliversDeeperSamplesBesideSixteenBit) {
+  EngineConfig config = Session(SampleFormat::FLOAT32, 48000, 2);
+  config.outputFormat = SampleFormat::PCM24;
+  AudioEngine engine;
+  ASSERT_TRUE(engine.Configure(config));
+  EXPECT_TRUE(engine.quantizing());
+  EXPECT_EQ(engine.outputFormat(), SampleFormat::PCM24);
+  EXPECT_EQ(engine.bytesPerSample(), 3);
+
+  std::vector<uint8_t> system = Bytes(std::vector<float>{0.25f, -0.5f, 1.5f, 0.0f});
+  std::vector<uint8_t> output;
+  std::vector<uint8_t> delivery;
+  engine.Process(system.data(), 2, nullptr, 0, true, EngineMeters(), output, delivery);
+  ASSERT_EQ(delivery.size(), 4u * 3);
+  auto pcm24 = [&](size_t i) {
+    int32_t value = delivery[i * 3] | delivery[i * 3 + 1] << 8 | delivery[i * 3 + 2] << 16;
+    return value << 8 >> 8;
+  };
+  EXPECT_EQ(pcm24(0), 2097152);
+  EXPECT_EQ(pcm24(1), -4194304);
+  EXPECT_EQ(pcm24(2), 8388607);
+  // The other stages get the 16-bit conversion they always had
+  EXPECT_EQ(Samples<int16_t>(output), (std::vector<int16_t>{8191, -16383, 32767, 0}));
+
+  // Without converting there is nothing to deliver
+  engine.Process(system.data(), 2, nullptr, 0, false, EngineMeters(), output, delivery);
+  EXPECT_TRUE(delivery.empty());
+  EXPECT_EQ(output.size(), 4u * 2);
+
+  // Encoders take 16-bit samples; 32-bit integers need no dither
+  config.encoded = true;
+  ASSERT_TRUE(engine.Configure(config));
+  EXPECT_FALSE(engine.quantizing());
+  EXPECT_EQ(engine.outputFormat(), SampleFormat::PCM16);
+  config.encoded = false;
+  config.outputFormat = SampleFormat::PCM32;
+  config.dither = DitherMode::TRIANGULAR;
+  ASSERT_TRUE(engine.Configure(config));
+  EXPECT_EQ(engine.outputFormat(), SampleFormat::PCM32);
+  EXPECT_EQ(engine.dither(), DitherMode::NONE);
+}
+
+TEST(AudioEngine, FusesTheSpeechRecognitionFormatWhenConverting) {
+  EngineConfig config = Session(SampleFormat::FLOAT32, 48000, 2);
+  config.outputRate = 16000;
+  config.outputChannels = 1;
+  AudioEngine engine;
+  ASSERT_TRUE(engine.Configure(config));
+  EXPECT_TRUE(engine.fastPath());
+
+  std::vector<uint8_t> output;
+  std::vector<uint8_t> delivery;
+  std::vector<int16_t> speech;
+  for (size_t packet = 0; packet < 100; packet++) {
+    std::vector<uint8_t> system = Bytes(Tone(1000.0, 0.5, 48000, 2, 480, packet * 480));
+    engine.Process(system.data(), 480, nullptr, 0, true, EngineMeters(), output, delivery);
+    EXPECT_EQ(output.size(), 160u * 2);
+    std::vector<int16_t> samples = Samples<int16_t>(output);
+    speech.insert(speech.end(), samples.begin(), samples.end());
+  }
+  EXPECT_NEAR(Rms(speech, 1000), 0.5 / std::sqrt(2.0), 0.005);
+
+  // Analysis-only packets go the generic way, at the device rate
+  std::vector<uint8_t> system = Bytes(Tone(1000.0, 0.5, 48000, 2, 480));
+  engine.Process(system.data(), 480, nullptr, 0, false, EngineMeters(), output, delivery);
+  EXPECT_EQ(output.size(), 480u * 2);
+
+  // Dithered output is rounded in float instead
+  config.dither = DitherMode::TRIANGULAR;
+  ASSERT_TRUE(engine.Configure(config));
+  EXPECT_FALSE(engine.fastPath());
+  EXPECT_TRUE(engine.quantizing());
+}
+
+TEST(AudioEngine, CleansTheSourcesTheFormatsAllow) {
+  EngineConfig config = Session(SampleFormat::FLOAT32, 48000, 2);
+  config.micFormat = SampleFormat::FLOAT32;
+  config.micRate = 44100;
+  config.micChannels = 1;
+  config.echoCancellation = true;
+  config.micNoiseSuppression = true;
+  config.systemNoiseSuppression = true;
+  AudioEngine engine;
+  ASSERT_TRUE(engine.Configure(config));
+  // The canceller pairs frames one to one; the suppressors run at any rate
+  EXPECT_EQ(engine.echoCanceller(), nullptr);
+  ASSERT_NE(engine.micSuppressor(), nullptr);
+  ASSERT_NE(engine.systemSuppressor(), nullptr);
+
+  config.micRate = 48000;
+  ASSERT_TRUE(engine.Configure(config));
+  EXPECT_NE(engine.echoCanceller(), nullptr);
+  EXPECT_EQ(engine.micNoiseDb(), -120.0f);
+
+  std::mt19937 random(5);
+  std::normal_distribution<float> noise(0.0f, 0.05f);
+  std::vector<uint8_t> output;
+  std::vector<uint8_t> delivery;
+  for (size_t packet = 0; packet < 200; packet++) {
+    std::vector<float> system(480 * 2);
+    std::vector<float> mic(480);
+    for (float& sample : system) sample = noise(random);
+    for (float& sample : mic) sample = noise(random);
+    std::vector<uint8_t> systemBytes = Bytes(system);
+    std::vector<uint8_t> micBytes = Bytes(mic);
+    engine.Process(systemBytes.data(), 480, micBytes.data(), 480, true, EngineMeters(), output, delivery);
+    // The detectors downstream hear the cleaned microphone
+    const uint8_t* cleaned = engine.CleanedMic(micBytes.data());
+    ASSERT_NE(cleaned, micBytes.data());
+    EXPECT_EQ(engine.CleanedMic(nullptr), nullptr);
+  }
+  EXPECT_GT(engine.micNoiseDb(), -120.0f);
+  EXPECT_GT(engine.systemNoiseDb(), -120.0f);
+
+  engine.Clear();
+  EXPECT_EQ(engine.micSuppressor(), nullptr);
+  EXPECT_EQ(engine.micNoiseDb(), -120.0f);
+}
+
+TEST(AudioEngine, WidensIntegerPacketsOnce) {
+  EngineConfig config = Session(SampleFormat::PCM24, 48000, 2);
+  AudioEngine engine;
+  ASSERT_TRUE(engine.Configure(config));
+
+  // 0.5 and -0.25 of full scale, packed
+  std::vector<uint8_t> packet = {0x00, 0x00, 0x40, 0x00, 0x00, 0xE0};
+  uint8_t* system = packet.data();
+  uint8_t* mic = nullptr;
+  engine.Widen(system, 1, mic, 0);
+  ASSERT_NE(system, packet.data());
+  EXPECT_EQ(mic, nullptr);
+  float widened[2];
+  std::memcpy(widened, system, sizeof(widened));
+  EXPECT_EQ(widened[0], 0.5f);
+  EXPECT_EQ(widened[1], -0.25f);
+
+  std::vector<uint8_t> output;
+  std::vector<uint8_t> delivery;
+  engine.Process(system, 1, nullptr, 0, true, EngineMeters(), output, delivery);
+  EXPECT_EQ(Samples<int16_t>(output), (std::vector<int16_t>{16383, -8191}));
+
+  // 16-bit packets are read where they are
+  ASSERT_TRUE(engine.Configure(Session(SampleFormat::PCM16, 48000, 2)));
+  system = packet.data();
+  engine.Widen(system, 1, mic, 0);
+  EXPECT_EQ(system, packet.data());
+}
+
+}  // namespace test
+}  // namespace windows_loopback_recorder
@@ -0,0 +1,166 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "windows_loopback_recorder/audio_meter.h"
+
+namespace windows_loopback_recorder {
+namespace test {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Interleaved 16-bit sine; |phase| in radians
+std::vector<int16_t> MakeSine(size_t frames, uint16_t channels, double cyclesPerSample,
+                              double amplitude, double phase = 0.0) {
+  std::vector<int16_t> samples;
+  for (size_t i = 0; i < frames; i++) {
+    double value = amplitude * std::sin(2 * kPi * cyclesPerSample * i + phase);
+    for (uint16_t c = 0; c < channels; c++) {
+      samples.push_back(static_cast<int16_t>(std::lround(value * 32767.0)));
+    }
+  }
+  return samples;
+}
+
+}  // namespace
+
+TEST(AudioMeter, RejectsUnsupportedChannelCounts) {
+  AudioMeter meter;
+  EXPECT_FALSE(meter.Configure(0));
+  EXPECT_FALSE(meter.Configure(AudioMeter::kMaxChannels + 1));
+  EXPECT_TRUE(meter.Configure(6));
+}
+
+TEST(AudioMeter, FullScaleSineMatchesReferenceLevels) {
+  AudioMeter meter;
+  ASSERT_TRUE(meter.Configure(2));
+  // 997 Hz at 48 kHz, the usual reference tone: RMS is 1/sqrt(2) (-3.01 dB)
+  std::vector<int16_t> samples = MakeSine(48000, 2, 997.0 / 48000, 1.0);
+
+  std::vector<ChannelLevels> levels;
+  meter.Measure(samples.data(), 48000, levels);
+  ASSERT_EQ(levels.size(), 2u);
+  for (const ChannelLevels& channel : levels) {
+    EXPECT_NEAR(channel.rms, 1.0 / std::sqrt(2.0), 1e-4);
+    EXPECT_NEAR(channel.peak, 1.0, 1e-3);
+    EXPECT_NEAR(channel.truePeak, 1.0, 0.01);
+  }
+}
+
+TEST(AudioMeter, TruePeakFindsIntersamplePeaks) {
+  AudioMeter meter;
+  ASSERT_TRUE(meter.Configure(1));
+  // A quarter of the sample rate, 45 degrees off: every sample lands at
+  // +-0.707 of the real peak, the case sample peak meters miss by 3 dB
+  std::vector<int16_t> samples = MakeSine(4800, 1, 0.25, 0.5, kPi / 4);
+
+  std::vector<ChannelLevels> levels;
+  meter.Measure(samples.data(), 4800, levels);
+  EXPECT_NEAR(levels[0].peak, 0.5 / std::sqrt(2.0), 1e-3);
+  EXPECT_NEAR(levels[0].truePeak, 0.5, 0.01);
+  EXPECT_NEAR(levels[0].rms, 0.5 / std::sqrt(2.0), 1e-3);
+}
+
+TEST(AudioMeter, FilterHistorySpansCalls) {
+  std::mt19937 random(7);
+  std::uniform_int_distribution<int> sample(-20000, 20000);
+  std::vector<int16_t> samples(3 * 1000);
+  for (int16_t& value : samples) {
+    value = static_cast<int16_t>(sample(random));
+  }
+
+  AudioMeter whole;
+  ASSERT_TRUE(whole.Configure(3));
+  std::vector<ChannelLevels> expected;
+  whole.Measure(samples.data(), 1000, expected);
+
+  // Irregular calls, some shorter than the filter, must find the same peaks
+  AudioMeter split;
+  ASSERT_TRUE(split.Configure(3));
+  std::vector<float> peak(3, 0.0f), truePeak(3, 0.0f);
+  std::vector<ChannelLevels> levels;
+  for (size_t done = 0, step = 1; done < 1000; done += step, step = step * 3 % 311 + 1) {
+    size_t frames = std::min<size_t>(step, 1000 - done);
+    split.Measure(samples.data() + done * 3, frames, levels);
+    for (int c = 0; c < 3; c++) {
+      peak[c] = std::max(peak[c], levels[c].peak);
+      truePeak[c] = std::max(truePeak[c], levels[c].truePeak);
+    }
+  }
+  for (int c = 0; c < 3; c++) {
+    EXPECT_FLOAT_EQ(peak[c], expected[c].peak);
+    EXPECT_NEAR(truePeak[c], expected[c].truePeak, 1e-6);
+  }
+}
+
+TEST(AudioMeter, ConvertAndMeasureMatchesSeparatePasses) {
+  std::mt19937 random(11);
+  std::uniform_real_distribution<float> sample(-1.25f, 1.25f);
+  constexpr size_t kFrames = 1003;
+  std::vector<float> input(kFrames * 2);
+  for (float& value : input) {
+    value = sample(random);
+  }
+
+  AudioMeter meter;
+  ASSERT_TRUE(meter.Configure(2));
+  std::vector<int16_t> output(input.size());
+  std::vector<ChannelLevels> levels;
+  meter.ConvertAndMeasure(input.data(), kFrames, output.data(), levels);
+
+  for (size_t i = 0; i < input.size(); i++) {
+    float clamped = std::min(1.0f, std::max(-1.0f, input[i]));
+    ASSERT_EQ(output[i], static_cast<int16_t>(clamped * 32767.0f)) << "sample " << i;
+  }
+  for (int c = 0; c < 2; c++) {
+    double squares = 0.0;
+    float peak = 0.0f;
+    for (size_t i = 0; i < kFrames; i++) {
+      squares += static_cast<double>(input[i * 2 + c]) * input[i * 2 + c];
+      peak = std::max(peak, std::fabs(input[i * 2 + c]));
+    }
+    EXPECT_NEAR(levels[c].rms, std::sqrt(squares / kFrames), 1e-5);
+    EXPECT_FLOAT_EQ(levels[c].peak, peak);
+    EXPECT_GT(levels[c].peak, 1.0f);  // Levels see the overs the conversion clipped
+  }
+}
+
+TEST(AudioMeter, CombineAveragesPowerAndKeepsLargestPeaks) {
+  std::vector<ChannelLevels> levels(2);
+  levels[0].rms = 0.6f;
+  levels[0].peak = 0.9f;
+  levels[0].truePeak = 1.1f;
+  levels[1].rms = 0.8f;
+  levels[1].peak = 0.95f;
+  levels[1].truePeak = 1.0f;
+
+  ChannelLevels combined = AudioMeter::Combine(levels);
+  EXPECT_NEAR(combined.rms, std::sqrt((0.36 + 0.64) / 2), 1e-6);
+  EXPECT_FLOAT_EQ(combined.peak, 0.95f);
+  EXPECT_FLOAT_EQ(combined.truePeak, 1.1f);
+}
+
+TEST(SourceLevels, MetersInsideAnotherLoop) {
+  SourceLevels source;
+  source.Begin(2);
+  for (int i = 0; i < 100; i++) {
+    source.Add(0, i % 2 ? 0.5f : -0.5f);
+    source.Add(1, i == 50 ? -0.9f : 0.0f);
+  }
+  std::vector<ChannelLevels> levels;
+  source.Finish(100, levels);
+  ASSERT_EQ(levels.size(), 2u);
+  EXPECT_FLOAT_EQ(levels[0].rms, 0.5f);
+  EXPECT_FLOAT_EQ(levels[0].peak, 0.5f);
+  EXPECT_NEAR(levels[1].rms, 0.09, 1e-6);
+  EXPECT_FLOAT_EQ(levels[1].truePeak, 0.9f);
+}
+
+}  // namespace test
+}  // namespace windows_loopback_recorder
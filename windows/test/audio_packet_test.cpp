@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "windows_loopback_recorder/audio_chunker.h"
+#include "windows_loopback_recorder/audio_packet.h"
+
+namespace windows_loopback_recorder {
+namespace test {
+
+namespace {
+
+constexpr uint32_t kSampleRate = 48000;
+constexpr uint32_t kBytesPerFrame = 4;
+
+AudioPacketHeader ReadHeader(const std::vector<uint8_t>& packet) {
+  AudioPacketHeader header;
+  std::memcpy(&header, packet.data(), sizeof(header));
+  return header;
+}
+
+}  // namespace
+
+TEST(AudioPacketizer, StampsFixedLayoutHeader) {
+  AudioPacketizer packetizer;
+  packetizer.Configure(true, kSampleRate, 2, AUDIO_FORMAT_PCM_S16, kBytesPerFrame);
+
+  std::vector<uint8_t> chunk(480 * kBytesPerFrame, 0x11);
+  packetizer.OnCapturedAudio(chunk.size(), 1000000, AUDIO_PACKET_DISCONTINUITY);
+  packetizer.Stamp(chunk);
+
+  ASSERT_EQ(chunk.size(), sizeof(AudioPacketHeader) + 480 * kBytesPerFrame);
+  // Spot-check the wire layout byte by byte.
+  EXPECT_EQ(chunk[0], 'W');
+  EXPECT_EQ(chunk[1], 'L');
+  EXPECT_EQ(chunk[2], 'R');
+  EXPECT_EQ(chunk[3], 'P');
+  EXPECT_EQ(chunk[4], 48);
+  EXPECT_EQ(chunk[5], kAudioPacketVersion);
+
+  AudioPacketHeader header = ReadHeader(chunk);
+  EXPECT_EQ(header.flags, AUDIO_PACKET_DISCONTINUITY);
+  EXPECT_EQ(header.sequence, 0u);
+  EXPECT_EQ(header.frameCount, 480u);
+  EXPECT_EQ(header.firstSampleIndex, 0u);
+  EXPECT_EQ(header.captureTime, 1000000);
+  EXPECT_EQ(header.sampleRate, kSampleRate);
+  EXPECT_EQ(header.channels, 2);
+  EXPECT_EQ(header.formatId, AUDIO_FORMAT_PCM_S16);
+  EXPECT_EQ(header.speechProbability, -1.0f);
+  EXPECT_EQ(chunk[sizeof(AudioPacketHeader)], 0x11);
+}
+
+TEST(AudioPacketizer, TracksTimingThroughChunker) {
+  AudioPacketizer packetizer;
+  packetizer.Configure(true, kSampleRate, 2, AUDIO_FORMAT_PCM_S16, kBytesPerFrame);
+  AudioChunker chunker;
+  ChunkingConfig config;
+  config.frameDurationMs = 10;
+  chunker.Configure(config, kSampleRate, kBytesPerFrame);
+
+  std::vector<AudioPacketHeader> headers;
+  auto emit = [&](std::vector<uint8_t>& chunk) {
+    packetizer.Stamp(chunk);
+    headers.push_back(ReadHeader(chunk));
+  };
+
+  // Two 15 ms capture packets; the second arrives 150000 ticks later and is
+  // reported silent.
+  std::vector<uint8_t> packet(720 * kBytesPerFrame, 0);
+  packetizer.OnCapturedAudio(packet.size(), 5000000, 0);
+  chunker.Push(packet.data(), packet.size(), emit);
+  packetizer.OnCapturedAudio(packet.size(), 5150000, AUDIO_PACKET_SILENT);
+  chunker.Push(packet.data(), packet.size(), emit);
+
+  ASSERT_EQ(headers.size(), 3u);
+  for (uint32_t i = 0; i < 3; i++) {
+    EXPECT_EQ(headers[i].sequence, i);
+    EXPECT_EQ(headers[i].frameCount, 480u);
+    EXPECT_EQ(headers[i].firstSampleIndex, 480u * i);
+    // 10 ms per frame = 100000 ticks
+    EXPECT_EQ(headers[i].captureTime, 5000000 + 100000 * static_cast<int64_t>(i));
+  }
+  EXPECT_EQ(headers[0].flags & AUDIO_PACKET_SILENT, 0);
+  // The second frame mixes audible and silent packets; the third is silent.
+  EXPECT_EQ(headers[1].flags & AUDIO_PACKET_SILENT, 0);
+  EXPECT_EQ(headers[2].flags & AUDIO_PACKET_SILENT, AUDIO_PACKET_SILENT);
+}
+
+TEST(AudioPacketizer, CarriesSpeechThroughChunker) {
+  AudioPacketizer packetizer;
+  packetizer.Configure(true, kSampleRate, 2, AUDIO_FORMAT_PCM_S16, kBytesPerFrame);
+  AudioChunker chunker;
+  ChunkingConfig config;
+  config.frameDurationMs = 10;
+  chunker.Configure(config, kSampleRate, kBytesPerFrame);
+
+  std::vector<AudioPacketHeader> headers;
+  auto emit = [&](std::vector<uint8_t>& chunk) {
+    packetizer.Stamp(chunk);
+    headers.push_back(ReadHeader(chunk));
+  };
+
+  // Speech, then 15 ms judged not to be speech
+  std::vector<uint8_t> packet(720 * kBytesPerFrame, 0);
+  packetizer.OnCapturedAudio(packet.size(), 0, AUDIO_PACKET_SPEECH, 0.9f);
+  chunker.Push(packet.data(), packet.size(), emit);
+  packetizer.OnCapturedAudio(packet.size(), 150000, 0, 0.2f);
+  chunker.Push(packet.data(), packet.size(), emit);
+
+  ASSERT_EQ(headers.size(), 3u);
+  // The second frame straddles both packets and keeps the higher probability.
+  EXPECT_EQ(headers[0].flags & AUDIO_PACKET_SPEECH, AUDIO_PACKET_SPEECH);
+  EXPECT_EQ(headers[0].speechProbability, 0.9f);
+  EXPECT_EQ(headers[1].flags & AUDIO_PACKET_SPEECH, AUDIO_PACKET_SPEECH);
+  EXPECT_EQ(headers[1].speechProbability, 0.9f);
+  EXPECT_EQ(headers[2].flags & AUDIO_PACKET_SPEECH, 0);
+  EXPECT_EQ(headers[2].speechProbability, 0.2f);
+}
+
+}  // namespace test
+}  // namespace windows_loopback_recorder
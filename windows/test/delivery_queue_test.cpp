@@ -0,0 +1,251 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "windows_loopback_recorder/audio_packet.h"
+#include "windows_loopback_recorder/delivery_queue.h"
+
+namespace windows_loopback_recorder {
+namespace test {
+
+namespace {
+
+constexpr uint32_t kBytesPerFrame = 4;
+constexpr size_t kChunkBytes = 1920;
+
+std::vector<uint8_t> MakeChunk(uint8_t id) {
+  return std::vector<uint8_t>(kChunkBytes, id);
+}
+
+AudioPacketHeader ReadHeader(const std::vector<uint8_t>& packet) {
+  AudioPacketHeader header;
+  std::memcpy(&header, packet.data(), sizeof(header));
+  return header;
+}
+
+// Records everything the queue sends; the consumer never acknowledges unless
+// the test does so explicitly.
+struct RecordingSink {
+  std::vector<DeliveryItem> items;
+
+  DeliveryQueue::SendFunction Sender() {
+    return [this](DeliveryItem& item) {
+      items.push_back(item);
+      return true;
+    };
+  }
+};
+
+}  // namespace
+
+TEST(DeliveryQueue, NonePolicyDeliversImmediately) {
+  DeliveryQueue queue;
+  RecordingSink sink;
+  queue.SetSender(sink.Sender());
+  queue.Configure(BackpressurePolicy::NONE, 4, kBytesPerFrame);
+
+  for (int i = 0; i < 50; i++) {
+    queue.Push(MakeChunk(static_cast<uint8_t>(i)));
+  }
+
+  EXPECT_EQ(sink.items.size(), 50u);
+  EXPECT_EQ(queue.GetStats().droppedChunks, 0u);
+}
+
+TEST(DeliveryQueue, DropOldestKeepsNewestAndStaysBounded) {
+  DeliveryQueue queue;
+  RecordingSink sink;
+  queue.SetSender(sink.Sender());
+  queue.Configure(BackpressurePolicy::DROP_OLDEST, 8, kBytesPerFrame);
+
+  // A stalled consumer: nothing is ever acknowledged.
+  for (int i = 0; i < 100; i++) {
+    queue.Push(MakeChunk(static_cast<uint8_t>(i)));
+  }
+
+  DeliveryStats stats = queue.GetStats();
+  EXPECT_EQ(sink.items.size(), 8u);
+  EXPECT_EQ(stats.inFlightChunks, 8u);
+  EXPECT_EQ(stats.queuedChunks, 8u);
+  EXPECT_LE(stats.highWatermarkChunks, 8u);
+  EXPECT_LE(stats.highWatermarkBytes, 8 * kChunkBytes);
+  EXPECT_EQ(stats.droppedChunks, 84u);
+  EXPECT_EQ(stats.droppedFrames, 84 * kChunkBytes / kBytesPerFrame);
+
+  // Once the consumer catches up it receives the 8 newest chunks.
+  queue.Acknowledge(8);
+  ASSERT_EQ(sink.items.size(), 16u);
+  for (size_t i = 8; i < 16; i++) {
+    EXPECT_EQ(sink.items[i].data[0], 92 + (i - 8));
+  }
+}
+
+TEST(DeliveryQueue, DropNewestSendsSilenceMarker) {
+  DeliveryQueue queue;
+  RecordingSink sink;
+  queue.SetSender(sink.Sender());
+  queue.Configure(BackpressurePolicy::DROP_NEWEST, 4, kBytesPerFrame);
+
+  for (int i = 0; i < 20; i++) {
+    queue.Push(MakeChunk(static_cast<uint8_t>(i)));
+  }
+  EXPECT_EQ(queue.GetStats().droppedChunks, 12u);
+
+  // Room again: the marker covering the 12 dropped chunks precedes new audio.
+  queue.Acknowledge(8);
+  queue.Push(MakeChunk(100));
+  queue.Acknowledge(8);
+
+  ASSERT_EQ(sink.items.size(), 10u);
+  EXPECT_EQ(sink.items[7].data[0], 7);
+  EXPECT_TRUE(sink.items[8].data.empty());
+  EXPECT_EQ(sink.items[8].silenceBytes, 12 * kChunkBytes);
+  EXPECT_EQ(sink.items[9].data[0], 100);
+}
+
+TEST(DeliveryQueue, DropNewestSendsStampedSilenceWithPacketHeaders) {
+  DeliveryQueue queue;
+  RecordingSink sink;
+  queue.SetSender(sink.Sender());
+  queue.Configure(BackpressurePolicy::DROP_NEWEST, 4, 1, sizeof(AudioPacketHeader), 0xFF);
+
+  // 10 ms µ-law chunks, one byte per frame, captured back to back
+  constexpr uint32_t kRate = 8000;
+  constexpr size_t kFrames = 80;
+  AudioPacketizer packetizer;
+  packetizer.Configure(true, kRate, 1, AUDIO_FORMAT_MULAW, 1);
+  auto push = [&](int i) {
+    std::vector<uint8_t> chunk(kFrames, static_cast<uint8_t>(i));
+    packetizer.OnCapturedAudio(chunk.size(), i * 100000, 0);
+    packetizer.Stamp(chunk);
+    queue.Push(std::move(chunk));
+  };
+  for (int i = 0; i < 20; i++) {
+    push(i);
+  }
+  queue.Acknowledge(8);
+  push(20);
+  queue.Acknowledge(8);
+
+  // Every item parses, and the timeline and sequence run on unbroken
+  ASSERT_EQ(sink.items.size(), 10u);
+  uint64_t nextFrame = 0;
+  for (size_t i = 0; i < sink.items.size(); i++) {
+    const std::vector<uint8_t>& data = sink.items[i].data;
+    ASSERT_GE(data.size(), sizeof(AudioPacketHeader));
+    AudioPacketHeader header = ReadHeader(data);
+    EXPECT_EQ(header.magic, kAudioPacketMagic);
+    EXPECT_EQ(header.sequence, i);
+    EXPECT_EQ(header.firstSampleIndex, nextFrame);
+    EXPECT_EQ(data.size(), sizeof(AudioPacketHeader) + header.frameCount);
+    nextFrame += header.frameCount;
+  }
+
+  const std::vector<uint8_t>& silence = sink.items[8].data;
+  AudioPacketHeader header = ReadHeader(silence);
+  EXPECT_EQ(header.flags, AUDIO_PACKET_SILENT | AUDIO_PACKET_DROPPED);
+  EXPECT_EQ(header.frameCount, 12 * kFrames);
+  EXPECT_EQ(header.captureTime, 8 * 100000);
+  EXPECT_EQ(header.formatId, AUDIO_FORMAT_MULAW);
+  EXPECT_EQ(silence[sizeof(AudioPacketHeader)], 0xFF);
+  EXPECT_EQ(silence.back(), 0xFF);
+  EXPECT_EQ(ReadHeader(sink.items[9].data).captureTime, 20 * 100000);
+  EXPECT_EQ(queue.GetStats().droppedFrames, 12 * kFrames);
+}
+
+TEST(DeliveryQueue, DropNewestLeavesCompressedStreamsUnpadded) {
+  DeliveryQueue queue;
+  RecordingSink sink;
+  queue.SetSender(sink.Sender());
+  queue.Configure(BackpressurePolicy::DROP_NEWEST, 4, 0);
+
+  for (int i = 0; i < 20; i++) {
+    queue.Push(MakeChunk(static_cast<uint8_t>(i)));
+  }
+  queue.Acknowledge(8);
+  queue.Push(MakeChunk(100));
+  queue.Acknowledge(8);
+
+  // Silence bytes would corrupt an encoded stream, so none are sent
+  DeliveryStats stats = queue.GetStats();
+  EXPECT_EQ(stats.droppedChunks, 12u);
+  EXPECT_EQ(stats.droppedFrames, 0u);
+  ASSERT_EQ(sink.items.size(), 9u);
+  EXPECT_EQ(sink.items[8].data[0], 100);
+}
+
+TEST(DeliveryQueue, BlockPolicyThrottlesProducerToSlowConsumer) {
+  DeliveryQueue queue;
+  std::atomic<size_t> received{0};
+  std::vector<uint8_t> order;
+  queue.SetSender([&received, &order](DeliveryItem& item) {
+    order.push_back(item.data[0]);
+    received++;
+    return true;
+  });
+  queue.Configure(BackpressurePolicy::BLOCK, 4, kBytesPerFrame);
+
+  constexpr size_t kChunks = 200;
+  std::atomic<bool> done{false};
+
+  // A consumer that takes ~100 us per chunk, much slower than the producer.
+  std::thread consumer([&queue, &received, &done] {
+    size_t acked = 0;
+    while (!done || acked < received) {
+      if (acked < received) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        queue.Acknowledge(1);
+        acked++;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  for (size_t i = 0; i < kChunks; i++) {
+    queue.Push(MakeChunk(static_cast<uint8_t>(i)));
+    DeliveryStats stats = queue.GetStats();
+    EXPECT_LE(stats.queuedChunks, 4u);
+    EXPECT_LE(stats.inFlightChunks, 4u);
+  }
+  while (received < kChunks) {
+    std::this_thread::yield();
+  }
+  done = true;
+  consumer.join();
+
+  DeliveryStats stats = queue.GetStats();
+  EXPECT_EQ(stats.droppedChunks, 0u);
+  EXPECT_EQ(stats.deliveredChunks, kChunks);
+  EXPECT_LE(stats.highWatermarkChunks, 4u);
+  ASSERT_EQ(order.size(), kChunks);
+  for (size_t i = 0; i < kChunks; i++) {
+    EXPECT_EQ(order[i], static_cast<uint8_t>(i));
+  }
+}
+
+TEST(DeliveryQueue, CloseReleasesBlockedProducer) {
+  DeliveryQueue queue;
+  RecordingSink sink;
+  queue.SetSender(sink.Sender());
+  queue.Configure(BackpressurePolicy::BLOCK, 2, kBytesPerFrame);
+
+  for (int i = 0; i < 4; i++) {
+    queue.Push(MakeChunk(static_cast<uint8_t>(i)));
+  }
+
+  std::thread producer([&queue] { queue.Push(MakeChunk(4)); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  queue.Close();
+  producer.join();
+
+  EXPECT_EQ(queue.GetStats().droppedChunks, 1u);
+}
+
+}  // namespace test
+}  // namespace windows_loopback_recorder
@@ -0,0 +1,150 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "windows_loopback_recorder/echo_canceller.h"
+
+namespace windows_loopback_recorder {
+namespace test {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr uint32_t kSampleRate = 16000;
+
+// Mono white noise at |db| dBFS RMS
+std::vector<float> Noise(double db, size_t frames, uint32_t seed) {
+  std::mt19937 random(seed);
+  std::normal_distribution<float> normal(0.0f, static_cast<float>(std::pow(10.0, db / 20.0)));
+  std::vector<float> samples(frames);
+  for (float& sample : samples) {
+    sample = normal(random);
+  }
+  return samples;
+}
+
+// A room: 20 ms of delay, then a decaying tail of 40 ms; about 10 dB of
+// echo loss
+std::vector<float> EchoPath() {
+  std::vector<float> taps(kSampleRate * 60 / 1000, 0.0f);
+  size_t delay = kSampleRate * 20 / 1000;
+  std::mt19937 random(7);
+  std::uniform_real_distribution<float> jitter(0.5f, 1.0f);
+  for (size_t i = delay; i < taps.size(); i++) {
+    float decay = std::exp(-static_cast<float>(i - delay) / (kSampleRate * 0.008f));
+    taps[i] = 0.05f * decay * jitter(random) * ((i % 3 == 0) ? -1.0f : 1.0f);
+  }
+  return taps;
+}
+
+std::vector<float> Convolve(const std::vector<float>& signal, const std::vector<float>& taps) {
+  std::vector<float> out(signal.size(), 0.0f);
+  for (size_t n = 0; n < signal.size(); n++) {
+    double sum = 0.0;
+    for (size_t t = 0; t < taps.size() && t <= n; t++) {
+      sum += static_cast<double>(taps[t]) * signal[n - t];
+    }
+    out[n] = static_cast<float>(sum);
+  }
+  return out;
+}
+
+double Energy(const std::vector<float>& samples, size_t first, size_t end) {
+  double sum = 0.0;
+  for (size_t i = first; i < end; i++) {
+    sum += static_cast<double>(samples[i]) * samples[i];
+  }
+  return sum;
+}
+
+// Runs |reference| and |mic| through the canceller in 10 ms packets
+std::vector<float> Cancel(EchoCanceller& canceller, const std::vector<float>& reference,
+                          const std::vector<float>& mic) {
+  std::vector<float> out(mic.size());
+  size_t packet = kSampleRate / 100;
+  for (size_t i = 0; i + packet <= mic.size(); i += packet) {
+    canceller.PushReference(&reference[i], packet);
+    canceller.Process(&mic[i], &out[i], packet);
+  }
+  return out;
+}
+
+}  // namespace
+
+TEST(EchoCanceller, RemovesEchoOfTheLoopback) {
+  EchoCanceller canceller;
+  ASSERT_TRUE(canceller.Configure(kSampleRate, 1, 1, 100));
+  EXPECT_EQ(canceller.blockSize(), 64u);
+  EXPECT_EQ(canceller.partitions(), 25u);
+
+  std::vector<float> reference = Noise(-20.0, kSampleRate * 6, 1);
+  std::vector<float> mic = Convolve(reference, EchoPath());
+  std::vector<float> out = Cancel(canceller, reference, mic);
+
+  // The output lags by one block; after 4 s the echo is 25 dB down
+  size_t lag = canceller.blockSize();
+  double echo = Energy(mic, kSampleRate * 4, kSampleRate * 6 - lag);
+  double residual = Energy(out, kSampleRate * 4 + lag, kSampleRate * 6);
+  EXPECT_GT(10.0 * std::log10(echo / residual), 25.0);
+  EXPECT_GT(canceller.erleDb(), 20.0f);
+}
+
+TEST(EchoCanceller, PassesTheMicrophoneWithoutLoopback) {
+  EchoCanceller canceller;
+  ASSERT_TRUE(canceller.Configure(kSampleRate, 2, 2, 100));
+
+  std::vector<int16_t> mic(kSampleRate * 2);
+  for (size_t i = 0; i < mic.size(); i++) {
+    mic[i] = static_cast<int16_t>(10000.0 * std::sin(2.0 * kPi * 440.0 * (i / 2) / kSampleRate));
+  }
+  std::vector<int16_t> out = mic;
+  canceller.Process(out.data(), out.data(), mic.size() / 2);
+
+  size_t lag = canceller.blockSize() * 2;
+  for (size_t i = 0; i < lag; i++) {
+    EXPECT_EQ(out[i], 0);
+  }
+  for (size_t i = lag; i < mic.size(); i++) {
+    ASSERT_EQ(out[i], mic[i - lag]) << i;
+  }
+}
+
+TEST(EchoCanceller, KeepsNearEndSpeechDuringDoubleTalk) {
+  EchoCanceller canceller;
+  ASSERT_TRUE(canceller.Configure(kSampleRate, 1, 1, 100));
+
+  std::vector<float> reference = Noise(-20.0, kSampleRate * 6, 2);
+  std::vector<float> mic = Convolve(reference, EchoPath());
+  // The near end talks over the last 2 s, well above the echo
+  std::vector<float> nearEnd(mic.size(), 0.0f);
+  for (size_t i = kSampleRate * 4; i < mic.size(); i++) {
+    nearEnd[i] = static_cast<float>(0.3 * std::sin(2.0 * kPi * 300.0 * i / kSampleRate));
+    mic[i] += nearEnd[i];
+  }
+  std::vector<float> out = Cancel(canceller, reference, mic);
+
+  // What is left is the near end, with the echo still 20 dB below it
+  size_t lag = canceller.blockSize();
+  double residual = 0.0;
+  for (size_t i = kSampleRate * 5; i < mic.size(); i++) {
+    double difference = out[i] - nearEnd[i - lag];
+    residual += difference * difference;
+  }
+  double speech = Energy(nearEnd, kSampleRate * 5 - lag, mic.size() - lag);
+  EXPECT_GT(10.0 * std::log10(speech / residual), 20.0);
+}
+
+TEST(EchoCanceller, RejectsInvalidSettings) {
+  EchoCanceller canceller;
+  EXPECT_FALSE(canceller.Configure(4000, 2, 1));
+  EXPECT_FALSE(canceller.Configure(48000, 0, 1));
+  EXPECT_FALSE(canceller.Configure(48000, 2, 1, EchoCanceller::kMaxTailMs + 1));
+  EXPECT_FALSE(canceller.configured());
+  ASSERT_TRUE(canceller.Configure(48000, 2, 1));
+  EXPECT_EQ(canceller.blockSize(), 256u);
+}
+
+}  // namespace test
+}  // namespace windows_loopback_recorder
@@ -0,0 +1,157 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "windows_loopback_recorder/feature_extractor.h"
+
+namespace windows_loopback_recorder {
+namespace test {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr uint32_t kSampleRate = 16000;
+
+// Stereo 16-bit: a tone at |hz| in both channels over a little noise
+std::vector<int16_t> MakeTone(double hz, size_t frames) {
+  std::mt19937 random(7);
+  std::uniform_int_distribution<int> noise(-30, 30);
+  std::vector<int16_t> samples(frames * 2);
+  for (size_t i = 0; i < frames; i++) {
+    double tone = 12000.0 * std::sin(2.0 * kPi * hz * i / kSampleRate);
+    samples[i * 2] = static_cast<int16_t>(tone + noise(random));
+    samples[i * 2 + 1] = static_cast<int16_t>(tone + noise(random));
+  }
+  return samples;
+}
+
+double MelCenterHz(const FeatureExtractor& extractor, size_t filter) {
+  auto mel = [](double hz) { return 2595.0 * std::log10(1.0 + hz / 700.0); };
+  double low = mel(extractor.minHz());
+  double high = mel(extractor.maxHz());
+  double center = low + (high - low) * (filter + 1) / (extractor.melBins() + 1);
+  return 700.0 * (std::pow(10.0, center / 2595.0) - 1.0);
+}
+
+}  // namespace
+
+TEST(FeatureExtractor, EmitsOneRowPerHop) {
+  FeatureExtractor extractor;
+  ASSERT_TRUE(extractor.Configure(kSampleRate, 2, FeatureOptions()));
+  EXPECT_EQ(extractor.windowFrames(), 400u);
+  EXPECT_EQ(extractor.hopFrames(), 160u);
+  EXPECT_EQ(extractor.fftSize(), 512u);
+  EXPECT_EQ(extractor.valuesPerRow(), 80u);
+
+  // A second of audio in odd-sized packets gives the rows of one push
+  std::vector<int16_t> samples = MakeTone(440.0, kSampleRate);
+  std::vector<float> whole;
+  EXPECT_EQ(extractor.Push(samples.data(), kSampleRate, whole), 98u);
+
+  ASSERT_TRUE(extractor.Configure(kSampleRate, 2, FeatureOptions()));
+  std::vector<float> pieces;
+  pieces.reserve(whole.size());
+  for (size_t i = 0; i < kSampleRate; i += 333) {
+    extractor.Push(&samples[i * 2], std::min<size_t>(333, kSampleRate - i), pieces);
+  }
+  EXPECT_EQ(extractor.rows(), 98u);
+  EXPECT_EQ(pieces, whole);
+}
+
+TEST(FeatureExtractor, PutsAToneInItsMelFilter) {
+  FeatureExtractor extractor;
+  FeatureOptions options;
+  options.preEmphasis = 0.0;
+  ASSERT_TRUE(extractor.Configure(kSampleRate, 2, options));
+
+  std::vector<int16_t> samples = MakeTone(1000.0, kSampleRate / 2);
+  std::vector<float> rows;
+  size_t count = extractor.Push(samples.data(), kSampleRate / 2, rows);
+  ASSERT_GT(count, 0u);
+
+  const float* last = &rows[(count - 1) * 80];
+  size_t peak = std::max_element(last, last + 80) - last;
+  EXPECT_NEAR(MelCenterHz(extractor, peak), 1000.0, 40.0);
+  // Far from the tone only the noise is left
+  EXPECT_GT(last[peak] - last[79], 10.0f);
+
+  // Silence reads the floor in every filter
+  std::vector<int16_t> silence(kSampleRate / 10 * 2, 0);
+  ASSERT_TRUE(extractor.Configure(kSampleRate, 2, options));
+  rows.clear();
+  count = extractor.Push(silence.data(), kSampleRate / 10, rows);
+  ASSERT_GT(count, 0u);
+  for (float value : rows) {
+    EXPECT_EQ(value, FeatureExtractor::kLogFloor);
+  }
+}
+
+TEST(FeatureExtractor, MfccIsTheDctOfTheLogMelRow) {
+  FeatureOptions options;
+  options.melBins = 40;
+  FeatureExtractor logMel;
+  ASSERT_TRUE(logMel.Configure(kSampleRate, 2, options));
+  options.mfcc = 13;
+  FeatureExtractor mfcc;
+  ASSERT_TRUE(mfcc.Configure(kSampleRate, 2, options));
+  EXPECT_EQ(mfcc.valuesPerRow(), 13u);
+
+  std::vector<int16_t> samples = MakeTone(700.0, kSampleRate / 5);
+  std::vector<float> energies;
+  std::vector<float> cepstra;
+  size_t count = logMel.Push(samples.data(), kSampleRate / 5, energies);
+  ASSERT_EQ(mfcc.Push(samples.data(), kSampleRate / 5, cepstra), count);
+
+  for (size_t r = 0; r < count; r++) {
+    for (size_t c = 0; c < 13; c++) {
+      double sum = 0.0;
+      for (size_t m = 0; m < 40; m++) {
+        sum += energies[r * 40 + m] * std::cos(kPi * c * (m + 0.5) / 40);
+      }
+      double expected = sum * std::sqrt((c == 0 ? 1.0 : 2.0) / 40);
+      EXPECT_NEAR(cepstra[r * 13 + c], expected, 1e-3) << r << " " << c;
+    }
+  }
+}
+
+TEST(FeatureExtractor, BuildsTheStreamFrameAndRejectsInvalidSettings) {
+  FeatureExtractor extractor;
+  FeatureOptions options;
+  options.melBins = 64;
+  options.maxHz = 30000.0;  // Limited to Nyquist
+  ASSERT_TRUE(extractor.Configure(48000, 1, options));
+  EXPECT_EQ(extractor.maxHz(), 24000.0f);
+  EXPECT_EQ(extractor.fftSize(), 2048u);
+
+  std::vector<float> rows(64 * 3, -1.5f);
+  std::vector<float> frame = BuildFeatureFrame(250, extractor, rows);
+  ASSERT_EQ(frame.size(), FEATURE_FRAME_FIELDS + rows.size());
+  EXPECT_EQ(frame[FEATURE_FRAME_HEADER_SIZE], static_cast<float>(FEATURE_FRAME_FIELDS));
+  EXPECT_EQ(frame[FEATURE_FRAME_SAMPLE_RATE], 48000.0f);
+  EXPECT_FLOAT_EQ(frame[FEATURE_FRAME_HOP_MS], 10.0f);
+  EXPECT_FLOAT_EQ(frame[FEATURE_FRAME_WINDOW_MS], 25.0f);
+  EXPECT_EQ(frame[FEATURE_FRAME_FIRST_ROW], 250.0f);
+  EXPECT_EQ(frame[FEATURE_FRAME_ROWS], 3.0f);
+  EXPECT_EQ(frame[FEATURE_FRAME_VALUES_PER_ROW], 64.0f);
+  EXPECT_EQ(frame[FEATURE_FRAME_MEL_BINS], 64.0f);
+  EXPECT_EQ(frame.back(), -1.5f);
+
+  options = FeatureOptions();
+  EXPECT_FALSE(extractor.Configure(4000, 1, options));
+  EXPECT_FALSE(extractor.Configure(kSampleRate, 0, options));
+  options.mfcc = 81;
+  EXPECT_FALSE(extractor.Configure(kSampleRate, 1, options));
+  options = FeatureOptions();
+  options.minHz = 9000.0;  // Above Nyquist at 16 kHz
+  EXPECT_FALSE(extractor.Configure(kSampleRate, 1, options));
+  options = FeatureOptions();
+  options.preEmphasis = 1.0;
+  EXPECT_FALSE(extractor.Configure(kSampleRate, 1, options));
+  EXPECT_FALSE(extractor.configured());
+}
+
+}  // namespace test
+}  // namespace windows_loopback_recorder
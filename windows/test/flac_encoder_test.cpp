@@ -0,0 +1,663 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "windows_loopback_recorder/flac_encoder.h"
+
+// Builds that find libFLAC define WLR_HAVE_LIBFLAC and check every stream
+// against the reference decoder; others use the decoder below.
+#ifdef WLR_HAVE_LIBFLAC
+#include <FLAC/stream_decoder.h>
+#endif
+
+namespace windows_loopback_recorder {
+namespace test {
+
+namespace {
+
+uint32_t ReadBE(const std::vector<uint8_t>& buffer, size_t offset, size_t bytes) {
+  uint32_t value = 0;
+  for (size_t i = 0; i < bytes; i++) {
+    value = (value << 8) | buffer[offset + i];
+  }
+  return value;
+}
+
+uint8_t Crc8(const uint8_t* data, size_t size) {
+  uint8_t crc = 0;
+  for (size_t i = 0; i < size; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = static_cast<uint8_t>((crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1);
+    }
+  }
+  return crc;
+}
+
+uint16_t Crc16(const uint8_t* data, size_t size) {
+  uint16_t crc = 0;
+  for (size_t i = 0; i < size; i++) {
+    crc ^= static_cast<uint16_t>(data[i] << 8);
+    for (int bit = 0; bit < 8; bit++) {
+      crc = static_cast<uint16_t>((crc & 0x8000) ? (crc << 1) ^ 0x8005 : crc << 1);
+    }
+  }
+  return crc;
+}
+
+FlacEncoderConfig Config(uint32_t sampleRate, uint16_t channels, uint16_t bitsPerSample) {
+  FlacEncoderConfig config;
+  config.sampleRate = sampleRate;
+  config.channels = channels;
+  config.bitsPerSample = bitsPerSample;
+  return config;
+}
+
+enum class Signal { SILENCE, TONE, NOISE, FULL_SCALE_SQUARE };
+
+// Interleaved test signal; channels differ so stereo modes get exercised
+std::vector<int32_t> MakeSignal(Signal signal, const FlacEncoderConfig& config, uint32_t frames) {
+  std::vector<int32_t> samples(static_cast<size_t>(frames) * config.channels);
+  int32_t maxValue = (1 << (config.bitsPerSample - 1)) - 1;
+  int32_t minValue = -maxValue - 1;
+  std::mt19937 random(7);
+  std::uniform_int_distribution<int32_t> noise(minValue, maxValue);
+  std::uniform_int_distribution<int32_t> dither(-4, 4);
+
+  for (uint32_t i = 0; i < frames; i++) {
+    for (uint32_t c = 0; c < config.channels; c++) {
+      int32_t value = 0;
+      switch (signal) {
+        case Signal::SILENCE:
+          break;
+        case Signal::TONE: {
+          double phase = 2.0 * 3.14159265358979323846 * (440.0 + 110.0 * c) * i / config.sampleRate;
+          value = static_cast<int32_t>(0.6 * maxValue * std::sin(phase)) + dither(random);
+          break;
+        }
+        case Signal::NOISE:
+          value = noise(random);
+          break;
+        case Signal::FULL_SCALE_SQUARE:
+          value = ((i / 5 + c) & 1) ? maxValue : minValue;
+          break;
+      }
+      samples[static_cast<size_t>(i) * config.channels + c] = std::clamp(value, minValue, maxValue);
+    }
+  }
+  return samples;
+}
+
+// Little-endian PCM as FlacStreamEncoder::Push() takes it; 8-bit samples
+// are unsigned, as in WAV
+std::vector<uint8_t> ToPcm(const std::vector<int32_t>& samples, uint32_t bitsPerSample) {
+  uint32_t bytes = (bitsPerSample + 7) / 8;
+  std::vector<uint8_t> pcm(samples.size() * bytes);
+  for (size_t i = 0; i < samples.size(); i++) {
+    int32_t sample = bitsPerSample == 8 ? samples[i] + 128 : samples[i];
+    uint32_t value = static_cast<uint32_t>(sample) << (bytes * 8 - bitsPerSample);
+    for (uint32_t b = 0; b < bytes; b++) {
+      pcm[i * bytes + b] = static_cast<uint8_t>(value >> (8 * b));
+    }
+  }
+  return pcm;
+}
+
+// Whole stream: header followed by every frame, pushed in uneven pieces
+std::vector<uint8_t> EncodeStream(const FlacEncoderConfig& config, const std::vector<int32_t>& samples,
+                                  WorkerPool* pool, std::vector<uint32_t>* frameSizes = nullptr) {
+  FlacStreamEncoder encoder(pool);
+  EXPECT_TRUE(encoder.Configure(config));
+
+  std::vector<uint8_t> frames;
+  auto append = [&](std::vector<uint8_t>& frame, uint32_t sampleFrames) {
+    frames.insert(frames.end(), frame.begin(), frame.end());
+    if (frameSizes) {
+      frameSizes->push_back(sampleFrames);
+    }
+  };
+
+  std::vector<uint8_t> pcm = ToPcm(samples, config.bitsPerSample);
+  for (size_t offset = 0; offset < pcm.size();) {
+    size_t count = std::min<size_t>(pcm.size() - offset, 1931);  // Splits sample frames
+    encoder.Push(pcm.data() + offset, count);
+    encoder.Collect(append);
+    offset += count;
+  }
+  encoder.Finish(append);
+
+  std::vector<uint8_t> stream = BuildFlacHeader(config, encoder.info());
+  stream.insert(stream.end(), frames.begin(), frames.end());
+  return stream;
+}
+
+struct DecodeState {
+  const std::vector<uint8_t>* stream = nullptr;
+  size_t offset = 0;
+  std::vector<int32_t> samples;
+  unsigned sampleRate = 0;
+  unsigned channels = 0;
+  unsigned bitsPerSample = 0;
+  uint64_t totalSamples = 0;
+  bool error = false;
+};
+
+#ifdef WLR_HAVE_LIBFLAC
+
+FLAC__StreamDecoderReadStatus ReadStream(const FLAC__StreamDecoder*, FLAC__byte buffer[],
+                                         size_t* bytes, void* clientData) {
+  auto* state = static_cast<DecodeState*>(clientData);
+  size_t count = std::min(*bytes, state->stream->size() - state->offset);
+  if (count == 0) {
+    *bytes = 0;
+    return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+  }
+  std::memcpy(buffer, state->stream->data() + state->offset, count);
+  state->offset += count;
+  *bytes = count;
+  return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+}
+
+FLAC__StreamDecoderWriteStatus WriteSamples(const FLAC__StreamDecoder*, const FLAC__Frame* frame,
+                                            const FLAC__int32* const buffer[], void* clientData) {
+  auto* state = static_cast<DecodeState*>(clientData);
+  for (unsigned i = 0; i < frame->header.blocksize; i++) {
+    for (unsigned c = 0; c < frame->header.channels; c++) {
+      state->samples.push_back(buffer[c][i]);
+    }
+  }
+  return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+void ReadMetadata(const FLAC__StreamDecoder*, const FLAC__StreamMetadata* metadata, void* clientData) {
+  auto* state = static_cast<DecodeState*>(clientData);
+  if (metadata->type == FLAC__METADATA_TYPE_STREAMINFO) {
+    state->sampleRate = metadata->data.stream_info.sample_rate;
+    state->channels = metadata->data.stream_info.channels;
+    state->bitsPerSample = metadata->data.stream_info.bits_per_sample;
+    state->totalSamples = metadata->data.stream_info.total_samples;
+  }
+}
+
+void RecordError(const FLAC__StreamDecoder*, FLAC__StreamDecoderErrorStatus, void* clientData) {
+  static_cast<DecodeState*>(clientData)->error = true;  // Bad CRC, lost sync, ...
+}
+
+DecodeState Decode(const std::vector<uint8_t>& stream) {
+  DecodeState state;
+  state.stream = &stream;
+  FLAC__StreamDecoder* decoder = FLAC__stream_decoder_new();
+  EXPECT_EQ(FLAC__stream_decoder_init_stream(decoder, ReadStream, nullptr, nullptr, nullptr, nullptr,
+                                             WriteSamples, ReadMetadata, RecordError, &state),
+            FLAC__STREAM_DECODER_INIT_STATUS_OK);
+  EXPECT_TRUE(FLAC__stream_decoder_process_until_end_of_stream(decoder));
+  FLAC__stream_decoder_finish(decoder);
+  FLAC__stream_decoder_delete(decoder);
+  return state;
+}
+#else
+// MSB-first reader over one FLAC stream. Reads past the end return zeros
+// and set |overrun|.
+class BitReader {
+ public:
+  BitReader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+  uint32_t Read(uint32_t bits) {
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < bits; i++) {
+      value = (value << 1) | ReadBit();
+    }
+    return value;
+  }
+
+  int32_t ReadSigned(uint32_t bits) {
+    if (bits == 0) {
+      return 0;
+    }
+    uint32_t value = Read(bits);
+    uint32_t sign = 1u << (bits - 1);
+    return static_cast<int32_t>((value ^ sign) - sign);
+  }
+
+  // Zeros before the next one
+  uint32_t ReadUnary() {
+    uint32_t count = 0;
+    while (!overrun && ReadBit() == 0) {
+      count++;
+    }
+    return count;
+  }
+
+  void AlignToByte() { bit_ = (bit_ + 7) & ~size_t{7}; }
+  size_t bytePosition() const { return bit_ / 8; }
+
+  bool overrun = false;
+
+ private:
+  uint32_t ReadBit() {
+    if (bit_ / 8 >= size_) {
+      overrun = true;
+      return 0;
+    }
+    uint32_t value = (data_[bit_ / 8] >> (7 - bit_ % 8)) & 1;
+    bit_++;
+    return value;
+  }
+
+  const uint8_t* data_;
+  size_t size_;
+  size_t bit_ = 0;
+};
+
+// Rice-coded residual of one subframe, after |order| warm-up samples
+bool DecodeResidual(BitReader& reader, uint32_t blockSize, uint32_t order, int32_t* out) {
+  uint32_t method = reader.Read(2);
+  if (method > 1) {
+    return false;
+  }
+  uint32_t parameterBits = method == 0 ? 4 : 5;
+  uint32_t escape = (1u << parameterBits) - 1;
+  uint32_t partitionOrder = reader.Read(4);
+  uint32_t partitions = 1u << partitionOrder;
+  if ((blockSize >> partitionOrder) < order) {
+    return false;
+  }
+
+  size_t index = order;
+  for (uint32_t partition = 0; partition < partitions; partition++) {
+    uint32_t count = (blockSize >> partitionOrder) - (partition == 0 ? order : 0);
+    uint32_t parameter = reader.Read(parameterBits);
+    if (parameter == escape) {
+      uint32_t bits = reader.Read(5);
+      for (uint32_t i = 0; i < count; i++) {
+        out[index++] = reader.ReadSigned(bits);
+      }
+      continue;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+      uint32_t value = (reader.ReadUnary() << parameter) | reader.Read(parameter);
+      out[index++] = static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+    }
+  }
+  return !reader.overrun;
+}
+
+// One channel of |blockSize| samples at |bits| per sample
+bool DecodeSubframe(BitReader& reader, uint32_t blockSize, uint32_t bits, int32_t* out) {
+  if (reader.Read(1) != 0) {
+    return false;
+  }
+  uint32_t type = reader.Read(6);
+  uint32_t wasted = reader.Read(1) ? reader.ReadUnary() + 1 : 0;
+  if (wasted >= bits) {
+    return false;
+  }
+  bits -= wasted;
+
+  if (type == 0) {  // CONSTANT
+    std::fill(out, out + blockSize, reader.ReadSigned(bits));
+  } else if (type == 1) {  // VERBATIM
+    for (uint32_t i = 0; i < blockSize; i++) {
+      out[i] = reader.ReadSigned(bits);
+    }
+  } else if (type >= 8 && type <= 12) {  // FIXED
+    static const int32_t kFixed[5][4] = {{0}, {1}, {2, -1}, {3, -3, 1}, {4, -6, 4, -1}};
+    uint32_t order = type - 8;
+    for (uint32_t i = 0; i < order; i++) {
+      out[i] = reader.ReadSigned(bits);
+    }
+    if (!DecodeResidual(reader, blockSize, order, out)) {
+      return false;
+    }
+    for (uint32_t i = order; i < blockSize; i++) {
+      int64_t prediction = 0;
+      for (uint32_t j = 0; j < order; j++) {
+        prediction += static_cast<int64_t>(kFixed[order][j]) * out[i - j - 1];
+      }
+      out[i] = static_cast<int32_t>(prediction + out[i]);
+    }
+  } else if (type >= 32) {  // LPC
+    uint32_t order = type - 31;
+    for (uint32_t i = 0; i < order; i++) {
+      out[i] = reader.ReadSigned(bits);
+    }
+    uint32_t precision = reader.Read(4) + 1;
+    int32_t shift = reader.ReadSigned(5);
+    if (precision == 16 || shift < 0) {
+      return false;
+    }
+    std::vector<int32_t> coefficients(order);
+    for (int32_t& coefficient : coefficients) {
+      coefficient = reader.ReadSigned(precision);
+    }
+    if (!DecodeResidual(reader, blockSize, order, out)) {
+      return false;
+    }
+    for (uint32_t i = order; i < blockSize; i++) {
+      int64_t prediction = 0;
+      for (uint32_t j = 0; j < order; j++) {
+        prediction += static_cast<int64_t>(coefficients[j]) * out[i - j - 1];
+      }
+      out[i] = static_cast<int32_t>((prediction >> shift) + out[i]);
+    }
+  } else {
+    return false;
+  }
+
+  if (wasted > 0) {
+    for (uint32_t i = 0; i < blockSize; i++) {
+      out[i] = static_cast<int32_t>(static_cast<uint32_t>(out[i]) << wasted);
+    }
+  }
+  return !reader.overrun;
+}
+
+// Appends one frame's interleaved samples; false on anything malformed or
+// a checksum that does not match
+bool DecodeFrame(const std::vector<uint8_t>& stream, size_t& offset, DecodeState& state) {
+  BitReader reader(stream.data() + offset, stream.size() - offset);
+  if (reader.Read(15) != 0x7FFC) {  // Sync code and reserved bit
+    return false;
+  }
+  reader.Read(1);  // Blocking strategy
+  uint32_t blockSizeCode = reader.Read(4);
+  uint32_t rateCode = reader.Read(4);
+  uint32_t assignment = reader.Read(4);
+  uint32_t sizeCode = reader.Read(3);
+  reader.Read(1);
+
+  // UTF-8 coded frame or sample number
+  uint32_t lead = reader.Read(8);
+  uint32_t continuation = 0;
+  while (continuation < 7 && (lead & (0x80 >> continuation))) {
+    continuation++;
+  }
+  for (uint32_t i = 1; i < continuation; i++) {
+    reader.Read(8);
+  }
+
+  uint32_t blockSize = 0;
+  if (blockSizeCode == 1) {
+    blockSize = 192;
+  } else if (blockSizeCode >= 2 && blockSizeCode <= 5) {
+    blockSize = 576u << (blockSizeCode - 2);
+  } else if (blockSizeCode == 6) {
+    blockSize = reader.Read(8) + 1;
+  } else if (blockSizeCode == 7) {
+    blockSize = reader.Read(16) + 1;
+  } else if (blockSizeCode >= 8) {
+    blockSize = 256u << (blockSizeCode - 8);
+  }
+  if (rateCode == 12) {
+    reader.Read(8);
+  } else if (rateCode == 13 || rateCode == 14) {
+    reader.Read(16);
+  }
+
+  static const uint32_t kSampleSizes[8] = {0, 8, 12, 0, 16, 20, 24, 32};
+  uint32_t bits = sizeCode == 0 ? state.bitsPerSample : kSampleSizes[sizeCode];
+  uint32_t channels = assignment < 8 ? assignment + 1 : 2;
+  size_t headerBytes = reader.bytePosition();
+  if (blockSize == 0 || bits == 0 || assignment > 10 || channels != state.channels ||
+      reader.Read(8) != Crc8(stream.data() + offset, headerBytes)) {
+    return false;
+  }
+
+  // The side channel carries one more bit
+  std::vector<std::vector<int32_t>> decoded(channels, std::vector<int32_t>(blockSize));
+  for (uint32_t c = 0; c < channels; c++) {
+    bool side = (assignment == 8 && c == 1) || (assignment == 9 && c == 0) || (assignment == 10 && c == 1);
+    if (!DecodeSubframe(reader, blockSize, bits + (side ? 1 : 0), decoded[c].data())) {
+      return false;
+    }
+  }
+  reader.AlignToByte();
+  reader.Read(16);
+  size_t frameBytes = reader.bytePosition();
+  if (reader.overrun || Crc16(stream.data() + offset, frameBytes) != 0) {
+    return false;
+  }
+  offset += frameBytes;
+
+  for (uint32_t i = 0; i < blockSize; i++) {
+    int32_t a = decoded[0][i];
+    int32_t b = channels > 1 ? decoded[1][i] : 0;
+    if (assignment == 8) {  // Left, side
+      b = a - b;
+    } else if (assignment == 9) {  // Side, right
+      a = a + b;
+    } else if (assignment == 10) {  // Mid, side
+      int64_t mid = (static_cast<int64_t>(a) * 2) | (b & 1);
+      a = static_cast<int32_t>((mid + b) >> 1);
+      b = static_cast<int32_t>((mid - b) >> 1);
+    }
+    state.samples.push_back(a);
+    if (channels > 1) {
+      state.samples.push_back(b);
+    }
+    for (uint32_t c = 2; c < channels; c++) {
+      state.samples.push_back(decoded[c][i]);
+    }
+  }
+  return true;
+}
+
+// Enough of a FLAC decoder for what FlacEncoder writes: STREAMINFO,
+// skipped metadata, and frames of CONSTANT, VERBATIM, FIXED and LPC
+// subframes with checked CRCs
+DecodeState Decode(const std::vector<uint8_t>& stream) {
+  DecodeState state;
+  state.stream = &stream;
+  if (stream.size() < 4 || std::memcmp(stream.data(), "fLaC", 4) != 0) {
+    state.error = true;
+    return state;
+  }
+
+  size_t offset = 4;
+  bool last = false;
+  while (!last) {
+    if (offset + 4 > stream.size()) {
+      state.error = true;
+      return state;
+    }
+    last = (stream[offset] & 0x80) != 0;
+    uint32_t type = stream[offset] & 0x7F;
+    uint32_t length = ReadBE(stream, offset + 1, 3);
+    offset += 4;
+    if (offset + length > stream.size()) {
+      state.error = true;
+      return state;
+    }
+    if (type == 0 && length >= 34) {
+      BitReader reader(stream.data() + offset + 10, 8);
+      state.sampleRate = reader.Read(20);
+      state.channels = reader.Read(3) + 1;
+      state.bitsPerSample = reader.Read(5) + 1;
+      state.totalSamples = (static_cast<uint64_t>(reader.Read(4)) << 32) | reader.Read(32);
+    }
+    offset += length;
+  }
+
+  while (offset < stream.size()) {
+    if (!DecodeFrame(stream, offset, state)) {
+      state.error = true;
+      break;
+    }
+  }
+  state.offset = offset;
+  return state;
+}
+#endif  // WLR_HAVE_LIBFLAC
+
+}  // namespace
+
+TEST(FlacEncoder, BuildsPaddedStreamInfoHeader) {
+  FlacStreamInfo info;
+  info.minFrameBytes = 12;
+  info.maxFrameBytes = 9000;
+  info.totalFrames = 0x123456789ull;
+  std::vector<uint8_t> header = BuildFlacHeader(Config(48000, 2, 16), info, 4096);
+
+  ASSERT_EQ(header.size(), 4096u);
+  EXPECT_EQ(std::memcmp(header.data(), "fLaC", 4), 0);
+  EXPECT_EQ(header[4], 0x00);  // STREAMINFO, more blocks follow
+  EXPECT_EQ(ReadBE(header, 5, 3), 34u);
+  EXPECT_EQ(ReadBE(header, 8, 2), 4096u);
+  EXPECT_EQ(ReadBE(header, 10, 2), 4096u);
+  EXPECT_EQ(ReadBE(header, 12, 3), 12u);
+  EXPECT_EQ(ReadBE(header, 15, 3), 9000u);
+  EXPECT_EQ(ReadBE(header, 18, 3) >> 4, 48000u);
+  EXPECT_EQ((header[20] >> 1) & 0x7, 1u);                      // Channels - 1
+  EXPECT_EQ(((header[20] & 1) << 4) | (header[21] >> 4), 15);  // Bits - 1
+  EXPECT_EQ(header[21] & 0xF, 0x1);
+  EXPECT_EQ(ReadBE(header, 22, 4), 0x23456789u);
+
+  EXPECT_EQ(header[42], 0x81);  // Last block: PADDING
+  EXPECT_EQ(ReadBE(header, 43, 3), 4096u - 46);
+
+  // Without padding STREAMINFO is the last block
+  std::vector<uint8_t> bare = BuildFlacHeader(Config(48000, 2, 16), info);
+  EXPECT_EQ(bare.size(), 42u);
+  EXPECT_EQ(bare[4], 0x80);
+}
+
+TEST(FlacEncoder, RejectsUnsupportedFormats) {
+  FlacEncoder encoder;
+  EXPECT_TRUE(encoder.Configure(Config(44100, 8, 24)));
+  EXPECT_FALSE(encoder.Configure(Config(44100, 9, 16)));
+  EXPECT_FALSE(encoder.Configure(Config(44100, 2, 32)));
+  EXPECT_FALSE(encoder.Configure(Config(0, 2, 16)));
+}
+
+TEST(FlacEncoder, FramesCarryValidHeadersAndChecksums) {
+  FlacEncoderConfig config = Config(48000, 2, 16);
+  FlacEncoder encoder;
+  ASSERT_TRUE(encoder.Configure(config));
+
+  std::vector<int32_t> samples = MakeSignal(Signal::TONE, config, config.blockSize);
+  std::vector<uint8_t> frame;
+  encoder.EncodeFrame(samples.data(), config.blockSize, 200, frame);
+
+  ASSERT_GT(frame.size(), 8u);
+  EXPECT_EQ(ReadBE(frame, 0, 2), 0xFFF8u);  // Sync code, fixed block size
+  EXPECT_EQ(frame[2] >> 4, 12);             // 4096 frames
+  EXPECT_EQ(frame[2] & 0xF, 10);            // 48 kHz
+  EXPECT_EQ((frame[3] >> 1) & 0x7, 4);      // 16 bits
+  EXPECT_EQ(frame[4], 0xC3);                // Frame 200 as two UTF-8 bytes
+  EXPECT_EQ(frame[5], 0x88);
+  EXPECT_EQ(Crc8(frame.data(), 6), frame[6]);
+  // A frame ending in its own CRC-16 checksums to zero
+  EXPECT_EQ(Crc16(frame.data(), frame.size()), 0);
+}
+
+TEST(FlacEncoder, RenumberedFramesMatchFreshlyEncodedOnes) {
+  FlacEncoderConfig config = Config(44100, 2, 16);
+  config.blockSize = 1000;  // Block size and rate stored after the frame number
+  FlacEncoder encoder;
+  ASSERT_TRUE(encoder.Configure(config));
+  std::vector<int32_t> samples = MakeSignal(Signal::TONE, config, config.blockSize);
+
+  for (uint64_t from : {0ull, 5ull, 200ull, 100000ull}) {
+    for (uint64_t to : {0ull, 127ull, 4000ull}) {
+      std::vector<uint8_t> original;
+      std::vector<uint8_t> expected;
+      encoder.EncodeFrame(samples.data(), config.blockSize, from, original);
+      encoder.EncodeFrame(samples.data(), config.blockSize, to, expected);
+
+      std::vector<uint8_t> renumbered;
+      ASSERT_TRUE(RenumberFlacFrame(original.data(), original.size(), to, renumbered));
+      EXPECT_EQ(renumbered, expected) << from << " -> " << to;
+    }
+  }
+
+  std::vector<uint8_t> out;
+  std::vector<uint8_t> garbage(16, 0xAB);
+  EXPECT_FALSE(RenumberFlacFrame(garbage.data(), garbage.size(), 0, out));
+  EXPECT_TRUE(out.empty());
+}
+
+TEST(FlacEncoder, CompressesPredictableAudio) {
+  FlacEncoderConfig config = Config(48000, 2, 16);
+  FlacEncoder encoder;
+  ASSERT_TRUE(encoder.Configure(config));
+  size_t pcmBytes = static_cast<size_t>(config.blockSize) * 4;
+
+  std::vector<uint8_t> silence;
+  std::vector<int32_t> samples = MakeSignal(Signal::SILENCE, config, config.blockSize);
+  encoder.EncodeFrame(samples.data(), config.blockSize, 0, silence);
+  EXPECT_LT(silence.size(), 20u);  // Two constant subframes
+
+  std::vector<uint8_t> tone;
+  samples = MakeSignal(Signal::TONE, config, config.blockSize);
+  encoder.EncodeFrame(samples.data(), config.blockSize, 0, tone);
+  EXPECT_LT(tone.size(), pcmBytes / 2);
+
+  // Incompressible input falls back to verbatim subframes
+  std::vector<uint8_t> noise;
+  samples = MakeSignal(Signal::NOISE, config, config.blockSize);
+  encoder.EncodeFrame(samples.data(), config.blockSize, 0, noise);
+  EXPECT_LT(noise.size(), pcmBytes + 32);
+}
+
+TEST(FlacStreamEncoder, PoolKeepsFramesInStreamOrder) {
+  FlacEncoderConfig config = Config(44100, 2, 16);
+  config.blockSize = 1024;
+  std::vector<int32_t> samples = MakeSignal(Signal::TONE, config, 100 * 1024 + 77);
+
+  WorkerPool pool(3);
+  std::vector<uint32_t> frameSizes;
+  std::vector<uint8_t> pooled = EncodeStream(config, samples, &pool, &frameSizes);
+  std::vector<uint8_t> synchronous = EncodeStream(config, samples, nullptr);
+
+  // Encoding is deterministic, so only ordering could make these differ
+  EXPECT_EQ(pooled, synchronous);
+  ASSERT_EQ(frameSizes.size(), 101u);
+  EXPECT_EQ(frameSizes.back(), 77u);  // Short final frame
+  EXPECT_EQ(ReadBE(pooled, 22, 4), 100u * 1024 + 77);  // STREAMINFO total
+}
+
+TEST(FlacStreamEncoder, RoundTripsThroughDecoder) {
+  struct Case {
+    uint32_t sampleRate;
+    uint16_t channels;
+    uint16_t bitsPerSample;
+    Signal signal;
+    uint32_t frames;
+  };
+  const Case cases[] = {
+      {48000, 2, 16, Signal::TONE, 48000 + 123},
+      {48000, 2, 16, Signal::NOISE, 20000},
+      {48000, 2, 16, Signal::SILENCE, 9000},
+      {44100, 2, 16, Signal::FULL_SCALE_SQUARE, 9000},
+      {44100, 1, 16, Signal::TONE, 5000},
+      {96000, 2, 24, Signal::TONE, 30000},
+      {96000, 2, 24, Signal::FULL_SCALE_SQUARE, 9000},
+      {48000, 6, 24, Signal::TONE, 10000},
+      {22050, 2, 8, Signal::TONE, 10000},
+      {16000, 1, 16, Signal::TONE, 100},
+  };
+
+  WorkerPool pool(2);
+  for (const Case& c : cases) {
+    SCOPED_TRACE(testing::Message() << c.channels << "ch " << c.bitsPerSample << "-bit");
+    FlacEncoderConfig config = Config(c.sampleRate, c.channels, c.bitsPerSample);
+    std::vector<int32_t> samples = MakeSignal(c.signal, config, c.frames);
+    std::vector<uint8_t> stream = EncodeStream(config, samples, &pool);
+
+    DecodeState decoded = Decode(stream);
+    EXPECT_FALSE(decoded.error);
+    EXPECT_EQ(decoded.sampleRate, c.sampleRate);
+    EXPECT_EQ(decoded.channels, c.channels);
+    EXPECT_EQ(decoded.bitsPerSample, c.bitsPerSample);
+    EXPECT_EQ(decoded.totalSamples, c.frames);
+    EXPECT_EQ(decoded.samples, samples);  // Bit exact
+  }
+}
+
+}  // namespace test
+}  // namespace windows_loopback_recorder
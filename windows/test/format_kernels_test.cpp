@@ -0,0 +1,320 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "windows_loopback_recorder/format_kernels.h"
+
+namespace windows_loopback_recorder {
+namespace test {
+
+namespace {
+
+// Interleaved samples of |bits| (16 or float) as bytes
+std::vector<uint8_t> MakeSource(size_t frames, uint16_t channels, uint16_t bits, std::mt19937& random) {
+  std::uniform_real_distribution<float> level(-0.9f, 0.9f);
+  std::vector<uint8_t> bytes(frames * channels * (bits / 8));
+  for (size_t i = 0; i < frames * channels; i++) {
+    float value = level(random);
+    if (bits == 16) {
+      int16_t sample = static_cast<int16_t>(value * 32767.0f);
+      std::memcpy(&bytes[i * 2], &sample, 2);
+    } else {
+      std::memcpy(&bytes[i * 4], &value, 4);
+    }
+  }
+  return bytes;
+}
+
+float Sample(const std::vector<uint8_t>& bytes, uint16_t bits, size_t index) {
+  if (bits == 16) {
+    int16_t sample;
+    std::memcpy(&sample, &bytes[index * 2], 2);
+    return sample;
+  }
+  float sample;
+  std::memcpy(&sample, &bytes[index * 4], 4);
+  return sample;
+}
+
+SampleFormat FormatOf(uint16_t bits) {
+  return bits == 16 ? SampleFormat::PCM16 : SampleFormat::FLOAT32;
+}
+
+int16_t ToPcm(float sample, uint16_t bits) {
+  return bits == 16 ? static_cast<int16_t>(sample) : static_cast<int16_t>(sample * 32767.0f);
+}
+
+// The per-sample mix the kernels replace, branching on every format
+std::vector<int16_t> ReferenceMix(const std::vector<uint8_t>& system, uint16_t systemBits,
+                                  uint16_t systemChannels, size_t systemFrames,
+                                  const std::vector<uint8_t>& mic, uint16_t micBits,
+                                  uint16_t micChannels, size_t micFrames) {
+  std::vector<int16_t> out(std::max(systemFrames, micFrames) * systemChannels, 0);
+  for (size_t frame = 0; frame < systemFrames; frame++) {
+    for (uint16_t channel = 0; channel < systemChannels; channel++) {
+      size_t index = frame * systemChannels + channel;
+      out[index] = ToPcm(Sample(system, systemBits, index), systemBits);
+    }
+  }
+  for (size_t frame = 0; frame < micFrames; frame++) {
+    for (uint16_t channel = 0; channel < std::min(systemChannels, micChannels); channel++) {
+      int32_t sum = out[frame * systemChannels + channel] +
+                    ToPcm(Sample(mic, micBits, frame * micChannels + channel), micBits);
+      out[frame * systemChannels + channel] = static_cast<int16_t>(std::min(32767, std::max(-32768, sum)));
+    }
+  }
+  return out;
+}
+
+// A WAVEFORMATEX, or WAVEFORMATEXTENSIBLE with |subFormatTag| set, as the
+// bytes the audio engine hands out
+std::vector<uint8_t> WaveFormat(uint16_t tag, uint16_t bits, uint16_t validBits = 0,
+                                uint16_t subFormatTag = 0) {
+  static const uint8_t kGuidTail[14] = {0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80,
+                                        0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+  bool extensible = tag == 0xFFFE;
+  std::vector<uint8_t> bytes(extensible ? 40 : 18, 0);
+  auto put16 = [&](size_t offset, uint16_t value) {
+    bytes[offset] = static_cast<uint8_t>(value);
+    bytes[offset + 1] = static_cast<uint8_t>(value >> 8);
+  };
+  put16(0, tag);
+  put16(2, 2);  // Channels
+  put16(14, bits);
+  if (extensible) {
+    put16(16, 22);
+    put16(18, validBits);
+    put16(24, subFormatTag);
+    std::memcpy(&bytes[26], kGuidTail, sizeof(kGuidTail));
+  }
+  return bytes;
+}
+
+SampleFormat Parse(const std::vector<uint8_t>& bytes) {
+  return ParseSampleFormat(bytes.data(), bytes.size());
+}
+
+}  // namespace
+
+TEST(FormatKernels, ParsesPlainAndExtensibleFormats) {
+  EXPECT_EQ(Parse(WaveFormat(1, 16)), SampleFormat::PCM16);
+  EXPECT_EQ(Parse(WaveFormat(1, 24)), SampleFormat::PCM24);
+  EXPECT_EQ(Parse(WaveFormat(1, 32)), SampleFormat::PCM32);
+  EXPECT_EQ(Parse(WaveFormat(3, 32)), SampleFormat::FLOAT32);
+  EXPECT_EQ(Parse(WaveFormat(1, 8)), SampleFormat::UNSUPPORTED);
+  EXPECT_EQ(Parse(WaveFormat(3, 64)), SampleFormat::UNSUPPORTED);
+
+  EXPECT_EQ(Parse(WaveFormat(0xFFFE, 32, 32, 3)), SampleFormat::FLOAT32);
+  EXPECT_EQ(Parse(WaveFormat(0xFFFE, 16, 16, 1)), SampleFormat::PCM16);
+  EXPECT_EQ(Parse(WaveFormat(0xFFFE, 24, 24, 1)), SampleFormat::PCM24);
+  EXPECT_EQ(Parse(WaveFormat(0xFFFE, 32, 32, 1)), SampleFormat::PCM32);
+  // 24 valid bits in a 32-bit container are the high ones
+  EXPECT_EQ(Parse(WaveFormat(0xFFFE, 32, 24, 1)), SampleFormat::PCM32);
+  EXPECT_EQ(Parse(WaveFormat(0xFFFE, 24, 32, 1)), SampleFormat::UNSUPPORTED);
+
+  // Not PCM or float (here A-law), a foreign GUID, or cut short
+  EXPECT_EQ(Parse(WaveFormat(0xFFFE, 16, 16, 6)), SampleFormat::UNSUPPORTED);
+  std::vector<uint8_t> foreign = WaveFormat(0xFFFE, 32, 32, 3);
+  foreign[39] ^= 0xFF;
+  EXPECT_EQ(Parse(foreign), SampleFormat::UNSUPPORTED);
+  std::vector<uint8_t> truncated = WaveFormat(0xFFFE, 32, 32, 3);
+  EXPECT_EQ(ParseSampleFormat(truncated.data(), 18), SampleFormat::UNSUPPORTED);
+}
+
+TEST(FormatKernels, WidensEveryIntegerFormatExactly) {
+  // Full scale, zero, the smallest steps and odd lengths for the scalar tail
+  std::mt19937 random(8);
+  std::uniform_int_distribution<int32_t> any(INT32_MIN, INT32_MAX);
+  std::vector<int32_t> values = {INT32_MIN, INT32_MAX, 0, -1, 1, 256, -256};
+  while (values.size() < 37) {
+    values.push_back(any(random));
+  }
+
+  for (SampleFormat format : {SampleFormat::PCM16, SampleFormat::PCM24, SampleFormat::PCM32}) {
+    size_t width = format == SampleFormat::PCM16 ? 2 : format == SampleFormat::PCM24 ? 3 : 4;
+    SCOPED_TRACE(width * 8);
+    std::vector<uint8_t> bytes;
+    std::vector<float> expected;
+    for (int32_t value : values) {
+      // The top |width| bytes of the value, little-endian
+      int32_t truncated = static_cast<int32_t>(static_cast<uint32_t>(value) >> (32 - width * 8) << (32 - width * 8));
+      for (size_t b = 4 - width; b < 4; b++) {
+        bytes.push_back(static_cast<uint8_t>(static_cast<uint32_t>(value) >> (b * 8)));
+      }
+      expected.push_back(static_cast<float>(truncated / 2147483648.0));
+    }
+    WidenKernel widen = SelectWidenKernel(format);
+    ASSERT_NE(widen, nullptr);
+    std::vector<float> out(values.size());
+    widen(bytes.data(), values.size(), out.data());
+    EXPECT_EQ(out, expected);
+  }
+  EXPECT_EQ(SelectWidenKernel(SampleFormat::FLOAT32), nullptr);
+}
+
+TEST(FormatKernels, IntegerCaptureIsWidenedAndMixedAsFloat) {
+  FormatKernels kernels = SelectFormatKernels(SampleFormat::PCM24, 2, SampleFormat::PCM32, 1, 1);
+  ASSERT_NE(kernels.widenSystem, nullptr);
+  ASSERT_NE(kernels.widenMic, nullptr);
+  EXPECT_EQ(kernels.systemBits, 32);
+  EXPECT_EQ(kernels.micBits, 32);
+  EXPECT_EQ(kernels.mixedMicChannels, 1);
+
+  // Half scale left, quarter scale right; the microphone adds a quarter
+  const uint8_t system[] = {0x00, 0x00, 0x40, 0x00, 0x00, 0x20};
+  const int32_t mic[] = {0x20000000};
+  float systemFloat[2];
+  float micFloat[1];
+  kernels.widenSystem(system, 2, systemFloat);
+  kernels.widenMic(reinterpret_cast<const uint8_t*>(mic), 1, micFloat);
+  int16_t out[2];
+  kernels.mix(reinterpret_cast<const uint8_t*>(systemFloat), 1,
+              reinterpret_cast<const uint8_t*>(micFloat), 1, 2, 1, out, nullptr, nullptr);
+  EXPECT_EQ(out[0], static_cast<int16_t>(0.5f * 32767.0f) + static_cast<int16_t>(0.25f * 32767.0f));
+  EXPECT_EQ(out[1], static_cast<int16_t>(0.25f * 32767.0f));
+
+  // 16-bit and float capture is read as it comes
+  kernels = SelectFormatKernels(SampleFormat::PCM16, 2, SampleFormat::FLOAT32, 2, 2);
+  EXPECT_EQ(kernels.widenSystem, nullptr);
+  EXPECT_EQ(kernels.widenMic, nullptr);
+  EXPECT_EQ(kernels.systemBits, 16);
+  EXPECT_EQ(kernels.micBits, 32);
+}
+
+TEST(FormatKernels, EverySpecializationMatchesThePerSampleMix) {
+  struct Case {
+    uint16_t systemBits, systemChannels, micBits, micChannels;
+  };
+  const Case cases[] = {{16, 2, 16, 2}, {16, 2, 16, 1}, {16, 1, 16, 2}, {32, 2, 32, 2},
+                        {32, 2, 16, 1}, {32, 1, 32, 1}, {32, 6, 32, 2}, {16, 2, 16, 4},
+                        {32, 8, 16, 6}};
+  std::mt19937 random(5);
+  for (const Case& c : cases) {
+    SCOPED_TRACE(testing::Message() << c.systemBits << "-bit x" << c.systemChannels << " + "
+                                    << c.micBits << "-bit x" << c.micChannels);
+    FormatKernels kernels = SelectFormatKernels(FormatOf(c.systemBits), c.systemChannels,
+                                                FormatOf(c.micBits), c.micChannels, 2);
+    ASSERT_NE(kernels.mix, nullptr);
+    EXPECT_EQ(kernels.mixedMicChannels, std::min(c.systemChannels, c.micChannels));
+
+    // The microphone runs longer than the loopback in one packet and
+    // shorter in the next
+    for (size_t micFrames : {333u, 100u}) {
+      size_t systemFrames = 240;
+      std::vector<uint8_t> system = MakeSource(systemFrames, c.systemChannels, c.systemBits, random);
+      std::vector<uint8_t> mic = MakeSource(micFrames, c.micChannels, c.micBits, random);
+      std::vector<int16_t> out(std::max(systemFrames, micFrames) * c.systemChannels, 12345);
+
+      SourceLevels systemMeter;
+      SourceLevels micMeter;
+      systemMeter.Begin(c.systemChannels);
+      micMeter.Begin(kernels.mixedMicChannels);
+      kernels.mix(system.data(), systemFrames, mic.data(), micFrames, c.systemChannels,
+                  c.micChannels, out.data(), &systemMeter, &micMeter);
+      EXPECT_EQ(out, ReferenceMix(system, c.systemBits, c.systemChannels, systemFrames, mic,
+                                  c.micBits, c.micChannels, micFrames));
+
+      std::vector<ChannelLevels> levels;
+      micMeter.Finish(micFrames, levels);
+      ASSERT_EQ(levels.size(), kernels.mixedMicChannels);
+      float peak = 0.0f;
+      for (size_t frame = 0; frame < micFrames; frame++) {
+        float sample = Sample(mic, c.micBits, frame * c.micChannels) / (c.micBits == 16 ? 32768.0f : 1.0f);
+        peak = std::max(peak, std::abs(sample));
+      }
+      EXPECT_FLOAT_EQ(levels[0].peak, peak);
+    }
+  }
+}
+
+TEST(FormatKernels, FloatKernelsKeepWhatTheSixteenBitOnesRound) {
+  // 16-bit sources come out exactly, scaled to [-1, 1)
+  FormatKernels kernels = SelectFormatKernels(SampleFormat::PCM16, 2, SampleFormat::PCM16, 1, 1);
+  ASSERT_NE(kernels.mixFloat, nullptr);
+  ASSERT_NE(kernels.channelsFloat, nullptr);
+  std::vector<int16_t> system = {1000, -3, 30000, 30000};
+  std::vector<int16_t> mic = {6, 10000};
+  std::vector<float> mixed(4);
+  kernels.mixFloat(reinterpret_cast<const uint8_t*>(system.data()), 2,
+                   reinterpret_cast<const uint8_t*>(mic.data()), 2, 2, 1, mixed.data(), nullptr, nullptr);
+  EXPECT_EQ(mixed, (std::vector<float>{1006 / 32768.0f, -3 / 32768.0f, 1.0f, 30000 / 32768.0f}));
+
+  // Averaging an odd sum keeps the half the 16-bit kernel drops
+  std::vector<float> mono(2);
+  kernels.channelsFloat(mixed.data(), 2, 2, 1, mono.data());
+  EXPECT_FLOAT_EQ(mono[0], 501.5f / 32768.0f);
+  std::vector<int16_t> truncated(2);
+  std::vector<int16_t> pcm = {1006, -3};
+  kernels.channels(pcm.data(), 1, 2, 1, truncated.data());
+  EXPECT_EQ(truncated[0], 501);
+
+  // A float loopback passes through unrounded
+  kernels = SelectFormatKernels(SampleFormat::FLOAT32, 1, SampleFormat::UNSUPPORTED, 0, 1);
+  EXPECT_EQ(kernels.channelsFloat, nullptr);
+  std::vector<float> quiet = {1e-6f, -0.3f};
+  kernels.mixFloat(reinterpret_cast<const uint8_t*>(quiet.data()), 2, nullptr, 0, 1, 0,
+                   mixed.data(), nullptr, nullptr);
+  EXPECT_EQ(mixed[0], 1e-6f);
+  EXPECT_EQ(mixed[1], -0.3f);
+}
+
+TEST(FormatKernels, LeavesUnreadFormatsUnmixed) {
+  // An 8-bit loopback is copied through by the caller
+  EXPECT_EQ(SelectFormatKernels(SampleFormat::UNSUPPORTED, 2, SampleFormat::PCM16, 2, 2).mix, nullptr);
+
+  // An 8-bit microphone is left out of the mix
+  FormatKernels kernels = SelectFormatKernels(SampleFormat::PCM16, 2, SampleFormat::UNSUPPORTED, 2, 2);
+  ASSERT_NE(kernels.mix, nullptr);
+  EXPECT_EQ(kernels.mixedMicChannels, 0);
+  std::vector<int16_t> system = {100, -100, 200, -200};
+  std::vector<int16_t> out(4);
+  kernels.mix(reinterpret_cast<const uint8_t*>(system.data()), 2, nullptr, 0, 2, 2, out.data(),
+              nullptr, nullptr);
+  EXPECT_EQ(out, system);
+
+  // Without a microphone at all
+  kernels = SelectFormatKernels(SampleFormat::FLOAT32, 2, SampleFormat::UNSUPPORTED, 0, 2);
+  ASSERT_NE(kernels.mix, nullptr);
+  std::vector<float> loud = {1.0f, -1.0f};
+  kernels.mix(reinterpret_cast<const uint8_t*>(loud.data()), 1, nullptr, 0, 2, 0, out.data(),
+              nullptr, nullptr);
+  EXPECT_EQ(out[0], 32767);
+  EXPECT_EQ(out[1], -32767);
+}
+
+TEST(FormatKernels, MapsChannelLayouts) {
+  EXPECT_EQ(SelectFormatKernels(SampleFormat::FLOAT32, 2, SampleFormat::FLOAT32, 2, 2).channels, nullptr);
+
+  std::vector<int16_t> stereo = {100, 300, -5, -8, 32767, 32767};
+  std::vector<int16_t> mono(3);
+  FormatKernels down = SelectFormatKernels(SampleFormat::FLOAT32, 2, SampleFormat::FLOAT32, 2, 1);
+  ASSERT_NE(down.channels, nullptr);
+  down.channels(stereo.data(), 3, 2, 1, mono.data());
+  EXPECT_EQ(mono, (std::vector<int16_t>{200, -6, 32767}));
+
+  std::vector<int16_t> doubled(6);
+  FormatKernels up = SelectFormatKernels(SampleFormat::PCM16, 1, SampleFormat::PCM16, 1, 2);
+  ASSERT_NE(up.channels, nullptr);
+  up.channels(mono.data(), 3, 1, 2, doubled.data());
+  EXPECT_EQ(doubled, (std::vector<int16_t>{200, 200, -6, -6, 32767, 32767}));
+
+  // Other layouts keep the channels both have
+  std::vector<int16_t> surround = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+  std::vector<int16_t> front(4);
+  FormatKernels narrow = SelectFormatKernels(SampleFormat::FLOAT32, 6, SampleFormat::FLOAT32, 2, 2);
+  narrow.channels(surround.data(), 2, 6, 2, front.data());
+  EXPECT_EQ(front, (std::vector<int16_t>{1, 2, 7, 8}));
+
+  std::vector<int16_t> wide(12, 99);
+  FormatKernels widen = SelectFormatKernels(SampleFormat::FLOAT32, 2, SampleFormat::FLOAT32, 2, 6);
+  widen.channels(front.data(), 2, 2, 6, wide.data());
+  EXPECT_EQ(wide, (std::vector<int16_t>{1, 2, 0, 0, 0, 0, 7, 8, 0, 0, 0, 0}));
+}
+
+}  // namespace test
+}  // namespace windows_loopback_recorder
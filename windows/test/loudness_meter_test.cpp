@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "windows_loopback_recorder/loudness_meter.h"
+
+namespace windows_loopback_recorder {
+namespace test {
+
+namespace {
+
+constexpr uint32_t kSampleRate = 48000;
+constexpr double kPi = 3.14159265358979323846;
+
+// A 1 kHz sine in every channel, in sections of (seconds, dBFS per channel),
+// as the EBU Tech 3341 conformance signals are built
+class ToneProgram {
+ public:
+  explicit ToneProgram(uint16_t channels) : channels_(channels) {}
+
+  void Add(double seconds, std::vector<double> levels) {
+    size_t frames = static_cast<size_t>(seconds * kSampleRate);
+    for (size_t i = 0; i < frames; i++, position_++) {
+      double value = std::sin(2 * kPi * 1000.0 * position_ / kSampleRate);
+      for (uint16_t c = 0; c < channels_; c++) {
+        double amplitude = std::pow(10.0, levels[levels.size() == 1 ? 0 : c] / 20.0);
+        samples_.push_back(static_cast<int16_t>(std::lround(value * amplitude * 32767.0)));
+      }
+    }
+  }
+
+  // Feeds the meter in 10 ms packets, as the capture thread does
+  LoudnessReading Measure(LoudnessMeter& meter) const {
+    size_t frames = samples_.size() / channels_;
+    for (size_t done = 0; done < frames; done += 480) {
+      meter.Process(&samples_[done * channels_], std::min<size_t>(480, frames - done));
+    }
+    return meter.reading();
+  }
+
+ private:
+  uint16_t channels_;
+  uint64_t position_ = 0;
+  std::vector<int16_t> samples_;
+};
+
+}  // namespace
+
+TEST(LoudnessMeter, StereoSineReadsItsLevel) {
+  // Tech 3341 cases 1 and 2: a stereo sine at -23 / -33 dBFS is -23 / -33 LUFS
+  for (double level : {-23.0, -33.0}) {
+    LoudnessMeter meter;
+    ASSERT_TRUE(meter.Configure(kSampleRate, 2));
+    ToneProgram program(2);
+    program.Add(20.0, {level});
+    LoudnessReading reading = program.Measure(meter);
+    EXPECT_NEAR(reading.integrated, level, 0.1);
+    EXPECT_NEAR(reading.momentary, level, 0.1);
+    EXPECT_NEAR(reading.shortTerm, level, 0.1);
+  }
+}
+
+TEST(LoudnessMeter, RelativeGateIgnoresQuietPassages) {
+  // Case 3: -36 / -23 / -36 dBFS for 10 / 60 / 10 s
+  LoudnessMeter meter;
+  ASSERT_TRUE(meter.Configure(kSampleRate, 2));
+  ToneProgram program(2);
+  program.Add(10.0, {-36.0});
+  program.Add(60.0, {-23.0});
+  program.Add(10.0, {-36.0});
+  EXPECT_NEAR(program.Measure(meter).integrated, -23.0, 0.1);
+}
+
+TEST(LoudnessMeter, AbsoluteGateIgnoresNearSilence) {
+  // Case 4: -72 / -36 / -23 / -36 / -72 dBFS for 10 / 10 / 60 / 10 / 10 s
+  LoudnessMeter meter;
+  ASSERT_TRUE(meter.Configure(kSampleRate, 2));
+  ToneProgram program(2);
+  program.Add(10.0, {-72.0});
+  program.Add(10.0, {-36.0});
+  program.Add(60.0, {-23.0});
+  program.Add(10.0, {-36.0});
+  program.Add(10.0, {-72.0});
+  EXPECT_NEAR(program.Measure(meter).integrated, -23.0, 0.1);
+}
+
+TEST(LoudnessMeter, GatedAverageOfLoudPassages) {
+  // Case 5: -26 / -20 / -26 dBFS for 20 / 20.1 / 20 s
+  LoudnessMeter meter;
+  ASSERT_TRUE(meter.Configure(kSampleRate, 2));
+  ToneProgram program(2);
+  program.Add(20.0, {-26.0});
+  program.Add(20.1, {-20.0});
+  program.Add(20.0, {-26.0});
+  EXPECT_NEAR(program.Measure(meter).integrated, -23.0, 0.1);
+}
+
+TEST(LoudnessMeter, WeighsSurroundChannels) {
+  // Case 6: 5.0 with L/R at -28, C at -24 and Ls/Rs at -30 dBFS
+  LoudnessMeter meter;
+  ASSERT_TRUE(meter.Configure(kSampleRate, 5));
+  ToneProgram program(5);
+  program.Add(20.0, {-28.0, -28.0, -24.0, -30.0, -30.0});
+  EXPECT_NEAR(program.Measure(meter).integrated, -23.0, 0.1);
+  EXPECT_EQ(LoudnessMeter::ChannelWeight(3, 6), 0.0);  // LFE of 5.1
+}
+
+TEST(LoudnessMeter, WindowsFillBeforeReporting) {
+  LoudnessMeter meter;
+  ASSERT_TRUE(meter.Configure(44100, 1));
+  ToneProgram program(1);
+  program.Add(0.35, {-20.0});
+  LoudnessReading reading = program.Measure(meter);
+  EXPECT_TRUE(std::isinf(reading.momentary));
+  EXPECT_TRUE(std::isinf(reading.integrated));
+
+  std::vector<int16_t> more(4410 * 30, 0);
+  meter.Process(more.data(), 4410);
+  EXPECT_FALSE(std::isinf(meter.reading().momentary));
+  EXPECT_TRUE(std::isinf(meter.reading().shortTerm));
+
+  meter.Reset();
+  EXPECT_TRUE(std::isinf(meter.reading().momentary));
+}
+
+}  // namespace test
+}  // namespace windows_loopback_recorder
@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include "windows_loopback_recorder/meter_frame.h"
+
+namespace windows_loopback_recorder {
+namespace test {
+
+namespace {
+
+ChannelLevels Levels(float rms, float peak, float truePeak) {
+  ChannelLevels levels;
+  levels.rms = rms;
+  levels.peak = peak;
+  levels.truePeak = truePeak;
+  return levels;
+}
+
+}  // namespace
+
+TEST(LevelAccumulator, WeighsPowerByFramesAndKeepsPeaks) {
+  LevelAccumulator accumulator;
+  EXPECT_TRUE(accumulator.empty());
+  accumulator.Add({Levels(0.5f, 0.7f, 0.8f)}, 480);
+  accumulator.Add({Levels(0.1f, 0.9f, 0.85f)}, 1440);
+  EXPECT_EQ(accumulator.frames(), 1920u);
+
+  std::vector<ChannelLevels> levels;
+  accumulator.Take(levels);
+  ASSERT_EQ(levels.size(), 1u);
+  EXPECT_NEAR(levels[0].rms, std::sqrt((0.25 * 480 + 0.01 * 1440) / 1920), 1e-6);
+  EXPECT_FLOAT_EQ(levels[0].peak, 0.9f);
+  EXPECT_FLOAT_EQ(levels[0].truePeak, 0.85f);
+
+  // Taking starts a new interval
+  EXPECT_TRUE(accumulator.empty());
+  accumulator.Add({Levels(0.2f, 0.3f, 0.3f)}, 10);
+  accumulator.Take(levels);
+  EXPECT_FLOAT_EQ(levels[0].rms, 0.2f);
+  EXPECT_FLOAT_EQ(levels[0].peak, 0.3f);
+}
+
+TEST(LevelAccumulator, RestartsWhenTheLayoutChanges) {
+  LevelAccumulator accumulator;
+  accumulator.Add({Levels(0.5f, 0.5f, 0.5f)}, 100);
+  accumulator.Add({Levels(0.1f, 0.2f, 0.3f), Levels(0.4f, 0.5f, 0.6f)}, 50);
+  EXPECT_EQ(accumulator.frames(), 50u);
+
+  std::vector<ChannelLevels> levels;
+  accumulator.Take(levels);
+  ASSERT_EQ(levels.size(), 2u);
+  EXPECT_FLOAT_EQ(levels[1].rms, 0.4f);
+}
+
+TEST(MeterFrame, FollowsThePublishedLayout) {
+  LoudnessReading loudness;
+  loudness.momentary = -20.5;
+  loudness.shortTerm = -21.0;
+  std::vector<ChannelLevels> channels = {Levels(0.1f, 0.2f, 0.3f), Levels(0.4f, 0.5f, 0.6f)};
+  std::vector<ChannelLevels> system = {Levels(0.3f, 0.4f, 0.4f), Levels(0.4f, 0.6f, 0.6f)};
+  std::vector<ChannelLevels> mic = {Levels(0.2f, 0.7f, 0.7f)};
+
+  std::vector<float> frame = BuildMeterFrame(1234.0, AudioMeter::Combine(channels), loudness,
+                                             channels, system, mic);
+  ASSERT_EQ(frame.size(), METER_FRAME_FIELDS + 7 * kMeterFrameStride);
+  EXPECT_EQ(frame[METER_FRAME_HEADER_SIZE], static_cast<float>(METER_FRAME_FIELDS));
+  EXPECT_EQ(frame[METER_FRAME_VERSION], kMeterFrameVersion);
+  EXPECT_EQ(frame[METER_FRAME_ELAPSED_MS], 1234.0f);
+  EXPECT_FLOAT_EQ(frame[METER_FRAME_PEAK], 0.5f);
+  EXPECT_FLOAT_EQ(frame[METER_FRAME_MOMENTARY_LUFS], -20.5f);
+  EXPECT_TRUE(std::isinf(frame[METER_FRAME_INTEGRATED_LUFS]));
+  EXPECT_EQ(frame[METER_FRAME_CHANNELS], 2.0f);
+  EXPECT_EQ(frame[METER_FRAME_SOURCES], 2.0f);
+  EXPECT_EQ(frame[METER_FRAME_SYSTEM_CHANNELS], 2.0f);
+  EXPECT_EQ(frame[METER_FRAME_MIC_CHANNELS], 1.0f);
+
+  const float* triples = &frame[METER_FRAME_FIELDS];
+  EXPECT_EQ(std::vector<float>(triples, triples + 6),
+            (std::vector<float>{0.1f, 0.2f, 0.3f, 0.4f, 0.5f, 0.6f}));
+  // Source summaries: power-averaged RMS, largest peak
+  EXPECT_NEAR(triples[6], std::sqrt((0.09 + 0.16) / 2), 1e-6);
+  EXPECT_FLOAT_EQ(triples[7], 0.6f);
+  EXPECT_FLOAT_EQ(triples[9], 0.2f);
+  EXPECT_FLOAT_EQ(triples[10], 0.7f);
+  // Then every source channel
+  EXPECT_EQ(std::vector<float>(triples + 12, triples + 21),
+            (std::vector<float>{0.3f, 0.4f, 0.4f, 0.4f, 0.6f, 0.6f, 0.2f, 0.7f, 0.7f}));
+}
+
+TEST(MeterFrame, MissingSourceReadsSilent) {
+  std::vector<ChannelLevels> channels = {Levels(0.1f, 0.2f, 0.3f)};
+  std::vector<float> frame = BuildMeterFrame(0.0, channels[0], LoudnessReading(), channels, channels, {});
+  ASSERT_EQ(frame.size(), METER_FRAME_FIELDS + 4 * kMeterFrameStride);
+  EXPECT_EQ(frame[METER_FRAME_MIC_CHANNELS], 0.0f);
+  const float* micSummary = &frame[METER_FRAME_FIELDS + 2 * kMeterFrameStride];
+  EXPECT_EQ(micSummary[0], 0.0f);
+  EXPECT_EQ(micSummary[1], 0.0f);
+}
+
+}  // namespace test
+}  // namespace windows_loopback_recorder
@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "windows_loopback_recorder/noise_suppressor.h"
+
+namespace windows_loopback_recorder {
+namespace test {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr uint32_t kSampleRate = 16000;
+
+// Mono white noise at |db| dBFS RMS
+std::vector<float> Noise(double db, size_t frames, uint32_t seed) {
+  std::mt19937 random(seed);
+  std::normal_distribution<float> normal(0.0f, static_cast<float>(std::pow(10.0, db / 20.0)));
+  std::vector<float> samples(frames);
+  for (float& sample : samples) {
+    sample = normal(random);
+  }
+  return samples;
+}
+
+double Energy(const std::vector<float>& samples, size_t first, size_t end) {
+  double sum = 0.0;
+  for (size_t i = first; i < end; i++) {
+    sum += static_cast<double>(samples[i]) * samples[i];
+  }
+  return sum;
+}
+
+// Runs |samples| through the suppressor in 10 ms packets
+std::vector<float> Suppress(NoiseSuppressor& suppressor, const std::vector<float>& samples) {
+  std::vector<float> out(samples.size());
+  size_t packet = kSampleRate / 100;
+  for (size_t i = 0; i + packet <= samples.size(); i += packet) {
+    suppressor.Process(&samples[i], &out[i], packet);
+  }
+  return out;
+}
+
+}  // namespace
+
+TEST(NoiseSuppressor, AttenuatesStationaryNoise) {
+  NoiseSuppressor suppressor;
+  ASSERT_TRUE(suppressor.Configure(kSampleRate, 1));
+
+  std::vector<float> noise = Noise(-40.0, kSampleRate * 4, 1);
+  std::vector<float> out = Suppress(suppressor, noise);
+
+  // Once the floor is learned the noise is close to the full 20 dB down
+  double before = Energy(noise, kSampleRate * 3, kSampleRate * 4);
+  double after = Energy(out, kSampleRate * 3, kSampleRate * 4);
+  EXPECT_GT(10.0 * std::log10(before / after), 15.0);
+  EXPECT_NEAR(suppressor.noiseDb(), -40.0f, 3.0f);
+}
+
+TEST(NoiseSuppressor, KeepsToneBurstsAboveTheNoise) {
+  NoiseSuppressor suppressor;
+  ASSERT_TRUE(suppressor.Configure(kSampleRate, 2));
+
+  // Stereo: the same 250 ms tone bursts in both channels over independent
+  // noise. A steady tone would eventually be taken for noise.
+  size_t frames = kSampleRate * 4;
+  std::vector<float> left = Noise(-45.0, frames, 2);
+  std::vector<float> right = Noise(-45.0, frames, 3);
+  std::vector<float> tone(frames);
+  std::vector<int16_t> samples(frames * 2);
+  for (size_t i = 0; i < frames; i++) {
+    bool on = (i / (kSampleRate / 4)) % 2 == 0;
+    tone[i] = on ? static_cast<float>(0.25 * std::sin(2.0 * kPi * 1000.0 * i / kSampleRate)) : 0.0f;
+    samples[i * 2] = static_cast<int16_t>(std::lround((tone[i] + left[i]) * 32767.0f));
+    samples[i * 2 + 1] = static_cast<int16_t>(std::lround((tone[i] + right[i]) * 32767.0f));
+  }
+  suppressor.Process(samples.data(), samples.data(), frames);
+
+  // What is left beside the delayed tone is well below the input noise
+  size_t lag = suppressor.latencyFrames();
+  double residual = 0.0;
+  double noise = 0.0;
+  for (size_t i = kSampleRate * 3; i < frames; i++) {
+    for (size_t c = 0; c < 2; c++) {
+      double difference = samples[i * 2 + c] / 32767.0 - tone[i - lag];
+      residual += difference * difference;
+    }
+    noise += static_cast<double>(left[i]) * left[i] + static_cast<double>(right[i]) * right[i];
+  }
+  EXPECT_GT(10.0 * std::log10(noise / residual), 6.0);
+}
+
+TEST(NoiseSuppressor, ReportsFixedLatency) {
+  NoiseSuppressor suppressor;
+  ASSERT_TRUE(suppressor.Configure(48000, 2));
+  EXPECT_EQ(suppressor.latencyFrames(), 512u);
+  EXPECT_NEAR(suppressor.latencyMs(), 10.67, 0.01);
+
+  // An impulse comes out latencyFrames() later, where it went in
+  ASSERT_TRUE(suppressor.Configure(kSampleRate, 1));
+  std::vector<float> samples(kSampleRate, 0.0f);
+  samples[1000] = 0.5f;
+  std::vector<float> out = Suppress(suppressor, samples);
+  size_t peak = 0;
+  for (size_t i = 0; i < out.size(); i++) {
+    if (std::fabs(out[i]) > std::fabs(out[peak])) {
+      peak = i;
+    }
+  }
+  EXPECT_EQ(peak, 1000 + suppressor.latencyFrames());
+}
+
+TEST(NoiseSuppressor, SharesTheFftAndRejectsInvalidSettings) {
+  NoiseSuppressor mic;
+  NoiseSuppressor system;
+  ASSERT_TRUE(mic.Configure(48000, 1));
+  ASSERT_TRUE(system.Configure(48000, 2, 12.0f, mic.fft()));
+  EXPECT_EQ(system.fft(), mic.fft());
+  ASSERT_TRUE(system.Configure(kSampleRate, 2, 12.0f, mic.fft()));
+  EXPECT_NE(system.fft(), mic.fft());
+
+  NoiseSuppressor suppressor;
+  EXPECT_FALSE(suppressor.Configure(4000, 1));
+  EXPECT_FALSE(suppressor.Configure(48000, 0));
+  EXPECT_FALSE(suppressor.Configure(48000, 1, 0.0f));
+  EXPECT_FALSE(suppressor.Configure(48000, 1, NoiseSuppressor::kMaxAttenuationDb + 1.0f));
+  EXPECT_FALSE(suppressor.configured());
+}
+
+}  // namespace test
+}  // namespace windows_loopback_recorder
@@ -0,0 +1,184 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "windows_loopback_recorder/peak_pyramid.h"
+
+namespace windows_loopback_recorder {
+namespace test {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Stereo: a swelling sine on the left, noise on the right
+std::vector<int16_t> MakeAudio(size_t frames) {
+  std::mt19937 random(5);
+  std::uniform_int_distribution<int> noise(-3000, 3000);
+  std::vector<int16_t> samples(frames * 2);
+  for (size_t i = 0; i < frames; i++) {
+    double swell = static_cast<double>(i) / frames;
+    samples[i * 2] = static_cast<int16_t>(30000.0 * swell * std::sin(2.0 * kPi * i / 1000.0));
+    samples[i * 2 + 1] = static_cast<int16_t>(noise(random));
+  }
+  return samples;
+}
+
+// Min, max and RMS of |channel| over frames [first, end), as a query reports them
+void Expect(const std::vector<int16_t>& samples, uint16_t channel, uint64_t first, uint64_t end,
+            const float* column) {
+  int16_t low = samples[first * 2 + channel];
+  int16_t high = low;
+  double energy = 0.0;
+  for (uint64_t i = first; i < end; i++) {
+    int16_t sample = samples[i * 2 + channel];
+    low = std::min(low, sample);
+    high = std::max(high, sample);
+    energy += static_cast<double>(sample) * sample;
+  }
+  EXPECT_FLOAT_EQ(column[0], low / 32768.0f) << first;
+  EXPECT_FLOAT_EQ(column[1], high / 32768.0f) << first;
+  EXPECT_NEAR(column[2], std::sqrt(energy / (end - first)) / 32768.0, 1e-4) << first;
+}
+
+int16_t MinOf(const std::vector<int16_t>& samples, uint16_t channel, uint64_t first, uint64_t end) {
+  int16_t low = samples[first * 2 + channel];
+  for (uint64_t i = first; i < end; i++) {
+    low = std::min(low, samples[i * 2 + channel]);
+  }
+  return low;
+}
+
+int16_t MaxOf(const std::vector<int16_t>& samples, uint16_t channel, uint64_t first, uint64_t end) {
+  int16_t high = samples[first * 2 + channel];
+  for (uint64_t i = first; i < end; i++) {
+    high = std::max(high, samples[i * 2 + channel]);
+  }
+  return high;
+}
+
+std::string TempPath(const char* name) {
+  return ::testing::TempDir() + name;
+}
+
+}  // namespace
+
+TEST(PeakPyramid, SummarizesEachBaseBucket) {
+  PeakPyramid pyramid;
+  ASSERT_TRUE(pyramid.Configure(48000, 2));
+  std::vector<int16_t> samples = MakeAudio(PeakPyramid::kBaseFrames * 40 + 100);
+  // Odd-sized pushes, as capture packets arrive
+  for (size_t i = 0; i < samples.size() / 2; i += 441) {
+    pyramid.Push(&samples[i * 2], std::min<size_t>(441, samples.size() / 2 - i));
+  }
+  EXPECT_EQ(pyramid.frames(), PeakPyramid::kBaseFrames * 40);
+
+  PeakColumns result;
+  ASSERT_TRUE(pyramid.Query(0, pyramid.frames(), 40, result));
+  EXPECT_EQ(result.bucketFrames, PeakPyramid::kBaseFrames);
+  ASSERT_EQ(result.values.size(), 40u * 2 * 3);
+  for (size_t i = 0; i < 40; i++) {
+    uint64_t first = i * PeakPyramid::kBaseFrames;
+    for (uint16_t c = 0; c < 2; c++) {
+      Expect(samples, c, first, first + PeakPyramid::kBaseFrames, &result.values[(i * 2 + c) * 3]);
+    }
+  }
+  EXPECT_FALSE(pyramid.Query(pyramid.frames(), pyramid.frames() + 10, 4, result));
+  EXPECT_FALSE(pyramid.Query(0, 100, 0, result));
+}
+
+TEST(PeakPyramid, ReadsWideRangesFromCoarseLevels) {
+  PeakPyramid pyramid;
+  ASSERT_TRUE(pyramid.Configure(48000, 2));
+  std::vector<int16_t> samples = MakeAudio(48000 * 30);
+  pyramid.Push(samples.data(), samples.size() / 2);
+
+  // 30 s in 20 columns: 72000 frames each, so 65536-frame buckets
+  PeakColumns result;
+  ASSERT_TRUE(pyramid.Query(0, pyramid.frames(), 20, result));
+  EXPECT_EQ(result.bucketFrames, PeakPyramid::BucketFrames(2));
+
+  // A column holds at least its own frames and at most the buckets it
+  // touches; level 2 buckets not finished yet are filled in from below
+  uint64_t frames = pyramid.frames();
+  uint64_t bucket = result.bucketFrames;
+  for (size_t i = 0; i < 20; i++) {
+    uint64_t a = frames * i / 20;
+    uint64_t b = frames * (i + 1) / 20;
+    for (uint16_t c = 0; c < 2; c++) {
+      const float* column = &result.values[(i * 2 + c) * 3];
+      EXPECT_LE(column[0], MinOf(samples, c, a, b) / 32768.0f) << i;
+      EXPECT_GE(column[0], MinOf(samples, c, a / bucket * bucket, std::min(b + bucket, frames)) / 32768.0f) << i;
+      EXPECT_GE(column[1], MaxOf(samples, c, a, b) / 32768.0f) << i;
+      EXPECT_LE(column[1], MaxOf(samples, c, a / bucket * bucket, std::min(b + bucket, frames)) / 32768.0f) << i;
+    }
+  }
+  // The last column still reaches the last frame
+  EXPECT_FLOAT_EQ(result.values[(19 * 2) * 3 + 1], MaxOf(samples, 0, frames * 19 / 20, frames) / 32768.0f);
+}
+
+TEST(PeakPyramid, SavesAndQueriesTheFile) {
+  PeakPyramid pyramid;
+  ASSERT_TRUE(pyramid.Configure(16000, 2));
+  size_t frames = 16000 * 20 + 1234;  // Partial buckets at every level
+  std::vector<int16_t> samples = MakeAudio(frames);
+  pyramid.Push(samples.data(), frames);
+
+  std::string path = TempPath("peak_pyramid_test.wav.peaks");
+  EXPECT_EQ(PeakPyramid::PathFor(TempPath("peak_pyramid_test.wav")), path);
+  ASSERT_TRUE(pyramid.Save(path));
+
+  // The file covers every frame, the partial tail included
+  PeakColumns fromFile;
+  ASSERT_TRUE(PeakPyramid::QueryFile(path, 0, frames, 10, fromFile));
+  EXPECT_EQ(fromFile.frames, frames);
+  EXPECT_EQ(fromFile.sampleRate, 16000u);
+  EXPECT_EQ(fromFile.channels, 2);
+  EXPECT_EQ(fromFile.bucketFrames, PeakPyramid::BucketFrames(1));
+  for (uint16_t c = 0; c < 2; c++) {
+    float high = -1.0f;
+    float low = 1.0f;
+    for (size_t i = 0; i < 10; i++) {
+      low = std::min(low, fromFile.values[(i * 2 + c) * 3]);
+      high = std::max(high, fromFile.values[(i * 2 + c) * 3 + 1]);
+    }
+    EXPECT_FLOAT_EQ(low, MinOf(samples, c, 0, frames) / 32768.0f);
+    EXPECT_FLOAT_EQ(high, MaxOf(samples, c, 0, frames) / 32768.0f);
+  }
+
+  // Where both have the buckets, file and memory agree
+  PeakColumns fromMemory;
+  ASSERT_TRUE(PeakPyramid::QueryFile(path, 2560, 25600, 90, fromFile));
+  ASSERT_TRUE(pyramid.Query(2560, 25600, 90, fromMemory));
+  EXPECT_EQ(fromFile.bucketFrames, PeakPyramid::kBaseFrames);
+  EXPECT_EQ(fromFile.values, fromMemory.values);
+
+  EXPECT_FALSE(PeakPyramid::QueryFile(TempPath("peak_pyramid_missing.peaks"), 0, 100, 4, fromFile));
+  std::remove(path.c_str());
+}
+
+TEST(PeakPyramid, WeighsThePartialTailByItsFrames) {
+  PeakPyramid pyramid;
+  ASSERT_TRUE(pyramid.Configure(16000, 2));
+  // Two silent base buckets, then 100 frames of a constant half scale
+  std::vector<int16_t> samples(612 * 2, 0);
+  std::fill(samples.begin() + 512 * 2, samples.end(), static_cast<int16_t>(16384));
+  pyramid.Push(samples.data(), 612);
+
+  std::string path = TempPath("peak_pyramid_tail.peaks");
+  ASSERT_TRUE(pyramid.Save(path));
+  PeakColumns fromFile;
+  ASSERT_TRUE(PeakPyramid::QueryFile(path, 0, 612, 1, fromFile));
+  for (uint16_t c = 0; c < 2; c++) {
+    Expect(samples, c, 0, 612, &fromFile.values[c * 3]);
+  }
+  std::remove(path.c_str());
+}
+
+}  // namespace test
+}  // namespace windows_loopback_recorder
@@ -0,0 +1,172 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "windows_loopback_recorder/pre_roll_buffer.h"
+
+namespace windows_loopback_recorder {
+namespace test {
+
+namespace {
+
+// 48 kHz stereo 16-bit: 4 bytes per frame, 100 ms PCM blocks of 19200 bytes.
+constexpr uint32_t kSampleRate = 48000;
+constexpr uint32_t kBytesPerFrame = 4;
+
+WavFormat MakeFormat() {
+  WavFormat format;
+  format.sampleRate = kSampleRate;
+  format.channels = 2;
+  format.bitsPerSample = 16;
+  return format;
+}
+
+// Each frame holds its own index (mod 2^32), so positions can be checked
+std::vector<uint8_t> MakeFrames(uint64_t first, size_t count) {
+  std::vector<uint8_t> data(count * kBytesPerFrame);
+  for (size_t i = 0; i < count; i++) {
+    uint32_t index = static_cast<uint32_t>(first + i);
+    std::memcpy(&data[i * kBytesPerFrame], &index, sizeof(index));
+  }
+  return data;
+}
+
+uint32_t FrameAt(const std::vector<uint8_t>& file, size_t dataOffset, size_t frame) {
+  uint32_t index = 0;
+  std::memcpy(&index, &file[dataOffset + frame * kBytesPerFrame], sizeof(index));
+  return index;
+}
+
+// Writes |frames| frames in 10 ms packets, starting at frame |first|
+void WritePackets(PreRollBuffer& buffer, uint64_t first, uint64_t frames) {
+  for (uint64_t done = 0; done < frames; done += 480) {
+    std::vector<uint8_t> packet = MakeFrames(first + done, static_cast<size_t>(std::min<uint64_t>(480, frames - done)));
+    buffer.Write(packet.data(), packet.size());
+  }
+}
+
+}  // namespace
+
+TEST(PreRollBuffer, RejectsBudgetBelowTwoBlocks) {
+  PreRollBuffer buffer;
+  PreRollOptions options;
+  options.budgetBytes = 19200;
+  EXPECT_FALSE(buffer.Configure(MakeFormat(), options));
+  options.budgetBytes = 2 * 19200;
+  EXPECT_TRUE(buffer.Configure(MakeFormat(), options));
+}
+
+TEST(PreRollBuffer, HoldsNewestAudioWithinBudget) {
+  PreRollBuffer buffer;
+  PreRollOptions options;
+  options.budgetBytes = kSampleRate * kBytesPerFrame;  // One second
+  ASSERT_TRUE(buffer.Configure(MakeFormat(), options));
+
+  WritePackets(buffer, 0, kSampleRate * 3 + 1234);
+  EXPECT_LE(buffer.heldBytes(), options.budgetBytes);
+  EXPECT_GE(buffer.heldFrames(), kSampleRate * 8 / 10);
+
+  PreRollSnapshot snapshot = buffer.Snapshot(0);
+  EXPECT_EQ(snapshot.container, FileContainer::WAV);
+  EXPECT_EQ(snapshot.frames, buffer.heldFrames());
+  EXPECT_EQ(snapshot.firstFrame + snapshot.frames, kSampleRate * 3 + 1234u);
+
+  std::vector<uint8_t> file = snapshot.ToFile();
+  ASSERT_EQ(file.size(), WavFileSink::kDataOffset + snapshot.frames * kBytesPerFrame);
+  EXPECT_EQ(std::memcmp(file.data(), "RIFF", 4), 0);
+  EXPECT_EQ(FrameAt(file, WavFileSink::kDataOffset, 0), snapshot.firstFrame);
+  EXPECT_EQ(FrameAt(file, WavFileSink::kDataOffset, snapshot.frames - 1), kSampleRate * 3 + 1233u);
+}
+
+TEST(PreRollBuffer, SnapshotTrimsToExactFrames) {
+  PreRollBuffer buffer;
+  PreRollOptions options;
+  options.budgetBytes = kSampleRate * kBytesPerFrame;
+  ASSERT_TRUE(buffer.Configure(MakeFormat(), options));
+  WritePackets(buffer, 0, 30000);
+
+  PreRollSnapshot snapshot = buffer.Snapshot(4801);
+  EXPECT_EQ(snapshot.frames, 4801u);
+  EXPECT_EQ(snapshot.firstFrame, 30000u - 4801u);
+
+  std::vector<uint8_t> file = snapshot.ToFile();
+  ASSERT_EQ(file.size(), WavFileSink::kDataOffset + 4801 * kBytesPerFrame);
+  for (size_t i = 0; i < 4801; i++) {
+    ASSERT_EQ(FrameAt(file, WavFileSink::kDataOffset, i), 30000u - 4801u + i);
+  }
+}
+
+TEST(PreRollBuffer, SnapshotOutlivesEviction) {
+  PreRollBuffer buffer;
+  PreRollOptions options;
+  options.budgetBytes = 4 * 19200;
+  ASSERT_TRUE(buffer.Configure(MakeFormat(), options));
+  WritePackets(buffer, 0, 9600);
+
+  PreRollSnapshot snapshot = buffer.Snapshot(0);
+  std::vector<uint8_t> before = snapshot.ToFile();
+
+  // Cycle the ring several times over; pinned blocks must not be recycled
+  WritePackets(buffer, 9600, kSampleRate * 2);
+  EXPECT_EQ(snapshot.ToFile(), before);
+  EXPECT_EQ(FrameAt(before, WavFileSink::kDataOffset, 0), snapshot.firstFrame);
+  EXPECT_EQ(buffer.Snapshot(1).firstFrame, 9600u + kSampleRate * 2 - 1);
+}
+
+TEST(PreRollBuffer, CompressedRingHoldsFlacFrames) {
+  PreRollBuffer buffer;
+  PreRollOptions options;
+  options.budgetBytes = kSampleRate * kBytesPerFrame / 2;
+  options.compressed = true;
+  ASSERT_TRUE(buffer.Configure(MakeFormat(), options));
+
+  // Silence compresses to a few bytes per frame, so the budget stretches
+  std::vector<uint8_t> silence(480 * kBytesPerFrame, 0);
+  for (int i = 0; i < 500; i++) {
+    buffer.Write(silence.data(), silence.size());
+  }
+  // Frames are encoded on the worker pool; give the last ones time to land
+  for (int i = 0; i < 200 && buffer.heldFrames() < 4096 * 58; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    buffer.Write(nullptr, 0);
+  }
+  EXPECT_EQ(buffer.heldFrames(), 4096u * 58);  // 240000 frames in, whole frames out
+  EXPECT_LE(buffer.heldBytes(), options.budgetBytes);
+
+  PreRollSnapshot snapshot = buffer.Snapshot(kSampleRate);
+  EXPECT_EQ(snapshot.container, FileContainer::FLAC);
+  EXPECT_EQ(snapshot.frames % 4096, 0u);
+  EXPECT_GE(snapshot.frames, kSampleRate);
+  EXPECT_EQ(snapshot.firstFrame % 4096, 0u);
+
+  std::vector<uint8_t> file = snapshot.ToFile();
+  EXPECT_EQ(std::memcmp(file.data(), "fLaC", 4), 0);
+}
+
+TEST(PreRollBuffer, CompressedRingKeepsPcmFlacCannotHold) {
+  WavFormat format = MakeFormat();
+  format.bitsPerSample = 32;
+  format.floatSamples = true;
+  PreRollOptions options;
+  options.budgetBytes = 1 << 20;
+  options.compressed = true;
+
+  PreRollBuffer buffer;
+  ASSERT_TRUE(buffer.Configure(format, options));
+  EXPECT_FALSE(buffer.options().compressed);
+
+  std::vector<uint8_t> packet(480 * 8, 0);
+  buffer.Write(packet.data(), packet.size());
+  PreRollSnapshot snapshot = buffer.Snapshot(0);
+  EXPECT_EQ(snapshot.container, FileContainer::WAV);
+  EXPECT_EQ(snapshot.frames, 480u);
+  EXPECT_TRUE(snapshot.format.floatSamples);
+}
+
+}  // namespace test
+}  // namespace windows_loopback_recorder
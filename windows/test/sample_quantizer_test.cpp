@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "windows_loopback_recorder/format_kernels.h"
+#include "windows_loopback_recorder/sample_quantizer.h"
+
+namespace windows_loopback_recorder {
+namespace test {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+std::vector<int16_t> ToPcm16(SampleQuantizer& quantizer, const std::vector<float>& in, size_t packet) {
+  uint16_t channels = quantizer.channels();
+  std::vector<int16_t> out(in.size());
+  for (size_t start = 0; start < in.size(); start += packet * channels) {
+    size_t frames = std::min(packet, (in.size() - start) / channels);
+    quantizer.Quantize(&in[start], frames, reinterpret_cast<uint8_t*>(&out[start]));
+  }
+  return out;
+}
+
+// What the output adds to the signal, in 16-bit steps
+std::vector<double> ErrorOf(const std::vector<int16_t>& out, const std::vector<float>& in) {
+  std::vector<double> error(in.size());
+  for (size_t i = 0; i < in.size(); i++) {
+    error[i] = out[i] - in[i] * 32768.0;
+  }
+  return error;
+}
+
+double Correlation(const std::vector<double>& a, size_t offsetA, const std::vector<double>& b,
+                   size_t offsetB, size_t stride, size_t count) {
+  double ab = 0.0;
+  double aa = 0.0;
+  double bb = 0.0;
+  for (size_t i = 0; i < count; i++) {
+    double x = a[offsetA + i * stride];
+    double y = b[offsetB + i * stride];
+    ab += x * y;
+    aa += x * x;
+    bb += y * y;
+  }
+  return ab / std::sqrt(aa * bb);
+}
+
+}  // namespace
+
+TEST(SampleQuantizer, UnditheredSixteenBitKeepsTheTruncatingConversion) {
+  SampleQuantizer quantizer;
+  ASSERT_TRUE(quantizer.Configure(SampleFormat::PCM16, 2, DitherMode::NONE));
+  std::vector<float> in = {0.5f, -0.5f, 1.5f, -1.5f, 0.99999f, -0.00002f, 0.25f};
+  in.resize(10, 0.1f);
+  std::vector<int16_t> out = ToPcm16(quantizer, in, 5);
+  for (size_t i = 0; i < in.size(); i++) {
+    float clamped = std::max(-1.0f, std::min(1.0f, in[i]));
+    EXPECT_EQ(out[i], static_cast<int16_t>(clamped * 32767.0f)) << i;
+  }
+  EXPECT_FALSE(quantizer.Configure(SampleFormat::UNSUPPORTED, 2, DitherMode::NONE));
+  EXPECT_FALSE(quantizer.Configure(SampleFormat::PCM16, 0, DitherMode::NONE));
+}
+
+TEST(SampleQuantizer, DeepFormatsUndoTheWidenKernels) {
+  // Every packed 24-bit and 32-bit value the capture side widens comes back
+  std::mt19937 random(3);
+  size_t samples = 1001;
+  std::vector<uint8_t> pcm24(samples * 3);
+  std::vector<uint8_t> pcm32(samples * 4);
+  for (uint8_t& byte : pcm24) byte = static_cast<uint8_t>(random());
+  for (size_t i = 0; i < samples; i++) {
+    // Float keeps 24 significant bits, so 32-bit sources carry that many
+    int32_t value = static_cast<int32_t>(random()) & ~0xFF;
+    std::memcpy(&pcm32[i * 4], &value, 4);
+  }
+  std::vector<float> widened(samples);
+  std::vector<uint8_t> out(samples * 4);
+  SampleQuantizer quantizer;
+
+  SelectWidenKernel(SampleFormat::PCM24)(pcm24.data(), samples, widened.data());
+  ASSERT_TRUE(quantizer.Configure(SampleFormat::PCM24, 1, DitherMode::NONE));
+  EXPECT_EQ(quantizer.bytesPerSample(), 3);
+  quantizer.Quantize(widened.data(), samples, out.data());
+  EXPECT_TRUE(std::equal(pcm24.begin(), pcm24.end(), out.begin()));
+
+  SelectWidenKernel(SampleFormat::PCM32)(pcm32.data(), samples, widened.data());
+  ASSERT_TRUE(quantizer.Configure(SampleFormat::PCM32, 1, DitherMode::TRIANGULAR));
+  EXPECT_EQ(quantizer.dither(), DitherMode::NONE);
+  quantizer.Quantize(widened.data(), samples, out.data());
+  EXPECT_EQ(out, pcm32);
+
+  // Full scale clips instead of wrapping
+  std::vector<float> loud = {1.0f, -1.0f, 2.0f};
+  quantizer.Quantize(loud.data(), 3, out.data());
+  int32_t clipped[3];
+  std::memcpy(clipped, out.data(), sizeof(clipped));
+  EXPECT_EQ(clipped[0], 2147483520);
+  EXPECT_EQ(clipped[1], INT32_MIN);
+  EXPECT_EQ(clipped[2], 2147483520);
+
+  ASSERT_TRUE(quantizer.Configure(SampleFormat::FLOAT32, 1, DitherMode::SHAPED));
+  quantizer.Quantize(loud.data(), 3, out.data());
+  float copied[3];
+  std::memcpy(copied, out.data(), sizeof(copied));
+  EXPECT_EQ(copied[0], 1.0f);
+  EXPECT_EQ(copied[2], 1.0f);
+}
+
+TEST(SampleQuantizer, TriangularDitherKeepsDetailBelowTheLastBit) {
+  // A tone of 0.4 steps truncates to nothing; dithered, it survives in the
+  // average and the error no longer follows it
+  size_t frames = 48000;
+  std::vector<float> tone(frames);
+  for (size_t i = 0; i < frames; i++) {
+    tone[i] = static_cast<float>(0.4 / 32768.0 * std::sin(2.0 * kPi * 1000.0 * i / 48000.0));
+  }
+  auto amplitude = [&](const std::vector<int16_t>& out) {
+    double sum = 0.0;
+    for (size_t i = 0; i < frames; i++) {
+      sum += out[i] * std::sin(2.0 * kPi * 1000.0 * i / 48000.0);
+    }
+    return 2.0 * sum / frames;
+  };
+  SampleQuantizer quantizer;
+  ASSERT_TRUE(quantizer.Configure(SampleFormat::PCM16, 1, DitherMode::NONE));
+  EXPECT_EQ(amplitude(ToPcm16(quantizer, tone, 480)), 0.0);
+
+  ASSERT_TRUE(quantizer.Configure(SampleFormat::PCM16, 1, DitherMode::TRIANGULAR));
+  std::vector<int16_t> out = ToPcm16(quantizer, tone, 480);
+  EXPECT_NEAR(amplitude(out), 0.4, 0.03);
+  std::vector<double> error = ErrorOf(out, tone);
+  double mean = 0.0;
+  double power = 0.0;
+  for (double e : error) {
+    EXPECT_LE(std::abs(e), 1.5);
+    mean += e;
+    power += e * e;
+  }
+  EXPECT_NEAR(mean / frames, 0.0, 0.01);
+  // Triangular noise has 1/6 of a step squared, rounding adds 1/12
+  EXPECT_NEAR(power / frames, 0.25, 0.01);
+}
+
+TEST(SampleQuantizer, ShapingMovesTheNoiseUp) {
+  size_t frames = 48000;
+  std::vector<float> quiet(frames * 2);
+  std::mt19937 random(8);
+  std::normal_distribution<float> normal(0.0f, 0.01f);
+  for (float& sample : quiet) sample = normal(random);
+
+  SampleQuantizer flat;
+  SampleQuantizer shaped;
+  ASSERT_TRUE(flat.Configure(SampleFormat::PCM16, 2, DitherMode::TRIANGULAR));
+  ASSERT_TRUE(shaped.Configure(SampleFormat::PCM16, 2, DitherMode::SHAPED));
+  std::vector<double> flatError = ErrorOf(ToPcm16(flat, quiet, 480), quiet);
+  std::vector<double> shapedError = ErrorOf(ToPcm16(shaped, quiet, 480), quiet);
+
+  // Neighbouring samples of one channel: white noise is uncorrelated,
+  // first-differenced noise correlates at -1/2
+  EXPECT_NEAR(Correlation(flatError, 0, flatError, 2, 2, frames - 1), 0.0, 0.02);
+  EXPECT_NEAR(Correlation(shapedError, 0, shapedError, 2, 2, frames - 1), -0.5, 0.02);
+  // The two channels get unrelated noise
+  EXPECT_NEAR(Correlation(flatError, 0, flatError, 1, 2, frames), 0.0, 0.02);
+  EXPECT_NEAR(Correlation(shapedError, 0, shapedError, 1, 2, frames), 0.0, 0.02);
+}
+
+TEST(SampleQuantizer, OutputDoesNotDependOnPacketSize) {
+  std::vector<float> in(3 * 1999);
+  std::mt19937 random(4);
+  std::uniform_real_distribution<float> level(-1.0f, 1.0f);
+  for (float& sample : in) sample = level(random);
+  for (DitherMode mode : {DitherMode::TRIANGULAR, DitherMode::SHAPED}) {
+    SampleQuantizer whole;
+    SampleQuantizer pieces;
+    ASSERT_TRUE(whole.Configure(SampleFormat::PCM16, 3, mode));
+    ASSERT_TRUE(pieces.Configure(SampleFormat::PCM16, 3, mode));
+    std::vector<int16_t> a = ToPcm16(whole, in, 1999);
+    std::vector<int16_t> b = ToPcm16(pieces, in, 7);
+    EXPECT_EQ(a, b);
+
+    // And starts over after a reset
+    whole.Reset();
+    EXPECT_EQ(ToPcm16(whole, in, 1999), a);
+  }
+}
+
+}  // namespace test
+}  // namespace windows_loopback_recorder
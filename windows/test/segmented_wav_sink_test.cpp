@@ -0,0 +1,196 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "windows_loopback_recorder/segmented_wav_sink.h"
+
+namespace windows_loopback_recorder {
+namespace test {
+
+namespace {
+
+constexpr uint32_t kBytesPerFrame = 4;  // 16-bit stereo
+
+WavFormat StereoPcm16() {
+  WavFormat format;
+  format.sampleRate = 48000;
+  format.channels = 2;
+  format.bitsPerSample = 16;
+  return format;
+}
+
+std::vector<uint8_t> ReadFile(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// Each frame holds its own index so cuts can be checked sample by sample
+std::vector<uint8_t> CountingFrames(uint32_t firstFrame, uint32_t frames) {
+  std::vector<uint8_t> data(frames * kBytesPerFrame);
+  for (uint32_t i = 0; i < frames; i++) {
+    uint32_t index = firstFrame + i;
+    std::memcpy(&data[i * kBytesPerFrame], &index, sizeof(index));
+  }
+  return data;
+}
+
+uint32_t FrameAt(const std::vector<uint8_t>& file, uint64_t frame) {
+  uint32_t index;
+  std::memcpy(&index, &file[WavFileSink::kDataOffset + frame * kBytesPerFrame], sizeof(index));
+  return index;
+}
+
+}  // namespace
+
+TEST(SegmentedWavSink, NumbersSegmentPaths) {
+  EXPECT_EQ(SegmentedWavSink::SegmentPath("C:\\rec\\capture.wav", 3), "C:\\rec\\capture_000003.wav");
+  EXPECT_EQ(SegmentedWavSink::SegmentPath("/tmp/a.b/capture", 12), "/tmp/a.b/capture_000012");
+}
+
+TEST(SegmentedWavSink, SingleFileWithoutLimits) {
+  std::string path = (std::filesystem::temp_directory_path() / "segmented_single.wav").string();
+
+  SegmentedWavSink sink;
+  ASSERT_TRUE(sink.Open(path, StereoPcm16(), SegmentOptions()));
+  EXPECT_FALSE(sink.segmented());
+  std::vector<uint8_t> data = CountingFrames(0, 480);
+  sink.Write(data.data(), data.size());
+  ASSERT_TRUE(sink.Close());
+
+  EXPECT_EQ(sink.segmentCount(), 1u);
+  EXPECT_EQ(ReadFile(path).size(), WavFileSink::kDataOffset + data.size());
+  std::filesystem::remove(path);
+}
+
+TEST(SegmentedWavSink, CutsExactlyWithoutGapOrOverlap) {
+  std::string path = (std::filesystem::temp_directory_path() / "segmented_cut.wav").string();
+
+  SegmentOptions segments;
+  segments.segmentBytes = WavFileSink::kDataOffset + 1000 * kBytesPerFrame;  // 1000 frames
+  WavSinkOptions options;
+  options.blockBytes = 4096;
+  options.blockCount = 4;
+
+  std::mutex mutex;
+  std::vector<SegmentInfo> completed;
+  SegmentedWavSink sink;
+  ASSERT_TRUE(sink.Open(path, StereoPcm16(), segments,
+                        [&](const SegmentInfo& segment) {
+                          std::lock_guard<std::mutex> lock(mutex);
+                          completed.push_back(segment);
+                        },
+                        options));
+  EXPECT_EQ(sink.segmentFrames(), 1000u);
+
+  // 35 packets of 96 frames never line up with the 1000-frame cuts
+  for (uint32_t packet = 0; packet < 35; packet++) {
+    std::vector<uint8_t> data = CountingFrames(packet * 96, 96);
+    sink.Write(data.data(), data.size());
+  }
+  ASSERT_TRUE(sink.Close());
+
+  ASSERT_EQ(completed.size(), 4u);
+  EXPECT_EQ(sink.segmentCount(), 4u);
+  EXPECT_EQ(sink.totalFrames(), 3360u);
+  EXPECT_EQ(sink.GetStats().droppedBytes, 0u);
+
+  uint64_t expectedFirst = 0;
+  for (uint32_t i = 0; i < completed.size(); i++) {
+    const SegmentInfo& segment = completed[i];
+    EXPECT_EQ(segment.index, i);
+    EXPECT_EQ(segment.path, SegmentedWavSink::SegmentPath(path, i));
+    EXPECT_EQ(segment.firstFrame, expectedFirst);
+    EXPECT_EQ(segment.frameCount, i < 3 ? 1000u : 360u);
+    EXPECT_TRUE(segment.complete);
+
+    std::vector<uint8_t> file = ReadFile(segment.path);
+    ASSERT_EQ(file.size(), WavFileSink::kDataOffset + segment.frameCount * kBytesPerFrame);
+    EXPECT_EQ(FrameAt(file, 0), segment.firstFrame);
+    EXPECT_EQ(FrameAt(file, segment.frameCount - 1), segment.firstFrame + segment.frameCount - 1);
+
+    expectedFirst += segment.frameCount;
+    std::filesystem::remove(segment.path);
+  }
+
+  // The segment prepared for audio that never came is cleaned up
+  EXPECT_FALSE(std::filesystem::exists(SegmentedWavSink::SegmentPath(path, 4)));
+}
+
+TEST(SegmentedWavSink, HoldoverKeepsItsPlaceBeforeDroppedAudio) {
+  std::string path = (std::filesystem::temp_directory_path() / "segmented_holdover.wav").string();
+
+  SegmentOptions segments;
+  segments.segmentBytes = WavFileSink::kDataOffset + 1000 * kBytesPerFrame;  // 1000 frames
+  WavSinkOptions options;
+  options.blockBytes = 4096;
+  options.blockCount = 4;  // Holds back at most 4096 frames
+
+  // Holding up the manager in the first callback keeps the third segment
+  // from opening
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future().share();
+  std::mutex mutex;
+  std::vector<SegmentInfo> completed;
+  SegmentedWavSink sink;
+  ASSERT_TRUE(sink.Open(path, StereoPcm16(), segments,
+                        [&](const SegmentInfo& segment) {
+                          if (segment.index == 0) {
+                            released.wait();
+                          }
+                          std::lock_guard<std::mutex> lock(mutex);
+                          completed.push_back(segment);
+                        },
+                        options));
+  while (sink.segmentCount() < 2) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  auto write = [&sink](uint32_t firstFrame, uint32_t frames) {
+    std::vector<uint8_t> data = CountingFrames(firstFrame, frames);
+    sink.Write(data.data(), data.size());
+  };
+  write(0, 2000);     // Fills both open segments
+  write(2000, 4000);  // Held back
+  write(6000, 200);   // Overflows: dropped
+  write(6200, 50);    // Would fit, but follows the dropped audio
+  release.set_value();
+  ASSERT_TRUE(sink.Close());
+
+  // The held-back audio fills four segments in place; the gap follows it
+  EXPECT_EQ(sink.totalFrames(), 6250u);
+  EXPECT_EQ(sink.GetStats().droppedBytes, 250 * kBytesPerFrame);
+  ASSERT_EQ(completed.size(), 6u);
+  for (uint32_t i = 0; i < completed.size(); i++) {
+    const SegmentInfo& segment = completed[i];
+    EXPECT_EQ(segment.firstFrame, i * 1000u);
+    EXPECT_EQ(segment.frameCount, 1000u);
+
+    std::vector<uint8_t> file = ReadFile(segment.path);
+    ASSERT_EQ(file.size(), WavFileSink::kDataOffset + 1000 * kBytesPerFrame);
+    EXPECT_EQ(FrameAt(file, 0), segment.firstFrame);
+    EXPECT_EQ(FrameAt(file, 999), segment.firstFrame + 999);
+    std::filesystem::remove(segment.path);
+  }
+}
+
+TEST(SegmentedWavSink, RejectsSegmentSmallerThanHeader) {
+  std::string path = (std::filesystem::temp_directory_path() / "segmented_tiny.wav").string();
+  SegmentOptions segments;
+  segments.segmentBytes = WavFileSink::kDataOffset;
+
+  SegmentedWavSink sink;
+  EXPECT_FALSE(sink.Open(path, StereoPcm16(), segments));
+}
+
+}  // namespace test
+}  // namespace windows_loopback_recorder
@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <vector>
+
+#include "windows_loopback_recorder/spectrum_analyzer.h"
+
+namespace windows_loopback_recorder {
+namespace test {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Interleaved 16-bit sine with the same value on every channel
+std::vector<int16_t> Sine(double hz, double amplitude, uint32_t rate, uint16_t channels, size_t frames) {
+  std::vector<int16_t> samples(frames * channels);
+  for (size_t i = 0; i < frames; i++) {
+    auto value = static_cast<int16_t>(std::lround(amplitude * 32767.0 * std::sin(2.0 * kPi * hz * i / rate)));
+    std::fill_n(samples.begin() + i * channels, channels, value);
+  }
+  return samples;
+}
+
+}  // namespace
+
+TEST(RealFft, MatchesDirectTransform) {
+  for (size_t size : {16u, 64u, 1024u}) {
+    std::vector<float> in(size);
+    uint32_t seed = 12345;
+    for (float& x : in) {
+      seed = seed * 1664525u + 1013904223u;
+      x = static_cast<float>(static_cast<int32_t>(seed) / 2147483648.0);
+    }
+    std::vector<float> re(size / 2 + 1), im(size / 2 + 1);
+    RealFft fft(size);
+    fft.Forward(in.data(), re.data(), im.data());
+
+    for (size_t k = 0; k <= size / 2; k++) {
+      std::complex<double> expected;
+      for (size_t n = 0; n < size; n++) {
+        expected += static_cast<double>(in[n]) * std::polar(1.0, -2.0 * kPi * k * n / size);
+      }
+      EXPECT_NEAR(re[k], expected.real(), 1e-3 * std::sqrt(size)) << size << " bin " << k;
+      EXPECT_NEAR(im[k], expected.imag(), 1e-3 * std::sqrt(size)) << size << " bin " << k;
+    }
+  }
+}
+
+TEST(RealFft, InverseUndoesForward) {
+  for (size_t size : {16u, 512u}) {
+    std::vector<float> in(size), out(size);
+    for (size_t n = 0; n < size; n++) {
+      in[n] = static_cast<float>(std::sin(0.37 * n) + 0.25 * std::cos(1.9 * n * n));
+    }
+    std::vector<float> re(size / 2 + 1), im(size / 2 + 1);
+    RealFft fft(size);
+    fft.Forward(in.data(), re.data(), im.data());
+    fft.Inverse(re.data(), im.data(), out.data());
+    for (size_t n = 0; n < size; n++) {
+      EXPECT_NEAR(out[n], in[n], 1e-5) << size << " sample " << n;
+    }
+  }
+}
+
+TEST(RealFft, RejectsSizesThatAreNotPowersOfTwo) {
+  EXPECT_TRUE(RealFft::IsValidSize(2048));
+  EXPECT_FALSE(RealFft::IsValidSize(1000));
+  EXPECT_FALSE(RealFft::IsValidSize(8));
+  EXPECT_FALSE(RealFft::IsValidSize(RealFft::kMaxSize * 2));
+}
+
+TEST(SpectrumAnalyzer, FullScaleSineReadsZeroDbInItsBand) {
+  SpectrumAnalyzer analyzer;
+  ASSERT_TRUE(analyzer.Configure(48000, 2, 2048, 32, 20.0f, 20000.0f));
+
+  // Exactly bin 43 (about 1008 Hz); half scale on both channels
+  double hz = 43.0 * 48000 / 2048;
+  std::vector<int16_t> samples = Sine(hz, 0.5, 48000, 2, 4096);
+  std::vector<float> bands;
+  analyzer.Push(samples.data(), 1000);
+  EXPECT_FALSE(analyzer.Analyze(bands));
+  analyzer.Push(samples.data() + 2000, 3096);
+  ASSERT_TRUE(analyzer.Analyze(bands));
+  ASSERT_EQ(bands.size(), 32u);
+
+  // The band holding 1008 Hz reads -6 dBFS; bands an octave away are far down
+  size_t expectedBand = static_cast<size_t>(32 * std::log(hz / 20.0) / std::log(1000.0));
+  auto loudest = std::max_element(bands.begin(), bands.end());
+  EXPECT_EQ(static_cast<size_t>(loudest - bands.begin()), expectedBand);
+  EXPECT_NEAR(*loudest, -6.02f, 0.1f);
+  EXPECT_LT(bands[expectedBand - 5], -60.0f);
+  EXPECT_LT(bands[expectedBand + 5], -60.0f);
+}
+
+TEST(SpectrumAnalyzer, SilenceReadsTheFloor) {
+  SpectrumAnalyzer analyzer;
+  ASSERT_TRUE(analyzer.Configure(16000, 1, 512, 16, 50.0f, 20000.0f));
+  EXPECT_FLOAT_EQ(analyzer.maxHz(), 8000.0f);  // Limited to Nyquist
+  std::vector<int16_t> silence(512);
+  analyzer.Push(silence.data(), silence.size());
+  std::vector<float> bands;
+  ASSERT_TRUE(analyzer.Analyze(bands));
+  for (float band : bands) {
+    EXPECT_EQ(band, SpectrumAnalyzer::kFloorDb);
+  }
+}
+
+TEST(SpectrumAnalyzer, RejectsInvalidSettings) {
+  SpectrumAnalyzer analyzer;
+  EXPECT_FALSE(analyzer.Configure(48000, 2, 1000, 32, 20.0f, 20000.0f));
+  EXPECT_FALSE(analyzer.Configure(48000, 2, 2048, 0, 20.0f, 20000.0f));
+  EXPECT_FALSE(analyzer.Configure(48000, 2, 2048, 32, 30000.0f, 40000.0f));
+  EXPECT_FALSE(analyzer.configured());
+}
+
+TEST(SpectrumFrame, FollowsThePublishedLayout) {
+  SpectrumAnalyzer analyzer;
+  ASSERT_TRUE(analyzer.Configure(44100, 2, 1024, 3, 100.0f, 10000.0f));
+  std::vector<float> frame = BuildSpectrumFrame(250.0, analyzer, {-10.0f, -20.0f, -30.0f});
+  ASSERT_EQ(frame.size(), SPECTRUM_FRAME_FIELDS + 3u);
+  EXPECT_EQ(frame[SPECTRUM_FRAME_HEADER_SIZE], static_cast<float>(SPECTRUM_FRAME_FIELDS));
+  EXPECT_EQ(frame[SPECTRUM_FRAME_VERSION], kSpectrumFrameVersion);
+  EXPECT_EQ(frame[SPECTRUM_FRAME_ELAPSED_MS], 250.0f);
+  EXPECT_EQ(frame[SPECTRUM_FRAME_SAMPLE_RATE], 44100.0f);
+  EXPECT_EQ(frame[SPECTRUM_FRAME_FFT_SIZE], 1024.0f);
+  EXPECT_EQ(frame[SPECTRUM_FRAME_MIN_HZ], 100.0f);
+  EXPECT_EQ(frame[SPECTRUM_FRAME_MAX_HZ], 10000.0f);
+  EXPECT_EQ(frame[SPECTRUM_FRAME_BANDS], 3.0f);
+  EXPECT_EQ(frame[SPECTRUM_FRAME_FIELDS + 2], -30.0f);
+}
+
+}  // namespace test
+}  // namespace windows_loopback_recorder
@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "windows_loopback_recorder/telephony_codec.h"
+
+namespace windows_loopback_recorder {
+namespace test {
+
+namespace {
+
+std::vector<uint8_t> ToBytes(const std::vector<int16_t>& samples) {
+  std::vector<uint8_t> bytes;
+  for (int16_t sample : samples) {
+    bytes.push_back(static_cast<uint8_t>(sample & 0xFF));
+    bytes.push_back(static_cast<uint8_t>((sample >> 8) & 0xFF));
+  }
+  return bytes;
+}
+
+// A 440 Hz tone at 8 kHz, interleaved with a quieter 1 kHz tone when stereo
+std::vector<int16_t> MakeTone(size_t frames, uint16_t channels) {
+  std::vector<int16_t> samples;
+  for (size_t i = 0; i < frames; i++) {
+    samples.push_back(static_cast<int16_t>(12000 * std::sin(2 * 3.14159265358979 * 440 * i / 8000)));
+    if (channels == 2) {
+      samples.push_back(static_cast<int16_t>(3000 * std::sin(2 * 3.14159265358979 * 1000 * i / 8000)));
+    }
+  }
+  return samples;
+}
+
+}  // namespace
+
+TEST(G711, MatchesReferenceCodeWords) {
+  std::vector<uint8_t> pcm = ToBytes({0, 32767, -32768, 1000, -1000});
+  std::vector<uint8_t> mu(5), a(5);
+  EncodeG711(G711Law::MU_LAW, pcm.data(), 5, mu.data());
+  EncodeG711(G711Law::A_LAW, pcm.data(), 5, a.data());
+  EXPECT_EQ(mu, (std::vector<uint8_t>{0xFF, 0x80, 0x00, 0xCE, 0x4E}));
+  EXPECT_EQ(a, (std::vector<uint8_t>{0xD5, 0xAA, 0x2A, 0xFA, 0x7A}));
+  EXPECT_EQ(G711SilenceByte(G711Law::MU_LAW), mu[0]);
+  EXPECT_EQ(G711SilenceByte(G711Law::A_LAW), a[0]);
+}
+
+TEST(G711, EveryCodeWordSurvivesDecodeAndEncode) {
+  for (G711Law law : {G711Law::MU_LAW, G711Law::A_LAW}) {
+    for (int code = 0; code < 256; code++) {
+      if (law == G711Law::MU_LAW && code == 0x7F) {
+        continue;  // Negative zero; encodes back as positive zero
+      }
+      std::vector<uint8_t> pcm = ToBytes({DecodeG711(law, static_cast<uint8_t>(code))});
+      uint8_t encoded = 0;
+      EncodeG711(law, pcm.data(), 1, &encoded);
+      EXPECT_EQ(encoded, code) << "law " << static_cast<int>(law);
+    }
+  }
+}
+
+TEST(G711, EncodesInPlace) {
+  std::vector<int16_t> samples = MakeTone(101, 1);
+  std::vector<uint8_t> pcm = ToBytes(samples);
+  std::vector<uint8_t> expected(samples.size());
+  EncodeG711(G711Law::A_LAW, pcm.data(), samples.size(), expected.data());
+
+  EncodeG711(G711Law::A_LAW, pcm.data(), samples.size(), pcm.data());
+  pcm.resize(samples.size());
+  EXPECT_EQ(pcm, expected);
+}
+
+TEST(ImaAdpcmEncoder, RejectsInvalidBlockSizes) {
+  ImaAdpcmEncoder encoder;
+  EXPECT_FALSE(encoder.Configure(1, 8));
+  EXPECT_FALSE(encoder.Configure(1, 504));
+  EXPECT_FALSE(encoder.Configure(0, 505));
+  EXPECT_TRUE(encoder.Configure(2, 505));
+  EXPECT_EQ(ImaAdpcmEncoder::DefaultSamplesPerBlock(8000), 505u);
+  EXPECT_EQ(ImaAdpcmEncoder::DefaultSamplesPerBlock(48000), 2041u);
+  EXPECT_EQ(ImaAdpcmEncoder::BlockBytes(2, 505), 512u);
+}
+
+TEST(ImaAdpcmEncoder, BlocksDecodeCloseToInput) {
+  constexpr uint16_t channels = 2;
+  constexpr uint32_t samplesPerBlock = 505;
+  ImaAdpcmEncoder encoder;
+  ASSERT_TRUE(encoder.Configure(channels, samplesPerBlock));
+
+  std::vector<int16_t> samples = MakeTone(samplesPerBlock * 3, channels);
+  std::vector<uint8_t> pcm = ToBytes(samples);
+
+  // Irregular pushes, splitting sample frames across calls
+  std::vector<std::vector<uint8_t>> blocks;
+  auto collect = [&blocks](std::vector<uint8_t>& block, uint32_t frames) {
+    EXPECT_EQ(frames, 505u);
+    blocks.push_back(std::move(block));
+  };
+  for (size_t offset = 0; offset < pcm.size(); offset += 333) {
+    encoder.Push(pcm.data() + offset, std::min<size_t>(333, pcm.size() - offset), collect);
+  }
+  ASSERT_EQ(blocks.size(), 3u);
+
+  double error = 0.0;
+  double signal = 0.0;
+  for (size_t b = 0; b < blocks.size(); b++) {
+    ASSERT_EQ(blocks[b].size(), ImaAdpcmEncoder::BlockBytes(channels, samplesPerBlock));
+    std::vector<int16_t> decoded;
+    ASSERT_TRUE(DecodeImaAdpcmBlock(blocks[b].data(), blocks[b].size(), channels, decoded));
+    ASSERT_EQ(decoded.size(), samplesPerBlock * channels);
+    for (size_t i = 0; i < decoded.size(); i++) {
+      double original = samples[b * samplesPerBlock * channels + i];
+      error += (decoded[i] - original) * (decoded[i] - original);
+      signal += original * original;
+    }
+  }
+  // 4-bit ADPCM on a clean tone stays well above 20 dB SNR
+  EXPECT_GT(10 * std::log10(signal / error), 20.0);
+}
+
+TEST(ImaAdpcmEncoder, FlushPadsTheLastBlock) {
+  ImaAdpcmEncoder encoder;
+  ASSERT_TRUE(encoder.Configure(1, 17));
+  std::vector<uint8_t> pcm = ToBytes(MakeTone(20, 1));
+
+  std::vector<uint32_t> frames;
+  auto collect = [&frames](std::vector<uint8_t>& block, uint32_t count) {
+    EXPECT_EQ(block.size(), ImaAdpcmEncoder::BlockBytes(1, 17));
+    frames.push_back(count);
+  };
+  encoder.Push(pcm.data(), pcm.size(), collect);
+  encoder.Flush(collect);
+  EXPECT_EQ(frames, (std::vector<uint32_t>{17, 3}));
+
+  encoder.Push(pcm.data(), 10, collect);
+  EXPECT_EQ(encoder.DiscardPending(), 5u);
+  encoder.Flush(collect);
+  EXPECT_EQ(frames.size(), 2u);
+}
+
+TEST(ImaAdpcmEncoder, DecoderRejectsMalformedBlocks) {
+  std::vector<int16_t> samples;
+  std::vector<uint8_t> block(4 + 8, 0);
+  EXPECT_TRUE(DecodeImaAdpcmBlock(block.data(), block.size(), 1, samples));
+  EXPECT_FALSE(DecodeImaAdpcmBlock(block.data(), block.size() - 1, 1, samples));
+  block[2] = 89;  // Step index out of range
+  EXPECT_FALSE(DecodeImaAdpcmBlock(block.data(), block.size(), 1, samples));
+}
+
+}  // namespace test
+}  // namespace windows_loopback_recorder
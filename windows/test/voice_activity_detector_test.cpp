@@ -0,0 +1,185 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "windows_loopback_recorder/audio_packet.h"
+#include "windows_loopback_recorder/voice_activity_detector.h"
+
+namespace windows_loopback_recorder {
+namespace test {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr uint32_t kSampleRate = 16000;
+
+// Mono white noise at |db| dBFS RMS
+std::vector<float> Noise(double db, size_t frames, uint32_t seed) {
+  std::mt19937 random(seed);
+  std::normal_distribution<float> normal(0.0f, static_cast<float>(std::pow(10.0, db / 20.0)));
+  std::vector<float> samples(frames);
+  for (float& sample : samples) {
+    sample = normal(random);
+  }
+  return samples;
+}
+
+// Voiced, speech-like sound: harmonics of a wandering pitch shaped by three
+// formants, in syllables of about 200 ms, peaking near -20 dBFS
+void AddSpeech(std::vector<float>& samples, size_t first, size_t frames) {
+  const double formants[3] = {700.0, 1200.0, 2500.0};
+  double phase = 0.0;
+  for (size_t i = 0; i < frames; i++) {
+    double t = static_cast<double>(i) / kSampleRate;
+    double pitch = 140.0 + 20.0 * std::sin(2.0 * kPi * 1.3 * t);
+    phase += 2.0 * kPi * pitch / kSampleRate;
+    double syllable = std::pow(std::fabs(std::sin(kPi * 2.5 * t)), 0.5);
+    double value = 0.0;
+    for (int h = 1; pitch * h < 3800.0; h++) {
+      double hz = pitch * h;
+      double gain = 0.0;
+      for (double formant : formants) {
+        gain += 1.0 / (1.0 + std::pow((hz - formant) / 150.0, 2.0));
+      }
+      value += gain / h * std::sin(h * phase);
+    }
+    samples[first + i] += static_cast<float>(0.08 * syllable * value);
+  }
+}
+
+// Fraction of 10 ms frames in [first, end) that the detector calls speech
+double SpeechShare(VoiceActivityDetector& detector, const std::vector<float>& samples, size_t first, size_t end) {
+  size_t step = kSampleRate / 100;
+  size_t speech = 0;
+  size_t frames = 0;
+  for (size_t i = 0; i + step <= samples.size(); i += step) {
+    detector.Process(&samples[i], step);
+    if (i >= first && i + step <= end) {
+      frames++;
+      speech += detector.speech() ? 1 : 0;
+    }
+  }
+  return frames > 0 ? static_cast<double>(speech) / frames : 0.0;
+}
+
+std::vector<uint8_t> Bytes(size_t count, uint8_t value) {
+  return std::vector<uint8_t>(count, value);
+}
+
+}  // namespace
+
+TEST(VoiceActivityDetector, IgnoresSilenceAndSteadyNoise) {
+  VoiceActivityDetector detector;
+  ASSERT_TRUE(detector.Configure(kSampleRate, 1, VadOptions()));
+
+  std::vector<float> silence(kSampleRate * 2, 0.0f);
+  EXPECT_EQ(SpeechShare(detector, silence, 0, silence.size()), 0.0);
+
+  std::vector<float> noise = Noise(-30.0, kSampleRate * 5, 1);
+  EXPECT_LT(SpeechShare(detector, noise, kSampleRate, noise.size()), 0.05);
+}
+
+TEST(VoiceActivityDetector, FindsSpeechOverNoiseAndHangsOver) {
+  VadOptions options;
+  options.hangoverMs = 200;
+  VoiceActivityDetector detector;
+  ASSERT_TRUE(detector.Configure(kSampleRate, 1, options));
+
+  // 2 s of noise, 3 s of speech over it, 2 s of noise again
+  std::vector<float> samples = Noise(-50.0, kSampleRate * 7, 2);
+  AddSpeech(samples, kSampleRate * 2, kSampleRate * 3);
+
+  std::vector<float> before(samples.begin(), samples.begin() + kSampleRate * 2);
+  EXPECT_LT(SpeechShare(detector, before, kSampleRate, before.size()), 0.05);
+
+  std::vector<float> talk(samples.begin() + kSampleRate * 2, samples.begin() + kSampleRate * 5);
+  EXPECT_GT(SpeechShare(detector, talk, 0, talk.size()), 0.9);
+  EXPECT_GT(detector.probability(), 0.5f);
+
+  // Still speech within the hangover, not long after
+  std::vector<float> after(samples.begin() + kSampleRate * 5, samples.end());
+  std::vector<float> start(after.begin(), after.begin() + kSampleRate / 10);
+  EXPECT_EQ(SpeechShare(detector, start, 0, start.size()), 1.0);
+  std::vector<float> rest(after.begin() + kSampleRate / 10, after.end());
+  EXPECT_LT(SpeechShare(detector, rest, kSampleRate / 2, rest.size()), 0.05);
+}
+
+TEST(VoiceActivityDetector, AcceptsInterleaved16Bit) {
+  // A harmonic tone over noise, as 48 kHz stereo
+  constexpr size_t kFrames = 48000 * 2;
+  VoiceActivityDetector detector;
+  ASSERT_TRUE(detector.Configure(48000, 2, VadOptions()));
+  std::vector<float> noise = Noise(-50.0, kFrames, 3);
+  std::vector<int16_t> stereo(kFrames * 2);
+  for (size_t i = 0; i < kFrames; i++) {
+    double t = static_cast<double>(i) / 48000;
+    double tone = 0.2 * std::sin(2.0 * kPi * 220.0 * t) + 0.1 * std::sin(2.0 * kPi * 660.0 * t) +
+                  0.05 * std::sin(2.0 * kPi * 1320.0 * t);
+    auto value = static_cast<int16_t>((tone + noise[i]) * 32767.0);
+    stereo[2 * i] = value;
+    stereo[2 * i + 1] = value;
+  }
+  detector.Process(stereo.data(), kFrames);
+  EXPECT_TRUE(detector.speech());
+  EXPECT_FALSE(detector.Configure(4000, 2, VadOptions()));
+}
+
+TEST(SpeechGate, PassesSpeechWithPaddingAndSuppressesTheRest) {
+  // 1000 Hz, 1-byte frames: one byte per ms, 100 ms of padding
+  SpeechGate gate;
+  gate.Configure(true, 1000, 1, 100);
+  struct Emitted {
+    size_t bytes;
+    uint8_t first;
+    int64_t captureTime;
+    uint16_t flags;
+  };
+  std::vector<Emitted> emitted;
+  auto emit = [&](std::vector<uint8_t>& audio, int64_t captureTime, uint16_t flags, float) {
+    emitted.push_back({audio.size(), audio.empty() ? uint8_t(0) : audio[0], captureTime, flags});
+  };
+
+  // 500 ms of non-speech: only the last 100 ms are held
+  for (int i = 0; i < 10; i++) {
+    std::vector<uint8_t> audio = Bytes(50, static_cast<uint8_t>(i));
+    gate.Push(audio, i * 500000LL, 0, 0.1f, false, emit);
+  }
+  EXPECT_TRUE(emitted.empty());
+  EXPECT_EQ(gate.suppressedBytes(), 400u);
+
+  // Speech releases the padding first, flagged as following a gap
+  std::vector<uint8_t> speech = Bytes(50, 0xAA);
+  gate.Push(speech, 5000000, 0, 0.9f, true, emit);
+  ASSERT_EQ(emitted.size(), 3u);
+  EXPECT_EQ(emitted[0].first, 8);
+  EXPECT_EQ(emitted[0].captureTime, 4000000);
+  EXPECT_EQ(emitted[0].flags, AUDIO_PACKET_DISCONTINUITY);
+  EXPECT_EQ(emitted[1].flags, 0);
+  EXPECT_EQ(emitted[2].first, 0xAA);
+
+  // 100 ms of trailing padding pass, ending inside the third buffer
+  emitted.clear();
+  bool ended = false;
+  for (int i = 0; i < 3 && !ended; i++) {
+    std::vector<uint8_t> audio = Bytes(40, 0xBB);
+    ended = gate.Push(audio, 5500000 + i * 400000LL, 0, 0.1f, false, emit);
+  }
+  EXPECT_TRUE(ended);
+  ASSERT_EQ(emitted.size(), 3u);
+  EXPECT_EQ(emitted[2].bytes, 20u);
+  EXPECT_EQ(gate.passedBytes(), 150u + 100u);
+
+  // The next segment starts with what followed the padding
+  emitted.clear();
+  std::vector<uint8_t> more = Bytes(10, 0xCC);
+  gate.Push(more, 7000000, 0, 0.9f, true, emit);
+  ASSERT_EQ(emitted.size(), 2u);
+  EXPECT_EQ(emitted[0].bytes, 20u);
+  EXPECT_EQ(emitted[0].captureTime, 5500000 + 2 * 400000LL + 200000);
+  EXPECT_EQ(emitted[0].flags, 0);  // Contiguous with the padding
+}
+
+}  // namespace test
+}  // namespace windows_loopback_recorder
@@ -0,0 +1,245 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "windows_loopback_recorder/wav_file_sink.h"
+
+namespace windows_loopback_recorder {
+namespace test {
+
+namespace {
+
+uint32_t ReadU32(const std::vector<uint8_t>& buffer, size_t offset) {
+  uint32_t value;
+  std::memcpy(&value, &buffer[offset], sizeof(value));
+  return value;
+}
+
+uint64_t ReadU64(const std::vector<uint8_t>& buffer, size_t offset) {
+  uint64_t value;
+  std::memcpy(&value, &buffer[offset], sizeof(value));
+  return value;
+}
+
+std::string FourCC(const std::vector<uint8_t>& buffer, size_t offset) {
+  return std::string(reinterpret_cast<const char*>(&buffer[offset]), 4);
+}
+
+std::vector<uint8_t> ReadFile(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+std::string TempPath(const char* name) {
+  return (std::filesystem::temp_directory_path() / name).string();
+}
+
+WavFormat StereoPcm16() {
+  WavFormat format;
+  format.sampleRate = 48000;
+  format.channels = 2;
+  format.bitsPerSample = 16;
+  return format;
+}
+
+}  // namespace
+
+TEST(WavFileSink, BuildsAlignedPcmHeader) {
+  std::vector<uint8_t> header = BuildWavHeader(StereoPcm16(), 19200);
+
+  ASSERT_EQ(header.size(), WavFileSink::kDataOffset);
+  EXPECT_EQ(FourCC(header, 0), "RIFF");
+  EXPECT_EQ(ReadU32(header, 4), WavFileSink::kDataOffset - 8 + 19200);
+  EXPECT_EQ(FourCC(header, 8), "WAVE");
+  EXPECT_EQ(FourCC(header, 12), "JUNK");
+  EXPECT_EQ(FourCC(header, 48), "fmt ");
+  EXPECT_EQ(ReadU32(header, 52), 16u);
+  EXPECT_EQ(header[56], 1);                // WAVE_FORMAT_PCM
+  EXPECT_EQ(ReadU32(header, 60), 48000u);  // nSamplesPerSec
+  EXPECT_EQ(ReadU32(header, 64), 192000u); // nAvgBytesPerSec
+  EXPECT_EQ(FourCC(header, WavFileSink::kDataOffset - 8), "data");
+  EXPECT_EQ(ReadU32(header, WavFileSink::kDataOffset - 4), 19200u);
+}
+
+TEST(WavFileSink, SwitchesToRf64PastFourGigabytes) {
+  uint64_t dataBytes = 5ull << 30;
+  std::vector<uint8_t> header = BuildWavHeader(StereoPcm16(), dataBytes);
+
+  EXPECT_EQ(FourCC(header, 0), "RF64");
+  EXPECT_EQ(ReadU32(header, 4), 0xFFFFFFFFu);
+  EXPECT_EQ(FourCC(header, 12), "ds64");
+  EXPECT_EQ(ReadU64(header, 20), WavFileSink::kDataOffset - 8 + dataBytes);
+  EXPECT_EQ(ReadU64(header, 28), dataBytes);
+  EXPECT_EQ(ReadU64(header, 36), dataBytes / 4);
+  EXPECT_EQ(ReadU32(header, WavFileSink::kDataOffset - 4), 0xFFFFFFFFu);
+}
+
+TEST(WavFileSink, UsesExtensibleFormatForMultichannel) {
+  WavFormat format;
+  format.sampleRate = 48000;
+  format.channels = 6;
+  format.bitsPerSample = 24;
+  std::vector<uint8_t> header = BuildWavHeader(format, 0);
+
+  EXPECT_EQ(ReadU32(header, 52), 40u);
+  EXPECT_EQ(header[56], 0xFE);
+  EXPECT_EQ(header[57], 0xFF);
+  EXPECT_EQ(header[68], 18);  // nBlockAlign
+  EXPECT_EQ(header[74], 24);  // wValidBitsPerSample
+  EXPECT_EQ(ReadU32(header, 76), 0x3Fu);
+  EXPECT_EQ(header[80], 1);   // KSDATAFORMAT_SUBTYPE_PCM
+  EXPECT_EQ(FourCC(header, 96), "JUNK");
+}
+
+TEST(WavFileSink, StreamsAcrossBlocks) {
+  std::string path = TempPath("wav_file_sink_streams.wav");
+  WavSinkOptions options;
+  options.blockBytes = 4096;
+  options.blockCount = 64;
+
+  WavFileSink sink;
+  ASSERT_TRUE(sink.Open(path, StereoPcm16(), options));
+
+  // 25 packets of 10 ms do not divide evenly into blocks
+  std::vector<uint8_t> expected;
+  for (int packet = 0; packet < 25; packet++) {
+    std::vector<uint8_t> data(1920);
+    for (size_t i = 0; i < data.size(); i++) {
+      data[i] = static_cast<uint8_t>(packet * 7 + i);
+    }
+    sink.Write(data.data(), data.size());
+    expected.insert(expected.end(), data.begin(), data.end());
+  }
+  ASSERT_TRUE(sink.Close());
+
+  WavSinkStats stats = sink.GetStats();
+  EXPECT_EQ(stats.dataBytes, expected.size());
+  EXPECT_EQ(stats.droppedBytes, 0u);
+  EXPECT_FALSE(stats.rf64);
+
+  std::vector<uint8_t> file = ReadFile(path);
+  ASSERT_EQ(file.size(), WavFileSink::kDataOffset + expected.size());
+  EXPECT_EQ(ReadU32(file, WavFileSink::kDataOffset - 4), expected.size());
+  EXPECT_TRUE(std::equal(expected.begin(), expected.end(), file.begin() + WavFileSink::kDataOffset));
+  std::filesystem::remove(path);
+}
+
+TEST(WavFileSink, WritesFlacContainer) {
+  std::string path = TempPath("wav_file_sink_flac.flac");
+  WavSinkOptions options;
+  options.container = FileContainer::FLAC;
+  options.blockBytes = 16384;
+  options.blockCount = 16;
+
+  WavFileSink sink;
+  ASSERT_TRUE(sink.Open(path, StereoPcm16(), options));
+
+  // One second of a quiet two-tone signal, which compresses well
+  const uint32_t frames = 48000;
+  std::vector<int16_t> samples(frames * 2);
+  for (uint32_t i = 0; i < frames; i++) {
+    samples[i * 2] = static_cast<int16_t>(3000 * std::sin(i * 0.05));
+    samples[i * 2 + 1] = static_cast<int16_t>(2000 * std::sin(i * 0.03));
+  }
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(samples.data());
+  for (size_t offset = 0; offset < samples.size() * 2; offset += 1920) {
+    sink.Write(bytes + offset, std::min<size_t>(1920, samples.size() * 2 - offset));
+  }
+  ASSERT_TRUE(sink.Close());
+
+  WavSinkStats stats = sink.GetStats();
+  std::vector<uint8_t> file = ReadFile(path);
+  EXPECT_EQ(stats.dataBytes, samples.size() * 2);
+  EXPECT_EQ(stats.fileBytes, file.size());
+  EXPECT_LT(file.size(), WavFileSink::kDataOffset + stats.dataBytes / 2);
+
+  ASSERT_GT(file.size(), WavFileSink::kDataOffset);
+  EXPECT_EQ(FourCC(file, 0), "fLaC");
+  // STREAMINFO total samples (low 32 of 36 bits, big endian)
+  uint32_t total = (file[22] << 24) | (file[23] << 16) | (file[24] << 8) | file[25];
+  EXPECT_EQ(total, frames);
+  // Frames start right after the padded header
+  EXPECT_EQ(file[WavFileSink::kDataOffset], 0xFF);
+  EXPECT_EQ(file[WavFileSink::kDataOffset + 1], 0xF8);
+  std::filesystem::remove(path);
+}
+
+TEST(WavFileSink, PadsOddSizedData) {
+  std::string path = TempPath("wav_file_sink_odd.wav");
+  WavFormat format = StereoPcm16();
+  format.channels = 1;
+  format.bitsPerSample = 8;
+
+  WavFileSink sink;
+  ASSERT_TRUE(sink.Open(path, format));
+  std::vector<uint8_t> data(101, 0x80);
+  sink.Write(data.data(), data.size());
+  ASSERT_TRUE(sink.Close());
+
+  std::vector<uint8_t> file = ReadFile(path);
+  ASSERT_EQ(file.size(), WavFileSink::kDataOffset + 102);
+  EXPECT_EQ(ReadU32(file, 4), WavFileSink::kDataOffset - 8 + 102);
+  EXPECT_EQ(ReadU32(file, WavFileSink::kDataOffset - 4), 101u);
+  std::filesystem::remove(path);
+}
+
+TEST(WavFileSink, CheckpointsKeepUnclosedFilePlayable) {
+  std::string path = TempPath("wav_file_sink_checkpoint.wav");
+  WavSinkOptions options;
+  options.checkpointIntervalMs = 10;
+
+  WavFileSink sink;
+  ASSERT_TRUE(sink.Open(path, StereoPcm16(), options));
+  std::vector<uint8_t> data(3840, 0x42);
+  sink.Write(data.data(), data.size());
+
+  // Nothing fills a block, so only the checkpoint can put this on disk
+  std::vector<uint8_t> file;
+  for (int attempt = 0; attempt < 200; attempt++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    file = ReadFile(path);
+    if (file.size() == WavFileSink::kDataOffset + data.size() &&
+        ReadU32(file, WavFileSink::kDataOffset - 4) == data.size()) {
+      break;
+    }
+  }
+  ASSERT_EQ(file.size(), WavFileSink::kDataOffset + data.size());
+  EXPECT_EQ(ReadU32(file, WavFileSink::kDataOffset - 4), data.size());
+  EXPECT_EQ(file.back(), 0x42);
+
+  ASSERT_TRUE(sink.Close());
+  std::filesystem::remove(path);
+}
+
+TEST(WavFileSink, DropsWholeWritesWhenBlocksRunOut) {
+  std::string path = TempPath("wav_file_sink_drop.wav");
+  WavSinkOptions options;
+  options.blockBytes = 4096;
+  options.blockCount = 1;
+
+  WavFileSink sink;
+  ASSERT_TRUE(sink.Open(path, StereoPcm16(), options));
+  std::vector<uint8_t> data(3000, 1);
+  sink.Write(data.data(), data.size());
+  // Does not fit in the single block and no spare block exists
+  sink.Write(data.data(), data.size());
+  WavSinkStats stats = sink.GetStats();
+  EXPECT_EQ(stats.dataBytes, 3000u);
+  EXPECT_EQ(stats.droppedBytes, 3000u);
+
+  ASSERT_TRUE(sink.Close());
+  std::filesystem::remove(path);
+}
+
+}  // namespace test
+}  // namespace windows_loopback_recorder
@@ -0,0 +1,280 @@
+#include "windows_loopback_recorder/voice_activity_detector.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "windows_loopback_recorder/audio_packet.h"
+
+namespace windows_loopback_recorder {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Frames quieter than this are never speech, whatever the noise floor
+constexpr float kSilenceDb = -65.0f;
+// Noise floor rise per 10 ms frame: 2 dB/s, or 20 dB/s while the frame
+// looks like noise
+constexpr float kNoiseRiseDb = 0.02f;
+constexpr float kNoiseLikeRiseDb = 0.2f;
+// Weight of the newest frame in the smoothed probability
+constexpr float kSmoothing = 0.3f;
+
+size_t BinOf(double hz, double binHz, size_t lastBin) {
+  return std::min(lastBin, static_cast<size_t>(std::lround(hz / binHz)));
+}
+
+}  // namespace
+
+bool VoiceActivityDetector::Configure(uint32_t sampleRate, uint16_t channels, const VadOptions& options) {
+  fft_.reset();
+  if (sampleRate < 8000 || channels == 0) {
+    return false;
+  }
+  sampleRate_ = sampleRate;
+  channels_ = channels;
+  options_ = options;
+  frameSamples_ = sampleRate * kFrameMs / 1000;
+  hangoverFrames_ = options.hangoverMs / kFrameMs;
+
+  size_t fftSize = RealFft::kMinSize;
+  while (fftSize < frameSamples_) {
+    fftSize *= 2;
+  }
+  fft_ = std::make_unique<RealFft>(fftSize);
+  window_.assign(fftSize, 0.0f);
+  for (uint32_t n = 0; n < frameSamples_; n++) {
+    window_[n] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * kPi * n / frameSamples_));
+  }
+
+  double binHz = static_cast<double>(sampleRate) / fftSize;
+  size_t lastBin = fftSize / 2;
+  speechFirst_ = BinOf(300.0, binHz, lastBin);
+  speechEnd_ = BinOf(3400.0, binHz, lastBin) + 1;
+  totalFirst_ = BinOf(50.0, binHz, lastBin);
+  totalEnd_ = BinOf(8000.0, binHz, lastBin) + 1;
+
+  frame_.assign(fftSize, 0.0f);
+  re_.resize(fftSize / 2 + 1);
+  im_.resize(fftSize / 2 + 1);
+  Reset();
+  return true;
+}
+
+void VoiceActivityDetector::Reset() {
+  filled_ = 0;
+  primed_ = false;
+  noiseDb_ = 0.0f;
+  probability_ = 0.0f;
+  hangover_ = 0;
+  speech_ = false;
+}
+
+void VoiceActivityDetector::Process(const int16_t* samples, size_t frames) {
+  if (!fft_) {
+    return;
+  }
+  float scale = 1.0f / (32768.0f * channels_);
+  for (size_t i = 0; i < frames; i++) {
+    int32_t sum = 0;
+    for (uint16_t c = 0; c < channels_; c++) {
+      sum += samples[c];
+    }
+    samples += channels_;
+    PushMono(sum * scale);
+  }
+}
+
+void VoiceActivityDetector::Process(const float* samples, size_t frames) {
+  if (!fft_) {
+    return;
+  }
+  float scale = 1.0f / channels_;
+  for (size_t i = 0; i < frames; i++) {
+    float sum = 0.0f;
+    for (uint16_t c = 0; c < channels_; c++) {
+      sum += samples[c];
+    }
+    samples += channels_;
+    PushMono(sum * scale);
+  }
+}
+
+void VoiceActivityDetector::PushMono(float sample) {
+  frame_[filled_++] = sample;
+  if (filled_ == frameSamples_) {
+    AnalyzeFrame();
+    filled_ = 0;
+  }
+}
+
+void VoiceActivityDetector::AnalyzeFrame() {
+  // Time domain: energy and zero crossings
+  double squares = 0.0;
+  uint32_t crossings = 0;
+  for (uint32_t n = 0; n < frameSamples_; n++) {
+    squares += static_cast<double>(frame_[n]) * frame_[n];
+    if (n > 0 && (frame_[n] >= 0.0f) != (frame_[n - 1] >= 0.0f)) {
+      crossings++;
+    }
+  }
+  float energyDb = static_cast<float>(10.0 * std::log10(squares / frameSamples_ + 1e-12));
+  float zeroCrossingRate = static_cast<float>(crossings) / frameSamples_;
+
+  // Frequency domain: speech band share and flatness
+  for (uint32_t n = 0; n < frameSamples_; n++) {
+    frame_[n] *= window_[n];
+  }
+  fft_->Forward(frame_.data(), re_.data(), im_.data());
+  double total = 1e-20;
+  double band = 1e-20;
+  double logSum = 0.0;
+  for (size_t k = totalFirst_; k < totalEnd_; k++) {
+    double power = static_cast<double>(re_[k]) * re_[k] + static_cast<double>(im_[k]) * im_[k];
+    total += power;
+    if (k >= speechFirst_ && k < speechEnd_) {
+      band += power;
+      logSum += std::log(power + 1e-20);
+    }
+  }
+  size_t bandBins = speechEnd_ - speechFirst_;
+  float bandShare = static_cast<float>(band / total);
+  float flatness = static_cast<float>(std::exp(logSum / bandBins) / (band / bandBins));
+
+  // Noise floor: drops to quieter frames quickly, creeps up otherwise
+  if (!primed_) {
+    noiseDb_ = energyDb;
+    primed_ = true;
+  } else if (energyDb < noiseDb_) {
+    noiseDb_ += 0.3f * (energyDb - noiseDb_);
+  } else {
+    bool noiseLike = flatness > 0.45f && bandShare < 0.6f;
+    noiseDb_ = std::min(energyDb, noiseDb_ + (noiseLike ? kNoiseLikeRiseDb : kNoiseRiseDb));
+  }
+  // Not below the silence gate, so noise that follows digital silence is
+  // learned within seconds
+  noiseDb_ = std::max(noiseDb_, kSilenceDb);
+  float snrDb = energyDb - noiseDb_;
+
+  // Weights put speech around +4 and white noise below -1 even when it is
+  // far above the floor
+  float frameProbability = 0.0f;
+  if (energyDb > kSilenceDb) {
+    float logit = -1.0f + 0.4f * (std::clamp(snrDb, -10.0f, 20.0f) - 6.0f) +
+                  6.0f * (bandShare - 0.6f) + 12.0f * (0.35f - flatness) -
+                  10.0f * std::max(0.0f, zeroCrossingRate - 0.35f);
+    frameProbability = 1.0f / (1.0f + std::exp(-logit));
+  }
+  probability_ += kSmoothing * (frameProbability - probability_);
+
+  if (probability_ >= options_.threshold) {
+    speech_ = true;
+    hangover_ = hangoverFrames_;
+  } else if (hangover_ > 0) {
+    hangover_--;
+  } else {
+    speech_ = false;
+  }
+}
+
+void SpeechGate::Configure(bool enabled, uint32_t sampleRate, uint32_t bytesPerFrame, uint32_t paddingMs) {
+  enabled_ = enabled;
+  sampleRate_ = sampleRate;
+  bytesPerFrame_ = bytesPerFrame > 0 ? bytesPerFrame : 1;
+  paddingBytes_ = static_cast<size_t>(static_cast<uint64_t>(sampleRate) * paddingMs / 1000) * bytesPerFrame_;
+  held_.clear();
+  heldBytes_ = 0;
+  tailBytes_ = 0;
+  open_ = false;
+  gap_ = false;
+  passedBytes_ = 0;
+  suppressedBytes_ = 0;
+}
+
+void SpeechGate::Reset() {
+  suppressedBytes_ += heldBytes_;
+  held_.clear();
+  heldBytes_ = 0;
+  tailBytes_ = 0;
+  open_ = false;
+  gap_ = false;
+}
+
+bool SpeechGate::Push(std::vector<uint8_t>& audio, int64_t captureTime, uint16_t flags, float probability,
+                      bool speech, const EmitFunction& emit) {
+  if (speech) {
+    // The segment starts with the held padding
+    while (!held_.empty()) {
+      Held& held = held_.front();
+      Emit(held.audio, held.captureTime, held.flags, held.probability, emit);
+      held_.pop_front();
+    }
+    heldBytes_ = 0;
+    Emit(audio, captureTime, flags, probability, emit);
+    open_ = true;
+    tailBytes_ = paddingBytes_;
+    return false;
+  }
+
+  if (!open_) {
+    Hold(audio, captureTime, flags, probability);
+    return false;
+  }
+
+  if (audio.size() <= tailBytes_) {
+    tailBytes_ -= audio.size();
+    Emit(audio, captureTime, flags, probability, emit);
+    open_ = tailBytes_ > 0;
+    return !open_;
+  }
+
+  // The trailing padding ends inside this buffer
+  size_t passed = tailBytes_;
+  std::vector<uint8_t> rest(audio.begin() + passed, audio.end());
+  audio.resize(passed);
+  if (!audio.empty()) {
+    Emit(audio, captureTime, flags, probability, emit);
+  }
+  Hold(rest, captureTime + Duration(passed), flags & ~AUDIO_PACKET_DISCONTINUITY, probability);
+  tailBytes_ = 0;
+  open_ = false;
+  return true;
+}
+
+void SpeechGate::Hold(std::vector<uint8_t>& audio, int64_t captureTime, uint16_t flags, float probability) {
+  heldBytes_ += audio.size();
+  held_.push_back(Held{std::move(audio), captureTime, flags, probability});
+
+  // Keep only the newest paddingBytes_; the rest will never be sent
+  while (heldBytes_ > paddingBytes_) {
+    Held& oldest = held_.front();
+    size_t excess = heldBytes_ - paddingBytes_;
+    if (oldest.audio.size() <= excess) {
+      heldBytes_ -= oldest.audio.size();
+      suppressedBytes_ += oldest.audio.size();
+      held_.pop_front();
+    } else {
+      oldest.audio.erase(oldest.audio.begin(), oldest.audio.begin() + excess);
+      oldest.captureTime += Duration(excess);
+      heldBytes_ -= excess;
+      suppressedBytes_ += excess;
+    }
+    gap_ = true;
+  }
+}
+
+void SpeechGate::Emit(std::vector<uint8_t>& audio, int64_t captureTime, uint16_t flags, float probability,
+                      const EmitFunction& emit) {
+  if (gap_) {
+    flags |= AUDIO_PACKET_DISCONTINUITY;
+    gap_ = false;
+  }
+  passedBytes_ += audio.size();
+  emit(audio, captureTime, flags, probability);
+}
+
+int64_t SpeechGate::Duration(size_t bytes) const {
+  return sampleRate_ > 0 ? static_cast<int64_t>(bytes / bytesPerFrame_) * 10000000 / sampleRate_ : 0;
+}
+
+}  // namespace windows_loopback_recorder
@@ -0,0 +1,367 @@
+#include "windows_loopback_recorder/wav_file_sink.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace windows_loopback_recorder {
+
+namespace {
+
+constexpr uint64_t kMaxRiffSize = 0xFFFFFFFF;
+constexpr uint16_t kWaveFormatPcm = 0x0001;
+constexpr uint16_t kWaveFormatIeeeFloat = 0x0003;
+constexpr uint16_t kWaveFormatExtensible = 0xFFFE;
+
+void PutFourCC(std::vector<uint8_t>& buffer, size_t offset, const char* fourcc) {
+  std::memcpy(&buffer[offset], fourcc, 4);
+}
+
+void PutLE(std::vector<uint8_t>& buffer, size_t offset, uint64_t value, size_t bytes) {
+  for (size_t i = 0; i < bytes; i++) {
+    buffer[offset + i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+}
+
+uint64_t RiffSizeFor(uint64_t dataBytes) {
+  // Odd-sized data chunks are followed by a pad byte
+  return WavFileSink::kDataOffset - 8 + dataBytes + (dataBytes & 1);
+}
+
+uint32_t DefaultChannelMask(uint16_t channels) {
+  switch (channels) {
+    case 1: return 0x4;    // FRONT_CENTER
+    case 2: return 0x3;    // FRONT_LEFT | FRONT_RIGHT
+    case 4: return 0x33;   // Quad
+    case 6: return 0x3F;   // 5.1
+    case 8: return 0x63F;  // 7.1
+    default: return 0;
+  }
+}
+
+}  // namespace
+
+std::vector<uint8_t> BuildWavHeader(const WavFormat& format, uint64_t dataBytes) {
+  std::vector<uint8_t> header(static_cast<size_t>(WavFileSink::kDataOffset), 0);
+
+  uint64_t riffSize = RiffSizeFor(dataBytes);
+  bool rf64 = riffSize > kMaxRiffSize;
+  uint32_t blockAlign = format.blockAlign();
+
+  PutFourCC(header, 0, rf64 ? "RF64" : "RIFF");
+  PutLE(header, 4, rf64 ? kMaxRiffSize : riffSize, 4);
+  PutFourCC(header, 8, "WAVE");
+
+  // Reserved for the ds64 chunk; a plain JUNK chunk until the file needs it
+  PutFourCC(header, 12, rf64 ? "ds64" : "JUNK");
+  PutLE(header, 16, 28, 4);
+  if (rf64) {
+    PutLE(header, 20, riffSize, 8);
+    PutLE(header, 28, dataBytes, 8);
+    PutLE(header, 36, blockAlign > 0 ? dataBytes / blockAlign : 0, 8);
+    PutLE(header, 44, 0, 4);  // No table entries
+  }
+
+  bool extensible = format.channels > 2 || format.bitsPerSample > 16;
+  uint32_t fmtSize = extensible ? 40 : format.floatSamples ? 18 : 16;
+  uint16_t containerBits = static_cast<uint16_t>(((format.bitsPerSample + 7) / 8) * 8);
+  uint16_t formatTag = extensible ? kWaveFormatExtensible
+                     : format.floatSamples ? kWaveFormatIeeeFloat : kWaveFormatPcm;
+
+  PutFourCC(header, 48, "fmt ");
+  PutLE(header, 52, fmtSize, 4);
+  PutLE(header, 56, formatTag, 2);
+  PutLE(header, 58, format.channels, 2);
+  PutLE(header, 60, format.sampleRate, 4);
+  PutLE(header, 64, static_cast<uint64_t>(format.sampleRate) * blockAlign, 4);
+  PutLE(header, 68, blockAlign, 2);
+  PutLE(header, 70, containerBits, 2);
+  if (fmtSize >= 18) {
+    PutLE(header, 72, extensible ? 22 : 0, 2);
+  }
+  if (extensible) {
+    PutLE(header, 74, format.bitsPerSample, 2);
+    PutLE(header, 76, DefaultChannelMask(format.channels), 4);
+    // KSDATAFORMAT_SUBTYPE_PCM / _IEEE_FLOAT: {0000000X-0000-0010-8000-00AA00389B71}
+    static const uint8_t kSubFormatTail[14] = {0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80,
+                                               0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+    header[80] = static_cast<uint8_t>(format.floatSamples ? kWaveFormatIeeeFloat : kWaveFormatPcm);
+    header[81] = 0;
+    std::memcpy(&header[82], kSubFormatTail, sizeof(kSubFormatTail));
+  }
+
+  // Pad so the audio data starts on a 4 KiB boundary
+  size_t padChunk = 56 + fmtSize;
+  PutFourCC(header, padChunk, "JUNK");
+  PutLE(header, padChunk + 4, WavFileSink::kDataOffset - 8 - (padChunk + 8), 4);
+
+  PutFourCC(header, static_cast<size_t>(WavFileSink::kDataOffset - 8), "data");
+  PutLE(header, static_cast<size_t>(WavFileSink::kDataOffset - 4),
+        rf64 ? kMaxRiffSize : dataBytes, 4);
+
+  return header;
+}
+
+WavFileSink::~WavFileSink() {
+  Close();
+}
+
+bool WavFileSink::Open(const std::string& path, const WavFormat& format,
+                       const WavSinkOptions& options) {
+  Close();
+
+  if (format.blockAlign() == 0 || options.blockBytes == 0 || options.blockCount == 0) {
+    return false;
+  }
+
+  std::unique_ptr<FlacStreamEncoder> flac;
+  if (options.container == FileContainer::FLAC) {
+    FlacEncoderConfig config;
+    config.sampleRate = format.sampleRate;
+    config.channels = format.channels;
+    config.bitsPerSample = format.bitsPerSample;
+    flac = std::make_unique<FlacStreamEncoder>();
+    if (format.floatSamples || !flac->Configure(config)) {
+      return false;
+    }
+  }
+
+  if (!writer_.Open(path)) {
+    return false;
+  }
+
+  path_ = path;
+  format_ = format;
+  options_ = options;
+  stats_ = WavSinkStats();
+  closing_ = false;
+  flac_ = std::move(flac);
+  flacOffset_ = kDataOffset;
+
+  if (!WriteHeader(0)) {
+    writer_.Close();
+    flac_.reset();
+    return false;
+  }
+  if (options_.preallocateBytes > 0 && !flac_) {
+    writer_.Preallocate(options_.preallocateBytes);
+  }
+
+  // Preallocate every block so Write() never allocates on the capture thread
+  blocks_.clear();
+  blocks_.resize(options_.blockCount);
+  freeBlocks_.clear();
+  fullBlocks_.clear();
+  for (Block& block : blocks_) {
+    block.storage.resize(options_.blockBytes + kDataOffset);
+    uintptr_t address = reinterpret_cast<uintptr_t>(block.storage.data());
+    uintptr_t aligned = (address + kDataOffset - 1) & ~static_cast<uintptr_t>(kDataOffset - 1);
+    block.data = block.storage.data() + (aligned - address);
+    freeBlocks_.push_back(&block);
+  }
+
+  current_ = freeBlocks_.back();
+  freeBlocks_.pop_back();
+  current_->size = 0;
+  current_->fileOffset = kDataOffset;
+  nextOffset_ = kDataOffset + options_.blockBytes;
+
+  writerThread_ = std::thread(&WavFileSink::WriterThreadFunction, this);
+  return true;
+}
+
+void WavFileSink::Write(const uint8_t* data, size_t size) {
+  if (size == 0) {
+    return;
+  }
+
+  bool handedOff = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!current_ || closing_) {
+      return;
+    }
+
+    // Drop the whole write rather than split a frame across a gap
+    size_t room = options_.blockBytes - current_->size + freeBlocks_.size() * options_.blockBytes;
+    if (stats_.writeError || size > room) {
+      stats_.droppedBytes += size;
+      return;
+    }
+
+    stats_.dataBytes += size;
+    while (size > 0) {
+      if (current_->size == options_.blockBytes) {
+        fullBlocks_.push_back(current_);
+        current_ = freeBlocks_.back();
+        freeBlocks_.pop_back();
+        current_->size = 0;
+        current_->fileOffset = nextOffset_;
+        nextOffset_ += options_.blockBytes;
+        handedOff = true;
+      }
+
+      size_t count = std::min(size, options_.blockBytes - current_->size);
+      std::memcpy(current_->data + current_->size, data, count);
+      current_->size += count;
+      data += count;
+      size -= count;
+    }
+  }
+
+  if (handedOff) {
+    wake_.notify_one();
+  }
+}
+
+bool WavFileSink::Close() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!writerThread_.joinable()) {
+      return !writer_.isOpen();
+    }
+    closing_ = true;
+    if (current_ && current_->size > 0) {
+      fullBlocks_.push_back(current_);
+    }
+    current_ = nullptr;
+  }
+  wake_.notify_one();
+  writerThread_.join();
+
+  uint64_t dataBytes = stats_.dataBytes;
+  bool ok = !stats_.writeError;
+  if (flac_) {
+    // The last partial block becomes the stream's final, shorter frame
+    ok = WriteFlacFrames(true) && ok;
+  } else if (ok && (dataBytes & 1)) {
+    uint8_t pad = 0;
+    ok = writer_.WriteAt(kDataOffset + dataBytes, &pad, 1);
+  }
+  ok = ok && WriteHeader(dataBytes) && writer_.Flush();
+  writer_.Close();
+
+  if (flac_) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.fileBytes = flacOffset_;
+  }
+  flac_.reset();
+
+  blocks_.clear();
+  freeBlocks_.clear();
+  return ok;
+}
+
+WavSinkStats WavFileSink::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  WavSinkStats stats = stats_;
+  if (options_.container == FileContainer::WAV) {
+    stats.fileBytes = kDataOffset + stats.dataBytes + (stats.dataBytes & 1);
+    stats.rf64 = RiffSizeFor(stats.dataBytes) > kMaxRiffSize;
+  }
+  return stats;
+}
+
+void WavFileSink::WriterThreadFunction() {
+  using Clock = std::chrono::steady_clock;
+  auto interval = std::chrono::milliseconds(options_.checkpointIntervalMs);
+  auto nextCheckpoint = Clock::now() + interval;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    if (fullBlocks_.empty() && !closing_) {
+      if (options_.checkpointIntervalMs > 0) {
+        wake_.wait_until(lock, nextCheckpoint);
+      } else {
+        wake_.wait(lock);
+      }
+    }
+
+    if (!fullBlocks_.empty()) {
+      Block* block = fullBlocks_.front();
+      fullBlocks_.pop_front();
+
+      lock.unlock();
+      bool ok = WriteBlock(*block);
+      lock.lock();
+
+      block->size = 0;
+      freeBlocks_.push_back(block);
+      stats_.blockWrites++;
+      stats_.writeError = stats_.writeError || !ok;
+      if (flac_) {
+        stats_.fileBytes = flacOffset_;
+      }
+      continue;
+    }
+
+    if (closing_) {
+      break;
+    }
+
+    if (options_.checkpointIntervalMs > 0 && Clock::now() >= nextCheckpoint) {
+      bool ok;
+      if (flac_) {
+        // A FLAC stream cannot take a partial block and carry on, so only
+        // the frames encoded so far are committed
+        lock.unlock();
+        ok = WriteFlacFrames(false) && WriteHeader(0) && writer_.Flush();
+        lock.lock();
+        stats_.fileBytes = flacOffset_;
+      } else {
+        // Every earlier block is on disk, so the partial block completes the
+        // file. Only the writer thread recycles blocks, and the capture thread
+        // only appends past |filled|, so the prefix is stable while unlocked.
+        const Block* block = current_;
+        size_t filled = block ? block->size : 0;
+        uint64_t offset = block ? block->fileOffset : nextOffset_;
+
+        lock.unlock();
+        ok = filled == 0 || writer_.WriteAt(offset, block->data, filled);
+        ok = ok && WriteHeader(offset - kDataOffset + filled) && writer_.Flush();
+        lock.lock();
+      }
+
+      stats_.writeError = stats_.writeError || !ok;
+      nextCheckpoint = Clock::now() + interval;
+    }
+  }
+}
+
+bool WavFileSink::WriteBlock(const Block& block) {
+  if (flac_) {
+    flac_->Push(block.data, block.size);
+    return WriteFlacFrames(false);
+  }
+  return writer_.WriteAt(block.fileOffset, block.data, block.size);
+}
+
+bool WavFileSink::WriteHeader(uint64_t dataBytes) {
+  // STREAMINFO counts the frames actually encoded, not the bytes accepted
+  std::vector<uint8_t> header = flac_
+      ? BuildFlacHeader(flac_->config(), flac_->info(), static_cast<size_t>(kDataOffset))
+      : BuildWavHeader(format_, dataBytes);
+  return writer_.WriteAt(0, header.data(), header.size());
+}
+
+bool WavFileSink::WriteFlacFrames(bool finish) {
+  flacFrames_.clear();
+  auto append = [this](std::vector<uint8_t>& frame, uint32_t) {
+    flacFrames_.insert(flacFrames_.end(), frame.begin(), frame.end());
+  };
+  if (finish) {
+    flac_->Finish(append);
+  } else {
+    flac_->Collect(append);
+  }
+
+  // Frames are appended back to back, so one write covers them all
+  if (flacFrames_.empty()) {
+    return true;
+  }
+  bool ok = writer_.WriteAt(flacOffset_, flacFrames_.data(), flacFrames_.size());
+  flacOffset_ += flacFrames_.size();
+  return ok;
+}
+
+}  // namespace windows_loopback_recorder
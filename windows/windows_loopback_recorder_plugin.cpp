@@ -57,6 +57,65 @@ void DebugOutput(const char* format, ...) {
   }
 }
 
+// Reads an optional integer argument from a method call map
+static bool ReadIntArgument(const flutter::EncodableMap& args, const char* key, UINT32& value) {
+  auto it = args.find(flutter::EncodableValue(key));
+  if (it == args.end() || it->second.IsNull()) {
+    return false;
+  }
+  value = static_cast<UINT32>(it->second.LongValue());
+  return true;
+}
+
+// Reads an optional 64-bit integer argument from a method call map
+static bool ReadIntArgument(const flutter::EncodableMap& args, const char* key, uint64_t& value) {
+  auto it = args.find(flutter::EncodableValue(key));
+  if (it == args.end() || it->second.IsNull()) {
+    return false;
+  }
+  value = static_cast<uint64_t>(it->second.LongValue());
+  return true;
+}
+
+// Reads an optional boolean argument from a method call map
+static bool ReadBoolArgument(const flutter::EncodableMap& args, const char* key, bool& value) {
+  auto it = args.find(flutter::EncodableValue(key));
+  if (it == args.end() || !std::holds_alternative<bool>(it->second)) {
+    return false;
+  }
+  value = std::get<bool>(it->second);
+  return true;
+}
+
+// Reads an optional floating point argument from a method call map; Dart
+// may send whole numbers as integers
+static bool ReadDoubleArgument(const flutter::EncodableMap& args, const char* key, double& value) {
+  auto it = args.find(flutter::EncodableValue(key));
+  if (it == args.end()) {
+    return false;
+  }
+  if (const auto* number = std::get_if<double>(&it->second)) {
+    value = *number;
+    return true;
+  }
+  if (std::holds_alternative<int32_t>(it->second) || std::holds_alternative<int64_t>(it->second)) {
+    value = static_cast<double>(it->second.LongValue());
+    return true;
+  }
+  return false;
+}
+
+// Current QueryPerformanceCounter time in 100 ns units, the same clock
+// WASAPI uses for capture positions
+static int64_t QpcNow100ns() {
+  LARGE_INTEGER counter;
+  LARGE_INTEGER frequency;
+  QueryPerformanceCounter(&counter);
+  QueryPerformanceFrequency(&frequency);
+  return static_cast<int64_t>(counter.QuadPart / frequency.QuadPart * 10000000 +
+                              counter.QuadPart % frequency.QuadPart * 10000000 / frequency.QuadPart);
+}
+
 // static
 void WindowsLoopbackRecorderPlugin::RegisterWithRegistrar(
     flutter::PluginRegistrarWindows *registrar) {
@@ -75,6 +134,21 @@ void WindowsLoopbackRecorderPlugin::RegisterWithRegistrar(
           registrar->messenger(), "windows_loopback_recorder/volume_stream",
           &flutter::StandardMethodCodec::GetInstance());
 
+  auto spectrum_event_channel =
+      std::make_unique<flutter::EventChannel<flutter::EncodableValue>>(
+          registrar->messenger(), "windows_loopback_recorder/spectrum_stream",
+          &flutter::StandardMethodCodec::GetInstance());
+
+  auto feature_event_channel =
+      std::make_unique<flutter::EventChannel<flutter::EncodableValue>>(
+          registrar->messenger(), "windows_loopback_recorder/feature_stream",
+          &flutter::StandardMethodCodec::GetInstance());
+
+  auto file_event_channel =
+      std::make_unique<flutter::EventChannel<flutter::EncodableValue>>(
+          registrar->messenger(), "windows_loopback_recorder/file_events",
+          &flutter::StandardMethodCodec::GetInstance());
+
   auto plugin = std::make_unique<WindowsLoopbackRecorderPlugin>();
 
   // Set up audio event channel handler
@@ -121,8 +195,76 @@ void WindowsLoopbackRecorderPlugin::RegisterWithRegistrar(
         return nullptr;
       });
 
+  // Set up spectrum event channel handler
+  auto spectrum_handler = std::make_unique<flutter::StreamHandlerFunctions<flutter::EncodableValue>>(
+      [plugin_pointer = plugin.get()](
+          const flutter::EncodableValue* arguments,
+          std::unique_ptr<flutter::EventSink<flutter::EncodableValue>>&& events)
+          -> std::unique_ptr<flutter::StreamHandlerError<flutter::EncodableValue>> {
+        {
+          std::lock_guard<std::mutex> lock(plugin_pointer->spectrumEventSinkMutex_);
+          plugin_pointer->spectrumEventSink_ = std::move(events);
+        }
+        return nullptr;
+      },
+      [plugin_pointer = plugin.get()](const flutter::EncodableValue* arguments)
+          -> std::unique_ptr<flutter::StreamHandlerError<flutter::EncodableValue>> {
+        {
+          std::lock_guard<std::mutex> lock(plugin_pointer->spectrumEventSinkMutex_);
+          plugin_pointer->spectrumEventSink_.reset();
+          plugin_pointer->spectrumEnabled_ = false;
+        }
+        return nullptr;
+      });
+
+  // Set up feature event channel handler
+  auto feature_handler = std::make_unique<flutter::StreamHandlerFunctions<flutter::EncodableValue>>(
+      [plugin_pointer = plugin.get()](
+          const flutter::EncodableValue* arguments,
+          std::unique_ptr<flutter::EventSink<flutter::EncodableValue>>&& events)
+          -> std::unique_ptr<flutter::StreamHandlerError<flutter::EncodableValue>> {
+        {
+          std::lock_guard<std::mutex> lock(plugin_pointer->featureEventSinkMutex_);
+          plugin_pointer->featureEventSink_ = std::move(events);
+        }
+        return nullptr;
+      },
+      [plugin_pointer = plugin.get()](const flutter::EncodableValue* arguments)
+          -> std::unique_ptr<flutter::StreamHandlerError<flutter::EncodableValue>> {
+        {
+          std::lock_guard<std::mutex> lock(plugin_pointer->featureEventSinkMutex_);
+          plugin_pointer->featureEventSink_.reset();
+          plugin_pointer->featuresEnabled_ = false;
+        }
+        return nullptr;
+      });
+
+  // Set up file event channel handler
+  auto file_event_handler = std::make_unique<flutter::StreamHandlerFunctions<flutter::EncodableValue>>(
+      [plugin_pointer = plugin.get()](
+          const flutter::EncodableValue* arguments,
+          std::unique_ptr<flutter::EventSink<flutter::EncodableValue>>&& events)
+          -> std::unique_ptr<flutter::StreamHandlerError<flutter::EncodableValue>> {
+        {
+          std::lock_guard<std::mutex> lock(plugin_pointer->fileEventSinkMutex_);
+          plugin_pointer->fileEventSink_ = std::move(events);
+        }
+        return nullptr;
+      },
+      [plugin_pointer = plugin.get()](const flutter::EncodableValue* arguments)
+          -> std::unique_ptr<flutter::StreamHandlerError<flutter::EncodableValue>> {
+        {
+          std::lock_guard<std::mutex> lock(plugin_pointer->fileEventSinkMutex_);
+          plugin_pointer->fileEventSink_.reset();
+        }
+        return nullptr;
+      });
+
   event_channel->SetStreamHandler(std::move(handler));
   volume_event_channel->SetStreamHandler(std::move(volume_handler));
+  spectrum_event_channel->SetStreamHandler(std::move(spectrum_handler));
+  feature_event_channel->SetStreamHandler(std::move(feature_handler));
+  file_event_channel->SetStreamHandler(std::move(file_event_handler));
 
   channel->SetMethodCallHandler(
       [plugin_pointer = plugin.get()](const auto &call, auto result) {
@@ -133,6 +275,8 @@ void WindowsLoopbackRecorderPlugin::RegisterWithRegistrar(
 }
 
 WindowsLoopbackRecorderPlugin::WindowsLoopbackRecorderPlugin() {
+  deliveryQueue_.SetSender([this](DeliveryItem& item) { return DeliverAudio(item); });
+
   // Initialize COM
   HRESULT hr = CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED);
   if (SUCCEEDED(hr)) {
@@ -152,8 +296,8 @@ WindowsLoopbackRecorderPlugin::WindowsLoopbackRecorderPlugin() {
 WindowsLoopbackRecorderPlugin::~WindowsLoopbackRecorderPlugin() {
   StopRecording();
 
-  // Clean up resampler
-  CleanupResampler();
+  // Release the engine
+  ReleaseEngine();
 
   // Clean up WASAPI resources
   if (systemCaptureClient_) {
@@ -213,20 +357,23 @@ void WindowsLoopbackRecorderPlugin::HandleMethodCall(
     if (method_call.arguments() && !method_call.arguments()->IsNull()) {
       const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
       if (args) {
-        auto sample_rate_it = args->find(flutter::EncodableValue("sampleRate"));
-        if (sample_rate_it != args->end() && !sample_rate_it->second.IsNull()) {
-          config.sampleRate = std::get<int32_t>(sample_rate_it->second);
-        }
-
-        auto channels_it = args->find(flutter::EncodableValue("channels"));
-        if (channels_it != args->end() && !channels_it->second.IsNull()) {
-          config.channels = std::get<int32_t>(channels_it->second);
-        }
-
-        auto bits_it = args->find(flutter::EncodableValue("bitsPerSample"));
-        if (bits_it != args->end() && !bits_it->second.IsNull()) {
-          config.bitsPerSample = std::get<int32_t>(bits_it->second);
-        }
+        ReadIntArgument(*args, "sampleRate", config.sampleRate);
+        ReadIntArgument(*args, "channels", config.channels);
+        ReadIntArgument(*args, "bitsPerSample", config.bitsPerSample);
+        ReadBoolArgument(*args, "floatSamples", config.floatSamples);
+        ReadIntArgument(*args, "dither", config.dither);
+        ReadIntArgument(*args, "frameDurationMs", config.frameDurationMs);
+        ReadIntArgument(*args, "minChunkBytes", config.minChunkBytes);
+        ReadIntArgument(*args, "maxLatencyMs", config.maxLatencyMs);
+        ReadIntArgument(*args, "backpressurePolicy", config.backpressurePolicy);
+        ReadIntArgument(*args, "maxQueuedChunks", config.maxQueuedChunks);
+        ReadBoolArgument(*args, "packetHeader", config.packetHeader);
+        ReadIntArgument(*args, "encoding", config.encoding);
+        ReadBoolArgument(*args, "echoCancellation", config.echoCancellation);
+        ReadIntArgument(*args, "echoTailMs", config.echoTailMs);
+        ReadBoolArgument(*args, "micNoiseSuppression", config.micNoiseSuppression);
+        ReadBoolArgument(*args, "systemNoiseSuppression", config.systemNoiseSuppression);
+        ReadIntArgument(*args, "noiseSuppressionDb", config.noiseSuppressionDb);
       }
     }
 
@@ -280,6 +427,8 @@ void WindowsLoopbackRecorderPlugin::HandleMethodCall(
     format_info[flutter::EncodableValue("sampleRate")] = flutter::EncodableValue(static_cast<int32_t>(audioConfig_.sampleRate));
     format_info[flutter::EncodableValue("channels")] = flutter::EncodableValue(static_cast<int32_t>(audioConfig_.channels));
     format_info[flutter::EncodableValue("bitsPerSample")] = flutter::EncodableValue(static_cast<int32_t>(audioConfig_.bitsPerSample));
+    format_info[flutter::EncodableValue("floatSamples")] = flutter::EncodableValue(audioConfig_.floatSamples);
+    format_info[flutter::EncodableValue("dither")] = flutter::EncodableValue(static_cast<int32_t>(audioConfig_.dither));
 
     printf("Returning user format: %dHz, %dch, %dbit\n",
            audioConfig_.sampleRate, audioConfig_.channels, audioConfig_.bitsPerSample);
@@ -287,13 +436,308 @@ void WindowsLoopbackRecorderPlugin::HandleMethodCall(
     result->Success(flutter::EncodableValue(format_info));
 
   } else if (method_call.method_name() == "startVolumeMonitoring") {
-    bool success = StartVolumeMonitoring();
+    UINT32 intervalMs = kDefaultMeterIntervalMs;
+    if (const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments())) {
+      ReadIntArgument(*args, "intervalMs", intervalMs);
+    }
+    bool success = StartVolumeMonitoring(intervalMs);
     result->Success(flutter::EncodableValue(success));
 
   } else if (method_call.method_name() == "stopVolumeMonitoring") {
     bool success = StopVolumeMonitoring();
     result->Success(flutter::EncodableValue(success));
 
+  } else if (method_call.method_name() == "startSpectrum") {
+    SpectrumOptions options;
+    if (const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments())) {
+      ReadIntArgument(*args, "intervalMs", options.intervalMs);
+      ReadIntArgument(*args, "fftSize", options.fftSize);
+      ReadIntArgument(*args, "bands", options.bands);
+      ReadDoubleArgument(*args, "minHz", options.minHz);
+      ReadDoubleArgument(*args, "maxHz", options.maxHz);
+    }
+    if (!StartSpectrum(options)) {
+      result->Error("INVALID_ARGUMENTS",
+                    "startSpectrum expects a power-of-two fftSize from 16 to 16384, 1 to 256 bands "
+                    "and 0 < minHz < maxHz");
+      return;
+    }
+    result->Success(flutter::EncodableValue(true));
+
+  } else if (method_call.method_name() == "stopSpectrum") {
+    StopSpectrum();
+    result->Success(flutter::EncodableValue(true));
+
+  } else if (method_call.method_name() == "startFeatures") {
+    FeatureStreamOptions options;
+    if (const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments())) {
+      ReadIntArgument(*args, "melBins", options.features.melBins);
+      ReadIntArgument(*args, "mfcc", options.features.mfcc);
+      ReadDoubleArgument(*args, "minHz", options.features.minHz);
+      ReadDoubleArgument(*args, "maxHz", options.features.maxHz);
+      ReadDoubleArgument(*args, "preEmphasis", options.features.preEmphasis);
+      ReadIntArgument(*args, "rowsPerUpdate", options.rowsPerUpdate);
+    }
+    if (!StartFeatures(options)) {
+      result->Error("INVALID_ARGUMENTS",
+                    "startFeatures expects 1 to 256 melBins, mfcc up to melBins, 0 <= minHz < maxHz, "
+                    "0 <= preEmphasis < 1 and 1 to 100 rowsPerUpdate");
+      return;
+    }
+    result->Success(flutter::EncodableValue(true));
+
+  } else if (method_call.method_name() == "stopFeatures") {
+    StopFeatures();
+    result->Success(flutter::EncodableValue(true));
+
+  } else if (method_call.method_name() == "startVad") {
+    VadOptions options;
+    if (const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments())) {
+      double threshold = options.threshold;
+      ReadDoubleArgument(*args, "threshold", threshold);
+      options.threshold = static_cast<float>(threshold);
+      ReadIntArgument(*args, "hangoverMs", options.hangoverMs);
+      ReadBoolArgument(*args, "gate", options.gate);
+      ReadIntArgument(*args, "paddingMs", options.paddingMs);
+    }
+    if (!StartVad(options)) {
+      result->Error("INVALID_ARGUMENTS",
+                    "startVad expects 0 < threshold < 1, hangoverMs up to 10000 and paddingMs up to 10000");
+      return;
+    }
+    result->Success(flutter::EncodableValue(true));
+
+  } else if (method_call.method_name() == "stopVad") {
+    StopVad();
+    result->Success(flutter::EncodableValue(true));
+
+  } else if (method_call.method_name() == "getVadStats") {
+    uint64_t passed = vadPassedBytes_;
+    uint64_t suppressed = vadSuppressedBytes_;
+    double ratio = passed + suppressed > 0 ? static_cast<double>(suppressed) / (passed + suppressed) : 0.0;
+
+    flutter::EncodableMap stats_info;
+    stats_info[flutter::EncodableValue("enabled")] = flutter::EncodableValue(vadEnabled_.load());
+    stats_info[flutter::EncodableValue("speaking")] = flutter::EncodableValue(speaking_.load());
+    stats_info[flutter::EncodableValue("speechProbability")] = flutter::EncodableValue(static_cast<double>(speechProbability_.load()));
+    stats_info[flutter::EncodableValue("micSpeechProbability")] = flutter::EncodableValue(static_cast<double>(micSpeechProbability_.load()));
+    stats_info[flutter::EncodableValue("passedBytes")] = flutter::EncodableValue(static_cast<int64_t>(passed));
+    stats_info[flutter::EncodableValue("suppressedBytes")] = flutter::EncodableValue(static_cast<int64_t>(suppressed));
+    stats_info[flutter::EncodableValue("suppressedRatio")] = flutter::EncodableValue(ratio);
+
+    result->Success(flutter::EncodableValue(stats_info));
+
+  } else if (method_call.method_name() == "getNoiseSuppressionStats") {
+    // The suppressors only change in StartRecording, on this thread
+    const NoiseSuppressor* micSuppressor = engine_.micSuppressor();
+    const NoiseSuppressor* systemSuppressor = engine_.systemSuppressor();
+    flutter::EncodableMap stats_info;
+    stats_info[flutter::EncodableValue("micEnabled")] = flutter::EncodableValue(micSuppressor != nullptr);
+    stats_info[flutter::EncodableValue("systemEnabled")] = flutter::EncodableValue(systemSuppressor != nullptr);
+    stats_info[flutter::EncodableValue("micLatencyMs")] =
+        flutter::EncodableValue(micSuppressor ? micSuppressor->latencyMs() : 0.0);
+    stats_info[flutter::EncodableValue("systemLatencyMs")] =
+        flutter::EncodableValue(systemSuppressor ? systemSuppressor->latencyMs() : 0.0);
+    stats_info[flutter::EncodableValue("micNoiseDb")] = flutter::EncodableValue(static_cast<double>(engine_.micNoiseDb()));
+    stats_info[flutter::EncodableValue("systemNoiseDb")] = flutter::EncodableValue(static_cast<double>(engine_.systemNoiseDb()));
+
+    result->Success(flutter::EncodableValue(stats_info));
+
+  } else if (method_call.method_name() == "resetLoudness") {
+    // Picked up by the capture thread before it meters the next packet
+    loudnessResetRequested_ = true;
+    result->Success(flutter::EncodableValue(true));
+
+  } else if (method_call.method_name() == "attachAudioPort") {
+    const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    if (!args) {
+      result->Error("INVALID_ARGUMENTS", "attachAudioPort expects a map with port and postCObject");
+      return;
+    }
+
+    auto port_it = args->find(flutter::EncodableValue("port"));
+    auto post_it = args->find(flutter::EncodableValue("postCObject"));
+    if (port_it == args->end() || post_it == args->end() ||
+        port_it->second.IsNull() || post_it->second.IsNull()) {
+      result->Error("INVALID_ARGUMENTS", "attachAudioPort expects a map with port and postCObject");
+      return;
+    }
+
+    bool success = AttachAudioPort(port_it->second.LongValue(), post_it->second.LongValue());
+    result->Success(flutter::EncodableValue(success));
+
+  } else if (method_call.method_name() == "detachAudioPort") {
+    DetachAudioPort();
+    result->Success(flutter::EncodableValue(true));
+
+  } else if (method_call.method_name() == "acknowledgeAudio") {
+    UINT32 count = 1;
+    const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    if (args) {
+      ReadIntArgument(*args, "count", count);
+    }
+    deliveryQueue_.Acknowledge(count);
+    result->Success(flutter::EncodableValue(true));
+
+  } else if (method_call.method_name() == "getDeliveryStats") {
+    DeliveryStats stats = deliveryQueue_.GetStats();
+
+    flutter::EncodableMap stats_info;
+    stats_info[flutter::EncodableValue("deliveredChunks")] = flutter::EncodableValue(static_cast<int64_t>(stats.deliveredChunks));
+    stats_info[flutter::EncodableValue("droppedChunks")] = flutter::EncodableValue(static_cast<int64_t>(stats.droppedChunks));
+    stats_info[flutter::EncodableValue("droppedFrames")] = flutter::EncodableValue(static_cast<int64_t>(stats.droppedFrames));
+    stats_info[flutter::EncodableValue("queuedChunks")] = flutter::EncodableValue(static_cast<int64_t>(stats.queuedChunks));
+    stats_info[flutter::EncodableValue("inFlightChunks")] = flutter::EncodableValue(static_cast<int64_t>(stats.inFlightChunks));
+    stats_info[flutter::EncodableValue("highWatermarkChunks")] = flutter::EncodableValue(static_cast<int64_t>(stats.highWatermarkChunks));
+    stats_info[flutter::EncodableValue("highWatermarkBytes")] = flutter::EncodableValue(static_cast<int64_t>(stats.highWatermarkBytes));
+
+    result->Success(flutter::EncodableValue(stats_info));
+
+  } else if (method_call.method_name() == "getPipelineStats") {
+    flutter::EncodableMap stages;
+    for (size_t i = 0; i < kPipelineStageCount; i++) {
+      PipelineStage stage = static_cast<PipelineStage>(i);
+      flutter::EncodableMap counters;
+      counters[flutter::EncodableValue("runs")] = flutter::EncodableValue(static_cast<int64_t>(pipelineStats_.runs(stage)));
+      counters[flutter::EncodableValue("skips")] = flutter::EncodableValue(static_cast<int64_t>(pipelineStats_.skips(stage)));
+      stages[flutter::EncodableValue(PipelineStageName(stage))] = flutter::EncodableValue(counters);
+    }
+    result->Success(flutter::EncodableValue(stages));
+
+  } else if (method_call.method_name() == "startFileRecording") {
+    const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    const std::string* path = nullptr;
+    if (args) {
+      auto path_it = args->find(flutter::EncodableValue("path"));
+      if (path_it != args->end()) {
+        path = std::get_if<std::string>(&path_it->second);
+      }
+    }
+    if (!path || path->empty()) {
+      result->Error("INVALID_ARGUMENTS", "startFileRecording expects a map with path");
+      return;
+    }
+
+    SegmentOptions segments;
+    ReadIntArgument(*args, "segmentSeconds", segments.segmentSeconds);
+    ReadIntArgument(*args, "segmentBytes", segments.segmentBytes);
+    UINT32 container = 0;
+    ReadIntArgument(*args, "format", container);
+    bool peaks = false;
+    ReadBoolArgument(*args, "peaks", peaks);
+
+    bool success = StartFileRecording(*path, segments,
+                                      container == static_cast<UINT32>(FileContainer::FLAC)
+                                          ? FileContainer::FLAC : FileContainer::WAV,
+                                      peaks);
+    result->Success(flutter::EncodableValue(success));
+
+  } else if (method_call.method_name() == "stopFileRecording") {
+    flutter::EncodableMap summary;
+    if (StopFileRecording(summary)) {
+      result->Success(flutter::EncodableValue(summary));
+    } else {
+      result->Success();
+    }
+
+  } else if (method_call.method_name() == "queryPeaks") {
+    const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    uint64_t startFrame = 0;
+    uint64_t endFrame = 0;
+    UINT32 columns = 0;
+    if (!args || !ReadIntArgument(*args, "startFrame", startFrame) ||
+        !ReadIntArgument(*args, "endFrame", endFrame) || !ReadIntArgument(*args, "columns", columns)) {
+      result->Error("INVALID_ARGUMENTS", "queryPeaks expects startFrame, endFrame and columns");
+      return;
+    }
+    const std::string* path = nullptr;
+    auto path_it = args->find(flutter::EncodableValue("path"));
+    if (path_it != args->end()) {
+      path = std::get_if<std::string>(&path_it->second);
+    }
+
+    // A saved .peaks file, or the file recording in progress
+    PeakColumns peaks;
+    bool found = false;
+    if (path) {
+      found = PeakPyramid::QueryFile(*path, startFrame, endFrame, columns, peaks);
+    } else {
+      std::shared_ptr<PeakPyramid> pyramid;
+      {
+        std::lock_guard<std::mutex> lock(fileSinkMutex_);
+        pyramid = filePeaks_;
+      }
+      found = pyramid && pyramid->Query(startFrame, endFrame, columns, peaks);
+    }
+    if (!found) {
+      result->Success();
+      return;
+    }
+    flutter::EncodableMap peaks_info;
+    peaks_info[flutter::EncodableValue("sampleRate")] = flutter::EncodableValue(static_cast<int64_t>(peaks.sampleRate));
+    peaks_info[flutter::EncodableValue("channels")] = flutter::EncodableValue(static_cast<int64_t>(peaks.channels));
+    peaks_info[flutter::EncodableValue("frames")] = flutter::EncodableValue(static_cast<int64_t>(peaks.frames));
+    peaks_info[flutter::EncodableValue("bucketFrames")] = flutter::EncodableValue(static_cast<int64_t>(peaks.bucketFrames));
+    peaks_info[flutter::EncodableValue("startFrame")] = flutter::EncodableValue(static_cast<int64_t>(startFrame));
+    peaks_info[flutter::EncodableValue("endFrame")] =
+        flutter::EncodableValue(static_cast<int64_t>((std::min)(endFrame, peaks.frames)));
+    peaks_info[flutter::EncodableValue("values")] = flutter::EncodableValue(std::move(peaks.values));
+    result->Success(flutter::EncodableValue(peaks_info));
+
+  } else if (method_call.method_name() == "startPreRoll") {
+    PreRollOptions options;
+    if (const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments())) {
+      uint64_t budgetBytes = options.budgetBytes;
+      ReadIntArgument(*args, "budgetBytes", budgetBytes);
+      options.budgetBytes = static_cast<size_t>(budgetBytes);
+      ReadBoolArgument(*args, "compressed", options.compressed);
+    }
+    result->Success(flutter::EncodableValue(StartPreRoll(options)));
+
+  } else if (method_call.method_name() == "stopPreRoll") {
+    StopPreRoll();
+    result->Success(flutter::EncodableValue(true));
+
+  } else if (method_call.method_name() == "savePreRoll" || method_call.method_name() == "getPreRoll") {
+    bool toFile = method_call.method_name() == "savePreRoll";
+    const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    const std::string* path = nullptr;
+    UINT32 seconds = 0;
+    if (args) {
+      auto path_it = args->find(flutter::EncodableValue("path"));
+      if (path_it != args->end()) {
+        path = std::get_if<std::string>(&path_it->second);
+      }
+      ReadIntArgument(*args, "seconds", seconds);
+    }
+    if (toFile && (!path || path->empty())) {
+      result->Error("INVALID_ARGUMENTS", "savePreRoll expects a map with path");
+      return;
+    }
+
+    // Collecting the snapshot only pins blocks; capture keeps running while
+    // the file is written or the bytes are copied out
+    PreRollSnapshot snapshot;
+    if (!SnapshotPreRoll(seconds, snapshot)) {
+      result->Success();
+      return;
+    }
+    if (!toFile) {
+      result->Success(flutter::EncodableValue(snapshot.ToFile()));
+      return;
+    }
+    if (!snapshot.WriteFile(*path)) {
+      DebugOutput("savePreRoll failed: cannot write %s", path->c_str());
+      result->Success();
+      return;
+    }
+    flutter::EncodableMap summary;
+    summary[flutter::EncodableValue("path")] = flutter::EncodableValue(*path);
+    summary[flutter::EncodableValue("firstFrame")] = flutter::EncodableValue(static_cast<int64_t>(snapshot.firstFrame));
+    summary[flutter::EncodableValue("frames")] = flutter::EncodableValue(static_cast<int64_t>(snapshot.frames));
+    summary[flutter::EncodableValue("format")] = flutter::EncodableValue(static_cast<int32_t>(snapshot.container));
+    result->Success(flutter::EncodableValue(summary));
+
   } else {
     result->NotImplemented();
   }
@@ -313,11 +757,125 @@ bool WindowsLoopbackRecorderPlugin::StartRecording(const AudioConfig& config) {
     return false;
   }
 
-  // Initialize resampler based on user configuration
-  if (!InitializeResampler()) {
+  // Mixing, conversion and the stages around them, for these formats
+  if (!ConfigureEngine()) {
     return false;
   }
 
+  // Metering sees the output layout; more channels than it supports leave
+  // the volume stream silent
+  if (!meter_.Configure(static_cast<uint16_t>(audioConfig_.channels))) {
+    DebugOutput("Volume metering unavailable for %u channels", audioConfig_.channels);
+  }
+  loudnessRate_ = 0;  // Integrated loudness covers one recording
+  spectrumRate_ = 0;
+  featureRate_ = 0;  // Row numbers start over with the recording
+  vadRate_ = 0;  // Detectors and gate start over, and so do the gate counters
+  meterAccumulator_.Clear();
+  systemAccumulator_.Clear();
+  micAccumulator_.Clear();
+  recordingStartTime_ = std::chrono::steady_clock::now();
+
+  // Output is PCM in the user's channel layout, rate and sample format,
+  // optionally encoded from 16-bit before delivery
+  UINT32 bytesPerFrame = audioConfig_.channels * engine_.bytesPerSample();
+  SampleFormat outputFormat = engine_.outputFormat();
+  UINT32 deliveredBytesPerFrame = bytesPerFrame;  // Zero for compressed streams
+  uint16_t formatId = outputFormat == SampleFormat::PCM24   ? AUDIO_FORMAT_PCM_S24
+                    : outputFormat == SampleFormat::PCM32   ? AUDIO_FORMAT_PCM_S32
+                    : outputFormat == SampleFormat::FLOAT32 ? AUDIO_FORMAT_F32
+                                                            : AUDIO_FORMAT_PCM_S16;
+  flacEncoder_.reset();
+  flacHeaderSent_ = false;
+  adpcmEncoder_.reset();
+  companding_ = false;
+
+  switch (static_cast<OutputEncoding>(audioConfig_.encoding)) {
+    case OutputEncoding::FLAC: {
+      // Each FLAC frame becomes one chunk, so frameDurationMs sets the block size
+      FlacEncoderConfig flacConfig;
+      flacConfig.sampleRate = audioConfig_.sampleRate;
+      flacConfig.channels = static_cast<uint16_t>(audioConfig_.channels);
+      flacConfig.bitsPerSample = 16;
+      if (audioConfig_.frameDurationMs > 0) {
+        uint64_t frames = static_cast<uint64_t>(audioConfig_.sampleRate) * audioConfig_.frameDurationMs / 1000;
+        flacConfig.blockSize = static_cast<uint32_t>(std::clamp<uint64_t>(frames, 16, 65535));
+      }
+      flacEncoder_ = std::make_unique<FlacStreamEncoder>();
+      if (!flacEncoder_->Configure(flacConfig)) {
+        DebugOutput("StartRecording failed: FLAC cannot encode %u channels at %u Hz",
+                    audioConfig_.channels, audioConfig_.sampleRate);
+        flacEncoder_.reset();
+        return false;
+      }
+      deliveredBytesPerFrame = 0;
+      formatId = AUDIO_FORMAT_FLAC;
+      break;
+    }
+    case OutputEncoding::MU_LAW:
+    case OutputEncoding::A_LAW:
+      // Companding keeps sample frames intact, so chunking still applies
+      companding_ = true;
+      if (audioConfig_.encoding == static_cast<UINT32>(OutputEncoding::MU_LAW)) {
+        g711Law_ = G711Law::MU_LAW;
+        formatId = AUDIO_FORMAT_MULAW;
+      } else {
+        g711Law_ = G711Law::A_LAW;
+        formatId = AUDIO_FORMAT_ALAW;
+      }
+      deliveredBytesPerFrame = audioConfig_.channels;
+      break;
+    case OutputEncoding::IMA_ADPCM: {
+      // One block per chunk; frameDurationMs picks the block length, rounded
+      // to the 8n + 1 samples the format requires
+      uint32_t samplesPerBlock = ImaAdpcmEncoder::DefaultSamplesPerBlock(audioConfig_.sampleRate);
+      if (audioConfig_.frameDurationMs > 0) {
+        uint64_t frames = static_cast<uint64_t>(audioConfig_.sampleRate) * audioConfig_.frameDurationMs / 1000;
+        samplesPerBlock = static_cast<uint32_t>(std::clamp<uint64_t>(frames / 8, 1, 8191) * 8 + 1);
+      }
+      adpcmEncoder_ = std::make_unique<ImaAdpcmEncoder>();
+      if (!adpcmEncoder_->Configure(static_cast<uint16_t>(audioConfig_.channels), samplesPerBlock)) {
+        DebugOutput("StartRecording failed: IMA ADPCM cannot encode %u channels", audioConfig_.channels);
+        adpcmEncoder_.reset();
+        return false;
+      }
+      deliveredBytesPerFrame = 0;
+      formatId = AUDIO_FORMAT_IMA_ADPCM;
+      break;
+    }
+    default:
+      audioConfig_.encoding = static_cast<UINT32>(OutputEncoding::PCM);
+      break;
+  }
+
+  ChunkingConfig chunking;
+  if (!flacEncoder_ && !adpcmEncoder_) {
+    chunking.frameDurationMs = audioConfig_.frameDurationMs;
+    chunking.minChunkBytes = audioConfig_.minChunkBytes;
+    chunking.maxLatencyMs = audioConfig_.maxLatencyMs;
+  }
+  chunker_.Configure(chunking, audioConfig_.sampleRate, bytesPerFrame);
+
+  UINT32 policy = audioConfig_.backpressurePolicy;
+  if (policy > static_cast<UINT32>(BackpressurePolicy::DROP_NEWEST)) {
+    policy = static_cast<UINT32>(BackpressurePolicy::NONE);
+  }
+  UINT32 headerBytes = audioConfig_.packetHeader ? sizeof(AudioPacketHeader) : 0;
+  uint8_t silenceByte = formatId == AUDIO_FORMAT_MULAW ? 0xFF : formatId == AUDIO_FORMAT_ALAW ? 0xD5 : 0;
+  deliveryQueue_.Configure(static_cast<BackpressurePolicy>(policy), audioConfig_.maxQueuedChunks,
+                           deliveredBytesPerFrame, headerBytes, silenceByte);
+
+  packetizer_.Configure(audioConfig_.packetHeader, audioConfig_.sampleRate,
+                        static_cast<uint16_t>(audioConfig_.channels), formatId, bytesPerFrame);
+
+  // A pre-roll armed earlier starts over in the new format; one that does
+  // not fit its budget is disarmed rather than failing the recording
+  if (preRollEnabled_ && !CreatePreRoll()) {
+    preRollEnabled_ = false;
+  }
+
+  pipelineStats_.Reset();
+
   // Start capture thread
   shouldStop_ = false;
   captureThread_ = std::thread(&WindowsLoopbackRecorderPlugin::CaptureThreadFunction, this);
@@ -351,10 +909,21 @@ bool WindowsLoopbackRecorderPlugin::StopRecording() {
 
   shouldStop_ = true;
 
+  // Release a capture thread blocked on a stalled consumer
+  deliveryQueue_.Close();
+
   if (captureThread_.joinable()) {
     captureThread_.join();
   }
 
+  // Deliver the tail held back by the chunker or the encoder
+  FlushChunker();
+  FlushEncoder();
+
+  // Finalize any file still being written
+  flutter::EncodableMap fileSummary;
+  StopFileRecording(fileSummary);
+
   // Stop audio clients first and ensure they are fully stopped
   if (systemAudioClient_) {
     systemAudioClient_->Stop();
@@ -366,8 +935,8 @@ bool WindowsLoopbackRecorderPlugin::StopRecording() {
     Sleep(50);
   }
 
-  // Clean up resampler before releasing WASAPI resources
-  CleanupResampler();
+  // Release the engine before the WASAPI resources
+  ReleaseEngine();
 
   // IMPORTANT: Release WASAPI resources to ensure clean restart
   // Release in reverse order of creation for proper cleanup
@@ -615,30 +1184,193 @@ void WindowsLoopbackRecorderPlugin::CaptureThreadFunction() {
       UINT32 micFrames = 0;
       DWORD systemFlags = 0;
       DWORD micFlags = 0;
+      UINT64 systemQpcPosition = 0;
+      UINT64 micQpcPosition = 0;
 
       // Get system audio buffer
       if (systemPacketLength > 0 && systemCaptureClient_) {
-        systemCaptureClient_->GetBuffer(&systemData, &systemFrames, &systemFlags, nullptr, nullptr);
+        systemCaptureClient_->GetBuffer(&systemData, &systemFrames, &systemFlags, nullptr, &systemQpcPosition);
       }
 
       // Get microphone audio buffer
       if (micPacketLength > 0 && micCaptureClient_) {
-        micCaptureClient_->GetBuffer(&micData, &micFrames, &micFlags, nullptr, nullptr);
+        micCaptureClient_->GetBuffer(&micData, &micFrames, &micFlags, nullptr, &micQpcPosition);
       }
 
-      // Mix audio buffers and send to Dart
+      // Mix audio buffers and send to Dart, running only the stages whose
+      // output has a consumer
       if (systemData || micData) {
+        PipelineDemand demand = GetPipelineDemand();
+        bool wantConvert = IsDemanded(demand, PipelineStage::CONVERT);
+        bool wantAudio = IsDemanded(demand, PipelineStage::DELIVER);
+        bool wantMeter = IsDemanded(demand, PipelineStage::METER);
+        bool wantRecord = IsDemanded(demand, PipelineStage::RECORD);
+        bool wantPreRoll = IsDemanded(demand, PipelineStage::PREROLL);
+        bool wantSpectrum = IsDemanded(demand, PipelineStage::SPECTRUM);
+        bool wantFeatures = IsDemanded(demand, PipelineStage::FEATURES);
+        bool wantVad = IsDemanded(demand, PipelineStage::VAD);
+
+        // Each source is metered inside the mix, before the sources are
+        // summed. An analysis-only session (meter, spectrum, features)
+        // still converts channels so levels match, but skips resampling.
+        // Resampled audio is metered during its conversion back to 16-bit,
+        // so the samples are read once.
         std::vector<BYTE> mixedBuffer;
-        MixAudioBuffers(systemData, micData, systemFrames, micFrames, mixedBuffer);
-
-        if (!mixedBuffer.empty()) {
-          std::lock_guard<std::mutex> lock(eventSinkMutex_);
-          if (eventSink_) {
-            // Convert std::vector<BYTE> to std::vector<uint8_t> for Flutter
-            std::vector<uint8_t> flutterBuffer(mixedBuffer.begin(), mixedBuffer.end());
-            eventSink_->Success(flutter::EncodableValue(flutterBuffer));
+        std::vector<BYTE> deliveryBuffer;  // Deeper output than mixedBuffer holds
+        meterLevels_.clear();
+        if (demand != 0) {
+          // 24-bit and 32-bit integer packets become float once, here;
+          // every stage after this reads the float copy
+          engine_.Widen(systemData, systemFrames, micData, micFrames);
+
+          EngineMeters meters;
+          if (wantMeter) {
+            meters.system = &systemMeter_;
+            meters.mic = &micMeter_;
+            meters.output = &meter_;
+            meters.levels = &meterLevels_;
+          }
+          engine_.Process(systemData, systemFrames, micData, micFrames, wantConvert, meters, mixedBuffer,
+                          deliveryBuffer);
+        }
+        pipelineStats_.Record(PipelineStage::MIX, demand != 0);
+        pipelineStats_.Record(PipelineStage::AEC, demand != 0 && engine_.echoCanceller());
+        pipelineStats_.Record(PipelineStage::DENOISE,
+                              demand != 0 && (engine_.micSuppressor() || engine_.systemSuppressor()));
+        pipelineStats_.Record(PipelineStage::CONVERT, wantConvert);
+
+        // Analysis-only sessions skip resampling, so the rate can be the device's
+        uint32_t bufferRate = wantConvert ? audioConfig_.sampleRate : deviceConfig_.sampleRate;
+
+        // Calculate and send volume update if somebody is listening
+        if (wantMeter && !mixedBuffer.empty() && meter_.channels() == audioConfig_.channels) {
+          const int16_t* samples = reinterpret_cast<const int16_t*>(mixedBuffer.data());
+          size_t frames = mixedBuffer.size() / (audioConfig_.channels * 2);
+          if (meterLevels_.empty()) {
+            meter_.Measure(samples, frames, meterLevels_);
+          }
+          MeterLoudness(samples, frames, bufferRate);
+
+          // Packets are aggregated; an update goes out once per meter
+          // interval of audio
+          meterAccumulator_.Add(meterLevels_, frames);
+          if (systemData) {
+            systemMeter_.Finish(systemFrames, sourceLevels_);
+            systemAccumulator_.Add(sourceLevels_, systemFrames);
+          }
+          if (micData) {
+            micMeter_.Finish(micFrames, sourceLevels_);
+            micAccumulator_.Add(sourceLevels_, micFrames);
+          }
+          if (meterAccumulator_.frames() >= static_cast<uint64_t>(meterIntervalMs_) * bufferRate / 1000) {
+            SendVolumeUpdate();
+          }
+        } else if (!wantMeter) {
+          meterAccumulator_.Clear();
+          systemAccumulator_.Clear();
+          micAccumulator_.Clear();
+        }
+        pipelineStats_.Record(PipelineStage::METER, wantMeter);
+
+        if (wantSpectrum && !mixedBuffer.empty()) {
+          AnalyzeSpectrum(reinterpret_cast<const int16_t*>(mixedBuffer.data()),
+                          mixedBuffer.size() / (audioConfig_.channels * 2), bufferRate);
+        }
+        pipelineStats_.Record(PipelineStage::SPECTRUM, wantSpectrum);
+
+        if (wantFeatures && !mixedBuffer.empty()) {
+          ExtractFeatures(reinterpret_cast<const int16_t*>(mixedBuffer.data()),
+                          mixedBuffer.size() / (audioConfig_.channels * 2), bufferRate);
+        }
+        pipelineStats_.Record(PipelineStage::FEATURES, wantFeatures);
+
+        // The file and pre-roll hold the delivered samples; peaks are
+        // measured on the 16-bit mix
+        const std::vector<BYTE>& recorded = deliveryBuffer.empty() ? mixedBuffer : deliveryBuffer;
+
+        // The file gets every processed frame, independent of chunking
+        if (wantRecord && !mixedBuffer.empty()) {
+          std::lock_guard<std::mutex> lock(fileSinkMutex_);
+          if (fileSink_) {
+            fileSink_->Write(recorded.data(), recorded.size());
+          }
+          if (filePeaks_) {
+            filePeaks_->Push(reinterpret_cast<const int16_t*>(mixedBuffer.data()),
+                             mixedBuffer.size() / (audioConfig_.channels * 2));
+          }
+        }
+        pipelineStats_.Record(PipelineStage::RECORD, wantRecord);
+
+        if (wantPreRoll && !mixedBuffer.empty()) {
+          std::lock_guard<std::mutex> lock(preRollMutex_);
+          if (preRoll_) {
+            preRoll_->Write(recorded.data(), recorded.size());
+          }
+        }
+        pipelineStats_.Record(PipelineStage::PREROLL, wantPreRoll);
+
+        // The detector hears the microphone after echo cancellation and
+        // noise suppression
+        const BYTE* vadMicData = engine_.CleanedMic(micData);
+        bool speech = wantVad && DetectSpeech(vadMicData, micFrames, mixedBuffer, bufferRate);
+        pipelineStats_.Record(PipelineStage::VAD, wantVad);
+
+        if (wantAudio && !mixedBuffer.empty()) {
+          std::vector<BYTE>& delivered = deliveryBuffer.empty() ? mixedBuffer : deliveryBuffer;
+          int64_t captureTime = 0;
+          uint16_t packetFlags = 0;
+          if (packetizer_.enabled()) {
+            // The system stream drives the mix timeline; fall back to the
+            // microphone, then to the current time.
+            captureTime = systemData ? static_cast<int64_t>(systemQpcPosition)
+                        : micData ? static_cast<int64_t>(micQpcPosition) : 0;
+            if (captureTime == 0) {
+              captureTime = QpcNow100ns();
+            }
+
+            DWORD combinedFlags = (systemData ? systemFlags : 0) | (micData ? micFlags : 0);
+            bool silent = (!systemData || (systemFlags & AUDCLNT_BUFFERFLAGS_SILENT)) &&
+                          (!micData || (micFlags & AUDCLNT_BUFFERFLAGS_SILENT));
+
+            if (silent) packetFlags |= AUDIO_PACKET_SILENT;
+            if (combinedFlags & AUDCLNT_BUFFERFLAGS_DATA_DISCONTINUITY) packetFlags |= AUDIO_PACKET_DISCONTINUITY;
+            if (combinedFlags & AUDCLNT_BUFFERFLAGS_TIMESTAMP_ERROR) packetFlags |= AUDIO_PACKET_TIMESTAMP_ERROR;
+          }
+          // Only delivery is tagged and gated; the file and pre-roll keep
+          // every frame
+          if (speech) packetFlags |= AUDIO_PACKET_SPEECH;
+          float speechProbability = wantVad ? speechProbability_.load() : -1.0f;
+
+          if (wantVad && speechGate_.enabled()) {
+            bool segmentEnded = speechGate_.Push(
+                delivered, captureTime, packetFlags, speechProbability, speech,
+                [this](std::vector<uint8_t>& audio, int64_t time, uint16_t flags, float probability) {
+                  DeliverCapturedAudio(audio, time, flags, probability);
+                });
+            // Don't leave the end of an utterance waiting in a coalescing
+            // chunker; fixed frames would need padding, so they wait
+            if (segmentEnded && !flacEncoder_ && !adpcmEncoder_ && chunker_.enabled() &&
+                !chunker_.exactFrames()) {
+              FlushChunker();
+            }
+            vadPassedBytes_ = speechGate_.passedBytes();
+            vadSuppressedBytes_ = speechGate_.suppressedBytes();
+          } else {
+            DeliverCapturedAudio(delivered, captureTime, packetFlags, speechProbability);
+          }
+        } else if (!wantAudio) {
+          // Don't glue stale audio to whatever comes after the gap
+          if (flacEncoder_) {
+            packetizer_.Discard(flacEncoder_->DiscardPending() * audioConfig_.channels * 2);
+          } else if (adpcmEncoder_) {
+            packetizer_.Discard(adpcmEncoder_->DiscardPending() * audioConfig_.channels * 2);
+          } else {
+            packetizer_.Discard(chunker_.pendingBytes());
           }
+          chunker_.Reset();
+          speechGate_.Reset();
         }
+        pipelineStats_.Record(PipelineStage::DELIVER, wantAudio);
       }
 
       // Release buffers
@@ -654,169 +1386,65 @@ void WindowsLoopbackRecorderPlugin::CaptureThreadFunction() {
   }
 }
 
-void WindowsLoopbackRecorderPlugin::MixAudioBuffers(const BYTE* systemBuffer, const BYTE* micBuffer,
-                                                   UINT32 systemFrames, UINT32 micFrames,
-                                                   std::vector<BYTE>& outputBuffer) {
-  if (!systemWaveFormat_) {
-    return;
-  }
-
-  // Use the actual system audio format parameters
-  UINT32 bytesPerFrame = systemWaveFormat_->nBlockAlign;
-  UINT32 maxFrames = (systemFrames > micFrames) ? systemFrames : micFrames;
-  UINT32 bufferSize = maxFrames * bytesPerFrame;
-
-  outputBuffer.resize(bufferSize);
-  std::fill(outputBuffer.begin(), outputBuffer.end(), BYTE(0));
-
-  // Handle different audio formats
-  if (systemWaveFormat_->wBitsPerSample == 16) {
-    // 16-bit PCM
-    UINT32 bytesPerSample = 2;
+PipelineDemand WindowsLoopbackRecorderPlugin::GetPipelineDemand() {
+  PipelineDemand demand = 0;
 
-    // Mix system audio (if available)
-    if (systemBuffer && systemFrames > 0) {
-      for (UINT32 frame = 0; frame < systemFrames && frame < maxFrames; frame++) {
-        for (UINT32 channel = 0; channel < systemWaveFormat_->nChannels; channel++) {
-          UINT32 sampleIndex = frame * systemWaveFormat_->nChannels + channel;
-          UINT32 byteIndex = sampleIndex * bytesPerSample;
-
-          if (byteIndex + 1 < bufferSize) {
-            int16_t sample = *reinterpret_cast<const int16_t*>(&systemBuffer[byteIndex]);
-            int16_t* outputSample = reinterpret_cast<int16_t*>(&outputBuffer[byteIndex]);
-            *outputSample = sample; // Preserve full system audio quality
-          }
-        }
+  {
+    std::lock_guard<std::mutex> lock(eventSinkMutex_);
+    if (eventSink_ || audioPort_) {
+      demand |= DemandBit(PipelineStage::MIX) | DemandBit(PipelineStage::CONVERT) |
+                DemandBit(PipelineStage::DELIVER);
+      if (vadEnabled_) {
+        demand |= DemandBit(PipelineStage::VAD);
       }
     }
+  }
 
-    // Add microphone audio (if available)
-    if (micBuffer && micFrames > 0 && micWaveFormat_) {
-      UINT32 minChannels = (micWaveFormat_->nChannels < systemWaveFormat_->nChannels) ? micWaveFormat_->nChannels : systemWaveFormat_->nChannels;
-      for (UINT32 frame = 0; frame < micFrames && frame < maxFrames; frame++) {
-        for (UINT32 channel = 0; channel < minChannels; channel++) {
-          UINT32 micSampleIndex = frame * micWaveFormat_->nChannels + channel;
-          UINT32 micByteIndex = micSampleIndex * bytesPerSample;
-
-          UINT32 outputSampleIndex = frame * systemWaveFormat_->nChannels + channel;
-          UINT32 outputByteIndex = outputSampleIndex * bytesPerSample;
-
-          if (micByteIndex + 1 < micFrames * micWaveFormat_->nBlockAlign &&
-              outputByteIndex + 1 < bufferSize) {
-            int16_t micSample = *reinterpret_cast<const int16_t*>(&micBuffer[micByteIndex]);
-            int16_t* outputSample = reinterpret_cast<int16_t*>(&outputBuffer[outputByteIndex]);
-
-            // Safe mixing: prevent overflow by using 32-bit arithmetic and clamping
-            int32_t mixed = static_cast<int32_t>(*outputSample) + static_cast<int32_t>(micSample);
-            if (mixed > 32767) mixed = 32767;
-            if (mixed < -32768) mixed = -32768;
-            *outputSample = static_cast<int16_t>(mixed);
-          }
-        }
-      }
+  {
+    std::lock_guard<std::mutex> lock(fileSinkMutex_);
+    if (fileSink_) {
+      demand |= DemandBit(PipelineStage::MIX) | DemandBit(PipelineStage::CONVERT) |
+                DemandBit(PipelineStage::RECORD);
     }
+  }
 
-    // Note: We don't update audioConfig_ here as it contains user preferences
-    // The actual device format is stored in deviceConfig_
-
-  } else if (systemWaveFormat_->wBitsPerSample == 32) {
-    // 32-bit float (common on modern Windows)
-    // Convert to 16-bit for consistency
-    UINT32 outputSize = maxFrames * systemWaveFormat_->nChannels * 2; // 16-bit output
-    outputBuffer.resize(outputSize);
-
-    if (systemBuffer && systemFrames > 0) {
-      for (UINT32 frame = 0; frame < systemFrames && frame < maxFrames; frame++) {
-        for (UINT32 channel = 0; channel < systemWaveFormat_->nChannels; channel++) {
-          UINT32 floatSampleIndex = frame * systemWaveFormat_->nChannels + channel;
-          UINT32 floatByteIndex = floatSampleIndex * 4; // 4 bytes per float
-
-          UINT32 outputSampleIndex = frame * systemWaveFormat_->nChannels + channel;
-          UINT32 outputByteIndex = outputSampleIndex * 2; // 2 bytes per 16-bit sample
-
-          if (floatByteIndex + 3 < systemFrames * systemWaveFormat_->nBlockAlign &&
-              outputByteIndex + 1 < outputBuffer.size()) {
-            float floatSample = *reinterpret_cast<const float*>(&systemBuffer[floatByteIndex]);
-            // Convert float (-1.0 to 1.0) to 16-bit PCM (-32768 to 32767)
-            // Preserve full dynamic range for better audio quality
-            int16_t pcmSample = static_cast<int16_t>(floatSample * 32767.0f);
-            *reinterpret_cast<int16_t*>(&outputBuffer[outputByteIndex]) = pcmSample;
-          }
-        }
-      }
+  {
+    std::lock_guard<std::mutex> lock(preRollMutex_);
+    if (preRoll_) {
+      demand |= DemandBit(PipelineStage::MIX) | DemandBit(PipelineStage::CONVERT) |
+                DemandBit(PipelineStage::PREROLL);
     }
+  }
 
-    // Add microphone (assuming 16-bit or also convert if float)
-    if (micBuffer && micFrames > 0 && micWaveFormat_) {
-      UINT32 minChannels = (micWaveFormat_->nChannels < systemWaveFormat_->nChannels) ? micWaveFormat_->nChannels : systemWaveFormat_->nChannels;
-      for (UINT32 frame = 0; frame < micFrames && frame < maxFrames; frame++) {
-        for (UINT32 channel = 0; channel < minChannels; channel++) {
-          UINT32 outputSampleIndex = frame * systemWaveFormat_->nChannels + channel;
-          UINT32 outputByteIndex = outputSampleIndex * 2;
-
-          if (outputByteIndex + 1 < outputBuffer.size()) {
-            int16_t micSample;
-
-            if (micWaveFormat_->wBitsPerSample == 16) {
-              UINT32 micSampleIndex = frame * micWaveFormat_->nChannels + channel;
-              UINT32 micByteIndex = micSampleIndex * 2;
-              if (micByteIndex + 1 < micFrames * micWaveFormat_->nBlockAlign) {
-                micSample = *reinterpret_cast<const int16_t*>(&micBuffer[micByteIndex]);
-              } else {
-                micSample = 0;
-              }
-            } else if (micWaveFormat_->wBitsPerSample == 32) {
-              UINT32 micSampleIndex = frame * micWaveFormat_->nChannels + channel;
-              UINT32 micByteIndex = micSampleIndex * 4;
-              if (micByteIndex + 3 < micFrames * micWaveFormat_->nBlockAlign) {
-                float micFloatSample = *reinterpret_cast<const float*>(&micBuffer[micByteIndex]);
-                micSample = static_cast<int16_t>(micFloatSample * 32767.0f);
-              } else {
-                micSample = 0;
-              }
-            } else {
-              micSample = 0;
-            }
-
-            int16_t* outputSample = reinterpret_cast<int16_t*>(&outputBuffer[outputByteIndex]);
-
-            // Safe mixing: prevent overflow by using 32-bit arithmetic and clamping
-            int32_t mixed = static_cast<int32_t>(*outputSample) + static_cast<int32_t>(micSample);
-            if (mixed > 32767) mixed = 32767;
-            if (mixed < -32768) mixed = -32768;
-            *outputSample = static_cast<int16_t>(mixed);
-          }
-        }
-      }
+  if (volumeMonitoringEnabled_) {
+    std::lock_guard<std::mutex> lock(volumeEventSinkMutex_);
+    if (volumeEventSink_) {
+      demand |= DemandBit(PipelineStage::MIX) | DemandBit(PipelineStage::METER);
     }
+  }
 
-    // Note: We don't update audioConfig_ here as it contains user preferences
-    // The actual device format is stored in deviceConfig_
-  } else {
-    // Unsupported format, just copy system audio
-    if (systemBuffer && systemFrames > 0) {
-      UINT32 sourceSize = systemFrames * bytesPerFrame;
-      UINT32 copySize = (sourceSize < bufferSize) ? sourceSize : bufferSize;
-      std::memcpy(outputBuffer.data(), systemBuffer, copySize);
+  if (spectrumEnabled_) {
+    std::lock_guard<std::mutex> lock(spectrumEventSinkMutex_);
+    if (spectrumEventSink_) {
+      demand |= DemandBit(PipelineStage::MIX) | DemandBit(PipelineStage::SPECTRUM);
     }
   }
 
-  // Apply user-defined audio format processing (resampling, channel conversion)
-  ProcessAudioFormat(outputBuffer);
-
-  // Calculate and send volume update if monitoring is enabled
-  if (volumeMonitoringEnabled_ && !outputBuffer.empty()) {
-    double rms = CalculateRMS(outputBuffer);
-    SendVolumeUpdate(rms);
+  if (featuresEnabled_) {
+    std::lock_guard<std::mutex> lock(featureEventSinkMutex_);
+    if (featureEventSink_) {
+      demand |= DemandBit(PipelineStage::MIX) | DemandBit(PipelineStage::FEATURES);
+    }
   }
+
+  return demand;
 }
 
 // Audio processing methods implementation
-bool WindowsLoopbackRecorderPlugin::InitializeResampler() {
-  // Clean up existing resampler if any
-  CleanupResampler();
+bool WindowsLoopbackRecorderPlugin::ConfigureEngine() {
+  // Release the previous session's engine, if any
+  ReleaseEngine();
 
-  // Check if resampling is needed
   if (!systemWaveFormat_) {
     return false;
   }
@@ -853,285 +1481,611 @@ bool WindowsLoopbackRecorderPlugin::InitializeResampler() {
   deviceConfig_ = newDeviceConfig;
   lastDeviceConfig = newDeviceConfig;
 
-  // Check if resampling is necessary
-  resamplingEnabled_ = (deviceConfig_.sampleRate != audioConfig_.sampleRate) ||
-                      (deviceConfig_.channels != audioConfig_.channels);
-
-  if (resamplingEnabled_) {
-    printf("Initializing resampler: %dHz/%dch -> %dHz/%dch\n",
-           deviceConfig_.sampleRate, deviceConfig_.channels,
-           audioConfig_.sampleRate, audioConfig_.channels);
-
-    // Create libsamplerate resampler for the target channel count
-    int error;
-    srcState_ = src_new(SRC_SINC_MEDIUM_QUALITY, audioConfig_.channels, &error);
-    if (error != 0) {
-      printf("Resampler initialization failed: %s\n", src_strerror(error));
-      srcState_ = nullptr;
-      return false;
-    }
-
-    // Warm up the resampler with a small amount of silence to stabilize
-    std::vector<float> warmupData(audioConfig_.channels * 64, 0.0f);
-    SRC_DATA warmupSrcData;
-    warmupSrcData.data_in = warmupData.data();
-    warmupSrcData.input_frames = 64;
-    warmupSrcData.data_out = warmupData.data();
-    warmupSrcData.output_frames = 64;
-    warmupSrcData.src_ratio = 1.0;
-    warmupSrcData.end_of_input = 0;
-    src_process(srcState_, &warmupSrcData);
+  EngineConfig config;
+  config.systemFormat = ParseSampleFormat(reinterpret_cast<const uint8_t*>(systemWaveFormat_),
+                                          sizeof(WAVEFORMATEX) + systemWaveFormat_->cbSize);
+  config.systemRate = systemWaveFormat_->nSamplesPerSec;
+  config.systemChannels = systemWaveFormat_->nChannels;
+  config.systemBlockAlign = systemWaveFormat_->nBlockAlign;
+  if (micWaveFormat_) {
+    config.micFormat = ParseSampleFormat(reinterpret_cast<const uint8_t*>(micWaveFormat_),
+                                         sizeof(WAVEFORMATEX) + micWaveFormat_->cbSize);
+    config.micRate = micWaveFormat_->nSamplesPerSec;
+    config.micChannels = micWaveFormat_->nChannels;
+  }
+  config.outputRate = audioConfig_.sampleRate;
+  config.outputChannels = static_cast<uint16_t>(audioConfig_.channels);
+  if (audioConfig_.bitsPerSample == 24) {
+    config.outputFormat = SampleFormat::PCM24;
+  } else if (audioConfig_.bitsPerSample == 32) {
+    config.outputFormat = audioConfig_.floatSamples ? SampleFormat::FLOAT32 : SampleFormat::PCM32;
+  }
+  if (audioConfig_.dither <= static_cast<UINT32>(DitherMode::SHAPED)) {
+    config.dither = static_cast<DitherMode>(audioConfig_.dither);
+  }
+  config.encoded = audioConfig_.encoding >= static_cast<UINT32>(OutputEncoding::FLAC) &&
+                   audioConfig_.encoding <= static_cast<UINT32>(OutputEncoding::IMA_ADPCM);
+  config.echoCancellation = audioConfig_.echoCancellation;
+  config.echoTailMs = audioConfig_.echoTailMs;
+  config.micNoiseSuppression = audioConfig_.micNoiseSuppression;
+  config.systemNoiseSuppression = audioConfig_.systemNoiseSuppression;
+  config.noiseSuppressionDb = static_cast<float>(audioConfig_.noiseSuppressionDb);
+  if (!engine_.Configure(config)) {
+    DebugOutput("Audio engine initialization failed for %dHz/%dch -> %dHz/%dch",
+                deviceConfig_.sampleRate, deviceConfig_.channels, audioConfig_.sampleRate, audioConfig_.channels);
+    return false;
+  }
 
-    printf("Resampler initialized and warmed up successfully\n");
+  // Report what the formats did not allow, and settle audioConfig_ to what
+  // is delivered
+  if (engine_.converting()) {
+    DebugOutput("Converting %dHz/%dch -> %dHz/%dch", deviceConfig_.sampleRate, deviceConfig_.channels,
+                audioConfig_.sampleRate, audioConfig_.channels);
+  }
+  if (engine_.kernels().widenSystem || engine_.kernels().widenMic) {
+    DebugOutput("Integer capture formats are widened to float as they arrive");
+  }
+  SampleFormat outputFormat = engine_.outputFormat();
+  if (outputFormat != config.outputFormat) {
+    DebugOutput("%u-bit output unavailable; delivering 16-bit", audioConfig_.bitsPerSample);
+  }
+  audioConfig_.bitsPerSample = outputFormat == SampleFormat::PCM16 ? 16
+                             : outputFormat == SampleFormat::PCM24 ? 24 : 32;
+  audioConfig_.floatSamples = outputFormat == SampleFormat::FLOAT32;
+  audioConfig_.dither = static_cast<UINT32>(engine_.dither());
+  if (engine_.fastPath()) {
+    DebugOutput("Using the fused 48 kHz stereo to 16 kHz mono path");
+  }
+  if (audioConfig_.echoCancellation && !engine_.echoCanceller()) {
+    DebugOutput("Echo cancellation unavailable: microphone and loopback formats differ or the %u ms tail is not supported",
+                audioConfig_.echoTailMs);
+  }
+  if (audioConfig_.micNoiseSuppression && !engine_.micSuppressor()) {
+    DebugOutput("Noise suppression unavailable for the microphone");
+  }
+  if (audioConfig_.systemNoiseSuppression && !engine_.systemSuppressor()) {
+    DebugOutput("Noise suppression unavailable for the system audio");
   }
 
   return true;
 }
 
-void WindowsLoopbackRecorderPlugin::CleanupResampler() {
-  if (srcState_) {
-    // Force reset the resampler state to clear any internal buffers
-    src_reset(srcState_);
-    src_delete(srcState_);
-    srcState_ = nullptr;
-  }
-  resamplingEnabled_ = false;
+void WindowsLoopbackRecorderPlugin::ReleaseEngine() {
+  engine_.Clear();
 
-  // Clear any cached resampling parameters to force recalculation
+  // Clear any cached device format to force recalculation
   deviceConfig_ = AudioConfig();
 
   // Reset format change detection for next recording session
   g_resetFormatDetection = true;
 }
 
-bool WindowsLoopbackRecorderPlugin::ProcessAudioFormat(std::vector<BYTE>& audioBuffer) {
-  if (!resamplingEnabled_) {
-    return true; // No processing needed
+// Volume monitoring methods implementation
+void WindowsLoopbackRecorderPlugin::SendVolumeUpdate() {
+  if (!volumeMonitoringEnabled_) {
+    meterAccumulator_.Clear();
+    systemAccumulator_.Clear();
+    micAccumulator_.Clear();
+    return;
   }
 
-  try {
-    // Step 1: Convert channels if necessary
-    if (deviceConfig_.channels != audioConfig_.channels) {
-      audioBuffer = ConvertChannels(audioBuffer);
-    }
-
-    // Step 2: Resample if necessary
-    if (deviceConfig_.sampleRate != audioConfig_.sampleRate) {
-      audioBuffer = ResampleAudio(audioBuffer);
-    }
+  std::vector<ChannelLevels> channels;
+  std::vector<ChannelLevels> systemChannels;
+  std::vector<ChannelLevels> micChannels;
+  meterAccumulator_.Take(channels);
+  systemAccumulator_.Take(systemChannels);
+  micAccumulator_.Take(micChannels);
+  double elapsedMs = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - recordingStartTime_).count();
+  std::vector<float> frame = BuildMeterFrame(elapsedMs, AudioMeter::Combine(channels),
+                                             loudness_.reading(), channels, systemChannels, micChannels);
 
-    return true;
-  } catch (...) {
-    return false;
+  std::lock_guard<std::mutex> lock(volumeEventSinkMutex_);
+  if (volumeEventSink_) {
+    // Arrives in Dart as a Float32List
+    volumeEventSink_->Success(flutter::EncodableValue(std::move(frame)));
   }
 }
 
-std::vector<BYTE> WindowsLoopbackRecorderPlugin::ResampleAudio(const std::vector<BYTE>& inputBuffer) {
-  if (!srcState_ || deviceConfig_.sampleRate == audioConfig_.sampleRate) {
-    return inputBuffer;
+void WindowsLoopbackRecorderPlugin::MeterLoudness(const int16_t* samples, size_t frames, uint32_t sampleRate) {
+  if (loudnessRate_ != sampleRate) {
+    loudness_.Configure(sampleRate, static_cast<uint16_t>(audioConfig_.channels));
+    loudnessRate_ = sampleRate;
+    loudnessResetRequested_ = false;
+  } else if (loudnessResetRequested_.exchange(false)) {
+    loudness_.Reset();
   }
+  loudness_.Process(samples, frames);
+}
 
-  // Convert to float for libsamplerate
-  std::vector<float> floatInput = ConvertToFloat(inputBuffer);
+bool WindowsLoopbackRecorderPlugin::StartVolumeMonitoring(uint32_t intervalMs) {
+  meterIntervalMs_ = intervalMs;
+  volumeMonitoringEnabled_ = true;
+  return true;
+}
 
-  // Calculate output size
-  double ratio = static_cast<double>(audioConfig_.sampleRate) / deviceConfig_.sampleRate;
-  size_t inputFrames = floatInput.size() / audioConfig_.channels;
-  size_t maxOutputFrames = static_cast<size_t>(inputFrames * ratio) + 1024;
+bool WindowsLoopbackRecorderPlugin::StopVolumeMonitoring() {
+  volumeMonitoringEnabled_ = false;
+  return true;
+}
 
-  std::vector<float> floatOutput(maxOutputFrames * audioConfig_.channels);
+// Spectrum stream methods implementation
+bool WindowsLoopbackRecorderPlugin::StartSpectrum(const SpectrumOptions& options) {
+  if (!RealFft::IsValidSize(options.fftSize) || options.bands == 0 ||
+      options.bands > SpectrumAnalyzer::kMaxBands || !(options.minHz > 0.0) ||
+      !(options.minHz < options.maxHz)) {
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(spectrumMutex_);
+    spectrumOptions_ = options;
+  }
+  spectrumReconfigure_ = true;
+  spectrumEnabled_ = true;
+  return true;
+}
 
-  // Setup SRC data structure
-  SRC_DATA srcData;
-  srcData.data_in = floatInput.data();
-  srcData.input_frames = inputFrames;
-  srcData.data_out = floatOutput.data();
-  srcData.output_frames = maxOutputFrames;
-  srcData.src_ratio = ratio;
-  srcData.end_of_input = 0;
+void WindowsLoopbackRecorderPlugin::StopSpectrum() {
+  spectrumEnabled_ = false;
+}
 
-  // Process resampling using libsamplerate
-  int error = src_process(srcState_, &srcData);
-  if (error != 0) {
-    return inputBuffer; // Return original on error
+void WindowsLoopbackRecorderPlugin::AnalyzeSpectrum(const int16_t* samples, size_t frames, uint32_t sampleRate) {
+  if (spectrumRate_ != sampleRate || spectrumReconfigure_.exchange(false)) {
+    SpectrumOptions options;
+    {
+      std::lock_guard<std::mutex> lock(spectrumMutex_);
+      options = spectrumOptions_;
+    }
+    if (!spectrum_.Configure(sampleRate, static_cast<uint16_t>(audioConfig_.channels), options.fftSize,
+                             options.bands, static_cast<float>(options.minHz), static_cast<float>(options.maxHz))) {
+      DebugOutput("Spectrum unavailable at %u Hz from %.0f Hz", sampleRate, options.minHz);
+    }
+    spectrumRate_ = sampleRate;
+    spectrumIntervalMs_ = options.intervalMs;
+    spectrumPendingFrames_ = 0;
   }
 
-  // Resize to actual output
-  floatOutput.resize(srcData.output_frames_gen * audioConfig_.channels);
+  // The analyzer keeps the last fftSize samples; a transform runs once per
+  // interval of audio, whatever the packet size
+  spectrum_.Push(samples, frames);
+  spectrumPendingFrames_ += frames;
+  if (spectrumPendingFrames_ < static_cast<uint64_t>(spectrumIntervalMs_) * sampleRate / 1000) {
+    return;
+  }
+  spectrumPendingFrames_ = 0;
+  if (!spectrum_.Analyze(spectrumBands_)) {
+    return;
+  }
 
-  // Convert back to BYTE
-  return ConvertFromFloat(floatOutput);
+  double elapsedMs = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - recordingStartTime_).count();
+  std::vector<float> frame = BuildSpectrumFrame(elapsedMs, spectrum_, spectrumBands_);
+  std::lock_guard<std::mutex> lock(spectrumEventSinkMutex_);
+  if (spectrumEventSink_) {
+    // Arrives in Dart as a Float32List
+    spectrumEventSink_->Success(flutter::EncodableValue(std::move(frame)));
+  }
 }
 
-std::vector<BYTE> WindowsLoopbackRecorderPlugin::ConvertChannels(const std::vector<BYTE>& inputBuffer) {
-  if (deviceConfig_.channels == audioConfig_.channels) {
-    return inputBuffer;
+// Feature stream methods implementation
+bool WindowsLoopbackRecorderPlugin::StartFeatures(const FeatureStreamOptions& options) {
+  // Checked at the highest rate the options may meet; the capture thread
+  // checks again at the actual one
+  FeatureExtractor check;
+  if (!check.Configure(192000, 1, options.features) || options.rowsPerUpdate == 0 ||
+      options.rowsPerUpdate > 100) {
+    return false;
   }
+  {
+    std::lock_guard<std::mutex> lock(featureMutex_);
+    featureOptions_ = options;
+  }
+  featureReconfigure_ = true;
+  featuresEnabled_ = true;
+  return true;
+}
+
+void WindowsLoopbackRecorderPlugin::StopFeatures() {
+  featuresEnabled_ = false;
+}
 
-  // Convert bytes to int16 for processing
-  size_t inputSamples = inputBuffer.size() / 2; // Assuming 16-bit samples
-  size_t inputFrames = inputSamples / deviceConfig_.channels;
+void WindowsLoopbackRecorderPlugin::ExtractFeatures(const int16_t* samples, size_t frames, uint32_t sampleRate) {
+  if (featureRate_ != sampleRate || featureReconfigure_.exchange(false)) {
+    FeatureStreamOptions options;
+    {
+      std::lock_guard<std::mutex> lock(featureMutex_);
+      options = featureOptions_;
+    }
+    if (!features_.Configure(sampleRate, static_cast<uint16_t>(audioConfig_.channels), options.features)) {
+      DebugOutput("Features unavailable at %u Hz from %.0f Hz", sampleRate, options.features.minHz);
+    }
+    featureRate_ = sampleRate;
+    featureRowsPerUpdate_ = options.rowsPerUpdate;
+    featureFirstRow_ = 0;
+    featureRows_.clear();
+    featureRows_.reserve((featureRowsPerUpdate_ + 1) * features_.valuesPerRow());
+  }
 
-  const int16_t* inputData = reinterpret_cast<const int16_t*>(inputBuffer.data());
+  features_.Push(samples, frames, featureRows_);
+  size_t valuesPerRow = features_.valuesPerRow();
+  if (valuesPerRow == 0 || featureRows_.size() < featureRowsPerUpdate_ * valuesPerRow) {
+    return;
+  }
 
-  std::vector<int16_t> outputData;
+  std::vector<float> frame = BuildFeatureFrame(featureFirstRow_, features_, featureRows_);
+  featureFirstRow_ += featureRows_.size() / valuesPerRow;
+  featureRows_.clear();
+  std::lock_guard<std::mutex> lock(featureEventSinkMutex_);
+  if (featureEventSink_) {
+    // Arrives in Dart as a Float32List
+    featureEventSink_->Success(flutter::EncodableValue(std::move(frame)));
+  }
+}
 
-  if (deviceConfig_.channels == 2 && audioConfig_.channels == 1) {
-    // Stereo to mono: mix left and right channels
-    outputData.resize(inputFrames);
-    for (size_t frame = 0; frame < inputFrames; frame++) {
-      int32_t mixed = static_cast<int32_t>(inputData[frame * 2]) +
-                     static_cast<int32_t>(inputData[frame * 2 + 1]);
-      outputData[frame] = static_cast<int16_t>(mixed / 2);
+// Voice activity detection methods implementation
+bool WindowsLoopbackRecorderPlugin::StartVad(const VadOptions& options) {
+  if (!(options.threshold > 0.0f && options.threshold < 1.0f) || options.hangoverMs > 10000 ||
+      options.paddingMs > 10000) {
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(vadMutex_);
+    vadOptions_ = options;
+  }
+  vadReconfigure_ = true;
+  vadEnabled_ = true;
+  return true;
+}
+
+void WindowsLoopbackRecorderPlugin::StopVad() {
+  vadEnabled_ = false;
+  speaking_ = false;
+  speechProbability_ = -1.0f;
+  micSpeechProbability_ = -1.0f;
+}
+
+bool WindowsLoopbackRecorderPlugin::DetectSpeech(const BYTE* micData, UINT32 micFrames,
+                                                 const std::vector<BYTE>& mixedBuffer, uint32_t sampleRate) {
+  if (vadRate_ != sampleRate || vadReconfigure_.exchange(false)) {
+    VadOptions options;
+    {
+      std::lock_guard<std::mutex> lock(vadMutex_);
+      options = vadOptions_;
     }
-  } else if (deviceConfig_.channels == 1 && audioConfig_.channels == 2) {
-    // Mono to stereo: duplicate mono channel
-    outputData.resize(inputFrames * 2);
-    for (size_t frame = 0; frame < inputFrames; frame++) {
-      outputData[frame * 2] = inputData[frame];
-      outputData[frame * 2 + 1] = inputData[frame];
+    if (!mixVad_.Configure(sampleRate, static_cast<uint16_t>(audioConfig_.channels), options)) {
+      DebugOutput("Voice activity detection unavailable at %u Hz", sampleRate);
     }
-  } else {
-    // For other channel conversions, just copy as much as possible
-    size_t outputFrames = inputFrames;
-    size_t outputSamples = outputFrames * audioConfig_.channels;
-    outputData.resize(outputSamples, 0);
-
-    size_t minChannels = (deviceConfig_.channels < audioConfig_.channels) ? deviceConfig_.channels : audioConfig_.channels;
-    for (size_t frame = 0; frame < outputFrames; frame++) {
-      for (size_t ch = 0; ch < minChannels; ch++) {
-        outputData[frame * audioConfig_.channels + ch] =
-            inputData[frame * deviceConfig_.channels + ch];
-      }
+    // The microphone is judged before the mix, so loud system audio cannot
+    // hide the user talking over it
+    if (!micWaveFormat_ ||
+        !micVad_.Configure(micWaveFormat_->nSamplesPerSec, micWaveFormat_->nChannels, options)) {
+      micSpeechProbability_ = -1.0f;
+    }
+    speechGate_.Configure(options.gate, sampleRate, audioConfig_.channels * engine_.bytesPerSample(),
+                          options.paddingMs);
+    vadPassedBytes_ = 0;
+    vadSuppressedBytes_ = 0;
+    vadRate_ = sampleRate;
+  }
+
+  if (micData && micVad_.configured()) {
+    if (engine_.kernels().micBits == 16) {
+      micVad_.Process(reinterpret_cast<const int16_t*>(micData), micFrames);
+    } else if (engine_.kernels().micBits == 32) {
+      micVad_.Process(reinterpret_cast<const float*>(micData), micFrames);
     }
+    micSpeechProbability_ = micVad_.probability();
+  }
+  if (!mixedBuffer.empty()) {
+    mixVad_.Process(reinterpret_cast<const int16_t*>(mixedBuffer.data()),
+                    mixedBuffer.size() / (audioConfig_.channels * 2));
   }
 
-  // Convert back to BYTE
-  std::vector<BYTE> result(outputData.size() * 2);
-  memcpy(result.data(), outputData.data(), result.size());
-  return result;
+  bool speech = micVad_.speech() || mixVad_.speech();
+  speechProbability_ = (std::max)(micVad_.probability(), mixVad_.probability());
+  speaking_ = speech;
+  return speech;
 }
 
-// ConvertToFloat and ConvertFromFloat methods for libsamplerate compatibility
-// libsamplerate processes audio in float format (-1.0 to 1.0)
+// Audio delivery methods implementation
+void WindowsLoopbackRecorderPlugin::DeliverCapturedAudio(std::vector<BYTE>& audioBuffer, int64_t captureTime,
+                                                         uint16_t flags, float speechProbability) {
+  if (packetizer_.enabled()) {
+    packetizer_.OnCapturedAudio(audioBuffer.size(), captureTime, flags, speechProbability);
+  }
+  EmitProcessedAudio(audioBuffer);
+}
 
-std::vector<float> WindowsLoopbackRecorderPlugin::ConvertToFloat(const std::vector<BYTE>& byteBuffer) {
-  size_t sampleCount = byteBuffer.size() / 2; // Assuming 16-bit samples
-  std::vector<float> floatBuffer(sampleCount);
+void WindowsLoopbackRecorderPlugin::EmitProcessedAudio(std::vector<BYTE>& audioBuffer) {
+  if (flacEncoder_) {
+    // Blocks are compressed on the worker pool; pick up whatever is done
+    flacEncoder_->Push(audioBuffer.data(), audioBuffer.size());
+    flacEncoder_->Collect([this](std::vector<uint8_t>& frame, uint32_t frames) {
+      QueueEncodedFrame(frame, frames);
+    });
+    return;
+  }
 
-  const int16_t* int16Data = reinterpret_cast<const int16_t*>(byteBuffer.data());
+  if (adpcmEncoder_) {
+    adpcmEncoder_->Push(audioBuffer.data(), audioBuffer.size(),
+                        [this](std::vector<uint8_t>& block, uint32_t frames) {
+                          QueueEncodedFrame(block, frames);
+                        });
+    return;
+  }
 
-  for (size_t i = 0; i < sampleCount; i++) {
-    floatBuffer[i] = static_cast<float>(int16Data[i]) / 32768.0f;
+  if (!chunker_.enabled()) {
+    QueueChunk(audioBuffer);
+    return;
   }
 
-  return floatBuffer;
+  chunker_.Push(audioBuffer.data(), audioBuffer.size(),
+                [this](std::vector<uint8_t>& chunk) { QueueChunk(chunk); });
 }
 
-std::vector<BYTE> WindowsLoopbackRecorderPlugin::ConvertFromFloat(const std::vector<float>& floatBuffer) {
-  std::vector<BYTE> byteBuffer(floatBuffer.size() * 2);
-  int16_t* int16Data = reinterpret_cast<int16_t*>(byteBuffer.data());
+void WindowsLoopbackRecorderPlugin::QueueChunk(std::vector<BYTE>& chunk, uint16_t extraFlags) {
+  if (companding_) {
+    // One byte per sample, encoded over the PCM it replaces
+    uint32_t frames = static_cast<uint32_t>(chunk.size() / (audioConfig_.channels * 2));
+    size_t samples = chunk.size() / 2;
+    EncodeG711(g711Law_, chunk.data(), samples, chunk.data());
+    chunk.resize(samples);
+    QueueEncodedFrame(chunk, frames, extraFlags);
+    return;
+  }
+  if (packetizer_.enabled()) {
+    packetizer_.Stamp(chunk, extraFlags);
+  }
+  deliveryQueue_.Push(std::move(chunk));
+}
 
-  for (size_t i = 0; i < floatBuffer.size(); i++) {
-    // Clamp and convert float to int16
-    float sample = floatBuffer[i];
-    if (sample > 1.0f) sample = 1.0f;
-    if (sample < -1.0f) sample = -1.0f;
-    int16Data[i] = static_cast<int16_t>(sample * 32767.0f);
+void WindowsLoopbackRecorderPlugin::QueueEncodedFrame(std::vector<BYTE>& frame, uint32_t frames,
+                                                      uint16_t extraFlags) {
+  if (flacEncoder_ && !flacHeaderSent_) {
+    // Totals are unknown while streaming and stay zero
+    std::vector<uint8_t> header = BuildFlacHeader(flacEncoder_->config(), FlacStreamInfo());
+    frame.insert(frame.begin(), header.begin(), header.end());
+    flacHeaderSent_ = true;
+  }
+  if (packetizer_.enabled()) {
+    packetizer_.Stamp(frame, frames, extraFlags);
   }
+  deliveryQueue_.Push(std::move(frame));
+}
 
-  return byteBuffer;
+void WindowsLoopbackRecorderPlugin::FlushChunker() {
+  // Only fixed-frame mode pads the tail
+  uint16_t flags = chunker_.exactFrames() ? AUDIO_PACKET_PADDED : 0;
+  chunker_.Flush([this, flags](std::vector<uint8_t>& chunk) { QueueChunk(chunk, flags); });
 }
 
-// Volume monitoring methods implementation
-double WindowsLoopbackRecorderPlugin::CalculateRMS(const std::vector<BYTE>& audioBuffer) {
-  if (audioBuffer.empty()) {
-    return 0.0;
+void WindowsLoopbackRecorderPlugin::FlushEncoder() {
+  if (flacEncoder_) {
+    // The stream ends with a shorter frame rather than padding
+    flacEncoder_->Finish([this](std::vector<uint8_t>& frame, uint32_t frames) {
+      QueueEncodedFrame(frame, frames);
+    });
+    flacEncoder_.reset();
   }
 
-  // Convert BYTE buffer to 16-bit samples
-  const int16_t* samples = reinterpret_cast<const int16_t*>(audioBuffer.data());
-  size_t sampleCount = audioBuffer.size() / 2;
+  if (adpcmEncoder_) {
+    // ADPCM blocks have a fixed length, so the last one is padded
+    adpcmEncoder_->Flush([this](std::vector<uint8_t>& block, uint32_t frames) {
+      QueueEncodedFrame(block, frames, AUDIO_PACKET_PADDED);
+    });
+    adpcmEncoder_.reset();
+  }
+}
 
-  if (sampleCount == 0) {
-    return 0.0;
+bool WindowsLoopbackRecorderPlugin::StartFileRecording(const std::string& path,
+                                                       const SegmentOptions& segments,
+                                                       FileContainer container, bool peaks) {
+  if (currentState_ == RecordingState::IDLE) {
+    DebugOutput("StartFileRecording failed: not recording");
+    return false;
   }
 
-  // Calculate RMS (Root Mean Square)
-  double sum = 0.0;
-  for (size_t i = 0; i < sampleCount; i++) {
-    double sample = static_cast<double>(samples[i]) / 32768.0; // Normalize to [-1, 1]
-    sum += sample * sample;
+  WavFormat format = RecordedWavFormat();
+  if (container == FileContainer::FLAC && (format.floatSamples || format.bitsPerSample > 24)) {
+    DebugOutput("StartFileRecording failed: FLAC cannot hold %u-bit samples", format.bitsPerSample);
+    return false;
   }
 
-  double rms = sqrt(sum / sampleCount);
-  return rms;
-}
+  WavSinkOptions options;
+  options.container = container;
 
-double WindowsLoopbackRecorderPlugin::RMSToDecibels(double rms) {
-  if (rms <= 0.0) {
-    return -96.0; // Return -96dB for silence (practical minimum)
+  auto sink = std::make_unique<SegmentedWavSink>();
+  if (!sink->Open(path, format, segments,
+                  [this](const SegmentInfo& segment) { SendSegmentComplete(segment); },
+                  options)) {
+    DebugOutput("StartFileRecording failed: cannot create %s", path.c_str());
+    return false;
   }
 
-  // Convert RMS to decibels: 20 * log10(rms)
-  // Reference level: 1.0 RMS = 0 dB
-  double db = 20.0 * log10(rms);
+  std::shared_ptr<PeakPyramid> pyramid;
+  if (peaks) {
+    pyramid = std::make_shared<PeakPyramid>();
+    pyramid->Configure(format.sampleRate, format.channels);
+  }
 
-  // Clamp to reasonable range
-  if (db < -96.0) db = -96.0;
-  if (db > 0.0) db = 0.0;
+  // A file recording still running is finished without its peaks
+  std::unique_ptr<SegmentedWavSink> previous;
+  {
+    std::lock_guard<std::mutex> lock(fileSinkMutex_);
+    previous = std::move(fileSink_);
+    fileSink_ = std::move(sink);
+    filePeaks_ = std::move(pyramid);
+  }
+  if (previous) {
+    previous->Close();
+  }
+  return true;
+}
 
-  return db;
+WavFormat WindowsLoopbackRecorderPlugin::RecordedWavFormat() const {
+  WavFormat format;
+  format.sampleRate = audioConfig_.sampleRate;
+  format.channels = static_cast<uint16_t>(audioConfig_.channels);
+  format.bitsPerSample = static_cast<uint16_t>(engine_.bytesPerSample() * 8);
+  format.floatSamples = engine_.outputFormat() == SampleFormat::FLOAT32;
+  return format;
 }
 
-int WindowsLoopbackRecorderPlugin::DecibelsToPercentage(double db) {
-  // Convert dB to percentage
-  // -96dB = 0%, 0dB = 100%
-  // Linear mapping: percentage = (db + 96) / 96 * 100
+bool WindowsLoopbackRecorderPlugin::StopFileRecording(flutter::EncodableMap& summary) {
+  std::unique_ptr<SegmentedWavSink> sink;
+  std::shared_ptr<PeakPyramid> pyramid;
+  {
+    std::lock_guard<std::mutex> lock(fileSinkMutex_);
+    sink = std::move(fileSink_);
+    pyramid = std::move(filePeaks_);
+  }
+  if (!sink) {
+    return false;
+  }
+
+  // Draining to disk happens outside the lock so capture never waits on it
+  bool closed = sink->Close();
+  WavSinkStats stats = sink->GetStats();
 
-  if (db <= -96.0) return 0;
-  if (db >= 0.0) return 100;
+  // One peaks file spans every segment of a rotating recording
+  if (pyramid) {
+    std::string peaksPath = PeakPyramid::PathFor(sink->path());
+    if (pyramid->Save(peaksPath)) {
+      summary[flutter::EncodableValue("peaksPath")] = flutter::EncodableValue(peaksPath);
+    } else {
+      DebugOutput("StopFileRecording: cannot write %s", peaksPath.c_str());
+    }
+  }
 
-  int percentage = static_cast<int>((db + 96.0) / 96.0 * 100.0);
+  summary[flutter::EncodableValue("path")] = flutter::EncodableValue(sink->path());
+  summary[flutter::EncodableValue("dataBytes")] = flutter::EncodableValue(static_cast<int64_t>(stats.dataBytes));
+  summary[flutter::EncodableValue("fileBytes")] = flutter::EncodableValue(static_cast<int64_t>(stats.fileBytes));
+  summary[flutter::EncodableValue("frames")] = flutter::EncodableValue(static_cast<int64_t>(sink->totalFrames()));
+  summary[flutter::EncodableValue("droppedBytes")] = flutter::EncodableValue(static_cast<int64_t>(stats.droppedBytes));
+  summary[flutter::EncodableValue("rf64")] = flutter::EncodableValue(stats.rf64);
+  summary[flutter::EncodableValue("complete")] = flutter::EncodableValue(closed && !stats.writeError);
+  summary[flutter::EncodableValue("segments")] = flutter::EncodableValue(static_cast<int64_t>(sink->segmentCount()));
+  return true;
+}
 
-  // Ensure within bounds
-  if (percentage < 0) percentage = 0;
-  if (percentage > 100) percentage = 100;
+bool WindowsLoopbackRecorderPlugin::StartPreRoll(const PreRollOptions& options) {
+  preRollOptions_ = options;
+  preRollEnabled_ = true;
+  // While idle the ring is only armed; StartRecording creates it
+  if (currentState_ != RecordingState::IDLE && !CreatePreRoll()) {
+    preRollEnabled_ = false;
+    return false;
+  }
+  return true;
+}
 
-  return percentage;
+void WindowsLoopbackRecorderPlugin::StopPreRoll() {
+  preRollEnabled_ = false;
+  std::unique_ptr<PreRollBuffer> buffer;
+  {
+    std::lock_guard<std::mutex> lock(preRollMutex_);
+    buffer = std::move(preRoll_);
+  }
+  // Waiting for in-flight FLAC frames happens outside the lock
 }
 
-void WindowsLoopbackRecorderPlugin::SendVolumeUpdate(double rms) {
-  if (!volumeMonitoringEnabled_) {
-    return;
+bool WindowsLoopbackRecorderPlugin::CreatePreRoll() {
+  WavFormat format = RecordedWavFormat();
+
+  auto buffer = std::make_unique<PreRollBuffer>();
+  if (!buffer->Configure(format, preRollOptions_)) {
+    DebugOutput("Pre-roll failed: %u Hz, %u channel, %u-bit audio does not fit two blocks of a %zu byte budget",
+                format.sampleRate, format.channels, format.bitsPerSample, preRollOptions_.budgetBytes);
+    return false;
+  }
+  if (preRollOptions_.compressed && !buffer->options().compressed) {
+    DebugOutput("Pre-roll holds PCM: FLAC cannot hold %u-bit%s samples", format.bitsPerSample,
+                format.floatSamples ? " float" : "");
   }
 
-  std::lock_guard<std::mutex> lock(volumeEventSinkMutex_);
-  if (volumeEventSink_) {
-    double db = RMSToDecibels(rms);
-    int percentage = DecibelsToPercentage(db);
+  std::unique_ptr<PreRollBuffer> previous;
+  {
+    std::lock_guard<std::mutex> lock(preRollMutex_);
+    previous = std::move(preRoll_);
+    preRoll_ = std::move(buffer);
+  }
+  return true;
+}
 
-    // Create volume data map
-    flutter::EncodableMap volumeData;
-    volumeData[flutter::EncodableValue("rms")] = flutter::EncodableValue(rms);
-    volumeData[flutter::EncodableValue("db")] = flutter::EncodableValue(db);
-    volumeData[flutter::EncodableValue("percentage")] = flutter::EncodableValue(percentage);
-    volumeData[flutter::EncodableValue("timestamp")] = flutter::EncodableValue(
-        std::chrono::duration_cast<std::chrono::milliseconds>(
-            std::chrono::steady_clock::now().time_since_epoch()).count());
+bool WindowsLoopbackRecorderPlugin::SnapshotPreRoll(uint32_t seconds, PreRollSnapshot& snapshot) {
+  std::lock_guard<std::mutex> lock(preRollMutex_);
+  if (!preRoll_) {
+    return false;
+  }
+  snapshot = preRoll_->Snapshot(static_cast<uint64_t>(seconds) * audioConfig_.sampleRate);
+  return snapshot.frames > 0;
+}
 
-    volumeEventSink_->Success(flutter::EncodableValue(volumeData));
+void WindowsLoopbackRecorderPlugin::SendSegmentComplete(const SegmentInfo& segment) {
+  std::lock_guard<std::mutex> lock(fileEventSinkMutex_);
+  if (!fileEventSink_) {
+    return;
   }
+
+  flutter::EncodableMap event;
+  event[flutter::EncodableValue("event")] = flutter::EncodableValue("segmentComplete");
+  event[flutter::EncodableValue("path")] = flutter::EncodableValue(segment.path);
+  event[flutter::EncodableValue("index")] = flutter::EncodableValue(static_cast<int64_t>(segment.index));
+  event[flutter::EncodableValue("firstFrame")] = flutter::EncodableValue(static_cast<int64_t>(segment.firstFrame));
+  event[flutter::EncodableValue("frameCount")] = flutter::EncodableValue(static_cast<int64_t>(segment.frameCount));
+  event[flutter::EncodableValue("droppedBytes")] = flutter::EncodableValue(static_cast<int64_t>(segment.stats.droppedBytes));
+  event[flutter::EncodableValue("complete")] = flutter::EncodableValue(segment.complete);
+  fileEventSink_->Success(flutter::EncodableValue(event));
 }
 
-bool WindowsLoopbackRecorderPlugin::StartVolumeMonitoring() {
-  volumeMonitoringEnabled_ = true;
+bool WindowsLoopbackRecorderPlugin::AttachAudioPort(int64_t port, int64_t postCObjectAddress) {
+  if (port == 0 || postCObjectAddress == 0) {
+    return false;
+  }
+
+  auto postCObject = reinterpret_cast<Dart_PostCObject_Type>(
+      static_cast<intptr_t>(postCObjectAddress));
+
+  std::lock_guard<std::mutex> lock(eventSinkMutex_);
+  audioPort_ = std::make_unique<DartNativePort>(port, postCObject);
+  DebugOutput("Audio delivery switched to native port %lld", static_cast<long long>(port));
   return true;
 }
 
-bool WindowsLoopbackRecorderPlugin::StopVolumeMonitoring() {
-  volumeMonitoringEnabled_ = false;
-  return true;
+void WindowsLoopbackRecorderPlugin::DetachAudioPort() {
+  std::lock_guard<std::mutex> lock(eventSinkMutex_);
+  audioPort_.reset();
+}
+
+bool WindowsLoopbackRecorderPlugin::DeliverAudio(DeliveryItem& item) {
+  std::lock_guard<std::mutex> lock(eventSinkMutex_);
+
+  // Silence markers travel as a bare byte count; Dart expands them. Streams
+  // with packet headers get stamped silent packets instead.
+  bool isMarker = item.data.empty();
+  int64_t silenceBytes = static_cast<int64_t>(item.silenceBytes);
+
+  if (audioPort_) {
+    // Ownership of the buffer moves to the receiving isolate; no copy.
+    bool posted = isMarker ? audioPort_->PostInt64(silenceBytes)
+                           : audioPort_->PostBuffer(item.data);
+    if (posted) {
+      return true;
+    }
+    // The receiving isolate is gone; fall back to the event channel.
+    DebugOutput("Native port %lld closed, detaching", static_cast<long long>(audioPort_->port()));
+    audioPort_.reset();
+  }
+
+  if (eventSink_) {
+    if (isMarker) {
+      eventSink_->Success(flutter::EncodableValue(silenceBytes));
+    } else {
+      eventSink_->Success(flutter::EncodableValue(std::move(item.data)));
+    }
+    return true;
+  }
+  return false;
 }
 
 }  // namespace windows_loopback_recorder
@@ -0,0 +1,58 @@
+#include "windows_loopback_recorder/worker_pool.h"
+
+#include <algorithm>
+
+namespace windows_loopback_recorder {
+
+WorkerPool::WorkerPool(size_t threadCount) {
+  threadCount = std::max<size_t>(threadCount, 1);
+  threads_.reserve(threadCount);
+  for (size_t i = 0; i < threadCount; i++) {
+    threads_.emplace_back(&WorkerPool::WorkerThreadFunction, this);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+void WorkerPool::Submit(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+  wake_.notify_one();
+}
+
+WorkerPool& WorkerPool::Shared() {
+  static WorkerPool pool([] {
+    unsigned cores = std::thread::hardware_concurrency();
+    return static_cast<size_t>(std::clamp(cores > 1 ? cores - 1 : 1u, 1u, 4u));
+  }());
+  return pool;
+}
+
+void WorkerPool::WorkerThreadFunction() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    wake_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+    if (tasks_.empty()) {
+      break;  // Stopping with nothing left to run
+    }
+
+    std::function<void()> task = std::move(tasks_.front());
+    tasks_.pop_front();
+    lock.unlock();
+    task();
+    lock.lock();
+  }
+}
+
+}  // namespace windows_loopback_recorder